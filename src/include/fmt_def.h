@@ -27,12 +27,13 @@ extern "C" {
 #define FMT_VERSION "v0.2.1"
 
 /* Thread Prority */
-#define VEHICLE_THREAD_PRIORITY    3
-#define FMTIO_THREAD_PRIORITY      4
-#define LOGGER_THREAD_PRIORITY     10
-#define MAVLINK_RX_THREAD_PRIORITY 11
-#define COMM_THREAD_PRIORITY       12
-#define STATUS_THREAD_PRIORITY     13
+#define VEHICLE_THREAD_PRIORITY      3
+#define FMTIO_THREAD_PRIORITY        4
+#define MCN_DISPATCH_THREAD_PRIORITY 5
+#define LOGGER_THREAD_PRIORITY       10
+#define MAVLINK_RX_THREAD_PRIORITY   11
+#define COMM_THREAD_PRIORITY         12
+#define STATUS_THREAD_PRIORITY       13
 
 #if !defined(bool) && !defined(__cplusplus)
 typedef int bool;
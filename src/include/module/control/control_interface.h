@@ -27,6 +27,7 @@ extern fmt_model_info_t control_model_info;
 
 void control_interface_init(void);
 void control_interface_step(uint32_t timestamp);
+void control_interface_reset(void);
 
 #ifdef __cplusplus
 }
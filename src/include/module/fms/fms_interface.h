@@ -27,6 +27,9 @@ extern fmt_model_info_t fms_model_info;
 
 void fms_interface_init(void);
 void fms_interface_step(uint32_t timestamp);
+fmt_err_t fms_interface_replay_input(uint8_t msg_id, const void* payload, uint16_t len);
+void fms_interface_replay_step(void);
+void fms_interface_reset(void);
 
 #ifdef __cplusplus
 }
@@ -61,6 +61,9 @@ extern fmt_model_info_t ins_model_info;
 
 void ins_interface_init(void);
 void ins_interface_step(uint32_t timestamp);
+fmt_err_t ins_interface_replay_input(uint8_t msg_id, const void* payload, uint16_t len);
+void ins_interface_replay_step(void);
+void ins_interface_reset(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MCN_RECORD_H__
+#define MCN_RECORD_H__
+
+#include <firmament.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCN_CAPTURE_MAGIC          0x52434D55 /* "UMCR" */
+#define MCN_CAPTURE_VERSION        1
+#define MCN_RECORD_BUFFER_SIZE     16384
+
+/* replay mode */
+#define MCN_REPLAY_FAST            0 /* publish records as fast as possible */
+#define MCN_REPLAY_REALTIME        1 /* publish records at original timing */
+
+/* Capture file layout, in native byte order:
+ * McnCaptureHeader | McnRecordHeader | topic data | McnRecordHeader | topic data | ... */
+typedef struct mcn_capture_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size; /* size of McnRecordHeader */
+    uint64_t start_time;  /* time (us) recording started */
+} McnCaptureHeader;
+
+typedef struct mcn_record_header {
+    uint32_t topic_id;
+    uint32_t size;      /* size of topic data followed */
+    uint64_t timestamp; /* publish time (us) */
+} McnRecordHeader;
+
+typedef struct mcn_record_stats {
+    uint8_t running;
+    uint32_t record_cnt;  /* records put into ring buffer */
+    uint32_t drop_cnt;    /* records dropped as ring buffer is full */
+    uint32_t write_error; /* failed file writes */
+    uint64_t bytes;       /* bytes written into file */
+    uint32_t buffer_size;
+    uint32_t peak_usage;  /* peak usage of ring buffer (bytes) */
+    uint32_t duration_ms;
+    uint64_t hook_time;   /* time (us) spent in publish context */
+} McnRecordStats;
+
+typedef struct mcn_replay_stats {
+    uint32_t replay_cnt;  /* records published */
+    uint32_t skip_cnt;    /* records of unknown topic or mismatched size */
+    uint32_t fail_cnt;    /* records failed to publish, e.g, topic suspended */
+    uint32_t capture_ms;  /* time span of the capture */
+    uint32_t duration_ms; /* time spent to replay */
+    McnHist error;        /* lateness of publish against original timing, realtime mode only */
+} McnReplayStats;
+
+fmt_err_t mcn_record_init(void);
+fmt_err_t mcn_record_start(const char* file_name, uint32_t buffer_size);
+fmt_err_t mcn_record_stop(void);
+fmt_err_t mcn_record_topic(McnHub_t hub, bool enable);
+void mcn_record_async_output(void);
+void mcn_record_get_stats(McnRecordStats* stats);
+fmt_err_t mcn_replay(const char* file_name, uint8_t mode, McnReplayStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MCN_SCHEMA_H__
+#define MCN_SCHEMA_H__
+
+#include <firmament.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* size of text buffer used by mcn_schema_echo() */
+#define MCN_SCHEMA_TEXT_SIZE 512
+/* max size of topic data which can be printed by mcn_schema_echo() */
+#define MCN_SCHEMA_ECHO_SIZE 512
+
+/* field type, which has the same encoding as mlog element type */
+enum {
+    MCN_INT8 = 0,
+    MCN_UINT8,
+    MCN_INT16,
+    MCN_UINT16,
+    MCN_INT32,
+    MCN_UINT32,
+    MCN_FLOAT,
+    MCN_DOUBLE,
+    MCN_BOOLEAN,
+};
+
+typedef struct mcn_field {
+    const char* name;
+    uint16_t offset;
+    uint16_t size; /* size of the member, must be num * size of type */
+    uint8_t type;
+    uint8_t num; /* array length, 1 for scalar */
+} McnField;
+
+typedef struct mcn_schema McnSchema;
+struct mcn_schema {
+    const char* name;
+    uint16_t size; /* size of the struct */
+    uint16_t field_num;
+    const McnField* field;
+    /* packer generated by MCN_SCHEMA_DEFINE(), see mcn_schema_pack() */
+    uint32_t (*pack)(const void* data, void* buffer);
+};
+
+/* The field loop of generated packer is unrolled at compile time, so each field
+ * is copied with constant offset and size, as a handwritten serializer does */
+#if defined(__GNUC__) && __GNUC__ >= 8
+    #define MCN_SCHEMA_UNROLL _Pragma("GCC unroll 64")
+#else
+    #define MCN_SCHEMA_UNROLL
+#endif
+
+static inline __attribute__((always_inline)) uint32_t __mcn_schema_pack_fields(const McnField* field,
+    uint32_t field_num, const void* data, void* buffer)
+{
+    const uint8_t* src = (const uint8_t*)data;
+    uint8_t* dst = (uint8_t*)buffer;
+    uint32_t len = 0;
+
+    MCN_SCHEMA_UNROLL
+    for (uint32_t i = 0; i < field_num; i++) {
+        memcpy(&dst[len], &src[field[i].offset], field[i].size);
+        len += field[i].size;
+    }
+
+    return len;
+}
+
+/******************* Helper Macro *******************/
+/* Describe a scalar member of struct */
+#define MCN_FIELD(_struct, _member, _type)                                                                  \
+    {                                                                                                       \
+        .name = #_member, .offset = offsetof(_struct, _member), .size = sizeof(((_struct*)0)->_member), \
+        .type = _type, .num = 1                                                                             \
+    }
+/* Describe an array member of struct */
+#define MCN_FIELD_VEC(_struct, _member, _type)                                                              \
+    {                                                                                                       \
+        .name = #_member, .offset = offsetof(_struct, _member), .size = sizeof(((_struct*)0)->_member), \
+        .type = _type, .num = sizeof(((_struct*)0)->_member) / sizeof(((_struct*)0)->_member[0])            \
+    }
+/* Obtain the schema of struct */
+#define MCN_SCHEMA(_struct) (&__mcn_schema_##_struct)
+/* Declare the schema of struct */
+#define MCN_SCHEMA_DECLARE(_struct) extern const McnSchema __mcn_schema_##_struct
+/* Define the schema of struct from its fields, e.g,
+ * MCN_SCHEMA_DEFINE(mag_data_t, MCN_FIELD(mag_data_t, timestamp_ms, MCN_UINT32),
+ *                   MCN_FIELD_VEC(mag_data_t, mag_B_gauss, MCN_FLOAT)); */
+#define MCN_SCHEMA_DEFINE(_struct, ...)                                                        \
+    static const McnField __mcn_field_##_struct[] = { __VA_ARGS__ };                          \
+    static uint32_t __mcn_pack_##_struct(const void* data, void* buffer)                      \
+    {                                                                                          \
+        return __mcn_schema_pack_fields(__mcn_field_##_struct,                                 \
+            sizeof(__mcn_field_##_struct) / sizeof(McnField), data, buffer);                   \
+    }                                                                                          \
+    const McnSchema __mcn_schema_##_struct = {                                                \
+        .name = #_struct,                                                                      \
+        .size = sizeof(_struct),                                                               \
+        .field_num = sizeof(__mcn_field_##_struct) / sizeof(McnField),                         \
+        .field = __mcn_field_##_struct,                                                        \
+        .pack = __mcn_pack_##_struct                                                           \
+    }
+
+/******************* API *******************/
+fmt_err_t mcn_schema_check(const McnSchema* schema);
+fmt_err_t mcn_set_schema(McnHub_t hub, const McnSchema* schema);
+uint32_t mcn_schema_type_size(uint8_t type);
+const char* mcn_schema_type_name(uint8_t type);
+const McnField* mcn_schema_find_field(const McnSchema* schema, const char* name);
+uint32_t mcn_schema_packed_size(const McnSchema* schema);
+uint32_t mcn_schema_pack_fields(const McnSchema* schema, const void* data, void* buffer);
+int mcn_schema_format(const McnSchema* schema, const void* data, char* buffer, uint32_t size);
+int mcn_schema_echo(void* parameter);
+
+/**
+ * @brief Pack fields of topic data back to back, in the order of schema
+ * @note Schemas defined by MCN_SCHEMA_DEFINE() are packed by their generated
+ * packer, others by mcn_schema_pack_fields(). It's inlined, so the packer is
+ * called directly by the caller.
+ *
+ * @param schema Topic schema
+ * @param data Topic data
+ * @param buffer Buffer to receive packed data, at least mcn_schema_packed_size()
+ * @return uint32_t Packed size
+ */
+static inline uint32_t mcn_schema_pack(const McnSchema* schema, const void* data, void* buffer)
+{
+    if (schema->pack != NULL) {
+        return schema->pack(data, buffer);
+    }
+
+    return mcn_schema_pack_fields(schema, data, buffer);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
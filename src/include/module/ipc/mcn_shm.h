@@ -0,0 +1,39 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MCN_SHM_H__
+#define MCN_SHM_H__
+
+#include <firmament.h>
+
+#include "module/ipc/mcn_shm_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Shared memory transport, which mirrors uMCN topics into a POSIX shared memory
+ * segment for external processes. Only available on Linux builds with
+ * FMT_USING_MCN_SHM defined, external processes read the segment with the
+ * client in mcn_shm_client.h. */
+
+fmt_err_t mcn_shm_start(const char* shm_name, McnHub_t* hubs, uint32_t hub_num);
+fmt_err_t mcn_shm_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
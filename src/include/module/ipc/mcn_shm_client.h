@@ -0,0 +1,76 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MCN_SHM_CLIENT_H__
+#define MCN_SHM_CLIENT_H__
+
+/* Client of uMCN shared memory transport, used by external processes on Linux.
+ * It only depends on libc, link mcn_shm_client.c into the process (and -lrt
+ * for old glibc) to read topics mirrored by mcn_shm_start(). */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCN_SHM_MAGIC    0x534E434D /* "MCNS" */
+#define MCN_SHM_VERSION  1
+#define MCN_SHM_NAME_LEN 32
+#define MCN_SHM_ALIGN    64
+
+/* Segment layout:
+ * McnShmHeader | McnShmTopic[topic_num] | topic data | topic data | ...
+ * Each topic is guarded by a seqlock, seq is odd while the topic is being
+ * written and advanced by 2 for each publish. */
+typedef struct mcn_shm_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t topic_num;
+    uint32_t segment_size;
+    uint32_t topic_offset; /* offset of topic table */
+    uint64_t start_time;   /* time (us) mirroring started */
+} McnShmHeader;
+
+typedef struct mcn_shm_topic {
+    char name[MCN_SHM_NAME_LEN];
+    uint32_t size;        /* size of topic data */
+    uint32_t data_offset; /* offset of topic data in segment */
+    volatile uint32_t seq;
+    uint32_t reserved;
+    volatile uint64_t timestamp; /* publish time (us) of the latest sample */
+    uint8_t padding[MCN_SHM_ALIGN - MCN_SHM_NAME_LEN - 24];
+} McnShmTopic;
+
+typedef struct mcn_shm_client {
+    int fd;
+    uint8_t* base;
+    uint32_t size;
+    const McnShmHeader* header;
+    const McnShmTopic* topic;
+} McnShmClient;
+
+int mcn_shm_client_open(McnShmClient* client, const char* shm_name);
+void mcn_shm_client_close(McnShmClient* client);
+const McnShmTopic* mcn_shm_client_find(const McnShmClient* client, const char* topic_name);
+int mcn_shm_client_poll(const McnShmTopic* topic, uint32_t last_seq);
+int mcn_shm_client_read(const McnShmClient* client, const McnShmTopic* topic, void* buffer, uint32_t* seq,
+                        uint64_t* timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
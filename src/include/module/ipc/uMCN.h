@@ -30,42 +30,182 @@ extern "C" {
 #define MCN_SEND_EVENT(event)       rt_sem_release(event)
 #define MCN_WAIT_EVENT(event, time) rt_sem_take(event, time)
 #define MCN_ASSERT(EX)              RT_ASSERT(EX)
+#define MCN_MEMORY_BARRIER()        __sync_synchronize()
+#define MCN_GET_TIME_MS()           systime_now_ms()
+#define MCN_GET_TIME_US()           systime_now_us()
+
+#define MCN_WAITSET_OBJECT                       struct rt_event
+#define MCN_WAITSET_INIT(ws, name)               rt_event_init(ws, name, RT_IPC_FLAG_FIFO)
+#define MCN_WAITSET_DETACH(ws)                   rt_event_detach(ws)
+#define MCN_WAITSET_SIGNAL(ws, set)              rt_event_send(ws, set)
+#define MCN_WAITSET_WAIT(ws, set, time, recved)  rt_event_recv(ws, set, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, time, recved)
 
 #define MCN_MAX_LINK_NUM        30
 #define MCN_FREQ_EST_WINDOW_LEN 5
+#define MCN_SEQLOCK_MAX_RETRY   3
+#define MCN_MAX_QUEUE_DEPTH     127
+#define MCN_MAX_BORROW_NUM      8
+/* bin i of timing histogram holds values in [2^(i-1), 2^i) us, the last bin also holds all larger values */
+#define MCN_HIST_BIN_NUM        21
+#define MCN_PROFILE_MAGIC       0x50434D55 /* "UMCP" */
+#define MCN_PROFILE_VERSION     1
+/* deferred callback dispatcher */
+#define MCN_DISPATCH_QUEUE_SIZE 32
+#define MCN_DISPATCH_STACK_SIZE 2048
+#define MCN_MAX_INSTANCE_NUM    4
+
+/* Static mode: topic data and subscribe nodes are allocated from static
+ * storage instead of heap. The storage of each topic is declared by MCN_DEFINE(),
+ * MCN_DEFINE_QUEUE() or MCN_DEFINE_LOAN(), which must match the advertise call. */
+#ifdef FMT_USING_MCN_STATIC
+    #ifndef MCN_STATIC_NODE_NUM
+        #define MCN_STATIC_NODE_NUM 64
+    #endif
+    #ifndef MCN_STATIC_REGISTRY_SIZE
+        #define MCN_STATIC_REGISTRY_SIZE 256
+    #endif
+    #ifndef MCN_STATIC_PROFILE_NUM
+        #define MCN_STATIC_PROFILE_NUM 4
+    #endif
+#endif
+
+typedef struct mcn_waitset McnWaitset;
+typedef struct mcn_waitset* McnWaitset_t;
+struct mcn_waitset {
+    MCN_WAITSET_OBJECT event;
+    uint32_t attach_mask;
+};
+
+/* timing histogram with microsecond log2 bins */
+typedef struct mcn_hist {
+    uint64_t sum;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t bin[MCN_HIST_BIN_NUM];
+} McnHist;
+
+typedef struct mcn_profile McnProfile;
+typedef struct mcn_profile* McnProfile_t;
+struct mcn_profile {
+    McnHist interval; /* publish inter-arrival time */
+    McnHist latency;  /* publish to subscriber copy latency */
+    uint64_t start_time;
+    uint64_t last_publish; /* publish time of the latest sample */
+};
+
+/* binary record dumped by mcn_profile_dump(), in native byte order */
+typedef struct mcn_profile_record {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bin_num;
+    uint32_t topic_id;
+    uint32_t duration_ms;
+    McnHist interval;
+    McnHist latency;
+} McnProfileRecord;
 
 typedef struct mcn_node McnNode;
 typedef struct mcn_node* McnNode_t;
+typedef struct mcn_hub* McnHub_t;
 struct mcn_node {
     volatile uint8_t renewal;
+    uint32_t cursor; /* index of the last sample read */
+    uint32_t lost;   /* number of samples overwritten before read */
     MCN_EVENT_HANDLE event;
+    McnWaitset_t waitset;
+    uint32_t wait_mask;
+    /* publish throttle */
+    uint32_t min_interval; /* min interval (ms) between delivered publishes */
+    uint32_t last_deliver;
+    uint16_t decimation; /* deliver one of every decimation publishes */
+    uint16_t decimation_cnt;
+    uint32_t skipped; /* number of publishes skipped by throttle */
     void (*pub_cb)(void* parameter);
+    /* deferred callback dispatch, pub_cb is called inline if dispatch_buf is NULL */
+    McnHub_t dispatch_hub;
+    void* dispatch_buf; /* copy of the sample passed to deferred callback */
+    uint8_t dispatch_pending;
+    uint32_t coalesced; /* publishes merged into a pending callback */
+    uint32_t overflow;  /* publishes dropped as dispatch queue is full */
     McnNode_t next;
 };
 
 typedef struct mcn_hub McnHub;
-typedef struct mcn_hub* McnHub_t;
+
+typedef struct mcn_list McnList;
+typedef struct mcn_list* McnList_t;
+struct mcn_list {
+    McnHub_t hub;
+    McnList_t next;
+};
+
 struct mcn_hub {
     const char* obj_name;
     const uint32_t obj_size;
+    uint32_t id; /* topic id, hash of topic name */
     void* pdata;
+    /* sequence counter of the topic data ring, odd while a publish is in progress */
+    volatile uint32_t seq;
+    /* publishes dropped since another publish of the topic was in progress */
+    uint32_t busy_drop;
+    uint16_t buffer_num;
+    /* zero-copy borrow, only for topic advertised by mcn_advertise_loan() */
+    uint8_t* buf_map; /* ring slot to buffer index */
+    uint8_t* pin_cnt; /* borrow count of each buffer */
+    uint8_t* spare;   /* buffers not in ring */
+    uint8_t spare_num;
+    uint8_t pin_num;
     McnNode_t link_head;
     McnNode_t link_tail;
     uint32_t link_num;
     uint8_t published;
     uint8_t suspend;
     int (*echo)(void* parameter);
+    /* publish hook is called if set, see mcn_set_publish_hook() */
+    uint8_t record;
+    /* mirror hook is called if set, see mcn_set_mirror_hook() */
+    void* mirror;
+    /* field layout of topic data, see mcn_set_schema() */
+    const struct mcn_schema* schema;
+    /* timing profile, only allocated while profiling */
+    McnProfile_t profile;
+#ifdef FMT_USING_MCN_STATIC
+    /* static storage declared by MCN_DEFINE() */
+    void* storage;
+    uint32_t storage_size;
+    McnList_t list_node;
+#endif
     /* publish freq estimate */
     float freq;
     uint16_t freq_est_window[MCN_FREQ_EST_WINDOW_LEN];
     uint16_t window_index;
 };
 
-typedef struct mcn_list McnList;
-typedef struct mcn_list* McnList_t;
-struct mcn_list {
-    McnHub_t hub;
-    McnList_t next;
+/* Multi-instance topic, which groups the instances of the same kind of topic
+ * (e.g, imu of different sensors) and selects the primary instance for consumers */
+typedef struct mcn_multi McnMulti;
+typedef struct mcn_multi* McnMulti_t;
+struct mcn_multi {
+    const char* name;
+    McnHub_t instance[MCN_MAX_INSTANCE_NUM];
+    uint8_t instance_num;
+    uint8_t primary;
+    /* instance with higher score is preferred, e.g, priority or health */
+    int16_t score[MCN_MAX_INSTANCE_NUM];
+    /* instance not updated within timeout (ms) is unusable, 0 to disable */
+    uint32_t timeout;
+    uint32_t last_seq[MCN_MAX_INSTANCE_NUM];
+    uint32_t last_update[MCN_MAX_INSTANCE_NUM];
+    uint32_t switch_cnt;
+    void (*on_switch)(McnMulti_t multi, uint8_t from, uint8_t to);
+};
+
+typedef struct mcn_multi_node McnMultiNode;
+typedef struct mcn_multi_node* McnMultiNode_t;
+struct mcn_multi_node {
+    McnMulti_t multi;
+    McnNode_t node[MCN_MAX_INSTANCE_NUM];
 };
 
 /******************* Helper Macro *******************/
@@ -74,34 +214,129 @@ struct mcn_list {
 /* Declare a uMCN topic. Declare the topic at places where you need use it */
 #define MCN_DECLARE(_name) extern McnHub __mcn_##_name
 /* Define a uMCN topic. A topic should only be defined once */
-#define MCN_DEFINE(_name, _size) \
-    McnHub __mcn_##_name = {     \
-        .obj_name = #_name,      \
-        .obj_size = _size,       \
-        .pdata = NULL,           \
-        .link_head = NULL,       \
-        .link_tail = NULL,       \
-        .link_num = 0,           \
-        .published = 0,          \
-        .suspend = 0,            \
-        .freq = 0.0f             \
+#define MCN_DEFINE(_name, _size) MCN_DEFINE_LOAN(_name, _size, 1, 0)
+/* Define a uMCN topic to be advertised by mcn_advertise_queue() */
+#define MCN_DEFINE_QUEUE(_name, _size, _depth) MCN_DEFINE_LOAN(_name, _size, _depth, 0)
+/* Define a uMCN topic to be advertised by mcn_advertise_loan() */
+#define MCN_DEFINE_LOAN(_name, _size, _depth, _borrow)   \
+    MCN_DEFINE_STORAGE(_name, _size, _depth, _borrow) \
+    McnHub __mcn_##_name = {                          \
+        .obj_name = #_name,                           \
+        .obj_size = _size,                            \
+        .id = 0,                                      \
+        .pdata = NULL,                                \
+        .seq = 0,                                     \
+        .buffer_num = 0,                              \
+        .buf_map = NULL,                              \
+        .link_head = NULL,                            \
+        .link_tail = NULL,                            \
+        .link_num = 0,                                \
+        .published = 0,                               \
+        .suspend = 0,                                 \
+        .record = 0,                                  \
+        .mirror = NULL,                               \
+        .schema = NULL,                               \
+        .profile = NULL,                              \
+        MCN_STORAGE_INIT(_name)                       \
+        .freq = 0.0f                                  \
+    };                                                \
+    MCN_EXPORT(_name)
+#ifdef FMT_USING_MCN_STATIC
+/* number of ring buffers for queue depth, see mcn_advertise_queue() */
+#define MCN_BUFFER_NUM(_depth) \
+    ((_depth) < 2 ? 2 : (_depth) < 4 ? 4 : (_depth) < 8 ? 8 : (_depth) < 16 ? 16 : (_depth) < 32 ? 32 : (_depth) < 64 ? 64 : 128)
+/* topic data buffers, plus buffer map, pin count and spare list for borrow */
+#define MCN_STORAGE_SIZE(_size, _depth, _borrow) \
+    ((MCN_BUFFER_NUM(_depth) + (_borrow)) * (_size) + ((_borrow) ? 2 * (MCN_BUFFER_NUM(_depth) + (_borrow)) : 0))
+/* the storage is sized here, so the limits of advertise are checked at compile time */
+#define MCN_DEFINE_STORAGE(_name, _size, _depth, _borrow)                                   \
+    _Static_assert((_depth) >= 1 && (_depth) <= MCN_MAX_QUEUE_DEPTH,                         \
+        "mcn topic " #_name ": queue depth out of range");                                  \
+    _Static_assert((_borrow) <= MCN_MAX_BORROW_NUM, "mcn topic " #_name ": too many borrow"); \
+    static uint64_t __mcn_storage_##_name[(MCN_STORAGE_SIZE(_size, _depth, _borrow) + 7) / 8]; \
+    static McnList __mcn_list_##_name;
+#define MCN_STORAGE_INIT(_name)                     \
+    .storage = __mcn_storage_##_name,               \
+    .storage_size = sizeof(__mcn_storage_##_name), \
+    .list_node = &__mcn_list_##_name,
+#else
+#define MCN_DEFINE_STORAGE(_name, _size, _depth, _borrow)
+#define MCN_STORAGE_INIT(_name)
+#endif
+/* Obtain multi-instance topic according to name */
+#define MCN_MULTI(_name) (&__mcn_multi_##_name)
+/* Declare a multi-instance topic */
+#define MCN_MULTI_DECLARE(_name) extern McnMulti __mcn_multi_##_name
+/* Define a multi-instance topic from instance hubs, e.g,
+ * MCN_MULTI_DEFINE(sensor_imu, 20, MCN_HUB(sensor_imu0), MCN_HUB(sensor_imu1)) */
+#define MCN_MULTI_DEFINE(_name, _timeout, ...)                                \
+    McnMulti __mcn_multi_##_name = {                                         \
+        .name = #_name,                                                      \
+        .instance = { __VA_ARGS__ },                                         \
+        .instance_num = sizeof((McnHub_t[]) { __VA_ARGS__ }) / sizeof(McnHub_t), \
+        .primary = 0,                                                        \
+        .timeout = _timeout,                                                 \
+        .switch_cnt = 0,                                                     \
+        .on_switch = NULL                                                    \
     }
+/* Export topic into McnTab section to build the topic registry */
+#define MCN_EXPORT(_name) \
+    RT_USED static McnHub_t const __mcn_entry_##_name SECTION("McnTab") = &__mcn_##_name
 
 /******************* API *******************/
 fmt_err_t mcn_init(void);
 fmt_err_t mcn_advertise(McnHub_t hub, int (*echo)(void* parameter));
+fmt_err_t mcn_advertise_queue(McnHub_t hub, uint16_t queue_depth, int (*echo)(void* parameter));
+fmt_err_t mcn_advertise_loan(McnHub_t hub, uint16_t queue_depth, uint8_t borrow_num, int (*echo)(void* parameter));
 McnNode_t mcn_subscribe(McnHub_t hub, MCN_EVENT_HANDLE event, void (*pub_cb)(void* parameter));
 fmt_err_t mcn_unsubscribe(McnHub_t hub, McnNode_t node);
 fmt_err_t mcn_publish(McnHub_t hub, const void* data);
+void* mcn_loan(McnHub_t hub);
+fmt_err_t mcn_commit(McnHub_t hub);
+const void* mcn_borrow(McnHub_t hub, McnNode_t node_t);
+fmt_err_t mcn_release(McnHub_t hub, const void* data);
 bool mcn_poll(McnNode_t node_t);
 bool mcn_poll_sync(McnNode_t node_t, int32_t timeout);
 fmt_err_t mcn_copy(McnHub_t hub, McnNode_t node_t, void* buffer);
+fmt_err_t mcn_copy_n(McnHub_t hub, McnNode_t node_t, void* buffer, uint32_t* num, uint32_t* lost);
 fmt_err_t mcn_copy_from_hub(McnHub_t hub, void* buffer);
 void mcn_suspend(McnHub_t hub);
 void mcn_resume(McnHub_t hub);
 McnList_t mcn_get_list(void);
 McnHub_t mcn_iterate(McnList_t* ite);
+McnHub_t mcn_find(const char* name);
+McnHub_t mcn_find_by_id(uint32_t id);
+uint32_t mcn_topic_id(const char* name);
+uint32_t mcn_get_topic_num(void);
+uint32_t mcn_get_topic_mem(McnHub_t hub);
+#ifdef FMT_USING_MCN_STATIC
+void mcn_get_node_pool_usage(uint32_t* used, uint32_t* total);
+#endif
 void mcn_node_clear(McnNode_t node_t);
+void mcn_node_throttle(McnNode_t node_t, uint32_t min_interval, uint16_t decimation);
+fmt_err_t mcn_node_defer_callback(McnHub_t hub, McnNode_t node_t, void* buffer);
+void mcn_get_dispatch_stats(uint32_t* peak, uint32_t* overflow);
+fmt_err_t mcn_waitset_init(McnWaitset_t waitset, const char* name);
+fmt_err_t mcn_waitset_deinit(McnWaitset_t waitset);
+fmt_err_t mcn_waitset_attach(McnWaitset_t waitset, McnNode_t node_t, uint8_t bit);
+fmt_err_t mcn_waitset_detach(McnWaitset_t waitset, McnNode_t node_t);
+uint32_t mcn_waitset_wait(McnWaitset_t waitset, int32_t timeout);
+fmt_err_t mcn_multi_subscribe(McnMulti_t multi, McnMultiNode_t multi_node, MCN_EVENT_HANDLE event);
+fmt_err_t mcn_multi_unsubscribe(McnMultiNode_t multi_node);
+bool mcn_multi_poll(McnMultiNode_t multi_node);
+fmt_err_t mcn_multi_copy(McnMultiNode_t multi_node, void* buffer);
+uint8_t mcn_multi_select(McnMulti_t multi);
+void mcn_multi_set_score(McnMulti_t multi, uint8_t instance, int16_t score);
+void mcn_multi_set_switch_cb(McnMulti_t multi, void (*on_switch)(McnMulti_t multi, uint8_t from, uint8_t to));
+fmt_err_t mcn_profile_start(McnHub_t hub);
+fmt_err_t mcn_profile_stop(McnHub_t hub);
+fmt_err_t mcn_profile_get(McnHub_t hub, McnProfile_t profile);
+fmt_err_t mcn_profile_dump(McnHub_t hub, McnProfileRecord* record);
+void mcn_hist_add(McnHist* hist, uint32_t val);
+void mcn_hist_reset(McnHist* hist);
+uint32_t mcn_hist_percentile(const McnHist* hist, float percent);
+void mcn_set_publish_hook(void (*hook)(McnHub_t hub, const void* data));
+void mcn_set_mirror_hook(void (*hook)(McnHub_t hub, const void* data));
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,8 @@
 
 #include <firmament.h>
 
+#include "module/log/mlog_format.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -30,19 +32,13 @@ extern "C" {
 #define LOGPACKED(__Declaration__) __pragma(pack(push, 1)) __Declaration__ __pragma(pack(pop))
 #endif
 
-#define MLOG_VERSION 1
-
-#define MLOG_BEGIN_MSG1 0x92
-#define MLOG_BEGIN_MSG2 0x05
-#define MLOG_END_MSG    0x26
-
 #define MLOG_MAX_NAME_LEN     20
 #define MLOG_DESCRIPTION_SIZE 128
 #define MLOG_MODEL_INFO_SIZE  256
 
 /* MLog Msg ID */
 enum {
-    /* must start from 1 */
+    /* must start from 1, MLOG_INDEX_ID is reserved */
     MLOG_IMU_ID = 1,
     MLOG_MAG_ID,
     MLOG_BARO_ID,
@@ -63,18 +59,7 @@ enum {
     MLOG_CB_START,
     MLOG_CB_STOP,
     MLOG_CB_UPDATE,
-};
-
-enum {
-    MLOG_INT8 = 0,
-    MLOG_UINT8,
-    MLOG_INT16,
-    MLOG_UINT16,
-    MLOG_INT32,
-    MLOG_UINT32,
-    MLOG_FLOAT,
-    MLOG_DOUBLE,
-    MLOG_BOOLEAN,
+    MLOG_CB_OUTPUT, /* called by storage writer before it takes the ready sectors */
 };
 
 enum {
@@ -84,20 +69,12 @@ enum {
     MLOG_STATUS_STOPPING,
 };
 
-LOGPACKED(
-    typedef struct {
-        char name[MLOG_MAX_NAME_LEN];
-        uint16_t type;
-        uint16_t number;
-    })
-mlog_elem_t;
-
+/* bus elements are described by the schema of bus, see mlog_register_bus_schema() */
 LOGPACKED(
     typedef struct {
         char name[MLOG_MAX_NAME_LEN];
         uint8_t msg_id;
-        uint8_t num_elem;
-        mlog_elem_t* elem_list;
+        const McnSchema* schema;
     })
 mlog_bus_t;
 
@@ -125,39 +102,116 @@ typedef struct {
     uint32_t head; // head point for sector
     uint32_t tail; // tail point for sector
     uint32_t num_sector;
-    uint32_t index; // index in sector
+    uint32_t index;    // index in sector
+    uint16_t* pending; // uncommitted reservations of each sector
 } mlog_buffer_t;
 
-#define MLOG_ELEMENT(_name, _type) \
-    {                              \
-#_name,                    \
-            _type,                 \
-            1                      \
-    }
+/* space of a msg frame reserved in buffer, the frame continues into the
+   following sectors if it doesn't fit into the current one */
+typedef struct {
+    uint32_t offset; // frame offset in buffer
+    uint32_t len;    // frame length
+    uint32_t sector; // sector holding the reservation
+    uint32_t pos;    // frame offset in log file
+} mlog_resv_t;
+
+/* logging statistics of a mlog bus */
+typedef struct {
+    uint32_t total_msg;
+    uint32_t lost_msg;
+    uint32_t total_byte;     // bytes of msg frames
+    uint32_t last_timestamp; // time (ms) of last msg
+    uint32_t skip_msg;       // msgs dropped by log rate of profile
+} mlog_stat_t;
+
+/* number of buckets of storage latency histogram, bucket 0 counts latency below
+   128us, bucket n counts latency in [64 << n, 128 << n) us, and the last bucket
+   counts all the rest */
+#define MLOG_LAT_BUCKET_NUM 12
+
+/* storage statistics of a logging session */
+typedef struct {
+    uint32_t peak_sector;                     // buffer high-water, max sectors in use
+    uint32_t drop_sector;                     // sectors dropped since storage write fails
+    uint32_t write_byte;                      // bytes written into storage
+    uint32_t write_time_us;                   // time spent on writing storage
+    uint32_t alloc_byte;                      // preallocated file size, 0 if not preallocated
+    uint32_t alloc_num;                       // times the file is preallocated or extended
+    uint32_t alloc_max_us;                    // max latency of extending the file
+    uint32_t write_max_us;                    // max latency of write()
+    uint32_t sync_max_us;                     // max latency of fsync()
+    uint32_t write_hist[MLOG_LAT_BUCKET_NUM]; // latency histogram of write()
+    uint32_t sync_hist[MLOG_LAT_BUCKET_NUM];  // latency histogram of fsync()
+} mlog_io_stat_t;
+
+/* bus is not logged */
+#define MLOG_RATE_OFF 0xFFFF
+
+/* log rate of a bus, the bus is logged at most once every period_ms,
+   0 means every msg is logged */
+typedef struct {
+    uint8_t msg_id;
+    uint16_t period_ms;
+} mlog_rate_t;
 
-#define MLOG_ELEMENT_VEC(_name, _type, _num) \
-    {                                        \
-#_name,                              \
-            _type,                           \
-            _num                             \
+/* a log profile sets the log rate of buses, the bus not in list is not logged */
+typedef struct {
+    const char* name;
+    const mlog_rate_t* rate_list;
+    uint8_t rate_num;
+} mlog_profile_t;
+
+#define MLOG_RATE(_id, _period) \
+    {                           \
+        _id, _period            \
+    }
+#define MLOG_PROFILE(_name, _rate_list)                                    \
+    {                                                                      \
+        _name, _rate_list, sizeof(_rate_list) / sizeof(mlog_rate_t)        \
     }
 
-#define MLOG_BUS(_name, _id, _elem_list)              \
-    {                                                 \
-#_name,                                       \
-            _id,                                      \
-            sizeof(_elem_list) / sizeof(mlog_elem_t), \
-            _elem_list                                \
+/* a piece of msg payload, used by mlog_push_msgv() */
+typedef struct {
+    const void* base;
+    uint16_t len;
+} mlog_iovec_t;
+
+#define MLOG_BUS(_name, _id) \
+    {                        \
+#_name,              \
+            _id,             \
+            NULL             \
     }
 
 fmt_err_t mlog_add_desc(char* desc);
 fmt_err_t mlog_start(char* file_name);
 void mlog_stop(void);
+#ifdef FMT_USING_MLOG_PERSIST
+void mlog_abort(void);
+fmt_err_t mlog_recover(char* file_name);
+#endif
 fmt_err_t mlog_push_msg(const uint8_t* payload, uint8_t msg_id, uint16_t len);
+fmt_err_t mlog_push_msgv(uint8_t msg_id, const mlog_iovec_t* iov, uint8_t iov_num);
+fmt_err_t mlog_reserve_msg(uint8_t msg_id, uint16_t len, mlog_resv_t* resv);
+void mlog_resv_write(mlog_resv_t* resv, uint16_t offset, const void* data, uint16_t len);
+void mlog_commit_msg(mlog_resv_t* resv);
+uint32_t mlog_get_header_size(void);
+uint32_t mlog_read_header(uint32_t offset, void* buf, uint32_t len);
+fmt_err_t mlog_read_sector(uint32_t* seq, void* buf);
 uint8_t mlog_get_status(void);
+uint32_t mlog_get_free_sector(void);
 char* mlog_get_file_name(void);
 void mlog_statistic(void);
+fmt_err_t mlog_get_bus_stat(uint8_t msg_id, mlog_stat_t* stat);
+void mlog_get_io_stat(mlog_io_stat_t* stat);
+fmt_err_t mlog_set_profile(const char* name);
+fmt_err_t mlog_apply_profile(const char* name);
+const mlog_profile_t* mlog_get_profile(void);
+const mlog_profile_t* mlog_get_profile_list(uint8_t* num);
+fmt_err_t mlog_set_bus_rate(uint8_t msg_id, uint16_t period_ms);
+uint16_t mlog_get_bus_rate(uint8_t msg_id);
 fmt_err_t mlog_register_callback(uint8_t cb_type, void (*cb)(void));
+fmt_err_t mlog_register_bus_schema(uint8_t msg_id, const McnSchema* schema);
 fmt_err_t mlog_init(void);
 void mlog_async_output(void);
 
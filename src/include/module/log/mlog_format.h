@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MLOG_FORMAT_H__
+#define MLOG_FORMAT_H__
+
+/* Layout of mlog msg frames and index records. It only depends on libc, so
+ * host tools can parse log files with the same definitions. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* version 2 adds frame checksum and index records */
+#define MLOG_VERSION 2
+/* set in version of header if log data is compressed into blocks, see mlog_lz.h */
+#define MLOG_VERSION_COMPRESSED 0x8000
+
+/* Msg frame:
+ * | MLOG_BEGIN_MSG1 | MLOG_BEGIN_MSG2 | MSG_ID | PAYLOAD | CHECKSUM | MLOG_END_MSG |
+ * The checksum is Fletcher-16 of msg id and payload, stored little-endian. The
+ * payload length is not in frame, it is given by the bus schema in header. */
+#define MLOG_BEGIN_MSG1     0x92
+#define MLOG_BEGIN_MSG2     0x05
+#define MLOG_END_MSG        0x26
+#define MLOG_FRAME_OVERHEAD 6
+
+/* msg id reserved for index records */
+#define MLOG_INDEX_ID    0xFF
+#define MLOG_INDEX_MAGIC 0x58444E49 /* "INDX" */
+/* offset of a bus which has not been logged yet */
+#define MLOG_OFFSET_NONE 0xFFFFFFFF
+
+/* Index record is written periodically as payload of MLOG_INDEX_ID frame. It's
+ * followed by the offset of the last frame of each bus, in the order of bus
+ * list in header. Offsets are counted from the beginning of the (decoded) log
+ * file, the size is limited to 4GB by FAT32 anyway. */
+typedef struct {
+    uint32_t magic;
+    uint32_t timestamp;   /* time (ms) the record is written, same clock as header timestamp */
+    uint32_t seq;         /* sequence of record, starts from 0 */
+    uint32_t prev_offset; /* offset of previous index record */
+    uint32_t last_offset[];
+} mlog_index_t;
+
+/**
+ * @brief Fletcher-16 checksum of msg frame
+ * @note Data can be accumulated piece by piece, start with 0
+ *
+ * @param sum Checksum of previous pieces
+ * @param data Data to accumulate
+ * @param len Length of data
+ * @return uint16_t Checksum
+ */
+static inline uint16_t mlog_checksum(uint16_t sum, const void* data, uint32_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t s1 = sum & 0xFF;
+    uint32_t s2 = sum >> 8;
+
+    while (len) {
+        /* modulo is deferred, the sums don't overflow within 4096 bytes */
+        uint32_t n = len < 4096 ? len : 4096;
+
+        len -= n;
+        while (n--) {
+            s1 += *p++;
+            s2 += s1;
+        }
+        s1 %= 255;
+        s2 %= 255;
+    }
+
+    return (uint16_t)(s2 << 8 | s1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MLOG_LZ_H__
+#define MLOG_LZ_H__
+
+/* Block compression of mlog sectors. It only depends on libc, so host tools
+ * can link mlog_lz.c to decode compressed log files. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MLOG_BLOCK_MAGIC 0x4B42 /* "BK" */
+
+/* number of entries of compressor work area */
+#define MLOG_LZ_HASH_SIZE 1024
+
+enum {
+    MLOG_BLOCK_STORED = 0,
+    MLOG_BLOCK_LZ,
+};
+
+/* When compression is enabled, log data after the header is a sequence of
+ * blocks, each holding one sector. A block can be decoded on its own, the
+ * decoded blocks concatenate into the plain msg stream.
+ * | mlog_block_t | data_len bytes of data |
+ * All members are naturally aligned, so the 8 bytes header has no padding. */
+typedef struct {
+    uint16_t magic;
+    uint8_t method;
+    uint8_t reserved;
+    uint16_t raw_len;  /* length of decoded data */
+    uint16_t data_len; /* length of data in block */
+} mlog_block_t;
+
+uint32_t mlog_lz_compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_size, uint16_t* work);
+int32_t mlog_lz_decompress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MLOG_READER_H__
+#define MLOG_READER_H__
+
+/* Reader of mlog files, used by host tools on Linux. It only depends on libc,
+ * link mlog_reader.c into the tool. The log file is memory-mapped, frames are
+ * returned in place without copy. Compressed logs must be decoded first by
+ * mlog_decode. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "module/log/mlog_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MLOG_READER_NAME_LEN 32
+
+typedef struct {
+    char name[MLOG_READER_NAME_LEN];
+    uint8_t msg_id;
+} mlog_reader_bus_t;
+
+typedef struct {
+    int fd;
+    const uint8_t* data;
+    size_t size;
+    uint16_t version;
+    uint32_t timestamp;         /* time (ms) logging started */
+    size_t data_offset;         /* offset of the first frame */
+    int32_t payload_len[256];   /* payload length of each msg id, -1 if unknown */
+    uint8_t num_bus;
+    mlog_reader_bus_t bus[255]; /* in the order of offsets of index record */
+} mlog_reader_t;
+
+typedef struct {
+    size_t offset; /* offset of frame in log file */
+    uint8_t msg_id;
+    uint16_t len;
+    const uint8_t* payload; /* points into mapped file, may be unaligned */
+} mlog_frame_t;
+
+int mlog_reader_open(mlog_reader_t* reader, const char* path);
+void mlog_reader_close(mlog_reader_t* reader);
+int mlog_reader_frame(const mlog_reader_t* reader, size_t offset, mlog_frame_t* frame);
+int mlog_reader_next(const mlog_reader_t* reader, size_t* offset, mlog_frame_t* frame);
+size_t mlog_reader_seek(const mlog_reader_t* reader, uint32_t timestamp);
+int mlog_reader_index(const mlog_reader_t* reader, size_t offset, mlog_index_t* index, uint32_t* last_offset);
+int mlog_reader_last_frame(const mlog_reader_t* reader, size_t index_offset, uint8_t msg_id, mlog_frame_t* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
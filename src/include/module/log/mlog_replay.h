@@ -0,0 +1,93 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MLOG_REPLAY_H__
+#define MLOG_REPLAY_H__
+
+/* Replay of model input buses recorded in a mlog file. The log is read as a
+ * stream, input frames are fed to models in the order they were logged and
+ * models are stepped on a 1ms clock driven by the timestamp of input buses,
+ * so the replay runs as fast as the models can be stepped. It only depends on
+ * libc, so host tools can link mlog_replay.c to replay logs with the models. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "module/log/mlog_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MLOG_REPLAY_BUFFER_SIZE 4096
+#define MLOG_REPLAY_NAME_LEN    24
+/* time (ms) between input frames longer than this is skipped without stepping */
+#define MLOG_REPLAY_MAX_GAP 1000
+
+typedef struct {
+    /* read log data, returns bytes read, 0 at the end of file or < 0 for error */
+    int32_t (*read)(void* ctx, void* buf, uint32_t len);
+    /* feed an input frame, payload may be unaligned */
+    void (*input)(void* ctx, uint8_t msg_id, const uint8_t* payload, uint16_t len);
+    /* step models at timestamp (ms) */
+    void (*step)(void* ctx, uint32_t timestamp);
+    void* ctx;
+} mlog_replay_io_t;
+
+typedef struct {
+    uint32_t frame;      /* frames read */
+    uint32_t input;      /* input frames fed */
+    uint32_t step;       /* model clock ticks */
+    uint32_t skip_byte;  /* corrupted bytes and frames of unknown bus */
+    uint32_t gap;        /* gaps skipped, see MLOG_REPLAY_MAX_GAP */
+    uint32_t start_time; /* timestamp (ms) of the first input */
+    uint32_t end_time;   /* timestamp (ms) of the last step */
+} mlog_replay_stat_t;
+
+typedef struct {
+    uint8_t msg_id;
+    char name[MLOG_REPLAY_NAME_LEN];
+} mlog_replay_bus_t;
+
+typedef struct {
+    const mlog_replay_io_t* io;
+    uint16_t version;
+    uint32_t timestamp;        /* time (ms) logging started */
+    uint32_t data_offset;      /* offset of the first frame, i.e, size of header */
+    int16_t payload_len[256];  /* payload length of each msg id, -1 if unknown */
+    uint8_t input[256];        /* msg id is an input bus */
+    uint8_t num_bus;
+    mlog_replay_bus_t bus[255];
+    uint8_t started;
+    uint8_t eof;
+    uint8_t error;
+    uint32_t time; /* model clock (ms) */
+    uint32_t read_byte;
+    uint32_t pos;
+    uint32_t len;
+    uint8_t buf[MLOG_REPLAY_BUFFER_SIZE];
+    mlog_replay_stat_t stat;
+} mlog_replay_t;
+
+int mlog_replay_open(mlog_replay_t* replay, const mlog_replay_io_t* io);
+int mlog_replay_find_bus(const mlog_replay_t* replay, const char* name, uint16_t* len);
+void mlog_replay_set_input(mlog_replay_t* replay, uint8_t msg_id);
+int mlog_replay_run(mlog_replay_t* replay, uint32_t max_step);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
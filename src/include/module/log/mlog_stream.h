@@ -0,0 +1,96 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MLOG_STREAM_H__
+#define MLOG_STREAM_H__
+
+/* Transport of log data over a lossy link in chunks, e.g. MAVLink LOGGING_DATA.
+ * The link budget is shared by a token bucket, chunks which need ack are kept
+ * in a window and retransmitted until they are acked. It only depends on libc,
+ * so host tools can link mlog_stream.c to simulate the link. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* data size of LOGGING_DATA and LOGGING_DATA_ACKED */
+#define MLOG_STREAM_CHUNK_SIZE 249
+/* number of chunks waiting for ack */
+#define MLOG_STREAM_WINDOW 8
+/* first_offset of chunk in which no msg frame starts, or it's unknown */
+#define MLOG_STREAM_NO_OFFSET 255
+
+typedef struct {
+    uint16_t seq;
+    uint8_t len;
+    uint8_t first_offset; /* offset of the first msg frame in data */
+    uint8_t acked;        /* chunk must be acked by receiver */
+    uint8_t data[MLOG_STREAM_CHUNK_SIZE];
+} mlog_chunk_t;
+
+typedef struct {
+    uint32_t rate;     /* link budget (bytes/s) */
+    uint32_t burst;    /* bytes can be sent at once after idle */
+    uint16_t overhead; /* bytes added to each chunk on the link, e.g. MAVLink header */
+    uint16_t timeout;  /* time (ms) to retransmit a chunk which is not acked */
+    uint8_t max_retry; /* chunk is given up after retransmitted so many times */
+} mlog_stream_config_t;
+
+typedef struct {
+    uint32_t sent_chunk;  /* chunks sent for the first time */
+    uint32_t retry_chunk; /* retransmissions */
+    uint32_t acked_chunk;
+    uint32_t lost_chunk;  /* chunks given up */
+    uint32_t data_byte;   /* data sent for the first time */
+    uint32_t link_byte;   /* bytes sent on link, including overhead and retransmission */
+} mlog_stream_stat_t;
+
+typedef struct {
+    /* fill data, len, first_offset and acked of next chunk, returns false if no data ready */
+    bool (*pull)(void* ctx, mlog_chunk_t* chunk);
+    /* send chunk over link, returns false if it fails */
+    bool (*send)(void* ctx, const mlog_chunk_t* chunk);
+    void* ctx;
+} mlog_stream_io_t;
+
+typedef struct {
+    mlog_chunk_t chunk;
+    uint32_t sent_time;
+    uint8_t retry;
+    uint8_t used;
+} mlog_stream_slot_t;
+
+typedef struct {
+    mlog_stream_config_t config;
+    uint32_t tokens; /* in 1/1000 bytes */
+    uint32_t last_time;
+    uint16_t next_seq;
+    mlog_stream_slot_t window[MLOG_STREAM_WINDOW];
+    mlog_stream_stat_t stat;
+} mlog_stream_t;
+
+void mlog_stream_init(mlog_stream_t* stream, const mlog_stream_config_t* config, uint32_t now);
+uint32_t mlog_stream_poll(mlog_stream_t* stream, const mlog_stream_io_t* io, uint32_t now);
+bool mlog_stream_ack(mlog_stream_t* stream, uint16_t seq);
+uint8_t mlog_stream_pending(const mlog_stream_t* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef ULOG_BUFFER_H__
+#define ULOG_BUFFER_H__
+
+/* Ring buffer of log text in front of a file. Lines are appended by any thread
+ * and written by a single writer in chunks aligned to the file offset, the
+ * remaining data is written when it has waited for the timeout. A line which
+ * doesn't fit is dropped as a whole, so lines in file are never torn. It only
+ * depends on libc, so host tools can link ulog_buffer.c to benchmark it. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t size;    /* ring size, must be a multiple of chunk */
+    uint32_t chunk;   /* write size alignment, e.g. sector size of storage */
+    uint32_t timeout; /* time (ms) data can wait for a full chunk */
+} ulog_buffer_config_t;
+
+typedef struct {
+    uint32_t append_line;
+    uint32_t drop_line;  /* lines dropped because ring is full */
+    uint32_t drop_byte;
+    uint32_t write;      /* write calls */
+    uint32_t write_byte;
+    uint32_t error;      /* failed writes, data is discarded */
+    uint32_t max_used;   /* high watermark of ring (bytes) */
+} ulog_buffer_stat_t;
+
+typedef struct {
+    /* write data into file, returns bytes written or < 0 for error */
+    int32_t (*write)(void* ctx, const void* buf, uint32_t len);
+    /* lock of ring indexes against concurrent append, held briefly */
+    void (*lock)(void* ctx);
+    void (*unlock)(void* ctx);
+    void* ctx;
+} ulog_buffer_io_t;
+
+typedef struct {
+    ulog_buffer_config_t config;
+    const ulog_buffer_io_t* io;
+    uint8_t* buf;
+    uint32_t head; /* next byte to append */
+    uint32_t tail; /* next byte to write */
+    uint8_t writing;
+    uint8_t waiting;       /* data is waiting for a full chunk */
+    uint32_t waiting_time; /* time (ms) it started waiting */
+    ulog_buffer_stat_t stat;
+} ulog_buffer_t;
+
+void ulog_buffer_init(ulog_buffer_t* buffer, const ulog_buffer_config_t* config, const ulog_buffer_io_t* io,
+    uint8_t* buf);
+bool ulog_buffer_append(ulog_buffer_t* buffer, const void* data, uint32_t len);
+uint32_t ulog_buffer_flush(ulog_buffer_t* buffer, uint32_t now);
+uint32_t ulog_buffer_sync(ulog_buffer_t* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
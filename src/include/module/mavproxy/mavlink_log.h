@@ -0,0 +1,35 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef MAVLINK_LOG_H__
+#define MAVLINK_LOG_H__
+
+#include <firmament.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+fmt_err_t mavlink_log_init(void);
+fmt_err_t mavlink_log_start(uint8_t target_system, uint8_t target_component);
+void mavlink_log_stop(void);
+void mavlink_log_handle_ack(uint16_t seq);
+void mavlink_log_output(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -20,6 +20,7 @@
 #include <mavlink.h>
 
 #include "module/mavproxy/mavlink_console.h"
+#include "module/mavproxy/mavlink_log.h"
 #include "module/mavproxy/mavlink_param.h"
 #include "module/mavproxy/mavlink_status.h"
 #include "module/mavproxy/mavproxy_cmd.h"
@@ -32,6 +33,7 @@ extern "C" {
 #define EVENT_MAVPROXY_UPDATE    (1 << 0)
 #define EVENT_MAVCONSOLE_TIMEOUT (1 << 1)
 #define EVENT_SEND_ALL_PARAM     (1 << 2)
+#define EVENT_MAVLOG_UPDATE      (1 << 3)
 
 typedef bool (*msg_pack_cb_t)(mavlink_message_t* msg_t);
 
@@ -21,6 +21,8 @@
 #include "module/system/statistic.h"
 #include "module/console/console.h"
 #include "module/ipc/uMCN.h"
+#include "module/ipc/mcn_record.h"
+#include "module/ipc/mcn_schema.h"
 #include "module/param/param.h"
 #include "module/log/boot_log.h"
 #include "module/log/mlog.h"
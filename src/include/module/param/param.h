@@ -150,6 +150,11 @@ typedef struct {
 /******************** Step 3: Declare Parameters In Group ********************/
 typedef struct {
     PARAM_DECLARE(MLOG_MODE);
+    PARAM_DECLARE(MLOG_PROFILE);
+    PARAM_DECLARE(MLOG_PREALLOC);
+    PARAM_DECLARE(MLOG_SYNC_MS);
+    PARAM_DECLARE(MLOG_STREAM_RATE);
+    PARAM_DECLARE(MLOG_STREAM_ACK);
 } PARAM_GROUP(SYSTEM);
 
 typedef struct {
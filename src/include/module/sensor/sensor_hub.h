@@ -120,6 +120,7 @@ typedef struct {
     float distance_m; // negative value indicate invalid
 } rf_data_t;
 
+fmt_err_t sensor_hub_init(void);
 void sensor_collect(void);
 fmt_err_t advertise_sensor_imu(uint8_t id);
 fmt_err_t advertise_sensor_mag(uint8_t id);
@@ -0,0 +1,39 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#ifndef TASK_VEHICLE_H__
+#define TASK_VEHICLE_H__
+
+#include <firmament.h>
+
+#include "module/log/mlog_replay.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    mlog_replay_stat_t log;
+    uint32_t mismatch;    /* input frames of which bus layout doesn't match the model */
+    uint32_t duration_ms; /* time spent to replay */
+} vehicle_replay_stat_t;
+
+fmt_err_t vehicle_replay_mlog(const char* log_file, char* out_file, vehicle_replay_stat_t* stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,15 +31,10 @@ static McnNode_t ins_out_nod;
 
 fmt_model_info_t control_model_info;
 
-static int control_out_echo(void* param)
-{
-    Control_Out_Bus control_out;
-    if(mcn_copy_from_hub((McnHub*)param, &control_out) == FMT_EOK){
-        console_printf("timestamp:%d actuator: %d %d %d %d\n", control_out.timestamp, control_out.actuator_cmd[0], 
-            control_out.actuator_cmd[1], control_out.actuator_cmd[2], control_out.actuator_cmd[3]);
-    }
-    return 0;
-}
+/* controller bus schema */
+MCN_SCHEMA_DEFINE(Control_Out_Bus,
+    MCN_FIELD(Control_Out_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD_VEC(Control_Out_Bus, actuator_cmd, MCN_UINT16));
 
 static void update_parameter(void)
 {
@@ -95,12 +90,18 @@ void control_interface_step(uint32_t timestamp)
 
     mcn_publish(MCN_HUB(control_output), &Controller_Y.Control_Out);
 
-    DEFINE_TIMETAG(control_output, 100);
-    /* Log Control output bus data */
-    if (check_timetag(TIMETAG(control_output))) {
-        /* Log Control out data */
-        mlog_push_msg((uint8_t*)&Controller_Y.Control_Out, MLOG_CONTROL_OUT_ID, sizeof(Control_Out_Bus));
-    }
+    /* Log Control output bus data, the log rate is decided by mlog profile */
+    mlog_push_msg((uint8_t*)&Controller_Y.Control_Out, MLOG_CONTROL_OUT_ID, sizeof(Control_Out_Bus));
+}
+
+/**
+ * Reset Controller model to its initial state, e.g, before and after log replay
+ */
+void control_interface_reset(void)
+{
+    Controller_init();
+
+    update_parameter();
 }
 
 void control_interface_init(void)
@@ -108,11 +109,14 @@ void control_interface_init(void)
     control_model_info.period = CONTROL_EXPORT.period;
     control_model_info.info = (char*)CONTROL_EXPORT.model_info;
 
-    mcn_advertise(MCN_HUB(control_output), control_out_echo);
+    mcn_set_schema(MCN_HUB(control_output), MCN_SCHEMA(Control_Out_Bus));
+    mcn_advertise(MCN_HUB(control_output), mcn_schema_echo);
 
     fms_out_nod = mcn_subscribe(MCN_HUB(fms_output), NULL, NULL);
     ins_out_nod = mcn_subscribe(MCN_HUB(ins_output), NULL, NULL);
 
+    FMT_CHECK(mlog_register_bus_schema(MLOG_CONTROL_OUT_ID, MCN_SCHEMA(Control_Out_Bus)));
+
     Controller_init();
 
     update_parameter();
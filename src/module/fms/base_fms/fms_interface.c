@@ -39,6 +39,28 @@ static uint8_t gcs_cmd_updated = 1;
 
 fmt_model_info_t fms_model_info;
 
+/* FMS bus schema */
+MCN_SCHEMA_DEFINE(FMS_Out_Bus,
+    MCN_FIELD(FMS_Out_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(FMS_Out_Bus, p_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, q_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, r_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, phi_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, theta_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, psi_rate_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, u_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, v_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, w_cmd, MCN_FLOAT),
+    MCN_FIELD(FMS_Out_Bus, throttle_cmd, MCN_UINT32),
+    MCN_FIELD_VEC(FMS_Out_Bus, actuator_cmd, MCN_UINT16),
+    MCN_FIELD(FMS_Out_Bus, status, MCN_UINT8),
+    MCN_FIELD(FMS_Out_Bus, state, MCN_UINT8),
+    MCN_FIELD(FMS_Out_Bus, ctrl_mode, MCN_UINT8),
+    MCN_FIELD(FMS_Out_Bus, reset, MCN_UINT8),
+    MCN_FIELD(FMS_Out_Bus, mode, MCN_UINT8),
+    MCN_FIELD(FMS_Out_Bus, reserved1, MCN_UINT8),
+    MCN_FIELD(FMS_Out_Bus, reserved2, MCN_UINT16));
+
 static void mlog_start_cb(void)
 {
     pilot_cmd_updated = 1;
@@ -60,6 +82,8 @@ static void update_parameter(void)
     FMS_PARAM.ROLL_PITCH_LIM = PARAM_GET_FLOAT(FMS, ROLL_PITCH_LIM);
 }
 
+static void fms_interface_run(void);
+
 void fms_interface_step(uint32_t timestamp)
 {
 #ifdef FMT_ONLINE_PARAM_TUNING
@@ -80,6 +104,11 @@ void fms_interface_step(uint32_t timestamp)
         gcs_cmd_updated = 1;
     }
 
+    fms_interface_run();
+}
+
+static void fms_interface_run(void)
+{
     if (mcn_poll(ins_out_nod)) {
         mcn_copy(MCN_HUB(ins_output), ins_out_nod, &FMS_U.INS_Out);
     }
@@ -104,12 +133,65 @@ void fms_interface_step(uint32_t timestamp)
         mlog_push_msg((uint8_t*)&FMS_U.GCS_Cmd, MLOG_GCS_CMD_ID, sizeof(GCS_Cmd_Bus));
     }
 
-    /* Log FMS output bus data */
-    DEFINE_TIMETAG(fms_output, 100);
-    if (check_timetag(TIMETAG(fms_output))) {
-        /* Log FMS out data */
-        mlog_push_msg((uint8_t*)&FMS_Y.FMS_Out, MLOG_FMS_OUT_ID, sizeof(FMS_Out_Bus));
+    /* Log FMS output bus data, the log rate is decided by mlog profile */
+    mlog_push_msg((uint8_t*)&FMS_Y.FMS_Out, MLOG_FMS_OUT_ID, sizeof(FMS_Out_Bus));
+}
+
+/**
+ * Feed a FMS input bus replayed from log
+ *
+ * @param msg_id mlog msg id of bus
+ * @param payload bus data logged, may be unaligned
+ * @param len payload length
+ *
+ * @return FMT_EOK if fed, FMT_ENOTHANDLE if it's not a FMS input bus, FMT_EINVAL
+ * if the length doesn't match the bus of this model
+ */
+fmt_err_t fms_interface_replay_input(uint8_t msg_id, const void* payload, uint16_t len)
+{
+    void* bus;
+    uint16_t size;
+
+    switch (msg_id) {
+    case MLOG_PILOT_CMD_ID:
+        bus = &FMS_U.Pilot_Cmd;
+        size = sizeof(Pilot_Cmd_Bus);
+        pilot_cmd_updated = 1;
+        break;
+    case MLOG_GCS_CMD_ID:
+        bus = &FMS_U.GCS_Cmd;
+        size = sizeof(GCS_Cmd_Bus);
+        gcs_cmd_updated = 1;
+        break;
+    default:
+        return FMT_ENOTHANDLE;
     }
+
+    if (len != size) {
+        return FMT_EINVAL;
+    }
+    memcpy(bus, payload, size);
+
+    return FMT_EOK;
+}
+
+/**
+ * Step FMS with the commands replayed, instead of pilot and gcs topics
+ */
+void fms_interface_replay_step(void)
+{
+    fms_interface_run();
+}
+
+/**
+ * Reset FMS model to its initial state, e.g, before and after log replay
+ */
+void fms_interface_reset(void)
+{
+    FMS_init();
+
+    update_parameter();
+    mlog_start_cb();
 }
 
 void fms_interface_init(void)
@@ -117,7 +199,8 @@ void fms_interface_init(void)
     fms_model_info.period = FMS_EXPORT.period;
     fms_model_info.info = (char*)FMS_EXPORT.model_info;
 
-    mcn_advertise(MCN_HUB(fms_output), NULL);
+    mcn_set_schema(MCN_HUB(fms_output), MCN_SCHEMA(FMS_Out_Bus));
+    mcn_advertise(MCN_HUB(fms_output), mcn_schema_echo);
 
     pilot_cmd_nod = mcn_subscribe(MCN_HUB(pilot_cmd), NULL, NULL);
     gcs_cmd_nod = mcn_subscribe(MCN_HUB(gcs_cmd), NULL, NULL);
@@ -125,6 +208,7 @@ void fms_interface_init(void)
     control_out_nod = mcn_subscribe(MCN_HUB(control_output), NULL, NULL);
 
     mlog_register_callback(MLOG_CB_START, mlog_start_cb);
+    FMT_CHECK(mlog_register_bus_schema(MLOG_FMS_OUT_ID, MCN_SCHEMA(FMS_Out_Bus)));
 
     FMS_init();
 
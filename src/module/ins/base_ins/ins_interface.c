@@ -19,20 +19,20 @@
 
 #include "module/sensor/sensor_hub.h"
 
-/* INS output bus */
-MCN_DEFINE(ins_output, sizeof(INS_Out_Bus));
+/* INS output bus, telemetry borrows it instead of copying the whole bus */
+MCN_DEFINE_LOAN(ins_output, sizeof(INS_Out_Bus), 1, 1);
 
 /* INS input bus */
-MCN_DECLARE(sensor_imu0);
-MCN_DECLARE(sensor_mag0);
+MCN_MULTI_DECLARE(sensor_imu);
+MCN_MULTI_DECLARE(sensor_mag);
 MCN_DECLARE(sensor_baro);
 MCN_DECLARE(sensor_gps);
 MCN_DECLARE(sensor_rangefinder);
 MCN_DECLARE(sensor_optflow);
 
 static struct INS_Handler {
-    McnNode_t imu_sub_node_t;
-    McnNode_t mag_sub_node_t;
+    McnMultiNode imu_sub_node;
+    McnMultiNode mag_sub_node;
     McnNode_t baro_sub_node_t;
     McnNode_t gps_sub_node_t;
     McnNode_t rf_sub_node_t;
@@ -55,16 +55,95 @@ static uint8_t optflow_data_updated;
 
 fmt_model_info_t ins_model_info;
 
-static int ins_output_echo(void* param)
-{
-    INS_Out_Bus ins_out;
-
-    mcn_copy_from_hub((McnHub*)param, &ins_out);
-
-    console_printf("euler angle(deg) %.2f %.2f %.2f\n", RAF2DEG(ins_out.phi), RAF2DEG(ins_out.theta), RAF2DEG(ins_out.psi));
-
-    return 0;
-}
+/* INS bus schema */
+MCN_SCHEMA_DEFINE(IMU_Bus,
+    MCN_FIELD(IMU_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(IMU_Bus, gyr_x, MCN_FLOAT),
+    MCN_FIELD(IMU_Bus, gyr_y, MCN_FLOAT),
+    MCN_FIELD(IMU_Bus, gyr_z, MCN_FLOAT),
+    MCN_FIELD(IMU_Bus, acc_x, MCN_FLOAT),
+    MCN_FIELD(IMU_Bus, acc_y, MCN_FLOAT),
+    MCN_FIELD(IMU_Bus, acc_z, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(MAG_Bus,
+    MCN_FIELD(MAG_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(MAG_Bus, mag_x, MCN_FLOAT),
+    MCN_FIELD(MAG_Bus, mag_y, MCN_FLOAT),
+    MCN_FIELD(MAG_Bus, mag_z, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(Barometer_Bus,
+    MCN_FIELD(Barometer_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(Barometer_Bus, pressure, MCN_FLOAT),
+    MCN_FIELD(Barometer_Bus, temperature, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(GPS_uBlox_Bus,
+    MCN_FIELD(GPS_uBlox_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, iTOW, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, year, MCN_UINT16),
+    MCN_FIELD(GPS_uBlox_Bus, month, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, day, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, hour, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, min, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, sec, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, valid, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, tAcc, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, nano, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, fixType, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, flags, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, reserved1, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, numSV, MCN_UINT8),
+    MCN_FIELD(GPS_uBlox_Bus, lon, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, lat, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, height, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, hMSL, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, hAcc, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, vAcc, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, velN, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, velE, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, velD, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, gSpeed, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, heading, MCN_INT32),
+    MCN_FIELD(GPS_uBlox_Bus, sAcc, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, headingAcc, MCN_UINT32),
+    MCN_FIELD(GPS_uBlox_Bus, pDOP, MCN_UINT16),
+    MCN_FIELD(GPS_uBlox_Bus, reserved2, MCN_UINT16));
+
+/* rangefinder and optical flow are logged from sensor report, which has the same layout */
+MCN_SCHEMA_DEFINE(Rangefinder_Bus,
+    MCN_FIELD(Rangefinder_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(Rangefinder_Bus, distance_m, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(Optical_Flow_Bus,
+    MCN_FIELD(Optical_Flow_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(Optical_Flow_Bus, vx, MCN_FLOAT),
+    MCN_FIELD(Optical_Flow_Bus, vy, MCN_FLOAT),
+    MCN_FIELD(Optical_Flow_Bus, valid, MCN_UINT32));
+
+MCN_SCHEMA_DEFINE(INS_Out_Bus,
+    MCN_FIELD(INS_Out_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(INS_Out_Bus, phi, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, theta, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, psi, MCN_FLOAT),
+    MCN_FIELD_VEC(INS_Out_Bus, quat, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, p, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, q, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, r, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, ax, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, ay, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, az, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, vn, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, ve, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, vd, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, reserved, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, lon, MCN_DOUBLE),
+    MCN_FIELD(INS_Out_Bus, lat, MCN_DOUBLE),
+    MCN_FIELD(INS_Out_Bus, alt, MCN_DOUBLE),
+    MCN_FIELD(INS_Out_Bus, x_R, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, y_R, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, h_R, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, h_AGL, MCN_FLOAT),
+    MCN_FIELD(INS_Out_Bus, flag, MCN_UINT32),
+    MCN_FIELD(INS_Out_Bus, status, MCN_UINT32));
 
 static void mlog_start_cb(void)
 {
@@ -82,11 +161,13 @@ static void update_parameter(void)
     return;
 }
 
+static void ins_interface_run(void);
+
 void ins_interface_step(uint32_t timestamp)
 {
     /* get sensor data */
-    if (mcn_poll(ins_handle.imu_sub_node_t)) {
-        mcn_copy(MCN_HUB(sensor_imu0), ins_handle.imu_sub_node_t, &ins_handle.imu_report);
+    if (mcn_multi_poll(&ins_handle.imu_sub_node)) {
+        mcn_multi_copy(&ins_handle.imu_sub_node, &ins_handle.imu_report);
 
         INS_U.IMU.gyr_x = ins_handle.imu_report.gyr_B_radDs[0];
         INS_U.IMU.gyr_y = ins_handle.imu_report.gyr_B_radDs[1];
@@ -100,8 +181,8 @@ void ins_interface_step(uint32_t timestamp)
         imu_data_updated = 1;
     }
 
-    if (mcn_poll(ins_handle.mag_sub_node_t)) {
-        mcn_copy(MCN_HUB(sensor_mag0), ins_handle.mag_sub_node_t, &ins_handle.mag_report);
+    if (mcn_multi_poll(&ins_handle.mag_sub_node)) {
+        mcn_multi_copy(&ins_handle.mag_sub_node, &ins_handle.mag_report);
 
         INS_U.MAG.mag_x = ins_handle.mag_report.mag_B_gauss[0];
         INS_U.MAG.mag_y = ins_handle.mag_report.mag_B_gauss[1];
@@ -157,6 +238,11 @@ void ins_interface_step(uint32_t timestamp)
         optflow_data_updated = 1;
     }
 
+    ins_interface_run();
+}
+
+static void ins_interface_run(void)
+{
     /* run INS */
     INS_step();
 
@@ -200,12 +286,85 @@ void ins_interface_step(uint32_t timestamp)
         mlog_push_msg((uint8_t*)&ins_handle.optflow_report, MLOG_OPTICAL_FLOW_ID, sizeof(ins_handle.optflow_report));
     }
 
-    /* Log INS output bus data */
-    DEFINE_TIMETAG(ins_output, 100);
-    if (check_timetag(TIMETAG(ins_output))) {
-        /* Log INS out data */
-        mlog_push_msg((uint8_t*)&INS_Y.INS_Out, MLOG_INS_OUT_ID, sizeof(INS_Y.INS_Out));
+    /* Log INS output bus data, the log rate is decided by mlog profile */
+    mlog_push_msg((uint8_t*)&INS_Y.INS_Out, MLOG_INS_OUT_ID, sizeof(INS_Y.INS_Out));
+}
+
+/**
+ * Feed an INS input bus replayed from log
+ *
+ * @param msg_id mlog msg id of bus
+ * @param payload bus data logged, may be unaligned
+ * @param len payload length
+ *
+ * @return FMT_EOK if fed, FMT_ENOTHANDLE if it's not an INS input bus, FMT_EINVAL
+ * if the length doesn't match the bus of this model
+ */
+fmt_err_t ins_interface_replay_input(uint8_t msg_id, const void* payload, uint16_t len)
+{
+    void* bus;
+    uint16_t size;
+
+    switch (msg_id) {
+    case MLOG_IMU_ID:
+        bus = &INS_U.IMU;
+        size = sizeof(INS_U.IMU);
+        imu_data_updated = 1;
+        break;
+    case MLOG_MAG_ID:
+        bus = &INS_U.MAG;
+        size = sizeof(INS_U.MAG);
+        mag_data_updated = 1;
+        break;
+    case MLOG_BARO_ID:
+        bus = &INS_U.Barometer;
+        size = sizeof(INS_U.Barometer);
+        baro_data_updated = 1;
+        break;
+    case MLOG_GPS_ID:
+        bus = &INS_U.GPS_uBlox;
+        size = sizeof(INS_U.GPS_uBlox);
+        gps_data_updated = 1;
+        break;
+    case MLOG_RANGEFINDER_ID:
+        bus = &ins_handle.rf_report;
+        size = sizeof(ins_handle.rf_report);
+        rf_data_updated = 1;
+        break;
+    case MLOG_OPTICAL_FLOW_ID:
+        bus = &ins_handle.optflow_report;
+        size = sizeof(ins_handle.optflow_report);
+        optflow_data_updated = 1;
+        break;
+    default:
+        return FMT_ENOTHANDLE;
     }
+
+    if (len != size) {
+        return FMT_EINVAL;
+    }
+    memcpy(bus, payload, size);
+
+    return FMT_EOK;
+}
+
+/**
+ * Step INS with the input buses replayed, instead of sensor topics
+ */
+void ins_interface_replay_step(void)
+{
+    ins_interface_run();
+}
+
+/**
+ * Reset INS model to its initial state, e.g, before and after log replay
+ */
+void ins_interface_reset(void)
+{
+    INS_init();
+
+    update_parameter();
+    mlog_start_cb();
 }
 
 void ins_interface_init(void)
@@ -213,16 +372,24 @@ void ins_interface_init(void)
     ins_model_info.period = INS_EXPORT.period;
     ins_model_info.info = (char*)INS_EXPORT.model_info;
 
-    mcn_advertise(MCN_HUB(ins_output), ins_output_echo);
+    mcn_set_schema(MCN_HUB(ins_output), MCN_SCHEMA(INS_Out_Bus));
+    mcn_advertise_loan(MCN_HUB(ins_output), 1, 1, mcn_schema_echo);
 
-    ins_handle.imu_sub_node_t = mcn_subscribe(MCN_HUB(sensor_imu0), NULL, NULL);
-    ins_handle.mag_sub_node_t = mcn_subscribe(MCN_HUB(sensor_mag0), NULL, NULL);
+    mcn_multi_subscribe(MCN_MULTI(sensor_imu), &ins_handle.imu_sub_node, NULL);
+    mcn_multi_subscribe(MCN_MULTI(sensor_mag), &ins_handle.mag_sub_node, NULL);
     ins_handle.baro_sub_node_t = mcn_subscribe(MCN_HUB(sensor_baro), NULL, NULL);
     ins_handle.gps_sub_node_t = mcn_subscribe(MCN_HUB(sensor_gps), NULL, NULL);
     ins_handle.rf_sub_node_t = mcn_subscribe(MCN_HUB(sensor_rangefinder), NULL, NULL);
     ins_handle.optflow_sub_node_t = mcn_subscribe(MCN_HUB(sensor_optflow), NULL, NULL);
 
     mlog_register_callback(MLOG_CB_START, mlog_start_cb);
+    FMT_CHECK(mlog_register_bus_schema(MLOG_IMU_ID, MCN_SCHEMA(IMU_Bus)));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_MAG_ID, MCN_SCHEMA(MAG_Bus)));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_BARO_ID, MCN_SCHEMA(Barometer_Bus)));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_GPS_ID, MCN_SCHEMA(GPS_uBlox_Bus)));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_RANGEFINDER_ID, MCN_SCHEMA(Rangefinder_Bus)));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_OPTICAL_FLOW_ID, MCN_SCHEMA(Optical_Flow_Bus)));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_INS_OUT_ID, MCN_SCHEMA(INS_Out_Bus)));
 
     INS_init();
 
@@ -18,7 +18,7 @@
 #include <INS.h>
 
 /* INS output bus */
-MCN_DEFINE(ins_output, sizeof(INS_Out_Bus));
+MCN_DEFINE_LOAN(ins_output, sizeof(INS_Out_Bus), 1, 1);
 /* Model information */
 fmt_model_info_t ins_model_info;
 
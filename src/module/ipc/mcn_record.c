@@ -0,0 +1,433 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <dfs_posix.h>
+
+#include "module/ipc/mcn_record.h"
+
+/* The recorder copies published samples of topics with record flag into a RAM
+ * ring in publisher context, the ring is then written into capture file by
+ * mcn_record_async_output() in logger task. */
+struct mcn_recorder {
+    uint8_t* buffer;
+    uint32_t size;
+    uint32_t head; /* write position of publish hook */
+    uint32_t tail; /* read position of file output */
+    uint32_t used;
+    volatile uint8_t running;
+    int fd;
+    uint64_t start_time;
+    uint64_t stop_time;
+    uint32_t record_cnt;
+    uint32_t drop_cnt;
+    uint32_t write_error;
+    uint64_t bytes;
+    uint32_t peak_usage;
+    uint64_t hook_time;
+};
+
+static struct mcn_recorder __recorder = { .fd = -1 };
+/* protect capture file from concurrent start, stop and output */
+static struct rt_mutex __record_lock;
+
+static void __record_put(const void* data, uint32_t len)
+{
+    uint32_t n = __recorder.size - __recorder.head;
+
+    if (n > len) {
+        n = len;
+    }
+    memcpy(&__recorder.buffer[__recorder.head], data, n);
+    memcpy(__recorder.buffer, (const uint8_t*)data + n, len - n);
+
+    __recorder.head = (__recorder.head + len) % __recorder.size;
+}
+
+/**
+ * @brief Publish hook to put a record of the published sample into ring
+ *
+ * @param hub uMCN hub
+ * @param data Published sample
+ */
+static void __record_hook(McnHub_t hub, const void* data)
+{
+    uint64_t now = MCN_GET_TIME_US();
+    McnRecordHeader header = { .topic_id = hub->id, .size = hub->obj_size, .timestamp = now };
+    uint32_t len = sizeof(header) + hub->obj_size;
+
+    MCN_ENTER_CRITICAL;
+    if (!__recorder.running) {
+        MCN_EXIT_CRITICAL;
+        return;
+    }
+
+    if (__recorder.size - __recorder.used < len) {
+        /* never overwrite records not written into file */
+        __recorder.drop_cnt++;
+    } else {
+        __record_put(&header, sizeof(header));
+        __record_put(data, hub->obj_size);
+        __recorder.used += len;
+        __recorder.record_cnt++;
+        if (__recorder.used > __recorder.peak_usage) {
+            __recorder.peak_usage = __recorder.used;
+        }
+    }
+    __recorder.hook_time += MCN_GET_TIME_US() - now;
+    MCN_EXIT_CRITICAL;
+}
+
+/**
+ * @brief Write records in ring into capture file
+ * @note Must be called with record lock taken
+ */
+static void __record_flush(void)
+{
+    uint32_t tail, used, len;
+
+    if (__recorder.fd < 0) {
+        return;
+    }
+
+    MCN_ENTER_CRITICAL;
+    tail = __recorder.tail;
+    used = __recorder.used;
+    MCN_EXIT_CRITICAL;
+
+    /* data in [tail, tail + used) is not touched by publish hook */
+    while (used) {
+        len = __recorder.size - tail;
+        if (len > used) {
+            len = used;
+        }
+
+        if (write(__recorder.fd, &__recorder.buffer[tail], len) != len) {
+            __recorder.write_error++;
+        } else {
+            __recorder.bytes += len;
+        }
+
+        tail = (tail + len) % __recorder.size;
+        used -= len;
+
+        MCN_ENTER_CRITICAL;
+        __recorder.tail = tail;
+        __recorder.used -= len;
+        MCN_EXIT_CRITICAL;
+    }
+}
+
+/**
+ * @brief Start recording uMCN traffic into capture file
+ * @note Only topics with record flag are recorded, see mcn_record_topic()
+ *
+ * @param file_name Capture file name
+ * @param buffer_size Size of record ring buffer, 0 to use MCN_RECORD_BUFFER_SIZE
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_record_start(const char* file_name, uint32_t buffer_size)
+{
+    McnCaptureHeader header;
+    fmt_err_t err = FMT_EOK;
+
+    MCN_ASSERT(file_name != NULL);
+
+    if (buffer_size == 0) {
+        buffer_size = MCN_RECORD_BUFFER_SIZE;
+    }
+
+    rt_mutex_take(&__record_lock, RT_WAITING_FOREVER);
+
+    if (__recorder.running) {
+        err = FMT_EBUSY;
+        goto out;
+    }
+
+    __recorder.buffer = (uint8_t*)MCN_MALLOC(buffer_size);
+    if (__recorder.buffer == NULL) {
+        err = FMT_ENOMEM;
+        goto out;
+    }
+
+    __recorder.fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC);
+    if (__recorder.fd < 0) {
+        MCN_FREE(__recorder.buffer);
+        __recorder.buffer = NULL;
+        err = FMT_ERROR;
+        goto out;
+    }
+
+    header.magic = MCN_CAPTURE_MAGIC;
+    header.version = MCN_CAPTURE_VERSION;
+    header.header_size = sizeof(McnRecordHeader);
+    header.start_time = MCN_GET_TIME_US();
+
+    if (write(__recorder.fd, &header, sizeof(header)) != sizeof(header)) {
+        close(__recorder.fd);
+        __recorder.fd = -1;
+        MCN_FREE(__recorder.buffer);
+        __recorder.buffer = NULL;
+        err = FMT_ERROR;
+        goto out;
+    }
+
+    MCN_ENTER_CRITICAL;
+    __recorder.size = buffer_size;
+    __recorder.head = 0;
+    __recorder.tail = 0;
+    __recorder.used = 0;
+    __recorder.start_time = header.start_time;
+    __recorder.record_cnt = 0;
+    __recorder.drop_cnt = 0;
+    __recorder.write_error = 0;
+    __recorder.bytes = sizeof(header);
+    __recorder.peak_usage = 0;
+    __recorder.hook_time = 0;
+    __recorder.running = 1;
+    MCN_EXIT_CRITICAL;
+
+    mcn_set_publish_hook(__record_hook);
+
+out:
+    rt_mutex_release(&__record_lock);
+
+    return err;
+}
+
+/**
+ * @brief Stop recording, the remaining records are written into capture file
+ *
+ * @return fmt_err_t FMT_EOK indicates success, FMT_EEMPTY if not recording
+ */
+fmt_err_t mcn_record_stop(void)
+{
+    rt_mutex_take(&__record_lock, RT_WAITING_FOREVER);
+
+    if (!__recorder.running) {
+        rt_mutex_release(&__record_lock);
+        return FMT_EEMPTY;
+    }
+
+    mcn_set_publish_hook(NULL);
+
+    /* publish hook won't touch the ring once running is cleared */
+    MCN_ENTER_CRITICAL;
+    __recorder.running = 0;
+    __recorder.stop_time = MCN_GET_TIME_US();
+    MCN_EXIT_CRITICAL;
+
+    __record_flush();
+
+    close(__recorder.fd);
+    __recorder.fd = -1;
+    MCN_FREE(__recorder.buffer);
+    __recorder.buffer = NULL;
+
+    rt_mutex_release(&__record_lock);
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Set record flag of a uMCN topic
+ *
+ * @param hub uMCN hub, NULL for all advertised topics
+ * @param enable Record the topic or not
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_record_topic(McnHub_t hub, bool enable)
+{
+    if (hub) {
+        hub->record = enable;
+        return FMT_EOK;
+    }
+
+    McnList_t ite = mcn_get_list();
+    for (hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+        hub->record = enable;
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Write recorded traffic into capture file
+ * @note Should be called periodically in a background task (e.g, logger) while
+ * recording, the ring buffer size must hold the traffic between two calls.
+ */
+void mcn_record_async_output(void)
+{
+    if (!__recorder.running) {
+        return;
+    }
+
+    rt_mutex_take(&__record_lock, RT_WAITING_FOREVER);
+    __record_flush();
+    rt_mutex_release(&__record_lock);
+}
+
+/**
+ * @brief Get statistics of the running or latest recording
+ *
+ * @param stats Buffer to receive the statistics
+ */
+void mcn_record_get_stats(McnRecordStats* stats)
+{
+    MCN_ASSERT(stats != NULL);
+
+    MCN_ENTER_CRITICAL;
+    stats->running = __recorder.running;
+    stats->record_cnt = __recorder.record_cnt;
+    stats->drop_cnt = __recorder.drop_cnt;
+    stats->write_error = __recorder.write_error;
+    stats->bytes = __recorder.bytes;
+    stats->buffer_size = __recorder.size;
+    stats->peak_usage = __recorder.peak_usage;
+    stats->duration_ms = (uint32_t)(((__recorder.running ? MCN_GET_TIME_US() : __recorder.stop_time) - __recorder.start_time) / 1000);
+    stats->hook_time = __recorder.hook_time;
+    MCN_EXIT_CRITICAL;
+}
+
+/**
+ * @brief Wait until the target time
+ * @note Sleep till the last ticks and spin the rest for accurate timing
+ *
+ * @param target Target time (us)
+ */
+static void __replay_wait(uint64_t target)
+{
+    uint64_t now;
+
+    while ((now = MCN_GET_TIME_US()) < target) {
+        if (target - now > 2000) {
+            uint32_t ms = (uint32_t)((target - now) / 1000) - 1;
+            rt_thread_delay(TICKS_FROM_MS(ms));
+        }
+    }
+}
+
+/**
+ * @brief Replay a capture file by re-publishing the records into their topics
+ * @note Replay runs in the caller context and returns when the capture is
+ * finished. Live publishers of the replayed topics should be stopped to get a
+ * deterministic topic stream. In realtime mode the caller spins for the last
+ * tick before each record, so lower priority threads may be starved for
+ * dense captures.
+ *
+ * @param file_name Capture file name
+ * @param mode MCN_REPLAY_FAST or MCN_REPLAY_REALTIME
+ * @param stats Buffer to receive replay statistics, can be NULL
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_replay(const char* file_name, uint8_t mode, McnReplayStats* stats)
+{
+    McnCaptureHeader header;
+    McnRecordHeader record;
+    McnReplayStats replay_stats;
+    McnHub_t hub;
+    uint8_t* data = NULL;
+    uint32_t data_size = 0;
+    uint64_t first = 0, last = 0, base = 0, start, now;
+    fmt_err_t err = FMT_EOK;
+    int fd;
+
+    MCN_ASSERT(file_name != NULL);
+
+    if (stats == NULL) {
+        stats = &replay_stats;
+    }
+
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        return FMT_ERROR;
+    }
+
+    if (read(fd, &header, sizeof(header)) != sizeof(header) || header.magic != MCN_CAPTURE_MAGIC
+        || header.version != MCN_CAPTURE_VERSION || header.header_size != sizeof(McnRecordHeader)) {
+        close(fd);
+        return FMT_EINVAL;
+    }
+
+    memset(stats, 0, sizeof(McnReplayStats));
+    mcn_hist_reset(&stats->error);
+
+    start = MCN_GET_TIME_US();
+    while (read(fd, &record, sizeof(record)) == sizeof(record)) {
+        if (record.size > data_size) {
+            MCN_FREE(data);
+            data = (uint8_t*)MCN_MALLOC(record.size);
+            if (data == NULL) {
+                err = FMT_ENOMEM;
+                break;
+            }
+            data_size = record.size;
+        }
+
+        if (read(fd, data, record.size) != record.size) {
+            /* truncated capture */
+            break;
+        }
+
+        if (base == 0) {
+            first = record.timestamp;
+            base = MCN_GET_TIME_US();
+        }
+        last = record.timestamp;
+
+        hub = mcn_find_by_id(record.topic_id);
+        if (hub == NULL || hub->obj_size != record.size) {
+            stats->skip_cnt++;
+            continue;
+        }
+
+        if (mode == MCN_REPLAY_REALTIME) {
+            uint64_t target = base + (record.timestamp - first);
+
+            __replay_wait(target);
+            now = MCN_GET_TIME_US();
+            mcn_hist_add(&stats->error, (uint32_t)(now - target));
+        }
+
+        if (mcn_publish(hub, data) == FMT_EOK) {
+            stats->replay_cnt++;
+        } else {
+            stats->fail_cnt++;
+        }
+    }
+
+    stats->capture_ms = (uint32_t)((last - first) / 1000);
+    stats->duration_ms = (uint32_t)((MCN_GET_TIME_US() - start) / 1000);
+
+    MCN_FREE(data);
+    close(fd);
+
+    return err;
+}
+
+/**
+ * @brief Initialize uMCN traffic recorder
+ *
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_record_init(void)
+{
+    if (rt_mutex_init(&__record_lock, "mcn_rec", RT_IPC_FLAG_FIFO) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    return FMT_EOK;
+}
@@ -0,0 +1,397 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "module/ipc/mcn_schema.h"
+
+static const uint8_t __type_size[] = { 1, 1, 2, 2, 4, 4, 4, 8, 1 };
+static const char* __type_name[] = { "int8", "uint8", "int16", "uint16", "int32", "uint32", "float", "double", "bool" };
+
+/**
+ * @brief Get size of field type
+ *
+ * @param type Field type
+ * @return uint32_t Size of type, 0 for invalid type
+ */
+uint32_t mcn_schema_type_size(uint8_t type)
+{
+    return type < sizeof(__type_size) ? __type_size[type] : 0;
+}
+
+/**
+ * @brief Get name of field type
+ *
+ * @param type Field type
+ * @return const char* Name of type
+ */
+const char* mcn_schema_type_name(uint8_t type)
+{
+    return type < sizeof(__type_size) ? __type_name[type] : "unknown";
+}
+
+/**
+ * @brief Check if the schema matches the layout of its struct
+ * @note Catches fields with wrong type, e.g, MCN_FLOAT for a double member
+ *
+ * @param schema Topic schema
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_schema_check(const McnSchema* schema)
+{
+    MCN_ASSERT(schema != NULL);
+
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        const McnField* field = &schema->field[i];
+
+        if (mcn_schema_type_size(field->type) * field->num != field->size
+            || field->offset + field->size > schema->size) {
+            return FMT_EINVAL;
+        }
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Attach schema to a uMCN topic
+ * @note Schema is used by generic serializers, e.g, mcn_schema_echo()
+ *
+ * @param hub uMCN hub
+ * @param schema Topic schema
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_set_schema(McnHub_t hub, const McnSchema* schema)
+{
+    MCN_ASSERT(hub != NULL);
+
+    if (schema != NULL && (schema->size != hub->obj_size || mcn_schema_check(schema) != FMT_EOK)) {
+        return FMT_EINVAL;
+    }
+
+    hub->schema = schema;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Find field of schema by name
+ *
+ * @param schema Topic schema
+ * @param name Field name
+ * @return const McnField* Field, NULL if not found
+ */
+const McnField* mcn_schema_find_field(const McnSchema* schema, const char* name)
+{
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        if (strcmp(schema->field[i].name, name) == 0) {
+            return &schema->field[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Get size of the topic data packed by mcn_schema_pack()
+ *
+ * @param schema Topic schema
+ * @return uint32_t Packed size
+ */
+uint32_t mcn_schema_packed_size(const McnSchema* schema)
+{
+    uint32_t size = 0;
+
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        size += schema->field[i].size;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Pack fields of topic data back to back by walking the schema
+ * @note It's used for schemas without generated packer, see mcn_schema_pack().
+ * Adjacent fields are copied at once, so topic data without padding is packed
+ * by a single copy
+ *
+ * @param schema Topic schema
+ * @param data Topic data
+ * @param buffer Buffer to receive packed data, at least mcn_schema_packed_size()
+ * @return uint32_t Packed size
+ */
+uint32_t mcn_schema_pack_fields(const McnSchema* schema, const void* data, void* buffer)
+{
+    const uint8_t* src = (const uint8_t*)data;
+    uint8_t* dst = (uint8_t*)buffer;
+    uint32_t len = 0;
+    uint32_t run_start = 0, run_len = 0;
+
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        const McnField* field = &schema->field[i];
+
+        if (run_len && field->offset != run_start + run_len) {
+            memcpy(&dst[len], &src[run_start], run_len);
+            len += run_len;
+            run_len = 0;
+        }
+        if (run_len == 0) {
+            run_start = field->offset;
+        }
+        run_len += field->size;
+    }
+    memcpy(&dst[len], &src[run_start], run_len);
+
+    return len + run_len;
+}
+
+/* Convert unsigned integer to decimal text, returns the length */
+static uint32_t __format_uint(uint32_t val, char* buffer)
+{
+    char digit[10];
+    uint32_t n = 0, len = 0;
+
+    do {
+        digit[n++] = '0' + val % 10;
+        val /= 10;
+    } while (val);
+
+    while (n) {
+        buffer[len++] = digit[--n];
+    }
+
+    return len;
+}
+
+static uint32_t __format_int(int32_t val, char* buffer)
+{
+    if (val < 0) {
+        buffer[0] = '-';
+        return 1 + __format_uint(0U - (uint32_t)val, &buffer[1]);
+    }
+
+    return __format_uint(val, buffer);
+}
+
+/* Convert floating point to text as "%f" does, returns the length or -1 if the
+ * value is not in the range handled here. The fraction is rounded to nearest
+ * even of the exact value, which is the rounding of printf */
+static int __format_fixed(double val, char* buffer)
+{
+    uint32_t ip, fp, len = 0;
+    double abs_val = fabs(val);
+    double frac, scaled, rounded;
+
+    if (!(abs_val < 2147483648.0)) {
+        /* large, inf or nan */
+        return -1;
+    }
+
+    ip = (uint32_t)abs_val;
+    /* exact, as both are in the same binade or the fraction is smaller */
+    frac = abs_val - ip;
+    scaled = frac * 1e6;
+    rounded = floor(scaled);
+    if (scaled - rounded > 0.5) {
+        rounded += 1.0;
+    } else if (scaled - rounded == 0.5) {
+        /* a tie after rounding of the product, decided by the exact product */
+        double err = fma(frac, 1e6, -scaled);
+
+        if (err > 0 || (err == 0 && fmod(rounded, 2.0) != 0)) {
+            rounded += 1.0;
+        }
+    }
+    fp = (uint32_t)rounded;
+    if (fp >= 1000000) {
+        fp -= 1000000;
+        ip++;
+    }
+
+    if (signbit(val)) {
+        buffer[len++] = '-';
+    }
+    len += __format_uint(ip, &buffer[len]);
+    buffer[len++] = '.';
+    for (int i = 5; i >= 0; i--) {
+        buffer[len + i] = '0' + fp % 10;
+        fp /= 10;
+    }
+
+    return len + 6;
+}
+
+/* Longest text of a value formatted without snprintf(), "-2147483647.999999" */
+#define FORMAT_VALUE_MAX_LEN 18
+
+static int __format_value(uint8_t type, const uint8_t* ptr, char* buffer, uint32_t size)
+{
+    union {
+        int8_t i8;
+        uint8_t u8;
+        int16_t i16;
+        uint16_t u16;
+        int32_t i32;
+        uint32_t u32;
+        float f;
+        double lf;
+    } val;
+    char text[FORMAT_VALUE_MAX_LEN];
+    int len;
+
+    /* member may be unaligned in packed struct */
+    memcpy(&val, ptr, mcn_schema_type_size(type));
+
+    /* snprintf() is the most costly part, which is only used if the value is out of
+     * the range handled by the converters above */
+    switch (type) {
+    case MCN_INT8:
+        len = __format_int(val.i8, text);
+        break;
+    case MCN_UINT8:
+    case MCN_BOOLEAN:
+        len = __format_uint(val.u8, text);
+        break;
+    case MCN_INT16:
+        len = __format_int(val.i16, text);
+        break;
+    case MCN_UINT16:
+        len = __format_uint(val.u16, text);
+        break;
+    case MCN_INT32:
+        len = __format_int(val.i32, text);
+        break;
+    case MCN_UINT32:
+        len = __format_uint(val.u32, text);
+        break;
+    case MCN_FLOAT:
+        len = __format_fixed(val.f, text);
+        if (len < 0) {
+            return snprintf(buffer, size, "%f", val.f);
+        }
+        break;
+    case MCN_DOUBLE:
+        len = __format_fixed(val.lf, text);
+        if (len < 0) {
+            return snprintf(buffer, size, "%lf", val.lf);
+        }
+        break;
+    default:
+        return snprintf(buffer, size, "?");
+    }
+
+    /* truncated as snprintf() does */
+    if (size) {
+        uint32_t n = (uint32_t)len < size ? (uint32_t)len : size - 1;
+
+        memcpy(buffer, text, n);
+        buffer[n] = '\0';
+    }
+
+    return len;
+}
+
+/**
+ * @brief Format topic data as text line, e.g, "timestamp_ms:100 mag_B_gauss:0.1 0.2 0.3\n"
+ *
+ * @param schema Topic schema
+ * @param data Topic data
+ * @param buffer Buffer to receive the text
+ * @param size Size of buffer
+ * @return int Length of the text, the text is truncated if buffer is too small
+ */
+int mcn_schema_format(const McnSchema* schema, const void* data, char* buffer, uint32_t size)
+{
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t len = 0;
+    int n;
+
+    if (size == 0) {
+        return 0;
+    }
+
+#define APPEND_TEXT(_str, _len)                     \
+    do {                                            \
+        if (len + (_len) >= size) {                 \
+            memcpy(&buffer[len], _str, size - len); \
+            goto truncated;                         \
+        }                                           \
+        memcpy(&buffer[len], _str, _len);           \
+        len += (_len);                              \
+    } while (0)
+
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        const McnField* field = &schema->field[i];
+        uint32_t type_size = mcn_schema_type_size(field->type);
+
+        if (i) {
+            APPEND_TEXT(" ", 1);
+        }
+        APPEND_TEXT(field->name, strlen(field->name));
+        APPEND_TEXT(":", 1);
+        for (uint32_t k = 0; k < field->num; k++) {
+            if (k) {
+                APPEND_TEXT(" ", 1);
+            }
+            n = __format_value(field->type, &src[field->offset + k * type_size], &buffer[len], size - len);
+            if (n < 0 || len + n >= size) {
+                goto truncated;
+            }
+            len += n;
+        }
+    }
+    APPEND_TEXT("\n", 1);
+    buffer[len] = '\0';
+
+#undef APPEND_TEXT
+
+    return len;
+
+truncated:
+    buffer[size - 1] = '\0';
+    return size - 1;
+}
+
+/**
+ * @brief Generic topic echo function, which prints topic data by its schema
+ * @note Pass this function as echo function when advertising a topic which
+ * has schema attached, see mcn_set_schema(). Echo is called by the shell
+ * periodically, so static buffers are used instead of allocating them per call.
+ *
+ * @param parameter uMCN hub
+ * @return int 0 indicates success
+ */
+int mcn_schema_echo(void* parameter)
+{
+    McnHub_t hub = (McnHub_t)parameter;
+    /* aligned for any member of topic data */
+    static uint64_t data[(MCN_SCHEMA_ECHO_SIZE + 7) / 8];
+    static char text[MCN_SCHEMA_TEXT_SIZE];
+
+    if (hub->schema == NULL || hub->obj_size > MCN_SCHEMA_ECHO_SIZE) {
+        return -1;
+    }
+
+    if (mcn_copy_from_hub(hub, data) == FMT_EOK) {
+        mcn_schema_format(hub->schema, data, text, MCN_SCHEMA_TEXT_SIZE);
+        console_printf("%s", text);
+    }
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+
+#ifdef FMT_USING_MCN_SHM
+
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "module/ipc/mcn_shm.h"
+
+#define MCN_SHM_ALIGN_UP(_x) (((_x) + MCN_SHM_ALIGN - 1) & ~(MCN_SHM_ALIGN - 1))
+
+static struct {
+    char name[MCN_SHM_NAME_LEN];
+    int fd;
+    uint8_t* base;
+    uint32_t size;
+    McnHub_t* hubs;
+    uint32_t hub_num;
+} __shm = { .fd = -1 };
+/* number of publishers running mirror hook */
+static uint32_t __shm_busy;
+
+/* called in publisher context, which copies the sample into segment under seqlock */
+static void __mirror_hook(McnHub_t hub, const void* data)
+{
+    McnShmTopic* topic;
+    uint32_t seq;
+
+    __atomic_add_fetch(&__shm_busy, 1, __ATOMIC_SEQ_CST);
+    /* mirror is cleared before the segment is unmapped, see mcn_shm_stop() */
+    topic = (McnShmTopic*)__atomic_load_n(&hub->mirror, __ATOMIC_SEQ_CST);
+    if (topic == NULL) {
+        __atomic_sub_fetch(&__shm_busy, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    /* take the seqlock, concurrent publishers of the same topic spin here */
+    do {
+        seq = __atomic_load_n(&topic->seq, __ATOMIC_RELAXED);
+    } while ((seq & 1) || !__atomic_compare_exchange_n(&topic->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    /* odd seq must be visible before the data is modified */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(&__shm.base[topic->data_offset], data, topic->size);
+    topic->timestamp = MCN_GET_TIME_US();
+
+    /* 0 is reserved for never published */
+    seq += 2;
+    if (seq == 0) {
+        seq = 2;
+    }
+    __atomic_store_n(&topic->seq, seq, __ATOMIC_RELEASE);
+
+    __atomic_sub_fetch(&__shm_busy, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Mirror uMCN topics into a POSIX shared memory segment
+ * @note Only one segment can be mirrored at a time. Each publish of the mirrored
+ * topics is also copied into the segment, which external processes read by
+ * mcn_shm_client_read().
+ *
+ * @param shm_name Segment name, e.g, "/fmt_mcn"
+ * @param hubs Topics to mirror, the array must be valid until mcn_shm_stop()
+ * @param hub_num Number of topics
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_shm_start(const char* shm_name, McnHub_t* hubs, uint32_t hub_num)
+{
+    McnShmHeader* header;
+    McnShmTopic* topic;
+    uint32_t offset;
+
+    if (shm_name == NULL || hubs == NULL || hub_num == 0 || hub_num > UINT16_MAX) {
+        return FMT_EINVAL;
+    }
+
+    if (__shm.base != NULL) {
+        return FMT_EBUSY;
+    }
+
+    for (uint32_t i = 0; i < hub_num; i++) {
+        if (hubs[i]->pdata == NULL || hubs[i]->mirror != NULL) {
+            return FMT_EINVAL;
+        }
+    }
+
+    /* compute segment size */
+    offset = MCN_SHM_ALIGN_UP(sizeof(McnShmHeader)) + hub_num * sizeof(McnShmTopic);
+    for (uint32_t i = 0; i < hub_num; i++) {
+        offset = MCN_SHM_ALIGN_UP(offset) + hubs[i]->obj_size;
+    }
+    __shm.size = MCN_SHM_ALIGN_UP(offset);
+
+    __shm.fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (__shm.fd < 0) {
+        return FMT_ERROR;
+    }
+
+    if (ftruncate(__shm.fd, __shm.size) < 0) {
+        goto fail;
+    }
+
+    __shm.base = mmap(NULL, __shm.size, PROT_READ | PROT_WRITE, MAP_SHARED, __shm.fd, 0);
+    if (__shm.base == MAP_FAILED) {
+        __shm.base = NULL;
+        goto fail;
+    }
+
+    strncpy(__shm.name, shm_name, sizeof(__shm.name) - 1);
+    __shm.hubs = hubs;
+    __shm.hub_num = hub_num;
+
+    /* build topic table */
+    header = (McnShmHeader*)__shm.base;
+    topic = (McnShmTopic*)&__shm.base[MCN_SHM_ALIGN_UP(sizeof(McnShmHeader))];
+    offset = MCN_SHM_ALIGN_UP(sizeof(McnShmHeader)) + hub_num * sizeof(McnShmTopic);
+    for (uint32_t i = 0; i < hub_num; i++) {
+        strncpy(topic[i].name, hubs[i]->obj_name, MCN_SHM_NAME_LEN - 1);
+        topic[i].size = hubs[i]->obj_size;
+        topic[i].data_offset = MCN_SHM_ALIGN_UP(offset);
+        topic[i].seq = 0;
+        offset = topic[i].data_offset + topic[i].size;
+    }
+
+    header->version = MCN_SHM_VERSION;
+    header->topic_num = hub_num;
+    header->segment_size = __shm.size;
+    header->topic_offset = (uint8_t*)topic - __shm.base;
+    header->start_time = MCN_GET_TIME_US();
+    /* magic is written at last, clients ignore the segment until it is set */
+    __atomic_store_n(&header->magic, MCN_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    mcn_set_mirror_hook(__mirror_hook);
+
+    for (uint32_t i = 0; i < hub_num; i++) {
+        /* mirror the sample published before */
+        if (hubs[i]->published) {
+            uint8_t* data = (uint8_t*)MCN_MALLOC(hubs[i]->obj_size);
+
+            if (data != NULL) {
+                if (mcn_copy_from_hub(hubs[i], data) == FMT_EOK) {
+                    hubs[i]->mirror = &topic[i];
+                    __mirror_hook(hubs[i], data);
+                }
+                MCN_FREE(data);
+            }
+        }
+        hubs[i]->mirror = &topic[i];
+    }
+
+    return FMT_EOK;
+
+fail:
+    close(__shm.fd);
+    __shm.fd = -1;
+    shm_unlink(shm_name);
+
+    return FMT_ERROR;
+}
+
+/**
+ * @brief Stop mirroring and remove the shared memory segment
+ * @note Processes which still map the segment keep reading the last samples
+ *
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_shm_stop(void)
+{
+    if (__shm.base == NULL) {
+        return FMT_EEMPTY;
+    }
+
+    for (uint32_t i = 0; i < __shm.hub_num; i++) {
+        __atomic_store_n(&__shm.hubs[i]->mirror, NULL, __ATOMIC_SEQ_CST);
+    }
+    mcn_set_mirror_hook(NULL);
+    /* wait publishers leaving mirror hook */
+    while (__atomic_load_n(&__shm_busy, __ATOMIC_SEQ_CST)) {
+        sched_yield();
+    }
+
+    munmap(__shm.base, __shm.size);
+    close(__shm.fd);
+    shm_unlink(__shm.name);
+
+    __shm.base = NULL;
+    __shm.fd = -1;
+    __shm.hubs = NULL;
+    __shm.hub_num = 0;
+
+    return FMT_EOK;
+}
+
+#endif
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Only built for Linux, this file is linked into external processes and
+ * does not depend on firmament.h */
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "module/ipc/mcn_shm_client.h"
+
+/**
+ * @brief Map the shared memory segment of uMCN mirror
+ *
+ * @param client Client handle
+ * @param shm_name Segment name passed to mcn_shm_start(), e.g, "/fmt_mcn"
+ * @return int 0 indicates success, -1 if segment not exists or invalid
+ */
+int mcn_shm_client_open(McnShmClient* client, const char* shm_name)
+{
+    struct stat st;
+    const McnShmHeader* header;
+
+    memset(client, 0, sizeof(McnShmClient));
+
+    client->fd = shm_open(shm_name, O_RDONLY, 0);
+    if (client->fd < 0) {
+        return -1;
+    }
+
+    if (fstat(client->fd, &st) < 0 || st.st_size < (off_t)sizeof(McnShmHeader)) {
+        goto fail;
+    }
+
+    client->base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, client->fd, 0);
+    if (client->base == MAP_FAILED) {
+        client->base = NULL;
+        goto fail;
+    }
+    client->size = st.st_size;
+
+    header = (const McnShmHeader*)client->base;
+    if (header->magic != MCN_SHM_MAGIC || header->version != MCN_SHM_VERSION
+        || header->segment_size > client->size
+        || header->topic_offset + header->topic_num * sizeof(McnShmTopic) > client->size) {
+        goto fail;
+    }
+
+    client->header = header;
+    client->topic = (const McnShmTopic*)&client->base[header->topic_offset];
+
+    return 0;
+
+fail:
+    mcn_shm_client_close(client);
+    return -1;
+}
+
+/**
+ * @brief Unmap the shared memory segment
+ *
+ * @param client Client handle
+ */
+void mcn_shm_client_close(McnShmClient* client)
+{
+    if (client->base) {
+        munmap(client->base, client->size);
+    }
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+
+    client->fd = -1;
+    client->base = NULL;
+    client->header = NULL;
+    client->topic = NULL;
+}
+
+/**
+ * @brief Find mirrored topic by name
+ *
+ * @param client Client handle
+ * @param topic_name Topic name
+ * @return const McnShmTopic* Mirrored topic, NULL if not found
+ */
+const McnShmTopic* mcn_shm_client_find(const McnShmClient* client, const char* topic_name)
+{
+    for (uint32_t i = 0; i < client->header->topic_num; i++) {
+        if (strncmp(client->topic[i].name, topic_name, MCN_SHM_NAME_LEN) == 0) {
+            return &client->topic[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Check if topic has been published since the sample last read
+ *
+ * @param topic Mirrored topic
+ * @param last_seq Sequence returned by mcn_shm_client_read(), 0 if never read
+ * @return int 1 if there is a new sample
+ */
+int mcn_shm_client_poll(const McnShmTopic* topic, uint32_t last_seq)
+{
+    uint32_t seq = __atomic_load_n(&topic->seq, __ATOMIC_ACQUIRE);
+
+    return (seq & ~1U) != last_seq;
+}
+
+/**
+ * @brief Copy the latest sample of topic
+ * @note The copy is retried if the writer updates the topic meanwhile, so it
+ * never returns a torn sample
+ *
+ * @param client Client handle
+ * @param topic Mirrored topic
+ * @param buffer Buffer to receive sample, at least topic->size bytes
+ * @param seq Sequence of the sample, used by mcn_shm_client_poll(), can be NULL
+ * @param timestamp Publish time (us) of the sample, can be NULL
+ * @return int 0 indicates success, -1 if topic has not been published
+ */
+int mcn_shm_client_read(const McnShmClient* client, const McnShmTopic* topic, void* buffer, uint32_t* seq,
+                        uint64_t* timestamp)
+{
+    const uint8_t* data = &client->base[topic->data_offset];
+    uint32_t seq_start, seq_end;
+    uint64_t time;
+
+    do {
+        seq_start = __atomic_load_n(&topic->seq, __ATOMIC_ACQUIRE);
+        if (seq_start & 1) {
+            /* writer in progress */
+            continue;
+        }
+
+        memcpy(buffer, data, topic->size);
+        time = topic->timestamp;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq_end = __atomic_load_n(&topic->seq, __ATOMIC_RELAXED);
+    } while ((seq_start & 1) || seq_start != seq_end);
+
+    if (seq_start == 0) {
+        return -1;
+    }
+
+    if (seq) {
+        *seq = seq_start;
+    }
+    if (timestamp) {
+        *timestamp = time;
+    }
+
+    return 0;
+}
+
+#endif
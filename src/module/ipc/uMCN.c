@@ -16,8 +16,284 @@
 #include <firmament.h>
 #include <string.h>
 
+/* Topic data is stored in a ring of buffer_num slots (a power of 2, at least 2)
+ * guarded by a sequence counter (seqlock). An even sequence means the data is
+ * stable, an odd sequence means a publish is in progress. Sample k (counted from
+ * 1) is stored in slot (k % buffer_num), and the latest stable sample for
+ * sequence s is sample (s >> 1), so the publisher always writes into a slot which
+ * is not the latest one and the data copy can run with the scheduler unlocked. */
+#define MCN_SLOT(_hub, _k) ((uint8_t*)(_hub)->pdata + MCN_BUF_INDEX(_hub, (_k) & ((_hub)->buffer_num - 1)) * (_hub)->obj_size)
+/* Topics which can be borrowed have spare buffers, and the ring slots are mapped
+ * to buffers by buf_map, so a borrowed buffer can be swapped out of the ring
+ * instead of being overwritten by the publisher. */
+#define MCN_BUF_INDEX(_hub, _slot) ((_hub)->buf_map ? (_hub)->buf_map[_slot] : (_slot))
+/* sample index is (seq >> 1), which wraps around at 31 bits */
+#define MCN_SAMPLE_MASK 0x7FFFFFFFU
+#define MCN_READ_LATEST 0xFFFFFFFFU
+
 static McnList __mcn_list = { .hub = NULL, .next = NULL };
 static struct rt_timer timer_mcn_freq_est;
+/* topic registry, open addressing hash table indexed by topic id */
+static McnHub_t* __mcn_registry;
+static uint32_t __mcn_registry_size;
+static uint32_t __mcn_topic_num;
+/* deferred callback dispatcher, the queue holds nodes which have a pending callback */
+static struct rt_thread __mcn_dispatch_thread;
+static char __mcn_dispatch_stack[MCN_DISPATCH_STACK_SIZE];
+static struct rt_semaphore __mcn_dispatch_sem;
+static struct rt_mutex __mcn_dispatch_lock;
+static McnNode_t __mcn_dispatch_queue[MCN_DISPATCH_QUEUE_SIZE];
+static uint32_t __mcn_dispatch_head;
+static uint32_t __mcn_dispatch_cnt;
+static uint32_t __mcn_dispatch_peak;
+static uint32_t __mcn_dispatch_overflow;
+static void (*volatile __mcn_publish_hook)(McnHub_t hub, const void* data);
+static void (*volatile __mcn_mirror_hook)(McnHub_t hub, const void* data);
+
+#ifdef FMT_USING_MCN_STATIC
+_Static_assert((MCN_STATIC_REGISTRY_SIZE & (MCN_STATIC_REGISTRY_SIZE - 1)) == 0,
+    "MCN_STATIC_REGISTRY_SIZE must be a power of 2");
+_Static_assert(MCN_STATIC_NODE_NUM > 0, "MCN_STATIC_NODE_NUM must not be 0");
+/* registry capacity is exported as an absolute symbol, so link.lds can check
+ * it against the number of topics in McnTab at link time */
+#define __MCN_STR(_x) #_x
+#define MCN_STR(_x)   __MCN_STR(_x)
+__asm__(".globl __mcn_registry_capacity\n\t.set __mcn_registry_capacity, " MCN_STR(MCN_STATIC_REGISTRY_SIZE));
+
+static McnHub_t __mcn_registry_pool[MCN_STATIC_REGISTRY_SIZE];
+/* subscribe node pool, free nodes are linked by next pointer */
+static McnNode __mcn_node_pool[MCN_STATIC_NODE_NUM];
+static McnNode_t __mcn_node_free_list;
+static uint32_t __mcn_node_used;
+static uint8_t __mcn_node_pool_ready;
+
+/**
+ * @brief Allocate a subscribe node from static node pool
+ * 
+ * @return McnNode_t Free node, NULL if the pool is exhausted
+ */
+static McnNode_t __mcn_node_alloc(void)
+{
+    McnNode_t node;
+
+    MCN_ENTER_CRITICAL;
+    if (!__mcn_node_pool_ready) {
+        for (int i = 0; i < MCN_STATIC_NODE_NUM; i++) {
+            __mcn_node_pool[i].next = (i == MCN_STATIC_NODE_NUM - 1) ? NULL : &__mcn_node_pool[i + 1];
+        }
+        __mcn_node_free_list = &__mcn_node_pool[0];
+        __mcn_node_pool_ready = 1;
+    }
+
+    node = __mcn_node_free_list;
+    if (node) {
+        __mcn_node_free_list = node->next;
+        __mcn_node_used++;
+    }
+    MCN_EXIT_CRITICAL;
+
+    return node;
+}
+
+/**
+ * @brief Return a subscribe node to static node pool
+ * @note Must be called with scheduler locked
+ * 
+ * @param node Subscribe node
+ */
+static void __mcn_node_free(McnNode_t node)
+{
+    node->next = __mcn_node_free_list;
+    __mcn_node_free_list = node;
+    __mcn_node_used--;
+}
+
+/**
+ * @brief Get the usage of static subscribe node pool
+ * 
+ * @param used Number of nodes in use
+ * @param total Total number of nodes in pool
+ */
+void mcn_get_node_pool_usage(uint32_t* used, uint32_t* total)
+{
+    *used = __mcn_node_used;
+    *total = MCN_STATIC_NODE_NUM;
+}
+
+static McnProfile __mcn_profile_pool[MCN_STATIC_PROFILE_NUM];
+static McnHub_t __mcn_profile_owner[MCN_STATIC_PROFILE_NUM];
+#endif
+
+/**
+ * @brief Add a sample into timing histogram
+ * 
+ * @param hist Timing histogram
+ * @param val Sample value (us)
+ */
+void mcn_hist_add(McnHist* hist, uint32_t val)
+{
+    uint32_t bin = 0;
+
+    /* bin index is the bit length of value */
+    while (bin < MCN_HIST_BIN_NUM - 1 && (val >> bin)) {
+        bin++;
+    }
+
+    hist->bin[bin]++;
+    hist->count++;
+    hist->sum += val;
+    if (val < hist->min) {
+        hist->min = val;
+    }
+    if (val > hist->max) {
+        hist->max = val;
+    }
+}
+
+/**
+ * @brief Clear timing histogram
+ * 
+ * @param hist Timing histogram
+ */
+void mcn_hist_reset(McnHist* hist)
+{
+    memset(hist, 0, sizeof(McnHist));
+    hist->min = UINT32_MAX;
+}
+
+/**
+ * @brief Record the latency from the latest publish to now
+ * @note Should be called after the latest sample is copied by subscriber
+ * 
+ * @param hub uMCN hub
+ */
+static void __mcn_profile_latency(McnHub_t hub)
+{
+    uint64_t now = MCN_GET_TIME_US();
+
+    MCN_ENTER_CRITICAL;
+    McnProfile_t profile = hub->profile;
+    if (profile && profile->last_publish && now > profile->last_publish) {
+        mcn_hist_add(&profile->latency, (uint32_t)(now - profile->last_publish));
+    }
+    MCN_EXIT_CRITICAL;
+}
+
+/**
+ * @brief Read consistent topic samples from hub
+ * @note The samples are only overwritten if the publisher wraps around the ring
+ * during the copy, in which case the copy is retried. Samples older than the
+ * queue depth are skipped and counted as lost.
+ * 
+ * @param hub uMCN hub
+ * @param first Index of the first sample to read, MCN_READ_LATEST to read the latest sample
+ * @param buffer Buffer to received the data
+ * @param num In: max number of samples to read, Out: number of samples read
+ * @param lost Number of samples have been overwritten before reading
+ * @return uint32_t Index of the last sample read
+ */
+static uint32_t __mcn_read_data(McnHub_t hub, uint32_t first, void* buffer, uint32_t* num, uint32_t* lost)
+{
+    uint32_t seq_begin, seq_end;
+    uint32_t depth = hub->buffer_num - 1;
+    uint32_t latest, start, pending, cnt;
+
+    for (int retry = 0; retry <= MCN_SEQLOCK_MAX_RETRY; retry++) {
+        if (retry == MCN_SEQLOCK_MAX_RETRY) {
+            /* the reader keeps being preempted by the publisher, fallback to copy with
+               scheduler locked, which prevents another publish from being started */
+            MCN_ENTER_CRITICAL;
+        }
+
+        seq_begin = hub->seq;
+        MCN_MEMORY_BARRIER();
+
+        latest = seq_begin >> 1;
+        start = first == MCN_READ_LATEST ? latest : first;
+        pending = (latest - start + 1) & MCN_SAMPLE_MASK;
+        *lost = 0;
+        if (pending > depth) {
+            *lost = pending - depth;
+            start = (latest - depth + 1) & MCN_SAMPLE_MASK;
+            pending = depth;
+        }
+        cnt = pending < *num ? pending : *num;
+
+        for (uint32_t i = 0; i < cnt; i++) {
+            memcpy((uint8_t*)buffer + i * hub->obj_size, MCN_SLOT(hub, start + i), hub->obj_size);
+        }
+
+        MCN_MEMORY_BARRIER();
+        seq_end = hub->seq;
+
+        if (retry == MCN_SEQLOCK_MAX_RETRY) {
+            MCN_EXIT_CRITICAL;
+            break;
+        }
+        /* the slot of sample start is overwritten once sample (start + buffer_num) is being published */
+        if (cnt == 0 || ((((seq_end + 1) >> 1) - start) & MCN_SAMPLE_MASK) < hub->buffer_num) {
+            break;
+        }
+    }
+
+    *num = cnt;
+
+    return (start + cnt - 1) & MCN_SAMPLE_MASK;
+}
+
+/**
+ * @brief Build topic registry from all topics defined by MCN_DEFINE()
+ * @note The registry is sized from the number of entries in McnTab section
+ * 
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+static fmt_err_t __mcn_registry_init(void)
+{
+    extern const int __mcn_tab_start;
+    extern const int __mcn_tab_end;
+
+    const McnHub_t* table = (const McnHub_t*)&__mcn_tab_start;
+    uint32_t size = 2;
+
+    __mcn_topic_num = (const McnHub_t*)&__mcn_tab_end - table;
+
+    /* keep load factor no more than 0.5 */
+    while (size < 2 * __mcn_topic_num) {
+        size <<= 1;
+    }
+
+#ifdef FMT_USING_MCN_STATIC
+    if (size > MCN_STATIC_REGISTRY_SIZE) {
+        console_printf("mcn registry is too small for %d topics\n", __mcn_topic_num);
+        return FMT_ENOMEM;
+    }
+    __mcn_registry = __mcn_registry_pool;
+#else
+    __mcn_registry = (McnHub_t*)MCN_MALLOC(size * sizeof(McnHub_t));
+    if (__mcn_registry == NULL) {
+        return FMT_ENOMEM;
+    }
+#endif
+    memset(__mcn_registry, 0, size * sizeof(McnHub_t));
+    __mcn_registry_size = size;
+
+    for (uint32_t i = 0; i < __mcn_topic_num; i++) {
+        McnHub_t hub = table[i];
+        uint32_t index;
+
+        hub->id = mcn_topic_id(hub->obj_name);
+
+        for (index = hub->id & (size - 1); __mcn_registry[index] != NULL; index = (index + 1) & (size - 1)) {
+            if (__mcn_registry[index]->id == hub->id) {
+                console_printf("mcn topic id conflict: %s %s\n", __mcn_registry[index]->obj_name, hub->obj_name);
+                return FMT_ERROR;
+            }
+        }
+        __mcn_registry[index] = hub;
+    }
+
+    return FMT_EOK;
+}
 
 /**
  * @brief Topic publish frequency estimator entry
@@ -62,6 +338,29 @@ void mcn_node_clear(McnNode_t node_t)
     MCN_EXIT_CRITICAL;
 }
 
+/**
+ * @brief Throttle the publish rate delivered to a uMCN node
+ * @note A throttled publish won't set the renewal flag, send the event or invoke
+ * the callback of the node, and it is counted in node->skipped. The data is
+ * still available by mcn_copy() or mcn_copy_n().
+ * 
+ * @param node_t uMCN node
+ * @param min_interval Minimum interval (ms) between two delivered publishes, 0 to disable
+ * @param decimation Deliver one of every decimation publishes, 0 or 1 to disable
+ */
+void mcn_node_throttle(McnNode_t node_t, uint32_t min_interval, uint16_t decimation)
+{
+    MCN_ASSERT(node_t != NULL);
+
+    MCN_ENTER_CRITICAL;
+    node_t->min_interval = min_interval;
+    /* let the next publish be delivered */
+    node_t->last_deliver = MCN_GET_TIME_MS() - min_interval;
+    node_t->decimation = decimation;
+    node_t->decimation_cnt = decimation ? decimation - 1 : 0;
+    MCN_EXIT_CRITICAL;
+}
+
 /**
  * @brief Suspend a uMCN topic
  * 
@@ -112,6 +411,101 @@ McnHub_t mcn_iterate(McnList_t* ite)
     return hub;
 }
 
+/**
+ * @brief Calculate topic id from topic name
+ * @note Topic id is the 32-bit FNV-1a hash of topic name, so it keeps the same
+ * across builds and can be used to identify topic in logs and telemetry
+ * 
+ * @param name Topic name
+ * @return uint32_t Topic id
+ */
+uint32_t mcn_topic_id(const char* name)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Find uMCN hub by topic id
+ * 
+ * @param id Topic id
+ * @return McnHub_t uMCN hub, NULL if not found
+ */
+McnHub_t mcn_find_by_id(uint32_t id)
+{
+    if (__mcn_registry == NULL) {
+        return NULL;
+    }
+
+    for (uint32_t index = id & (__mcn_registry_size - 1); __mcn_registry[index] != NULL;
+         index = (index + 1) & (__mcn_registry_size - 1)) {
+        if (__mcn_registry[index]->id == id) {
+            return __mcn_registry[index];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find uMCN hub by topic name
+ * @note The topic may not be advertised yet
+ * 
+ * @param name Topic name
+ * @return McnHub_t uMCN hub, NULL if not found
+ */
+McnHub_t mcn_find(const char* name)
+{
+    MCN_ASSERT(name != NULL);
+
+    McnHub_t hub = mcn_find_by_id(mcn_topic_id(name));
+
+    if (hub == NULL || strcmp(hub->obj_name, name) != 0) {
+        return NULL;
+    }
+
+    return hub;
+}
+
+/**
+ * @brief Get the number of topics defined
+ * 
+ * @return uint32_t Number of topics
+ */
+uint32_t mcn_get_topic_num(void)
+{
+    return __mcn_topic_num;
+}
+
+/**
+ * @brief Get memory occupied by topic data
+ * @note In static mode the reserved storage is reported even if the topic
+ * is not advertised. Subscribe nodes are not included.
+ * 
+ * @param hub uMCN hub
+ * @return uint32_t Size in bytes of data buffers and meta data
+ */
+uint32_t mcn_get_topic_mem(McnHub_t hub)
+{
+#ifdef FMT_USING_MCN_STATIC
+    return hub->storage_size;
+#else
+    uint32_t buffer_num = hub->buffer_num + hub->spare_num;
+
+    if (hub->pdata == NULL) {
+        return 0;
+    }
+
+    return buffer_num * hub->obj_size + (hub->spare_num ? 2 * buffer_num : 0);
+#endif
+}
+
 /**
  * @brief Poll for topic status
  * @note This function would return immediately
@@ -175,10 +569,17 @@ fmt_err_t mcn_copy(McnHub_t hub, McnNode_t node_t, void* buffer)
         return FMT_ENOTHANDLE;
     }
 
-    MCN_ENTER_CRITICAL;
-    memcpy(buffer, hub->pdata, hub->obj_size);
+    uint32_t num = 1;
+    uint32_t lost;
+    uint8_t renewal = node_t->renewal;
+
+    /* clear renewal flag before reading, so a publish during the copy will be noticed */
     node_t->renewal = 0;
-    MCN_EXIT_CRITICAL;
+    node_t->cursor = __mcn_read_data(hub, MCN_READ_LATEST, buffer, &num, &lost);
+
+    if (hub->profile && renewal) {
+        __mcn_profile_latency(hub);
+    }
 
     return FMT_EOK;
 }
@@ -207,22 +608,65 @@ fmt_err_t mcn_copy_from_hub(McnHub_t hub, void* buffer)
         return FMT_ENOTHANDLE;
     }
 
-    MCN_ENTER_CRITICAL;
-    memcpy(buffer, hub->pdata, hub->obj_size);
-    MCN_EXIT_CRITICAL;
+    uint32_t num = 1;
+    uint32_t lost;
+
+    __mcn_read_data(hub, MCN_READ_LATEST, buffer, &num, &lost);
 
     return FMT_EOK;
 }
 
 /**
- * @brief Advertise a uMCN topic
+ * @brief Copy all pending uMCN topic samples from hub
+ * @note Samples are copied from the oldest to the newest. If there are more
+ * pending samples than num, the rest keep pending for the next call. The
+ * renewal flag is cleared if all pending samples have been copied.
  * 
  * @param hub uMCN hub
- * @param echo Echo function to print topic contents
+ * @param node_t uMCN node
+ * @param buffer Buffer to received the data, which should be able to hold num samples
+ * @param num In: max number of samples to copy, Out: number of samples copied
+ * @param lost Number of samples have been overwritten since last copy, can be NULL
  * @return fmt_err_t FMT_EOK indicates success
  */
-fmt_err_t mcn_advertise(McnHub_t hub, int (*echo)(void* parameter))
+fmt_err_t mcn_copy_n(McnHub_t hub, McnNode_t node_t, void* buffer, uint32_t* num, uint32_t* lost)
+{
+    uint32_t lost_num;
+
+    MCN_ASSERT(hub != NULL);
+    MCN_ASSERT(node_t != NULL);
+    MCN_ASSERT(buffer != NULL);
+    MCN_ASSERT(num != NULL);
+
+    if (hub->pdata == NULL) {
+        /* copy from non-advertised hub */
+        return FMT_ERROR;
+    }
+
+    /* clear renewal flag before reading, so a publish during the copy will be noticed */
+    node_t->renewal = 0;
+    node_t->cursor = __mcn_read_data(hub, (node_t->cursor + 1) & MCN_SAMPLE_MASK, buffer, num, &lost_num);
+    node_t->lost += lost_num;
+
+    if (node_t->cursor != (hub->seq >> 1)) {
+        /* there are still samples pending */
+        node_t->renewal = 1;
+    } else if (hub->profile && *num) {
+        __mcn_profile_latency(hub);
+    }
+
+    if (lost) {
+        *lost = lost_num;
+    }
+
+    return FMT_EOK;
+}
+
+static fmt_err_t __mcn_advertise(McnHub_t hub, uint16_t queue_depth, uint8_t borrow_num, int (*echo)(void* parameter))
 {
+    uint16_t buffer_num = 2;
+    uint8_t* meta = NULL;
+
     MCN_ASSERT(hub != NULL);
 
     if (hub->pdata != NULL) {
@@ -230,15 +674,71 @@ fmt_err_t mcn_advertise(McnHub_t hub, int (*echo)(void* parameter))
         return FMT_ENOTHANDLE;
     }
 
+    if (queue_depth < 1 || queue_depth > MCN_MAX_QUEUE_DEPTH || borrow_num > MCN_MAX_BORROW_NUM) {
+        return FMT_EINVAL;
+    }
+
+    /* one more slot is reserved for the sample being published */
+    while (buffer_num < queue_depth + 1) {
+        buffer_num <<= 1;
+    }
+
+#ifdef FMT_USING_MCN_STATIC
+    /* data buffers followed by meta data, which is the layout of MCN_STORAGE_SIZE() */
+    if (hub->storage == NULL
+        || hub->storage_size < (buffer_num + borrow_num) * hub->obj_size + (borrow_num ? 2 * (buffer_num + borrow_num) : 0)) {
+        console_printf("mcn topic %s storage is not enough, check MCN_DEFINE\n", hub->obj_name);
+        return FMT_ENOMEM;
+    }
+
+    if (borrow_num) {
+        meta = (uint8_t*)hub->storage + (buffer_num + borrow_num) * hub->obj_size;
+    }
+
+    MCN_ENTER_CRITICAL;
+    hub->pdata = hub->storage;
+    hub->echo = echo;
+#else
+    if (borrow_num) {
+        /* buffer map, pin count of each buffer and spare buffer list */
+        meta = MCN_MALLOC(buffer_num + (buffer_num + borrow_num) + borrow_num);
+        if (meta == NULL) {
+            return FMT_ENOMEM;
+        }
+    }
+
     MCN_ENTER_CRITICAL;
-    hub->pdata = MCN_MALLOC(hub->obj_size);
+    hub->pdata = MCN_MALLOC((buffer_num + borrow_num) * hub->obj_size);
     hub->echo = echo;
 
     if (hub->pdata == NULL) {
+        MCN_EXIT_CRITICAL;
+        MCN_FREE(meta);
         return FMT_ENOMEM;
     }
-
-    memset(hub->pdata, 0, hub->obj_size);
+#endif
+
+    memset(hub->pdata, 0, (buffer_num + borrow_num) * hub->obj_size);
+    hub->buffer_num = buffer_num;
+    hub->seq = 0;
+    hub->busy_drop = 0;
+
+    if (meta) {
+        hub->buf_map = meta;
+        hub->pin_cnt = &meta[buffer_num];
+        hub->spare = &meta[buffer_num + buffer_num + borrow_num];
+        for (int i = 0; i < buffer_num; i++) {
+            hub->buf_map[i] = i;
+        }
+        for (int i = 0; i < buffer_num + borrow_num; i++) {
+            hub->pin_cnt[i] = 0;
+        }
+        for (int i = 0; i < borrow_num; i++) {
+            hub->spare[i] = buffer_num + i;
+        }
+    }
+    hub->spare_num = borrow_num;
+    hub->pin_num = 0;
 
     /* update Mcn List */
     McnList_t cp = &__mcn_list;
@@ -249,10 +749,16 @@ fmt_err_t mcn_advertise(McnHub_t hub, int (*echo)(void* parameter))
     }
 
     if (cp->hub != NULL) {
+#ifdef FMT_USING_MCN_STATIC
+        cp->next = hub->list_node;
+#else
         cp->next = (McnList_t)MCN_MALLOC(sizeof(McnList));
+#endif
 
-        if (cp->next == NULL)
+        if (cp->next == NULL) {
+            MCN_EXIT_CRITICAL;
             return FMT_ENOMEM;
+        }
 
         cp = cp->next;
     }
@@ -269,6 +775,52 @@ fmt_err_t mcn_advertise(McnHub_t hub, int (*echo)(void* parameter))
     return FMT_EOK;
 }
 
+/**
+ * @brief Advertise a uMCN topic
+ * 
+ * @param hub uMCN hub
+ * @param echo Echo function to print topic contents
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_advertise(McnHub_t hub, int (*echo)(void* parameter))
+{
+    return __mcn_advertise(hub, 1, 0, echo);
+}
+
+/**
+ * @brief Advertise a uMCN topic with sample queue
+ * @note The queue depth is rounded up so that depth + 1 is a power of 2
+ * 
+ * @param hub uMCN hub
+ * @param queue_depth Number of samples can be buffered for each subscriber
+ * @param echo Echo function to print topic contents
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_advertise_queue(McnHub_t hub, uint16_t queue_depth, int (*echo)(void* parameter))
+{
+    return __mcn_advertise(hub, queue_depth, 0, echo);
+}
+
+/**
+ * @brief Advertise a uMCN topic which supports zero-copy borrow
+ * @note borrow_num spare buffers are allocated, so at most borrow_num
+ * buffers can be borrowed at the same time
+ * 
+ * @param hub uMCN hub
+ * @param queue_depth Number of samples can be buffered for each subscriber
+ * @param borrow_num Max number of buffers can be borrowed at the same time
+ * @param echo Echo function to print topic contents
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_advertise_loan(McnHub_t hub, uint16_t queue_depth, uint8_t borrow_num, int (*echo)(void* parameter))
+{
+    if (borrow_num == 0) {
+        return FMT_EINVAL;
+    }
+
+    return __mcn_advertise(hub, queue_depth, borrow_num, echo);
+}
+
 /**
  * @brief Subscribe a uMCN topic
  * 
@@ -286,7 +838,11 @@ McnNode_t mcn_subscribe(McnHub_t hub, MCN_EVENT_HANDLE event, void (*pub_cb)(voi
         return NULL;
     }
 
+#ifdef FMT_USING_MCN_STATIC
+    McnNode_t node = __mcn_node_alloc();
+#else
     McnNode_t node = (McnNode_t)MCN_MALLOC(sizeof(McnNode));
+#endif
 
     if (node == NULL) {
         console_printf("mcn create node fail!\n");
@@ -295,10 +851,25 @@ McnNode_t mcn_subscribe(McnHub_t hub, MCN_EVENT_HANDLE event, void (*pub_cb)(voi
 
     node->renewal = 0;
     node->event = event;
+    node->waitset = NULL;
+    node->wait_mask = 0;
     node->pub_cb = pub_cb;
+    node->lost = 0;
+    node->min_interval = 0;
+    node->last_deliver = 0;
+    node->decimation = 0;
+    node->decimation_cnt = 0;
+    node->skipped = 0;
+    node->dispatch_hub = NULL;
+    node->dispatch_buf = NULL;
+    node->dispatch_pending = 0;
+    node->coalesced = 0;
+    node->overflow = 0;
     node->next = NULL;
 
     MCN_ENTER_CRITICAL;
+    /* the latest sample is pending if it's already published */
+    node->cursor = ((hub->seq >> 1) - (hub->published ? 1 : 0)) & MCN_SAMPLE_MASK;
 
     /* no node link yet */
     if (hub->link_tail == NULL) {
@@ -317,7 +888,7 @@ McnNode_t mcn_subscribe(McnHub_t hub, MCN_EVENT_HANDLE event, void (*pub_cb)(voi
 
         if (node->pub_cb) {
             /* if data published before subscribe, then call callback immediately */
-            node->pub_cb(hub->pdata);
+            node->pub_cb(MCN_SLOT(hub, hub->seq >> 1));
         }
     }
 
@@ -355,6 +926,11 @@ fmt_err_t mcn_unsubscribe(McnHub_t hub, McnNode_t node)
         return FMT_EEMPTY;
     }
 
+    if (cur_node->dispatch_buf) {
+        /* wait for the running callback and drop the pending one */
+        mcn_node_defer_callback(hub, cur_node, NULL);
+    }
+
     /* update list */
     MCN_ENTER_CRITICAL;
 
@@ -373,8 +949,17 @@ fmt_err_t mcn_unsubscribe(McnHub_t hub, McnNode_t node)
         }
     }
 
+    /* detach from waitset */
+    if (cur_node->waitset) {
+        cur_node->waitset->attach_mask &= ~cur_node->wait_mask;
+    }
+
     /* free current node */
+#ifdef FMT_USING_MCN_STATIC
+    __mcn_node_free(cur_node);
+#else
     MCN_FREE(cur_node);
+#endif
     // cur_node = NULL;
     hub->link_num--;
     MCN_EXIT_CRITICAL;
@@ -383,36 +968,117 @@ fmt_err_t mcn_unsubscribe(McnHub_t hub, McnNode_t node)
 }
 
 /**
- * @brief Publish uMCN topic
+ * @brief Check if a publish should be skipped for the node
  * 
- * @param hub uMCN hub, which can be obtained by MCN_HUB() macro
- * @param data Data of topic to publish
- * @return fmt_err_t FMT_EOK indicates success
+ * @param node uMCN node
+ * @return true The node is throttled by decimation or min interval
+ * @return false The publish should be delivered to the node
  */
-fmt_err_t mcn_publish(McnHub_t hub, const void* data)
+static bool __mcn_node_throttled(McnNode_t node)
 {
-    MCN_ASSERT(hub != NULL);
-    MCN_ASSERT(data != NULL);
+    if (node->decimation > 1) {
+        if (++node->decimation_cnt < node->decimation) {
+            return true;
+        }
+        node->decimation_cnt = 0;
+    }
 
-    if (hub->pdata == NULL) {
-        /* hub is not advertised yet */
-        return FMT_ERROR;
+    if (node->min_interval) {
+        uint32_t now = MCN_GET_TIME_MS();
+
+        if (now - node->last_deliver < node->min_interval) {
+            return true;
+        }
+        node->last_deliver = now;
     }
 
-    if (hub->suspend) {
-        return FMT_ENOTHANDLE;
+    return false;
+}
+
+/**
+ * @brief Start a publish and get the buffer to write topic data
+ * 
+ * @param hub uMCN hub
+ * @return void* Buffer to write, NULL if another publish is in progress
+ */
+static void* __mcn_publish_begin(McnHub_t hub)
+{
+    uint32_t seq;
+    void* buffer;
+
+    MCN_ENTER_CRITICAL;
+    if (hub->seq & 1) {
+        /* another publish is in progress, the sample is dropped */
+        hub->busy_drop++;
+        MCN_EXIT_CRITICAL;
+        return NULL;
+    }
+    seq = ++hub->seq;
+
+    if (hub->buf_map) {
+        uint32_t slot = ((seq + 1) >> 1) & (hub->buffer_num - 1);
+
+        if (hub->pin_cnt[hub->buf_map[slot]]) {
+            /* buffer is borrowed, swap it with a free spare buffer. There must be one
+               since the number of borrowed buffers never exceeds spare_num */
+            for (int i = 0; i < hub->spare_num; i++) {
+                if (hub->pin_cnt[hub->spare[i]] == 0) {
+                    uint8_t tmp = hub->spare[i];
+                    hub->spare[i] = hub->buf_map[slot];
+                    hub->buf_map[slot] = tmp;
+                    break;
+                }
+            }
+        }
     }
 
-    /* update freq estimator window */
-    hub->freq_est_window[hub->window_index]++;
+    buffer = MCN_SLOT(hub, (seq + 1) >> 1);
+    MCN_EXIT_CRITICAL;
+
+    return buffer;
+}
+
+/**
+ * @brief Finish a publish, make the new data visible and inform subscribers
+ * 
+ * @param hub uMCN hub
+ */
+static void __mcn_publish_commit(McnHub_t hub)
+{
+    uint32_t seq;
+    uint32_t dispatch_num = 0;
+    /* inline callbacks to invoke, decided with the same snapshot as the other
+       subscribers, so a nested publish of this hub can't change them */
+    void (*inline_cb[MCN_MAX_LINK_NUM])(void* parameter);
+    uint32_t inline_num = 0;
+    bool deliver;
+
+    MCN_MEMORY_BARRIER();
 
     MCN_ENTER_CRITICAL;
-    /* copy data to hub */
-    memcpy(hub->pdata, data, hub->obj_size);
+    /* make the new data visible */
+    seq = ++hub->seq;
+
+    if (hub->profile) {
+        uint64_t now = MCN_GET_TIME_US();
+
+        if (hub->profile->last_publish) {
+            mcn_hist_add(&hub->profile->interval, (uint32_t)(now - hub->profile->last_publish));
+        }
+        hub->profile->last_publish = now;
+    }
     /* traverse each node */
     McnNode_t node = hub->link_head;
 
     while (node != NULL) {
+        /* throttled node is neither signaled nor woken up */
+        deliver = !__mcn_node_throttled(node);
+        if (!deliver) {
+            node->skipped++;
+            node = node->next;
+            continue;
+        }
+
         /* update each node's renewal flag */
         node->renewal = 1;
 
@@ -423,26 +1089,815 @@ fmt_err_t mcn_publish(McnHub_t hub, const void* data)
                 MCN_SEND_EVENT(node->event);
         }
 
+        /* mark the topic ready in the waitset */
+        if (node->waitset) {
+            MCN_WAITSET_SIGNAL(&node->waitset->event, node->wait_mask);
+        }
+
+        if (node->pub_cb != NULL && node->dispatch_buf == NULL && inline_num < MCN_MAX_LINK_NUM) {
+            inline_cb[inline_num++] = node->pub_cb;
+        }
+
+        /* queue deferred callback, a pending one will pick up this sample as well */
+        if (node->pub_cb != NULL && node->dispatch_buf != NULL) {
+            if (node->dispatch_pending) {
+                node->coalesced++;
+            } else if (__mcn_dispatch_cnt >= MCN_DISPATCH_QUEUE_SIZE) {
+                node->overflow++;
+                __mcn_dispatch_overflow++;
+            } else {
+                __mcn_dispatch_queue[(__mcn_dispatch_head + __mcn_dispatch_cnt) % MCN_DISPATCH_QUEUE_SIZE] = node;
+                __mcn_dispatch_cnt++;
+                if (__mcn_dispatch_cnt > __mcn_dispatch_peak) {
+                    __mcn_dispatch_peak = __mcn_dispatch_cnt;
+                }
+                node->dispatch_pending = 1;
+                dispatch_num++;
+            }
+        }
+
         node = node->next;
     }
 
     hub->published = 1;
     MCN_EXIT_CRITICAL;
 
-    /* invoke callback func */
-    node = hub->link_head;
+    while (dispatch_num--) {
+        rt_sem_release(&__mcn_dispatch_sem);
+    }
+
+    if (hub->record) {
+        void (*hook)(McnHub_t hub, const void* data) = __mcn_publish_hook;
 
-    while (node != NULL) {
-        if (node->pub_cb != NULL) {
-            node->pub_cb(hub->pdata);
+        if (hook) {
+            hook(hub, MCN_SLOT(hub, seq >> 1));
         }
+    }
 
-        node = node->next;
+    if (hub->mirror) {
+        void (*hook)(McnHub_t hub, const void* data) = __mcn_mirror_hook;
+
+        if (hook) {
+            hook(hub, MCN_SLOT(hub, seq >> 1));
+        }
+    }
+
+    /* invoke inline callback func */
+    for (uint32_t i = 0; i < inline_num; i++) {
+        inline_cb[i](MCN_SLOT(hub, seq >> 1));
+    }
+}
+
+/**
+ * @brief Publish uMCN topic
+ * @note A topic should only be published from one context at a time, a publish
+ * which preempts another publish of the same topic is rejected with FMT_EBUSY
+ * 
+ * @param hub uMCN hub, which can be obtained by MCN_HUB() macro
+ * @param data Data of topic to publish
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_publish(McnHub_t hub, const void* data)
+{
+    void* buffer;
+
+    MCN_ASSERT(hub != NULL);
+    MCN_ASSERT(data != NULL);
+
+    if (hub->pdata == NULL) {
+        /* hub is not advertised yet */
+        return FMT_ERROR;
+    }
+
+    if (hub->suspend) {
+        return FMT_ENOTHANDLE;
+    }
+
+    /* update freq estimator window */
+    hub->freq_est_window[hub->window_index]++;
+
+    buffer = __mcn_publish_begin(hub);
+    if (buffer == NULL) {
+        return FMT_EBUSY;
+    }
+
+    /* copy data to the buffer which is not being read, with scheduler unlocked */
+    memcpy(buffer, data, hub->obj_size);
+
+    __mcn_publish_commit(hub);
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Loan a buffer from hub to publish topic data without copy
+ * @note The loaned buffer contains a stale sample and must be completely filled
+ * before mcn_commit() is called. Readers are not blocked during the loan, but
+ * the topic can't be published by others until the loan is committed.
+ * 
+ * @param hub uMCN hub
+ * @return void* Buffer to write topic data, NULL if fail
+ */
+void* mcn_loan(McnHub_t hub)
+{
+    MCN_ASSERT(hub != NULL);
+
+    if (hub->pdata == NULL || hub->suspend) {
+        return NULL;
+    }
+
+    /* update freq estimator window */
+    hub->freq_est_window[hub->window_index]++;
+
+    return __mcn_publish_begin(hub);
+}
+
+/**
+ * @brief Publish the buffer loaned by mcn_loan()
+ * 
+ * @param hub uMCN hub
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_commit(McnHub_t hub)
+{
+    MCN_ASSERT(hub != NULL);
+
+    if (!(hub->seq & 1)) {
+        /* no buffer loaned */
+        return FMT_ERROR;
+    }
+
+    __mcn_publish_commit(hub);
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Borrow the latest topic data from hub without copy
+ * @note The returned buffer won't be modified until mcn_release() is called.
+ * Only topics advertised by mcn_advertise_loan() can be borrowed. This function
+ * will clear the renewal flag.
+ * 
+ * @param hub uMCN hub
+ * @param node_t uMCN node
+ * @return const void* Read-only topic data, NULL if fail
+ */
+const void* mcn_borrow(McnHub_t hub, McnNode_t node_t)
+{
+    uint32_t latest;
+    uint8_t index;
+
+    MCN_ASSERT(hub != NULL);
+    MCN_ASSERT(node_t != NULL);
+
+    if (hub->pdata == NULL || hub->buf_map == NULL || !hub->published) {
+        return NULL;
+    }
+
+    MCN_ENTER_CRITICAL;
+    if (hub->pin_num >= hub->spare_num) {
+        /* no more spare buffer to swap out the borrowed one */
+        MCN_EXIT_CRITICAL;
+        return NULL;
+    }
+    latest = hub->seq >> 1;
+    index = hub->buf_map[latest & (hub->buffer_num - 1)];
+    hub->pin_cnt[index]++;
+    hub->pin_num++;
+    node_t->renewal = 0;
+    node_t->cursor = latest;
+    MCN_EXIT_CRITICAL;
+
+    if (hub->profile) {
+        __mcn_profile_latency(hub);
+    }
+
+    return (uint8_t*)hub->pdata + index * hub->obj_size;
+}
+
+/**
+ * @brief Release the buffer borrowed by mcn_borrow()
+ * 
+ * @param hub uMCN hub
+ * @param data Buffer returned by mcn_borrow()
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_release(McnHub_t hub, const void* data)
+{
+    uint32_t index;
+
+    MCN_ASSERT(hub != NULL);
+    MCN_ASSERT(data != NULL);
+
+    if (hub->buf_map == NULL) {
+        return FMT_ERROR;
+    }
+
+    index = ((const uint8_t*)data - (const uint8_t*)hub->pdata) / hub->obj_size;
+    if (index >= hub->buffer_num + hub->spare_num) {
+        return FMT_EINVAL;
+    }
+
+    MCN_ENTER_CRITICAL;
+    if (hub->pin_cnt[index] == 0) {
+        MCN_EXIT_CRITICAL;
+        return FMT_ERROR;
+    }
+    hub->pin_cnt[index]--;
+    hub->pin_num--;
+    MCN_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Initialize a uMCN waitset
+ * @note A waitset allows a task to wait for several topics at the same time
+ * 
+ * @param waitset uMCN waitset
+ * @param name Waitset name
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_waitset_init(McnWaitset_t waitset, const char* name)
+{
+    MCN_ASSERT(waitset != NULL);
+
+    waitset->attach_mask = 0;
+
+    if (MCN_WAITSET_INIT(&waitset->event, name) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Deinitialize a uMCN waitset
+ * @note All nodes should be detached before deinit
+ * 
+ * @param waitset uMCN waitset
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_waitset_deinit(McnWaitset_t waitset)
+{
+    MCN_ASSERT(waitset != NULL);
+
+    if (waitset->attach_mask) {
+        return FMT_EBUSY;
+    }
+
+    if (MCN_WAITSET_DETACH(&waitset->event) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Attach a subscribe node to waitset
+ * @note The waitset is signaled immediately if the node has pending data
+ * 
+ * @param waitset uMCN waitset
+ * @param node_t uMCN node
+ * @param bit Bit in the ready mask returned by mcn_waitset_wait(), 0~31
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_waitset_attach(McnWaitset_t waitset, McnNode_t node_t, uint8_t bit)
+{
+    MCN_ASSERT(waitset != NULL);
+    MCN_ASSERT(node_t != NULL);
+
+    if (bit > 31) {
+        return FMT_EINVAL;
+    }
+
+    MCN_ENTER_CRITICAL;
+    if (node_t->waitset != NULL || (waitset->attach_mask & (1UL << bit))) {
+        /* node already attached or bit already used */
+        MCN_EXIT_CRITICAL;
+        return FMT_EBUSY;
+    }
+
+    node_t->wait_mask = 1UL << bit;
+    node_t->waitset = waitset;
+    waitset->attach_mask |= node_t->wait_mask;
+
+    if (node_t->renewal) {
+        MCN_WAITSET_SIGNAL(&waitset->event, node_t->wait_mask);
+    }
+    MCN_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Detach a subscribe node from waitset
+ * 
+ * @param waitset uMCN waitset
+ * @param node_t uMCN node
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_waitset_detach(McnWaitset_t waitset, McnNode_t node_t)
+{
+    MCN_ASSERT(waitset != NULL);
+    MCN_ASSERT(node_t != NULL);
+
+    MCN_ENTER_CRITICAL;
+    if (node_t->waitset != waitset) {
+        MCN_EXIT_CRITICAL;
+        return FMT_EINVAL;
+    }
+
+    waitset->attach_mask &= ~node_t->wait_mask;
+    node_t->waitset = NULL;
+    node_t->wait_mask = 0;
+    MCN_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Wait for any topic attached to the waitset to be published
+ * @note The ready bits are cleared after return, the renewal flag of each
+ * node is untouched and should be cleared by mcn_copy()
+ * 
+ * @param waitset uMCN waitset
+ * @param timeout Wait timeout
+ * @return uint32_t Ready mask of attached topics, 0 if timeout
+ */
+uint32_t mcn_waitset_wait(McnWaitset_t waitset, int32_t timeout)
+{
+    rt_uint32_t recved = 0;
+
+    MCN_ASSERT(waitset != NULL);
+
+    if (waitset->attach_mask == 0) {
+        return 0;
     }
 
+    if (MCN_WAITSET_WAIT(&waitset->event, waitset->attach_mask, timeout, &recved) != RT_EOK) {
+        return 0;
+    }
+
+    return recved;
+}
+
+/**
+ * @brief Check if an instance of multi-instance topic can be selected
+ * @note Must be called with scheduler locked
+ * 
+ * @param multi Multi-instance topic
+ * @param index Instance index
+ * @param now Current time (ms)
+ * @return true The instance is advertised, published and not timeout
+ */
+static bool __mcn_multi_usable(McnMulti_t multi, uint8_t index, uint32_t now)
+{
+    McnHub_t hub = multi->instance[index];
+
+    if (hub->pdata == NULL || !hub->published) {
+        return false;
+    }
+
+    if (hub->seq != multi->last_seq[index]) {
+        multi->last_seq[index] = hub->seq;
+        multi->last_update[index] = now;
+    }
+
+    return multi->timeout == 0 || now - multi->last_update[index] <= multi->timeout;
+}
+
+/**
+ * @brief Select the primary instance of multi-instance topic
+ * @note The primary instance is kept unless it becomes unusable or another usable
+ * instance has a higher score. If no instance is usable, the primary is kept.
+ * 
+ * @param multi Multi-instance topic
+ * @return uint8_t Index of primary instance
+ */
+uint8_t mcn_multi_select(McnMulti_t multi)
+{
+    uint32_t now = MCN_GET_TIME_MS();
+    uint8_t from, best;
+    int best_score = INT32_MIN;
+
+    MCN_ASSERT(multi != NULL);
+
+    MCN_ENTER_CRITICAL;
+    from = best = multi->primary;
+    if (__mcn_multi_usable(multi, from, now)) {
+        best_score = multi->score[from];
+    }
+    for (uint8_t i = 0; i < multi->instance_num; i++) {
+        if (i != from && __mcn_multi_usable(multi, i, now) && multi->score[i] > best_score) {
+            best = i;
+            best_score = multi->score[i];
+        }
+    }
+    if (best != from) {
+        multi->primary = best;
+        multi->switch_cnt++;
+    }
+    MCN_EXIT_CRITICAL;
+
+    if (best != from && multi->on_switch) {
+        multi->on_switch(multi, from, best);
+    }
+
+    return best;
+}
+
+/**
+ * @brief Set the score of an instance of multi-instance topic
+ * 
+ * @param multi Multi-instance topic
+ * @param instance Instance index
+ * @param score Instance with higher score is preferred
+ */
+void mcn_multi_set_score(McnMulti_t multi, uint8_t instance, int16_t score)
+{
+    MCN_ASSERT(multi != NULL);
+    MCN_ASSERT(instance < multi->instance_num);
+
+    multi->score[instance] = score;
+}
+
+/**
+ * @brief Set the function called when the primary instance is switched
+ * 
+ * @param multi Multi-instance topic
+ * @param on_switch Switch callback, which is called in the context of the consumer
+ */
+void mcn_multi_set_switch_cb(McnMulti_t multi, void (*on_switch)(McnMulti_t multi, uint8_t from, uint8_t to))
+{
+    MCN_ASSERT(multi != NULL);
+
+    multi->on_switch = on_switch;
+}
+
+/**
+ * @brief Subscribe all instances of multi-instance topic
+ * 
+ * @param multi Multi-instance topic
+ * @param multi_node Multi-instance subscribe node
+ * @param event Event handler, which is sent when any instance is published
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_multi_subscribe(McnMulti_t multi, McnMultiNode_t multi_node, MCN_EVENT_HANDLE event)
+{
+    MCN_ASSERT(multi != NULL);
+    MCN_ASSERT(multi_node != NULL);
+
+    if (multi->instance_num == 0 || multi->instance_num > MCN_MAX_INSTANCE_NUM) {
+        return FMT_EINVAL;
+    }
+
+    multi_node->multi = multi;
+    for (uint8_t i = 0; i < multi->instance_num; i++) {
+        multi_node->node[i] = mcn_subscribe(multi->instance[i], event, NULL);
+
+        if (multi_node->node[i] == NULL) {
+            while (i--) {
+                mcn_unsubscribe(multi->instance[i], multi_node->node[i]);
+            }
+            return FMT_ERROR;
+        }
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Unsubscribe multi-instance topic
+ * 
+ * @param multi_node Multi-instance subscribe node
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_multi_unsubscribe(McnMultiNode_t multi_node)
+{
+    McnMulti_t multi = multi_node->multi;
+
+    MCN_ASSERT(multi != NULL);
+
+    for (uint8_t i = 0; i < multi->instance_num; i++) {
+        FMT_TRY(mcn_unsubscribe(multi->instance[i], multi_node->node[i]));
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Poll for the update of primary instance
+ * 
+ * @param multi_node Multi-instance subscribe node
+ * @return true Primary instance updated
+ * @return false Primary instance not updated
+ */
+bool mcn_multi_poll(McnMultiNode_t multi_node)
+{
+    return mcn_poll(multi_node->node[mcn_multi_select(multi_node->multi)]);
+}
+
+/**
+ * @brief Copy topic data of primary instance
+ * 
+ * @param multi_node Multi-instance subscribe node
+ * @param buffer Buffer to received the data
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_multi_copy(McnMultiNode_t multi_node, void* buffer)
+{
+    McnMulti_t multi = multi_node->multi;
+    uint8_t primary = mcn_multi_select(multi);
+
+    return mcn_copy(multi->instance[primary], multi_node->node[primary], buffer);
+}
+
+/**
+ * @brief Start timing profile of a uMCN topic
+ * @note Publish inter-arrival time and latency from publish to subscriber copy
+ * of the latest sample are recorded. Restart a running profile clears it.
+ * 
+ * @param hub uMCN hub
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_profile_start(McnHub_t hub)
+{
+    McnProfile_t profile = NULL;
+
+    MCN_ASSERT(hub != NULL);
+
+    if (hub->profile == NULL) {
+#ifdef FMT_USING_MCN_STATIC
+        MCN_ENTER_CRITICAL;
+        for (int i = 0; i < MCN_STATIC_PROFILE_NUM; i++) {
+            if (__mcn_profile_owner[i] == NULL) {
+                __mcn_profile_owner[i] = hub;
+                profile = &__mcn_profile_pool[i];
+                break;
+            }
+        }
+        MCN_EXIT_CRITICAL;
+#else
+        profile = (McnProfile_t)MCN_MALLOC(sizeof(McnProfile));
+#endif
+        if (profile == NULL) {
+            return FMT_ENOMEM;
+        }
+    }
+
+    MCN_ENTER_CRITICAL;
+    if (profile == NULL) {
+        profile = hub->profile;
+    }
+    mcn_hist_reset(&profile->interval);
+    mcn_hist_reset(&profile->latency);
+    profile->start_time = MCN_GET_TIME_US();
+    profile->last_publish = 0;
+    hub->profile = profile;
+    MCN_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Stop timing profile of a uMCN topic and free the profile
+ * 
+ * @param hub uMCN hub
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_profile_stop(McnHub_t hub)
+{
+    McnProfile_t profile;
+
+    MCN_ASSERT(hub != NULL);
+
+    MCN_ENTER_CRITICAL;
+    profile = hub->profile;
+    hub->profile = NULL;
+#ifdef FMT_USING_MCN_STATIC
+    for (int i = 0; i < MCN_STATIC_PROFILE_NUM; i++) {
+        if (__mcn_profile_owner[i] == hub) {
+            __mcn_profile_owner[i] = NULL;
+        }
+    }
+#endif
+    MCN_EXIT_CRITICAL;
+
+    if (profile == NULL) {
+        return FMT_EEMPTY;
+    }
+
+#ifndef FMT_USING_MCN_STATIC
+    MCN_FREE(profile);
+#endif
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Get a snapshot of topic timing profile
+ * 
+ * @param hub uMCN hub
+ * @param profile Buffer to receive the profile
+ * @return fmt_err_t FMT_EOK indicates success, FMT_EEMPTY if not profiling
+ */
+fmt_err_t mcn_profile_get(McnHub_t hub, McnProfile_t profile)
+{
+    MCN_ASSERT(hub != NULL);
+    MCN_ASSERT(profile != NULL);
+
+    MCN_ENTER_CRITICAL;
+    if (hub->profile == NULL) {
+        MCN_EXIT_CRITICAL;
+        return FMT_EEMPTY;
+    }
+    *profile = *hub->profile;
+    MCN_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Dump topic timing profile as a binary record
+ * 
+ * @param hub uMCN hub
+ * @param record Buffer to receive the record
+ * @return fmt_err_t FMT_EOK indicates success, FMT_EEMPTY if not profiling
+ */
+fmt_err_t mcn_profile_dump(McnHub_t hub, McnProfileRecord* record)
+{
+    McnProfile profile;
+
+    MCN_ASSERT(record != NULL);
+
+    FMT_TRY(mcn_profile_get(hub, &profile));
+
+    record->magic = MCN_PROFILE_MAGIC;
+    record->version = MCN_PROFILE_VERSION;
+    record->bin_num = MCN_HIST_BIN_NUM;
+    record->topic_id = hub->id;
+    record->duration_ms = (uint32_t)((MCN_GET_TIME_US() - profile.start_time) / 1000);
+    record->interval = profile.interval;
+    record->latency = profile.latency;
+
+    return FMT_EOK;
+}
+
+/**
+ * @brief Estimate percentile of timing histogram
+ * @note The result is the upper bound of the bin where the percentile falls,
+ * limited by the max value
+ * 
+ * @param hist Timing histogram
+ * @param percent Percentile in [0, 100]
+ * @return uint32_t Percentile value (us)
+ */
+uint32_t mcn_hist_percentile(const McnHist* hist, float percent)
+{
+    uint32_t target, cnt = 0;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    target = (uint32_t)(hist->count * percent / 100.0f + 0.5f);
+    if (target < 1) {
+        target = 1;
+    }
+
+    for (uint32_t i = 0; i < MCN_HIST_BIN_NUM - 1; i++) {
+        cnt += hist->bin[i];
+        if (cnt >= target) {
+            uint32_t upper = i ? (1U << i) - 1 : 0;
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+/**
+ * @brief Set the hook called after each publish of topics with record flag set
+ * @note The hook is called in the publisher context with the published sample,
+ * which is used by the traffic recorder. Pass NULL to remove the hook.
+ * 
+ * @param hook Publish hook
+ */
+void mcn_set_publish_hook(void (*hook)(McnHub_t hub, const void* data))
+{
+    __mcn_publish_hook = hook;
+}
+
+/**
+ * @brief Set the hook called after each publish of topics with mirror set
+ * @note The hook is called in the publisher context with the published sample,
+ * the mirror field of hub is left to the hook owner, e.g, the shared memory
+ * transport keeps the mirrored slot in it. Pass NULL to remove the hook.
+ * 
+ * @param hook Mirror hook
+ */
+void mcn_set_mirror_hook(void (*hook)(McnHub_t hub, const void* data))
+{
+    __mcn_mirror_hook = hook;
+}
+
+/**
+ * @brief Deferred callback dispatcher thread entry
+ * 
+ * @param parameter Unused
+ */
+static void mcn_dispatch_entry(void* parameter)
+{
+    McnNode_t node;
+    uint32_t num, lost;
+
+    while (1) {
+        if (rt_sem_take(&__mcn_dispatch_sem, RT_WAITING_FOREVER) != RT_EOK) {
+            continue;
+        }
+
+        /* node can't be unsubscribed while its callback is running */
+        rt_mutex_take(&__mcn_dispatch_lock, RT_WAITING_FOREVER);
+
+        MCN_ENTER_CRITICAL;
+        node = NULL;
+        if (__mcn_dispatch_cnt) {
+            node = __mcn_dispatch_queue[__mcn_dispatch_head];
+            __mcn_dispatch_head = (__mcn_dispatch_head + 1) % MCN_DISPATCH_QUEUE_SIZE;
+            __mcn_dispatch_cnt--;
+        }
+        if (node) {
+            /* publishes from now on queue a new callback */
+            node->dispatch_pending = 0;
+        }
+        MCN_EXIT_CRITICAL;
+
+        if (node) {
+            num = 1;
+            __mcn_read_data(node->dispatch_hub, MCN_READ_LATEST, node->dispatch_buf, &num, &lost);
+            node->pub_cb(node->dispatch_buf);
+        }
+
+        rt_mutex_release(&__mcn_dispatch_lock);
+    }
+}
+
+/**
+ * @brief Set the callback of a node to be called by the dispatcher thread
+ * @note Instead of in the publisher context, the callback is called in the
+ * dispatcher thread with a copy of the latest sample. Publishes arriving while
+ * a callback is pending are coalesced into it. If the dispatch queue is full,
+ * the publish is dropped for the node and counted as overflow.
+ * 
+ * @param hub uMCN hub
+ * @param node_t uMCN node
+ * @param buffer Buffer to hold the sample for callback, which should be at least
+ * the topic size. NULL to call the callback inline in publisher context.
+ * @return fmt_err_t FMT_EOK indicates success
+ */
+fmt_err_t mcn_node_defer_callback(McnHub_t hub, McnNode_t node_t, void* buffer)
+{
+    MCN_ASSERT(hub != NULL);
+    MCN_ASSERT(node_t != NULL);
+
+    if (node_t->pub_cb == NULL) {
+        return FMT_EINVAL;
+    }
+
+    rt_mutex_take(&__mcn_dispatch_lock, RT_WAITING_FOREVER);
+
+    MCN_ENTER_CRITICAL;
+    /* remove the pending callback */
+    for (uint32_t i = 0; i < __mcn_dispatch_cnt; i++) {
+        uint32_t index = (__mcn_dispatch_head + i) % MCN_DISPATCH_QUEUE_SIZE;
+
+        if (__mcn_dispatch_queue[index] == node_t) {
+            __mcn_dispatch_queue[index] = NULL;
+        }
+    }
+    node_t->dispatch_pending = 0;
+    node_t->dispatch_hub = hub;
+    node_t->dispatch_buf = buffer;
+    MCN_EXIT_CRITICAL;
+
+    rt_mutex_release(&__mcn_dispatch_lock);
+
     return FMT_EOK;
 }
 
+/**
+ * @brief Get statistics of deferred callback dispatcher
+ * 
+ * @param peak Max number of callbacks pending in dispatch queue
+ * @param overflow Number of callbacks dropped as dispatch queue is full
+ */
+void mcn_get_dispatch_stats(uint32_t* peak, uint32_t* overflow)
+{
+    *peak = __mcn_dispatch_peak;
+    *overflow = __mcn_dispatch_overflow;
+}
+
 /**
  * @brief Initialize uMCN module
  * 
@@ -450,6 +1905,30 @@ fmt_err_t mcn_publish(McnHub_t hub, const void* data)
  */
 fmt_err_t mcn_init(void)
 {
+    FMT_TRY(__mcn_registry_init());
+
+    if (rt_sem_init(&__mcn_dispatch_sem, "mcn_disp", 0, RT_IPC_FLAG_FIFO) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    if (rt_mutex_init(&__mcn_dispatch_lock, "mcn_disp", RT_IPC_FLAG_FIFO) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    if (rt_thread_init(&__mcn_dispatch_thread,
+            "mcn_disp",
+            mcn_dispatch_entry,
+            RT_NULL,
+            &__mcn_dispatch_stack[0],
+            sizeof(__mcn_dispatch_stack), MCN_DISPATCH_THREAD_PRIORITY, 5)
+        != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    if (rt_thread_startup(&__mcn_dispatch_thread) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
     rt_timer_init(&timer_mcn_freq_est, "mcn_freq_est",
         mcn_freq_est_entry,
         NULL,
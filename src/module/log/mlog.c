@@ -14,214 +14,136 @@
  * limitations under the License.
  *****************************************************************************/
 #include <firmament.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "module/control/control_interface.h"
 #include "module/file_manager/file_manager.h"
 #include "module/fms/fms_interface.h"
 #include "module/ins/ins_interface.h"
+#include "module/log/mlog_lz.h"
+#include "module/math/ap_math.h"
 #ifdef FMT_USING_SIH
 #include "module/plant/plant_interface.h"
 #endif
 
 #define TAG                   "MLog"
 #define MLOG_MAX_CALLBACK_NUM 10
+/* period (ms) to write index record */
+#define MLOG_INDEX_PERIOD 100
 
-#define WRITE_PAYLOAD(_payload, _len) write(mlog_handle.fid, _payload, _len);
+#define WRITE_PAYLOAD(_payload, _len) __header_write(out, _payload, _len);
 
-static uint8_t mlog_data_buffer[MLOG_BUFFER_SIZE];
-
-/* MLog element define */
-mlog_elem_t IMU_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("gyr_x", MLOG_FLOAT),
-    MLOG_ELEMENT("gyr_y", MLOG_FLOAT),
-    MLOG_ELEMENT("gyr_z", MLOG_FLOAT),
-    MLOG_ELEMENT("acc_x", MLOG_FLOAT),
-    MLOG_ELEMENT("acc_y", MLOG_FLOAT),
-    MLOG_ELEMENT("acc_z", MLOG_FLOAT),
-};
-
-mlog_elem_t MAG_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("mag_x", MLOG_FLOAT),
-    MLOG_ELEMENT("mag_y", MLOG_FLOAT),
-    MLOG_ELEMENT("mag_z", MLOG_FLOAT),
-};
-
-mlog_elem_t Barometer_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("pressure", MLOG_FLOAT),
-    MLOG_ELEMENT("temperature", MLOG_FLOAT),
-};
-
-mlog_elem_t GPS_uBlox_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("iTOW", MLOG_UINT32),
-    MLOG_ELEMENT("year", MLOG_UINT16),
-    MLOG_ELEMENT("month", MLOG_UINT8),
-    MLOG_ELEMENT("day", MLOG_UINT8),
-    MLOG_ELEMENT("hour", MLOG_UINT8),
-    MLOG_ELEMENT("min", MLOG_UINT8),
-    MLOG_ELEMENT("sec", MLOG_UINT8),
-    MLOG_ELEMENT("valid", MLOG_UINT8),
-    MLOG_ELEMENT("tAcc", MLOG_UINT32),
-    MLOG_ELEMENT("nano", MLOG_INT32),
-    MLOG_ELEMENT("fixType", MLOG_UINT8),
-    MLOG_ELEMENT("flags", MLOG_UINT8),
-    MLOG_ELEMENT("reserved1", MLOG_UINT8),
-    MLOG_ELEMENT("numSV", MLOG_UINT8),
-    MLOG_ELEMENT("lon", MLOG_INT32),
-    MLOG_ELEMENT("lat", MLOG_INT32),
-    MLOG_ELEMENT("height", MLOG_INT32),
-    MLOG_ELEMENT("hMSL", MLOG_INT32),
-    MLOG_ELEMENT("hAcc", MLOG_UINT32),
-    MLOG_ELEMENT("vAcc", MLOG_UINT32),
-    MLOG_ELEMENT("velN", MLOG_INT32),
-    MLOG_ELEMENT("velE", MLOG_INT32),
-    MLOG_ELEMENT("velD", MLOG_INT32),
-    MLOG_ELEMENT("gSpeed", MLOG_INT32),
-    MLOG_ELEMENT("heading", MLOG_INT32),
-    MLOG_ELEMENT("sAcc", MLOG_UINT32),
-    MLOG_ELEMENT("headingAcc", MLOG_UINT32),
-    MLOG_ELEMENT("pDOP", MLOG_UINT16),
-    MLOG_ELEMENT("reserved2", MLOG_UINT16),
-};
+#ifdef FMT_USING_MLOG_PERSIST
+#define MLOG_NOINIT        __attribute__((section(".noinit")))
+#define MLOG_PERSIST_MAGIC 0x54535250 /* "PRST" */
 
-mlog_elem_t Rangefinder_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("distance_m", MLOG_FLOAT),
-};
-
-mlog_elem_t Optflow_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("vx", MLOG_FLOAT),
-    MLOG_ELEMENT("vy", MLOG_FLOAT),
-    MLOG_ELEMENT("valid", MLOG_UINT32),
-};
-
-mlog_elem_t Pilot_Cmd_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("stick_yaw", MLOG_FLOAT),
-    MLOG_ELEMENT("stick_throttle", MLOG_FLOAT),
-    MLOG_ELEMENT("stick_roll", MLOG_FLOAT),
-    MLOG_ELEMENT("stick_pitch", MLOG_FLOAT),
-    MLOG_ELEMENT("mode", MLOG_UINT32),
-    MLOG_ELEMENT("cmd_1", MLOG_UINT32),
-    MLOG_ELEMENT("cmd_2", MLOG_UINT32),
-};
+/* State of log buffer, which is kept with the buffer in no-init RAM and
+ * validated at next boot. Data from tail to head are not in log file yet. */
+typedef struct {
+    uint32_t magic;
+    uint32_t timestamp; /* header timestamp of the session */
+    uint16_t num_sector;
+    uint16_t sector_size;
+    uint16_t head;
+    uint16_t tail;
+    uint16_t crc;
+} mlog_persist_t;
+
+static MLOG_NOINIT uint8_t mlog_data_buffer[MLOG_BUFFER_SIZE];
+static MLOG_NOINIT mlog_persist_t mlog_persist;
+#else
+static uint8_t mlog_data_buffer[MLOG_BUFFER_SIZE];
+#endif
+static uint16_t mlog_sector_pending[MLOG_BUFFER_SIZE / MLOG_SECTOR_SIZE];
+#ifdef FMT_USING_MLOG_COMPRESS
+static uint8_t mlog_block_buffer[sizeof(mlog_block_t) + MLOG_SECTOR_SIZE];
+static uint16_t mlog_lz_work[MLOG_LZ_HASH_SIZE];
+#endif
 
-mlog_elem_t GCS_Cmd_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("mode", MLOG_UINT32),
-    MLOG_ELEMENT("cmd_1", MLOG_UINT32),
-    MLOG_ELEMENT("cmd_2", MLOG_UINT32),
+/* MLog bus define */
+mlog_bus_t _mlog_bus[] = {
+    MLOG_BUS("IMU", MLOG_IMU_ID),
+    MLOG_BUS("MAG", MLOG_MAG_ID),
+    MLOG_BUS("Barometer", MLOG_BARO_ID),
+    MLOG_BUS("GPS_uBlox", MLOG_GPS_ID),
+    MLOG_BUS("Rangefinder", MLOG_RANGEFINDER_ID),
+    MLOG_BUS("Optical_Flow", MLOG_OPTICAL_FLOW_ID),
+    MLOG_BUS("Pilot_Cmd", MLOG_PILOT_CMD_ID),
+    MLOG_BUS("GCS_Cmd", MLOG_GCS_CMD_ID),
+    MLOG_BUS("INS_Out", MLOG_INS_OUT_ID),
+    MLOG_BUS("FMS_Out", MLOG_FMS_OUT_ID),
+    MLOG_BUS("Control_Out", MLOG_CONTROL_OUT_ID),
+#if defined(FMT_USING_SIH)
+    MLOG_BUS("Plant_States", MLOG_PLANT_STATE_ID),
+#endif
 };
 
-mlog_elem_t INS_Out_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("phi", MLOG_FLOAT),
-    MLOG_ELEMENT("theta", MLOG_FLOAT),
-    MLOG_ELEMENT("psi", MLOG_FLOAT),
-    MLOG_ELEMENT_VEC("quat", MLOG_FLOAT, 4),
-    MLOG_ELEMENT("p", MLOG_FLOAT),
-    MLOG_ELEMENT("q", MLOG_FLOAT),
-    MLOG_ELEMENT("r", MLOG_FLOAT),
-    MLOG_ELEMENT("ax", MLOG_FLOAT),
-    MLOG_ELEMENT("ay", MLOG_FLOAT),
-    MLOG_ELEMENT("az", MLOG_FLOAT),
-    MLOG_ELEMENT("vn", MLOG_FLOAT),
-    MLOG_ELEMENT("ve", MLOG_FLOAT),
-    MLOG_ELEMENT("vd", MLOG_FLOAT),
-    MLOG_ELEMENT("reserved", MLOG_FLOAT),
-    MLOG_ELEMENT("lon", MLOG_DOUBLE),
-    MLOG_ELEMENT("lat", MLOG_DOUBLE),
-    MLOG_ELEMENT("alt", MLOG_DOUBLE),
-    MLOG_ELEMENT("x_R", MLOG_FLOAT),
-    MLOG_ELEMENT("y_R", MLOG_FLOAT),
-    MLOG_ELEMENT("h_R", MLOG_FLOAT),
-    MLOG_ELEMENT("h_AGL", MLOG_FLOAT),
-    MLOG_ELEMENT("flag", MLOG_UINT32),
-    MLOG_ELEMENT("status", MLOG_UINT32),
+/* MLog profile define, the order is the value of parameter MLOG_PROFILE */
+static const mlog_rate_t _default_rates[] = {
+    MLOG_RATE(MLOG_IMU_ID, 0),
+    MLOG_RATE(MLOG_MAG_ID, 0),
+    MLOG_RATE(MLOG_BARO_ID, 0),
+    MLOG_RATE(MLOG_GPS_ID, 0),
+    MLOG_RATE(MLOG_RANGEFINDER_ID, 0),
+    MLOG_RATE(MLOG_OPTICAL_FLOW_ID, 0),
+    MLOG_RATE(MLOG_PILOT_CMD_ID, 0),
+    MLOG_RATE(MLOG_GCS_CMD_ID, 0),
+    MLOG_RATE(MLOG_INS_OUT_ID, 100),
+    MLOG_RATE(MLOG_FMS_OUT_ID, 100),
+    MLOG_RATE(MLOG_CONTROL_OUT_ID, 100),
+#if defined(FMT_USING_SIH)
+    MLOG_RATE(MLOG_PLANT_STATE_ID, 100),
+#endif
 };
 
-mlog_elem_t FMS_Out_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("p_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("q_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("r_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("phi_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("theta_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("psi_rate_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("u_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("v_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("w_cmd", MLOG_FLOAT),
-    MLOG_ELEMENT("throttle_cmd", MLOG_UINT32),
-    MLOG_ELEMENT_VEC("actuator_cmd", MLOG_UINT16, 16),
-    MLOG_ELEMENT("status", MLOG_UINT8),
-    MLOG_ELEMENT("state", MLOG_UINT8),
-    MLOG_ELEMENT("ctrl_mode", MLOG_UINT8),
-    MLOG_ELEMENT("reset", MLOG_UINT8),
-    MLOG_ELEMENT("mode", MLOG_UINT8),
-    MLOG_ELEMENT("reserved1", MLOG_UINT8),
-    MLOG_ELEMENT("reserved2", MLOG_UINT16),
+static const mlog_rate_t _full_rates[] = {
+    MLOG_RATE(MLOG_IMU_ID, 0),
+    MLOG_RATE(MLOG_MAG_ID, 0),
+    MLOG_RATE(MLOG_BARO_ID, 0),
+    MLOG_RATE(MLOG_GPS_ID, 0),
+    MLOG_RATE(MLOG_RANGEFINDER_ID, 0),
+    MLOG_RATE(MLOG_OPTICAL_FLOW_ID, 0),
+    MLOG_RATE(MLOG_PILOT_CMD_ID, 0),
+    MLOG_RATE(MLOG_GCS_CMD_ID, 0),
+    MLOG_RATE(MLOG_INS_OUT_ID, 0),
+    MLOG_RATE(MLOG_FMS_OUT_ID, 0),
+    MLOG_RATE(MLOG_CONTROL_OUT_ID, 0),
+#if defined(FMT_USING_SIH)
+    MLOG_RATE(MLOG_PLANT_STATE_ID, 0),
+#endif
 };
 
-mlog_elem_t Control_Out_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT_VEC("actuator_cmd", MLOG_UINT16, 16),
+/* control loop in full rate, other sensors in low rate */
+static const mlog_rate_t _tuning_rates[] = {
+    MLOG_RATE(MLOG_IMU_ID, 0),
+    MLOG_RATE(MLOG_MAG_ID, 100),
+    MLOG_RATE(MLOG_BARO_ID, 100),
+    MLOG_RATE(MLOG_GPS_ID, 200),
+    MLOG_RATE(MLOG_PILOT_CMD_ID, 0),
+    MLOG_RATE(MLOG_GCS_CMD_ID, 0),
+    MLOG_RATE(MLOG_INS_OUT_ID, 0),
+    MLOG_RATE(MLOG_FMS_OUT_ID, 0),
+    MLOG_RATE(MLOG_CONTROL_OUT_ID, 0),
 };
 
-#if defined(FMT_USING_SIH)
-mlog_elem_t Plant_States_Elems[] = {
-    MLOG_ELEMENT("timestamp", MLOG_UINT32),
-    MLOG_ELEMENT("phi", MLOG_FLOAT),
-    MLOG_ELEMENT("theta", MLOG_FLOAT),
-    MLOG_ELEMENT("psi", MLOG_FLOAT),
-    MLOG_ELEMENT("rot_x_B", MLOG_FLOAT),
-    MLOG_ELEMENT("rot_y_B", MLOG_FLOAT),
-    MLOG_ELEMENT("rot_z_B", MLOG_FLOAT),
-    MLOG_ELEMENT("acc_x_O", MLOG_FLOAT),
-    MLOG_ELEMENT("acc_y_O", MLOG_FLOAT),
-    MLOG_ELEMENT("acc_z_O", MLOG_FLOAT),
-    MLOG_ELEMENT("vel_x_O", MLOG_FLOAT),
-    MLOG_ELEMENT("vel_y_O", MLOG_FLOAT),
-    MLOG_ELEMENT("vel_z_O", MLOG_FLOAT),
-    MLOG_ELEMENT("x_R", MLOG_FLOAT),
-    MLOG_ELEMENT("y_R", MLOG_FLOAT),
-    MLOG_ELEMENT("h_R", MLOG_FLOAT),
-    MLOG_ELEMENT("lon", MLOG_DOUBLE),
-    MLOG_ELEMENT("lat", MLOG_DOUBLE),
-    MLOG_ELEMENT("alt", MLOG_DOUBLE),
-    MLOG_ELEMENT("lon_ref", MLOG_DOUBLE),
-    MLOG_ELEMENT("lat_ref", MLOG_DOUBLE),
-    MLOG_ELEMENT("alt_ref", MLOG_DOUBLE),
+/* enough to review the flight path */
+static const mlog_rate_t _minimal_rates[] = {
+    MLOG_RATE(MLOG_GPS_ID, 0),
+    MLOG_RATE(MLOG_PILOT_CMD_ID, 100),
+    MLOG_RATE(MLOG_GCS_CMD_ID, 0),
+    MLOG_RATE(MLOG_INS_OUT_ID, 200),
+    MLOG_RATE(MLOG_FMS_OUT_ID, 200),
 };
-#endif
 
-/* MLog bus define */
-mlog_bus_t _mlog_bus[] = {
-    MLOG_BUS("IMU", MLOG_IMU_ID, IMU_Elems),
-    MLOG_BUS("MAG", MLOG_MAG_ID, MAG_Elems),
-    MLOG_BUS("Barometer", MLOG_BARO_ID, Barometer_Elems),
-    MLOG_BUS("GPS_uBlox", MLOG_GPS_ID, GPS_uBlox_Elems),
-    MLOG_BUS("Rangefinder", MLOG_RANGEFINDER_ID, Rangefinder_Elems),
-    MLOG_BUS("Optical_Flow", MLOG_OPTICAL_FLOW_ID, Optflow_Elems),
-    MLOG_BUS("Pilot_Cmd", MLOG_PILOT_CMD_ID, Pilot_Cmd_Elems),
-    MLOG_BUS("GCS_Cmd", MLOG_GCS_CMD_ID, GCS_Cmd_Elems),
-    MLOG_BUS("INS_Out", MLOG_INS_OUT_ID, INS_Out_Elems),
-    MLOG_BUS("FMS_Out", MLOG_FMS_OUT_ID, FMS_Out_Elems),
-    MLOG_BUS("Control_Out", MLOG_CONTROL_OUT_ID, Control_Out_Elems),
-#if defined(FMT_USING_SIH)
-    MLOG_BUS("Plant_States", MLOG_PLANT_STATE_ID, Plant_States_Elems),
-#endif
+static const mlog_profile_t _mlog_profile[] = {
+    MLOG_PROFILE("default", _default_rates),
+    MLOG_PROFILE("full", _full_rates),
+    MLOG_PROFILE("tuning", _tuning_rates),
+    MLOG_PROFILE("minimal", _minimal_rates),
 };
 
-typedef struct {
-    uint32_t total_msg;
-    uint32_t lost_msg;
-} mlog_stat_t;
-
 struct fmt_mlog {
     int fid;
     uint8_t is_open;
@@ -229,14 +151,44 @@ struct fmt_mlog {
     uint8_t log_status;
     mlog_header_t header;
     mlog_buffer_t buffer;
-    struct rt_mutex lock;
+    uint32_t start_time; // time (ms) logging started
+    uint8_t bus_map[UINT8_MAX + 1]; // msg id to bus index + 1, 0 for unknown msg id
     mlog_stat_t monitor[sizeof(_mlog_bus) / sizeof(mlog_bus_t)];
+    const mlog_profile_t* profile;
+    uint16_t period[sizeof(_mlog_bus) / sizeof(mlog_bus_t)];   // log period (ms) of each bus
+    uint32_t last_log[sizeof(_mlog_bus) / sizeof(mlog_bus_t)]; // time (ms) each bus was last logged
+    uint32_t frame_pos;                                        // offset of next frame in log file
+    uint32_t last_pos[sizeof(_mlog_bus) / sizeof(mlog_bus_t)]; // offset of last frame of each bus
+    uint32_t index_pos;                                        // offset of last index record
+    uint32_t index_seq;                                        // sequence of next index record
+    uint32_t last_index;                                       // time (ms) of last index record
+    mlog_io_stat_t io;
+    uint32_t file_pos;    // bytes written into log file
+    uint32_t header_size; // bytes of log header
+    uint32_t alloc_step;  // bytes to extend preallocated file each time, 0 if not preallocated
+    uint32_t sync_period; // fsync interval (ms), 0 to fsync after each output
+    uint32_t last_sync;   // time (ms) of last fsync
+    uint8_t unsynced;     // data written since last fsync
+    uint32_t tail_seq;    // sectors passed by tail since logging started
+    uint32_t taken_seq;   // sectors taken by storage writer, they may be cleared or reused
+#ifdef FMT_USING_MLOG_PERSIST
+    uint8_t aborted; // stopped without writing buffer, see mlog_abort()
+#endif
+#ifdef FMT_USING_MLOG_COMPRESS
+    struct {
+        uint32_t sector_num;
+        uint32_t raw_byte;
+        uint32_t data_byte; // bytes written into storage, including block header
+        uint32_t time_us;   // time spent on compression
+    } compress;
+#endif
 };
 
 static struct fmt_mlog mlog_handle = { 0 };
 static void (*mlog_start_cbs[MLOG_MAX_CALLBACK_NUM])(void);
 static void (*mlog_stop_cbs[MLOG_MAX_CALLBACK_NUM])(void);
 static void (*mlog_update_cbs[MLOG_MAX_CALLBACK_NUM])(void);
+static void (*mlog_output_cbs[MLOG_MAX_CALLBACK_NUM])(void);
 
 static void __invoke_callback_func(uint8_t cb_type)
 {
@@ -265,49 +217,17 @@ static void __invoke_callback_func(uint8_t cb_type)
             }
         }
     }
-}
-
-static void __buffer_putc(uint8_t ch)
-{
-    uint32_t free_space_in_sector = MLOG_SECTOR_SIZE - mlog_handle.buffer.index;
-
-    if (free_space_in_sector < 1) {
-        // move head point to next sector
-        mlog_handle.buffer.head = (mlog_handle.buffer.head + 1) % mlog_handle.buffer.num_sector;
-        mlog_handle.buffer.index = 0;
-
-        /* we have a new sector data, inform callback functions */
-        __invoke_callback_func(MLOG_CB_UPDATE);
-    }
-
-    mlog_handle.buffer.data[mlog_handle.buffer.head * MLOG_SECTOR_SIZE + mlog_handle.buffer.index] = ch;
-    mlog_handle.buffer.index += 1;
-}
-
-static void __buffer_write(const uint8_t* data, uint16_t len)
-{
-    uint32_t free_space_in_sector = MLOG_SECTOR_SIZE - mlog_handle.buffer.index;
-
-    // TODO: add support with len larger than MLOG_SECTOR_SIZE
 
-    if (free_space_in_sector < len) {
-        memcpy(&mlog_handle.buffer.data[mlog_handle.buffer.head * MLOG_SECTOR_SIZE + mlog_handle.buffer.index], data, free_space_in_sector);
-
-        // move head point to next sector
-        mlog_handle.buffer.head = (mlog_handle.buffer.head + 1) % mlog_handle.buffer.num_sector;
-        mlog_handle.buffer.index = 0;
-
-        memcpy(&mlog_handle.buffer.data[mlog_handle.buffer.head * MLOG_SECTOR_SIZE + mlog_handle.buffer.index], &data[free_space_in_sector], len - free_space_in_sector);
-        mlog_handle.buffer.index += len - free_space_in_sector;
-
-        /* we have a new sector data, inform callback functions */
-        __invoke_callback_func(MLOG_CB_UPDATE);
-    } else {
-        memcpy(&mlog_handle.buffer.data[mlog_handle.buffer.head * MLOG_SECTOR_SIZE + mlog_handle.buffer.index], data, len);
-        mlog_handle.buffer.index += len;
+    if (cb_type == MLOG_CB_OUTPUT) {
+        for (i = 0; i < MLOG_MAX_CALLBACK_NUM; i++) {
+            if (mlog_output_cbs[i]) {
+                mlog_output_cbs[i]();
+            }
+        }
     }
 }
 
+/* only used in cold path, the hot path looks up bus by mlog_handle.bus_map */
 static int32_t get_bus_index(uint8_t msg_id)
 {
     for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
@@ -338,22 +258,221 @@ static uint16_t get_max_write_sector(uint32_t head_p, uint32_t tail_p)
     return sector_to_write <= MLOG_MAX_SECTOR_TO_WRITE ? sector_to_write : MLOG_MAX_SECTOR_TO_WRITE;
 }
 
-static bool buffer_is_full(uint32_t len_to_write)
+static void __record_latency(uint32_t* hist, uint32_t* max_us, uint32_t us)
+{
+    uint32_t bucket = 0;
+
+    for (uint32_t n = us >> 7; n && bucket < MLOG_LAT_BUCKET_NUM - 1; n >>= 1) {
+        bucket++;
+    }
+    hist[bucket]++;
+
+    if (us > *max_us) {
+        *max_us = us;
+    }
+}
+
+static bool __storage_write(const void* data, uint32_t len)
 {
-    uint32_t free_space_in_sector = MLOG_SECTOR_SIZE - mlog_handle.buffer.index;
+    uint64_t start = systime_now_us();
+    int size = write(mlog_handle.fid, data, len);
+    uint32_t latency = systime_now_us() - start;
 
-    // TODO: check if write multiple sectors at once
+    __record_latency(mlog_handle.io.write_hist, &mlog_handle.io.write_max_us, latency);
+    mlog_handle.io.write_time_us += latency;
 
-    /* check if buffer is full */
-    if (free_space_in_sector < len_to_write) {
-        if ((mlog_handle.buffer.head + 1) % mlog_handle.buffer.num_sector == mlog_handle.buffer.tail) {
-            return true;
+    if (size > 0) {
+        mlog_handle.io.write_byte += size;
+        mlog_handle.file_pos += size;
+        mlog_handle.unsynced = 1;
+    }
+
+    return size == len;
+}
+
+static void __storage_sync(void)
+{
+    uint64_t start = systime_now_us();
+
+    fsync(mlog_handle.fid);
+    __record_latency(mlog_handle.io.sync_hist, &mlog_handle.io.sync_max_us, systime_now_us() - start);
+
+    mlog_handle.last_sync = systime_now_ms();
+    mlog_handle.unsynced = 0;
+}
+
+/* Extend the file by seeking beyond its end, which makes the file system allocate
+ * the clusters at once, so the following writes don't update allocation table. */
+static bool __storage_alloc(uint32_t size)
+{
+    uint64_t start = systime_now_us();
+    off_t pos = lseek(mlog_handle.fid, size, SEEK_SET);
+
+    uint32_t latency;
+
+    /* seek back even if it fails, the clusters allocated are kept */
+    lseek(mlog_handle.fid, mlog_handle.file_pos, SEEK_SET);
+    /* not counted as write, the histogram is about the latency of data */
+    latency = systime_now_us() - start;
+    if (latency > mlog_handle.io.alloc_max_us) {
+        mlog_handle.io.alloc_max_us = latency;
+    }
+    mlog_handle.io.alloc_num++;
+
+    if (pos > 0 && pos > mlog_handle.io.alloc_byte) {
+        mlog_handle.io.alloc_byte = pos;
+    }
+
+    return pos == size;
+}
+
+#ifdef FMT_USING_MLOG_PERSIST
+/* must be called in critical section after head or tail is moved */
+static void __persist_update(void)
+{
+    mlog_persist.head = mlog_handle.buffer.head;
+    mlog_persist.tail = mlog_handle.buffer.tail;
+    mlog_persist.crc = math_crc16(0, &mlog_persist, offsetof(mlog_persist_t, crc));
+}
+
+static bool __persist_valid(void)
+{
+    return mlog_persist.magic == MLOG_PERSIST_MAGIC
+        && mlog_persist.crc == math_crc16(0, &mlog_persist, offsetof(mlog_persist_t, crc))
+        && mlog_persist.num_sector == MLOG_BUFFER_SIZE / MLOG_SECTOR_SIZE
+        && mlog_persist.sector_size == MLOG_SECTOR_SIZE
+        && mlog_persist.head < mlog_persist.num_sector
+        && mlog_persist.tail < mlog_persist.num_sector;
+}
+#endif
+
+#ifdef FMT_USING_MLOG_COMPRESS
+/* compress each sector into a block, which is stored as it is if it can't be compressed,
+   returns the number of sectors failed to write */
+static uint32_t __write_data(const uint8_t* data, uint32_t len)
+{
+    uint32_t fail_sector = 0;
+
+    mlog_block_t* block = (mlog_block_t*)mlog_block_buffer;
+
+    while (len) {
+        uint32_t raw_len = len < MLOG_SECTOR_SIZE ? len : MLOG_SECTOR_SIZE;
+        uint64_t start = systime_now_us();
+        uint32_t data_len = mlog_lz_compress(data, raw_len, &mlog_block_buffer[sizeof(mlog_block_t)], raw_len - 1, mlog_lz_work);
+
+        block->magic = MLOG_BLOCK_MAGIC;
+        block->reserved = 0;
+        block->raw_len = raw_len;
+        if (data_len) {
+            block->method = MLOG_BLOCK_LZ;
+            block->data_len = data_len;
+        } else {
+            block->method = MLOG_BLOCK_STORED;
+            block->data_len = raw_len;
+            memcpy(&mlog_block_buffer[sizeof(mlog_block_t)], data, raw_len);
+        }
+        mlog_handle.compress.time_us += systime_now_us() - start;
+        mlog_handle.compress.sector_num++;
+        mlog_handle.compress.raw_byte += raw_len;
+        mlog_handle.compress.data_byte += sizeof(mlog_block_t) + block->data_len;
+
+        if (!__storage_write(mlog_block_buffer, sizeof(mlog_block_t) + block->data_len)) {
+            fail_sector++;
         }
+
+        data += raw_len;
+        len -= raw_len;
+    }
+
+    return fail_sector;
+}
+#else
+/* returns the number of sectors failed to write */
+static uint32_t __write_data(const uint8_t* data, uint32_t len)
+{
+    if (!__storage_write(data, len)) {
+        return (len + MLOG_SECTOR_SIZE - 1) / MLOG_SECTOR_SIZE;
     }
 
+    return 0;
+}
+#endif
+
+/* check if msg is dropped by log rate of bus */
+static bool __bus_filtered(int32_t bus_index, uint32_t now)
+{
+    uint16_t period = mlog_handle.period[bus_index];
+
+    if (period == 0) {
+        return false;
+    }
+
+    if (period == MLOG_RATE_OFF || now - mlog_handle.last_log[bus_index] < period) {
+        return true;
+    }
+    mlog_handle.last_log[bus_index] = now;
+
     return false;
 }
 
+static void __apply_profile(const mlog_profile_t* profile)
+{
+    for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
+        mlog_handle.period[i] = MLOG_RATE_OFF;
+    }
+
+    for (int i = 0; i < profile->rate_num; i++) {
+        int32_t bus_index = get_bus_index(profile->rate_list[i].msg_id);
+
+        if (bus_index >= 0) {
+            mlog_handle.period[bus_index] = profile->rate_list[i].period_ms;
+        }
+    }
+
+    mlog_handle.profile = profile;
+}
+
+/* get the sectors which are complete and have no uncommitted reservation */
+static uint32_t get_ready_head(uint32_t head_p, uint32_t tail_p)
+{
+    uint32_t ready_p = tail_p;
+
+    while (ready_p != head_p && mlog_handle.buffer.pending[ready_p] == 0) {
+        ready_p = (ready_p + 1) % mlog_handle.buffer.num_sector;
+    }
+
+    return ready_p;
+}
+
+/* copy data into frame, which may wrap around the end of buffer */
+static void __resv_copy(mlog_resv_t* resv, uint32_t offset, const void* data, uint32_t len)
+{
+    uint32_t buffer_size = mlog_handle.buffer.num_sector * MLOG_SECTOR_SIZE;
+    uint32_t pos = (resv->offset + offset) % buffer_size;
+
+    if (pos + len <= buffer_size) {
+        memcpy(&mlog_handle.buffer.data[pos], data, len);
+    } else {
+        memcpy(&mlog_handle.buffer.data[pos], data, buffer_size - pos);
+        memcpy(mlog_handle.buffer.data, (const uint8_t*)data + buffer_size - pos, len - buffer_size + pos);
+    }
+}
+
+/* checksum of msg id and payload in frame, which may wrap around the end of buffer */
+static uint16_t __resv_checksum(mlog_resv_t* resv)
+{
+    uint32_t buffer_size = mlog_handle.buffer.num_sector * MLOG_SECTOR_SIZE;
+    uint32_t pos = (resv->offset + 2) % buffer_size;
+    uint32_t len = resv->len - 5;
+
+    if (pos + len <= buffer_size) {
+        return mlog_checksum(0, &mlog_handle.buffer.data[pos], len);
+    }
+
+    return mlog_checksum(mlog_checksum(0, &mlog_handle.buffer.data[pos], buffer_size - pos), mlog_handle.buffer.data,
+        len - buffer_size + pos);
+}
+
 /**
  * Get current logging status
  *
@@ -364,6 +483,23 @@ uint8_t mlog_get_status(void)
     return mlog_handle.log_status;
 }
 
+/**
+ * Get the number of free sectors in log buffer
+ *
+ * @return free sectors, msgs are dropped when there is none
+ */
+uint32_t mlog_get_free_sector(void)
+{
+    uint32_t free_sector;
+
+    OS_ENTER_CRITICAL;
+    free_sector = (mlog_handle.buffer.tail + mlog_handle.buffer.num_sector - mlog_handle.buffer.head - 1)
+                  % mlog_handle.buffer.num_sector;
+    OS_EXIT_CRITICAL;
+
+    return free_sector;
+}
+
 /**
  * Get current logging file name
  *
@@ -374,22 +510,231 @@ char* mlog_get_file_name(void)
     return mlog_handle.file_name;
 }
 
+#ifdef FMT_USING_MLOG_COMPRESS
+static void show_compress_stat(void)
+{
+    uint32_t sector_num = mlog_handle.compress.sector_num;
+
+    console_printf("compress: %ld sectors, %ld -> %ld bytes, ratio:%.1f%%, cpu:%ldus/sector\n", sector_num,
+        mlog_handle.compress.raw_byte, mlog_handle.compress.data_byte,
+        mlog_handle.compress.raw_byte ? 100.0f * mlog_handle.compress.data_byte / mlog_handle.compress.raw_byte : 0.0f,
+        sector_num ? mlog_handle.compress.time_us / sector_num : 0);
+}
+#endif
+
+static void show_latency_hist(const char* name, const uint32_t* hist, uint32_t max_us)
+{
+    console_printf("%-6s", name);
+    for (int i = 0; i < MLOG_LAT_BUCKET_NUM; i++) {
+        console_printf(" %-6ld", hist[i]);
+    }
+    console_printf(" max:%ldus\n", max_us);
+}
+
+/**
+ * Get the storage statistics of current (or last) logging session
+ *
+ * @param stat statistics to be filled
+ */
+void mlog_get_io_stat(mlog_io_stat_t* stat)
+{
+    OS_ENTER_CRITICAL;
+    *stat = mlog_handle.io;
+    OS_EXIT_CRITICAL;
+}
+
+/**
+ * Get the logging statistics of a mlog bus
+ *
+ * @param msg_id msg id of the bus
+ * @param stat statistics to be filled
+ * 
+ * @return FMT Errors
+ */
+fmt_err_t mlog_get_bus_stat(uint8_t msg_id, mlog_stat_t* stat)
+{
+    int32_t bus_index = get_bus_index(msg_id);
+
+    if (bus_index < 0) {
+        return FMT_EINVAL;
+    }
+
+    OS_ENTER_CRITICAL;
+    *stat = mlog_handle.monitor[bus_index];
+    OS_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * Select log profile, which sets the log rate of all buses
+ *
+ * @note The profile is saved into parameter MLOG_PROFILE, so it's also used by
+ *       the following log sessions.
+ *
+ * @param name profile name
+ * 
+ * @return FMT Errors
+ */
+fmt_err_t mlog_set_profile(const char* name)
+{
+    for (int32_t i = 0; i < sizeof(_mlog_profile) / sizeof(mlog_profile_t); i++) {
+        if (strcmp(_mlog_profile[i].name, name) == 0) {
+            __apply_profile(&_mlog_profile[i]);
+            return param_set_val(&PARAM_GET(SYSTEM, MLOG_PROFILE), &i);
+        }
+    }
+
+    return FMT_EINVAL;
+}
+
+/**
+ * Apply log profile to the log rate of all buses, without changing parameter
+ * MLOG_PROFILE
+ *
+ * @note The profile is replaced by the one of MLOG_PROFILE at the next
+ *       mlog_start() if they are different.
+ *
+ * @param name profile name
+ * 
+ * @return FMT Errors
+ */
+fmt_err_t mlog_apply_profile(const char* name)
+{
+    for (int32_t i = 0; i < sizeof(_mlog_profile) / sizeof(mlog_profile_t); i++) {
+        if (strcmp(_mlog_profile[i].name, name) == 0) {
+            __apply_profile(&_mlog_profile[i]);
+            return FMT_EOK;
+        }
+    }
+
+    return FMT_EINVAL;
+}
+
+/**
+ * Get current log profile
+ * 
+ * @return log profile
+ */
+const mlog_profile_t* mlog_get_profile(void)
+{
+    return mlog_handle.profile;
+}
+
+/**
+ * Get all log profiles
+ *
+ * @param num number of profiles
+ * 
+ * @return profile list
+ */
+const mlog_profile_t* mlog_get_profile_list(uint8_t* num)
+{
+    *num = sizeof(_mlog_profile) / sizeof(mlog_profile_t);
+
+    return _mlog_profile;
+}
+
+/**
+ * Set log rate of a bus, which overrides the rate of current profile
+ *
+ * @param msg_id msg id of the bus
+ * @param period_ms bus is logged at most once every period_ms, 0 for every msg,
+ *                  MLOG_RATE_OFF to disable the bus
+ * 
+ * @return FMT Errors
+ */
+fmt_err_t mlog_set_bus_rate(uint8_t msg_id, uint16_t period_ms)
+{
+    int32_t bus_index = get_bus_index(msg_id);
+
+    if (bus_index < 0) {
+        return FMT_EINVAL;
+    }
+
+    mlog_handle.period[bus_index] = period_ms;
+
+    return FMT_EOK;
+}
+
+/**
+ * Get log rate of a bus
+ *
+ * @param msg_id msg id of the bus
+ * 
+ * @return log period (ms), MLOG_RATE_OFF if bus is not logged
+ */
+uint16_t mlog_get_bus_rate(uint8_t msg_id)
+{
+    int32_t bus_index = get_bus_index(msg_id);
+
+    return bus_index < 0 ? MLOG_RATE_OFF : mlog_handle.period[bus_index];
+}
+
 /**
  * Show the mlog logging statistics
  *
  */
 void mlog_statistic(void)
 {
+    mlog_stat_t stat[sizeof(_mlog_bus) / sizeof(mlog_bus_t)];
+    uint32_t duration = systime_now_ms() - mlog_handle.start_time;
+    uint32_t total_byte = 0;
+    mlog_io_stat_t io;
+
+    OS_ENTER_CRITICAL;
+    memcpy(stat, mlog_handle.monitor, sizeof(stat));
+    OS_EXIT_CRITICAL;
+
     for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
-        console_printf("%-20s id:%-3d record:%-8ld lost:%-5ld\n", _mlog_bus[i].name, _mlog_bus[i].msg_id,
-            mlog_handle.monitor[i].total_msg, mlog_handle.monitor[i].lost_msg);
+        total_byte += stat[i].total_byte;
+    }
+
+    console_printf("profile: %s\n", mlog_handle.profile ? mlog_handle.profile->name : "none");
+    console_printf("%-20s %-3s %-6s %-8s %-5s %-8s %-10s %-8s %-6s %s\n", "bus", "id", "rate", "record", "lost", "skip",
+        "bytes", "B/s", "share", "last(ms)");
+    for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
+        char rate[8];
+
+        if (mlog_handle.period[i] == MLOG_RATE_OFF) {
+            strcpy(rate, "off");
+        } else {
+            snprintf(rate, sizeof(rate), "%dms", mlog_handle.period[i]);
+        }
+        console_printf("%-20s %-3d %-6s %-8ld %-5ld %-8ld %-10ld %-8ld %-5.1f%% %ld\n", _mlog_bus[i].name,
+            _mlog_bus[i].msg_id, rate, stat[i].total_msg, stat[i].lost_msg, stat[i].skip_msg, stat[i].total_byte,
+            duration ? (uint32_t)((uint64_t)stat[i].total_byte * 1000 / duration) : 0,
+            total_byte ? 100.0f * stat[i].total_byte / total_byte : 0.0f, stat[i].last_timestamp);
     }
+
+    mlog_get_io_stat(&io);
+    console_printf("buffer: peak %ld/%ld sectors in use, %ld sectors dropped\n", io.peak_sector,
+        mlog_handle.buffer.num_sector, io.drop_sector);
+    console_printf("storage: %ld bytes written, %ld B/s, busy %.1f%%, preallocated %ld bytes in %ld times (max %ldus)\n",
+        io.write_byte, duration ? (uint32_t)((uint64_t)io.write_byte * 1000 / duration) : 0,
+        duration ? io.write_time_us / 10.0f / duration : 0.0f, io.alloc_byte, io.alloc_num, io.alloc_max_us);
+    /* bucket n counts latency below 128 << n us */
+    console_printf("%-6s", "(us)");
+    for (int i = 0; i < MLOG_LAT_BUCKET_NUM - 1; i++) {
+        console_printf(" <%-5ld", 128UL << i);
+    }
+    console_printf(" %-6s\n", "more");
+    show_latency_hist("write", io.write_hist, io.write_max_us);
+    show_latency_hist("fsync", io.sync_hist, io.sync_max_us);
+#ifdef FMT_USING_MLOG_COMPRESS
+    show_compress_stat();
+#endif
 }
 
 /**
  * Register mlog callback function
  *
- * @param cb_type MLOG_CB_START | MLOG_CB_STOP | MLOG_CB_UPDATE
+ * @note MLOG_CB_UPDATE is called in the thread of publisher when a sector is
+ *       complete. MLOG_CB_OUTPUT is called in the thread of storage writer
+ *       before it takes the ready sectors, which can still be read by
+ *       mlog_read_sector() in the callback.
+ *
+ * @param cb_type MLOG_CB_START | MLOG_CB_STOP | MLOG_CB_UPDATE | MLOG_CB_OUTPUT
  * @param cb callback function
  * 
  * @return FMT Error
@@ -423,6 +768,13 @@ fmt_err_t mlog_register_callback(uint8_t cb_type, void (*cb)(void))
                 return FMT_EOK;
             }
         }
+    } else if (cb_type == MLOG_CB_OUTPUT) {
+        for (i = 0; i < MLOG_MAX_CALLBACK_NUM; i++) {
+            if (mlog_output_cbs[i] == NULL) {
+                mlog_output_cbs[i] = cb;
+                return FMT_EOK;
+            }
+        }
     } else {
         return FMT_EINVAL;
     }
@@ -431,21 +783,246 @@ fmt_err_t mlog_register_callback(uint8_t cb_type, void (*cb)(void))
 }
 
 /**
- * Add log description into mlog header
+ * Register schema of mlog bus, which describes the bus elements
+ * 
+ * @note Bus schema should be registered before mlog started, the
+ *       schema size should match the length of message pushed
+ * 
+ * @note The message is logged as a raw copy of the struct and decoders read
+ *       the elements back to back, so the fields must cover the whole struct
+ *       in offset order without gap, otherwise the schema is rejected
+ * 
+ * @param msg_id mlog bus message id
+ * @param schema bus schema
+ * 
+ * @return FMT Error
+ */
+fmt_err_t mlog_register_bus_schema(uint8_t msg_id, const McnSchema* schema)
+{
+    int32_t bus_index = get_bus_index(msg_id);
+    uint32_t offset = 0;
+
+    if (bus_index < 0 || schema == NULL) {
+        return FMT_EINVAL;
+    }
+
+    if (mcn_schema_check(schema) != FMT_EOK) {
+        return FMT_EINVAL;
+    }
+
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        if (schema->field[i].offset != offset) {
+            ulog_e(TAG, "schema %s: field %s is not contiguous", schema->name, schema->field[i].name);
+            return FMT_EINVAL;
+        }
+        offset += schema->field[i].size;
+    }
+
+    if (mcn_schema_packed_size(schema) != schema->size) {
+        ulog_e(TAG, "schema %s doesn't cover the struct", schema->name);
+        return FMT_EINVAL;
+    }
+
+    _mlog_bus[bus_index].schema = schema;
+
+    return FMT_EOK;
+}
+
+/**
+ * Add log description into mlog header
+ *
+ * @param desc description text, should not longer than MLOG_DESCRIPTION_SIZE
+ * @return FMT Error
+ */
+fmt_err_t mlog_add_desc(char* desc)
+{
+    if (strlen(desc) > MLOG_DESCRIPTION_SIZE - 1) {
+        ulog_w(TAG, "description too long.");
+        return FMT_ENOMEM;
+    }
+
+    strcpy(mlog_handle.header.description, desc);
+
+    return FMT_EOK;
+}
+
+/* reserve msg frame, which is also used by index records */
+static fmt_err_t __reserve_msg(uint8_t msg_id, uint16_t len, mlog_resv_t* resv)
+{
+    /*                                   MLOG MSG Format                                        */
+    /*   ==================================================================================== */
+    /*   | MLOG_BEGIN_MSG1 | MLOG_BEGIN_MSG2 | MSG_ID | PAYLOAD | CHECKSUM | MLOG_END_MSG | */
+    /*   ==================================================================================== */
+    const uint8_t begin[3] = { MLOG_BEGIN_MSG1, MLOG_BEGIN_MSG2, msg_id };
+    const uint8_t end = MLOG_END_MSG;
+    uint32_t frame_len = len + MLOG_FRAME_OVERHEAD;
+    uint32_t free_space_in_sector;
+    uint32_t sector_to_use, free_sector;
+    uint8_t sector_ready = 0;
+    int32_t bus_index = (int32_t)mlog_handle.bus_map[msg_id] - 1;
+    uint32_t now = systime_now_ms();
+    uint32_t sector_in_use;
+
+    /* msg dropped by log rate never enters the critical section */
+    if (bus_index >= 0 && mlog_handle.log_status == MLOG_STATUS_LOGGING && __bus_filtered(bus_index, now)) {
+        mlog_handle.monitor[bus_index].skip_msg += 1;
+        return FMT_ENOTHANDLE;
+    }
+
+    OS_ENTER_CRITICAL;
+
+    /* check log status */
+    if (mlog_handle.log_status != MLOG_STATUS_LOGGING) {
+        OS_EXIT_CRITICAL;
+        return FMT_EEMPTY;
+    }
+
+    free_space_in_sector = MLOG_SECTOR_SIZE - mlog_handle.buffer.index;
+
+    resv->offset = mlog_handle.buffer.head * MLOG_SECTOR_SIZE + mlog_handle.buffer.index;
+    resv->len = frame_len;
+
+    if (free_space_in_sector < frame_len) {
+        /* number of following sectors the frame spans */
+        sector_to_use = (frame_len - free_space_in_sector + MLOG_SECTOR_SIZE - 1) / MLOG_SECTOR_SIZE;
+        free_sector = (mlog_handle.buffer.tail + mlog_handle.buffer.num_sector - mlog_handle.buffer.head - 1)
+                      % mlog_handle.buffer.num_sector;
+
+        /* check if buffer has enough space to store msg */
+        if (sector_to_use > free_sector) {
+            if (bus_index >= 0) {
+                mlog_handle.monitor[bus_index].lost_msg += 1;
+            }
+            OS_EXIT_CRITICAL;
+
+            if (sector_to_use >= mlog_handle.buffer.num_sector) {
+                /* frame is larger than the whole buffer */
+                return FMT_EINVAL;
+            }
+
+            /* do not let it print too fast */
+            PERIOD_EXECUTE(mlog_buff_full, 1000, ulog_w(TAG, "buffer is full!"););
+
+            return FMT_EFULL;
+        }
+
+        if (free_space_in_sector) {
+            resv->sector = mlog_handle.buffer.head;
+        } else {
+            /* current sector is complete, frame starts from next sector */
+            resv->sector = (mlog_handle.buffer.head + 1) % mlog_handle.buffer.num_sector;
+            resv->offset = resv->sector * MLOG_SECTOR_SIZE;
+            sector_ready = (mlog_handle.buffer.pending[mlog_handle.buffer.head] == 0);
+        }
+
+        // move head point to the last sector of frame
+        mlog_handle.buffer.head = (mlog_handle.buffer.head + sector_to_use) % mlog_handle.buffer.num_sector;
+        mlog_handle.buffer.index = frame_len - free_space_in_sector - (sector_to_use - 1) * MLOG_SECTOR_SIZE;
+#ifdef FMT_USING_MLOG_PERSIST
+        __persist_update();
+#endif
+    } else {
+        resv->sector = mlog_handle.buffer.head;
+        mlog_handle.buffer.index += frame_len;
+    }
+
+    /* sectors are written into storage in order, so holding the first
+       sector of frame also holds the rest of it */
+    mlog_handle.buffer.pending[resv->sector]++;
+
+    /* frames are continuous in log file, even if they span sectors */
+    resv->pos = mlog_handle.frame_pos;
+    mlog_handle.frame_pos += frame_len;
+
+    if (bus_index >= 0) {
+        mlog_handle.last_pos[bus_index] = resv->pos;
+        mlog_handle.monitor[bus_index].total_msg += 1;
+        mlog_handle.monitor[bus_index].total_byte += frame_len;
+        mlog_handle.monitor[bus_index].last_timestamp = now;
+    }
+
+    sector_in_use = (mlog_handle.buffer.head + mlog_handle.buffer.num_sector - mlog_handle.buffer.tail)
+                        % mlog_handle.buffer.num_sector
+                    + 1;
+    if (sector_in_use > mlog_handle.io.peak_sector) {
+        mlog_handle.io.peak_sector = sector_in_use;
+    }
+
+    OS_EXIT_CRITICAL;
+
+    if (sector_ready) {
+        /* we have a new sector data, inform callback functions */
+        __invoke_callback_func(MLOG_CB_UPDATE);
+    }
+
+    /* write msg begin and end flag */
+    __resv_copy(resv, 0, begin, sizeof(begin));
+    __resv_copy(resv, frame_len - 1, &end, 1);
+
+    return FMT_EOK;
+}
+
+/**
+ * Reserve space of a mlog message in buffer
+ *
+ * @note The reservation only takes a short critical section, the caller fills
+ *       the payload by mlog_resv_write() and must commit it by mlog_commit_msg()
+ *       as soon as possible, since the sector can not be written into storage
+ *       until all reservations in it are committed.
+ *
+ * @param msg_id msg id
+ * @param len payload length
+ * @param resv reservation to be filled
+ * 
+ * @return FMT Error, FMT_ENOTHANDLE if msg is dropped by log rate of bus
+ */
+fmt_err_t mlog_reserve_msg(uint8_t msg_id, uint16_t len, mlog_resv_t* resv)
+{
+    if (msg_id == MLOG_INDEX_ID) {
+        return FMT_EINVAL;
+    }
+
+    return __reserve_msg(msg_id, len, resv);
+}
+
+/**
+ * Write payload of a reserved mlog message
+ *
+ * @param resv reservation returned by mlog_reserve_msg()
+ * @param offset offset in payload
+ * @param data data to write
+ * @param len data length
+ */
+void mlog_resv_write(mlog_resv_t* resv, uint16_t offset, const void* data, uint16_t len)
+{
+    /* skip msg begin flag and msg id */
+    __resv_copy(resv, offset + 3, data, len);
+}
+
+/**
+ * Commit a reserved mlog message, which then can be written into storage
  *
- * @param desc description text, should not longer than MLOG_DESCRIPTION_SIZE
- * @return FMT Error
+ * @param resv reservation returned by mlog_reserve_msg()
  */
-fmt_err_t mlog_add_desc(char* desc)
+void mlog_commit_msg(mlog_resv_t* resv)
 {
-    if (strlen(desc) > MLOG_DESCRIPTION_SIZE - 1) {
-        ulog_w(TAG, "description too long.");
-        return FMT_ENOMEM;
-    }
+    uint16_t sum = __resv_checksum(resv);
+    const uint8_t checksum[2] = { sum & 0xFF, sum >> 8 };
+    uint8_t sector_ready;
 
-    strcpy(mlog_handle.header.description, desc);
+    /* payload is complete, fill the checksum */
+    __resv_copy(resv, resv->len - 3, checksum, sizeof(checksum));
 
-    return FMT_EOK;
+    OS_ENTER_CRITICAL;
+    mlog_handle.buffer.pending[resv->sector]--;
+    /* the sector is complete if head has moved to next sector */
+    sector_ready = (mlog_handle.buffer.pending[resv->sector] == 0 && resv->sector != mlog_handle.buffer.head);
+    OS_EXIT_CRITICAL;
+
+    if (sector_ready) {
+        /* we have a new sector data, inform callback functions */
+        __invoke_callback_func(MLOG_CB_UPDATE);
+    }
 }
 
 /**
@@ -459,100 +1036,87 @@ fmt_err_t mlog_add_desc(char* desc)
  */
 fmt_err_t mlog_push_msg(const uint8_t* payload, uint8_t msg_id, uint16_t len)
 {
-    /*                           MLOG MSG Format                                 */
-    /*   ======================================================================= */
-    /*   | MLOG_BEGIN_MSG1 | MLOG_BEGIN_MSG2 | MSG_ID | PAYLOAD | MLOG_END_MSG | */
-    /*   ======================================================================= */
-    int32_t bus_index;
-
-    /* check log status */
-    if (mlog_handle.log_status != MLOG_STATUS_LOGGING) {
-        return FMT_EEMPTY;
-    }
+    mlog_resv_t resv;
 
-    /* check if buffer has enough space to store msg */
-    if (buffer_is_full(len + 4)) {
-        /* do not let it print too fast */
-        PERIOD_EXECUTE(mlog_buff_full, 1000, ulog_w(TAG, "buffer is full!"););
+    FMT_TRY(mlog_reserve_msg(msg_id, len, &resv));
 
-        bus_index = get_bus_index(msg_id);
-        mlog_handle.monitor[bus_index].lost_msg += 1;
+    mlog_resv_write(&resv, 0, payload, len);
 
-        return FMT_EFULL;
-    }
-
-    rt_mutex_take(&mlog_handle.lock, RT_WAITING_FOREVER);
-
-    /* write msg begin flag */
-    __buffer_putc(MLOG_BEGIN_MSG1);
-    __buffer_putc(MLOG_BEGIN_MSG2);
-    /* write msg id */
-    __buffer_putc(msg_id);
-    /* write payload */
-    __buffer_write(payload, len);
-    /* write msg end flag */
-    __buffer_putc(MLOG_END_MSG);
-
-    rt_mutex_release(&mlog_handle.lock);
-
-    bus_index = get_bus_index(msg_id);
-    if (bus_index >= 0) {
-        mlog_handle.monitor[bus_index].total_msg += 1;
-    }
+    mlog_commit_msg(&resv);
 
     return FMT_EOK;
 }
 
 /**
- * Call this function to start the binary log
+ * Push a mlog message gathered from multiple pieces into buffer
  *
- * @param file_name mlog_handle file name with full path
+ * @note The pieces are copied into buffer directly, which saves the copy
+ *       to stage them into a continuous payload.
+ *
+ * @param msg_id msg id
+ * @param iov payload pieces
+ * @param iov_num number of payload pieces
+ * 
  * @return FMT Error
  */
-fmt_err_t mlog_start(char* file_name)
+fmt_err_t mlog_push_msgv(uint8_t msg_id, const mlog_iovec_t* iov, uint8_t iov_num)
 {
-    if (mlog_handle.log_status != MLOG_STATUS_IDLE) {
-        ulog_w(TAG, "%s is logging, stop it first", mlog_handle.file_name);
-        return FMT_EBUSY;
+    mlog_resv_t resv;
+    uint32_t len = 0;
+
+    for (uint8_t i = 0; i < iov_num; i++) {
+        len += iov[i].len;
     }
 
-    /*********************** create log file ***********************/
-    mlog_handle.fid = open(file_name, O_CREAT | O_WRONLY);
+    if (len > UINT16_MAX) {
+        return FMT_EINVAL;
+    }
 
-    if (mlog_handle.fid < 0) {
-        ulog_e(TAG, "%s open fail", file_name);
-        return FMT_ERROR;
+    FMT_TRY(mlog_reserve_msg(msg_id, len, &resv));
+
+    len = 0;
+    for (uint8_t i = 0; i < iov_num; i++) {
+        mlog_resv_write(&resv, len, iov[i].base, iov[i].len);
+        len += iov[i].len;
     }
-    /* set log file open flag */
-    mlog_handle.is_open = 1;
-    /* get current time stamp */
-    mlog_handle.header.timestamp = systime_now_ms();
 
-    /*********************** init log buffer ***********************/
-    mlog_handle.buffer.head = mlog_handle.buffer.tail = 0;
-    mlog_handle.buffer.index = 0;
+    mlog_commit_msg(&resv);
 
-    /*********************** write log header ***********************/
-    mlog_handle.log_status = MLOG_STATUS_WRITE_HEAD;
+    return FMT_EOK;
+}
+
+/* log header is written into file, or the range [offset, offset + len) is copied into buffer */
+typedef struct {
+    uint8_t* buf; /* NULL to write into mlog_handle.fid */
+    uint32_t offset;
+    uint32_t len;
+    uint32_t pos; /* bytes of header generated */
+} mlog_header_out_t;
+
+static void __header_write(mlog_header_out_t* out, const void* data, uint32_t len)
+{
+    if (out->buf == NULL) {
+        write(mlog_handle.fid, data, len);
+    } else if (out->pos + len > out->offset && out->pos < out->offset + out->len) {
+        uint32_t from = out->offset > out->pos ? out->offset - out->pos : 0;
+        uint32_t to = out->offset + out->len < out->pos + len ? out->offset + out->len - out->pos : len;
 
+        memcpy(&out->buf[out->pos + from - out->offset], (const uint8_t*)data + from, to - from);
+    }
+    out->pos += len;
+}
+
+static void __write_header(mlog_header_out_t* out, uint16_t version, uint32_t timestamp)
+{
     /* write log info */
-    WRITE_PAYLOAD(&mlog_handle.header.version, sizeof(mlog_handle.header.version));
-    WRITE_PAYLOAD(&mlog_handle.header.timestamp, sizeof(mlog_handle.header.timestamp));
+    WRITE_PAYLOAD(&version, sizeof(version));
+    WRITE_PAYLOAD(&timestamp, sizeof(timestamp));
     WRITE_PAYLOAD(&mlog_handle.header.max_name_len, sizeof(mlog_handle.header.max_name_len));
     WRITE_PAYLOAD(&mlog_handle.header.max_desc_len, sizeof(mlog_handle.header.max_desc_len));
     WRITE_PAYLOAD(&mlog_handle.header.max_model_info_len, sizeof(mlog_handle.header.max_model_info_len));
     WRITE_PAYLOAD(mlog_handle.header.description, MLOG_DESCRIPTION_SIZE);
-    /* clear the description after it has been written */
-    memset(mlog_handle.header.description, 0, MLOG_DESCRIPTION_SIZE);
 
-    /* write model information */
-#ifdef FMT_USING_SIH
-    sprintf(mlog_handle.header.model_info, "%s\n%s\n%s\n%s", ins_model_info.info, fms_model_info.info,
-        control_model_info.info, plant_model_info.info);
-#else
-    sprintf(mlog_handle.header.model_info, "%s\n%s\n%s", ins_model_info.info, fms_model_info.info,
-        control_model_info.info);
-#endif
+    /* write model information, which is generated by mlog_start() */
     WRITE_PAYLOAD(mlog_handle.header.model_info, MLOG_MODEL_INFO_SIZE);
 
     /* write bus information */
@@ -561,12 +1125,22 @@ fmt_err_t mlog_start(char* file_name)
         /* write bus list */
         WRITE_PAYLOAD(mlog_handle.header.bus_list[n].name, MLOG_MAX_NAME_LEN);
         WRITE_PAYLOAD(&mlog_handle.header.bus_list[n].msg_id, sizeof(mlog_handle.header.bus_list[n].msg_id));
-        WRITE_PAYLOAD(&mlog_handle.header.bus_list[n].num_elem, sizeof(mlog_handle.header.bus_list[n].num_elem));
-        /* write bus element */
-        for (int k = 0; k < mlog_handle.header.bus_list[n].num_elem; k++) {
-            WRITE_PAYLOAD(mlog_handle.header.bus_list[n].elem_list[k].name, MLOG_MAX_NAME_LEN);
-            WRITE_PAYLOAD(&mlog_handle.header.bus_list[n].elem_list[k].type, sizeof(mlog_handle.header.bus_list[n].elem_list[k].type));
-            WRITE_PAYLOAD(&mlog_handle.header.bus_list[n].elem_list[k].number, sizeof(mlog_handle.header.bus_list[n].elem_list[k].number));
+        /* write bus element, which is generated from bus schema */
+        const McnSchema* schema = mlog_handle.header.bus_list[n].schema;
+        uint8_t num_elem = schema ? schema->field_num : 0;
+
+        WRITE_PAYLOAD(&num_elem, sizeof(num_elem));
+        for (int k = 0; k < num_elem; k++) {
+            char elem_name[MLOG_MAX_NAME_LEN + 1] = { 0 };
+            uint16_t type = schema->field[k].type;
+            uint16_t number = schema->field[k].num;
+
+            /* element name is quoted, which keeps the format of log file */
+            snprintf(elem_name, sizeof(elem_name), "\"%s\"", schema->field[k].name);
+
+            WRITE_PAYLOAD(elem_name, MLOG_MAX_NAME_LEN);
+            WRITE_PAYLOAD(&type, sizeof(type));
+            WRITE_PAYLOAD(&number, sizeof(number));
         }
     }
 
@@ -611,13 +1185,239 @@ fmt_err_t mlog_start(char* file_name)
             }
         }
     }
+}
+
+/* write index record, which makes the log file seekable by time */
+static void __write_index(uint32_t now)
+{
+    uint32_t record[sizeof(mlog_index_t) / sizeof(uint32_t) + sizeof(_mlog_bus) / sizeof(mlog_bus_t)];
+    mlog_index_t* index = (mlog_index_t*)record;
+    mlog_resv_t resv;
+
+    index->magic = MLOG_INDEX_MAGIC;
+    index->timestamp = now;
+    index->seq = mlog_handle.index_seq;
+    index->prev_offset = mlog_handle.index_pos;
+    OS_ENTER_CRITICAL;
+    memcpy(index->last_offset, mlog_handle.last_pos, sizeof(mlog_handle.last_pos));
+    OS_EXIT_CRITICAL;
+
+    if (__reserve_msg(MLOG_INDEX_ID, sizeof(record), &resv) == FMT_EOK) {
+        mlog_resv_write(&resv, 0, record, sizeof(record));
+        mlog_commit_msg(&resv);
+
+        mlog_handle.index_pos = resv.pos;
+        mlog_handle.index_seq++;
+        mlog_handle.last_index = now;
+    }
+}
+
+/**
+ * Get the size of log header of current session
+ *
+ * @return header size in bytes, 0 if not logging
+ */
+uint32_t mlog_get_header_size(void)
+{
+    if (mlog_handle.log_status == MLOG_STATUS_IDLE) {
+        return 0;
+    }
+
+    return mlog_handle.header_size;
+}
+
+/**
+ * Read the log header of current session
+ *
+ * @note The header is generated again on each call, so it has the parameter
+ *       values at the time it's read. It should be read at once into a buffer
+ *       of mlog_get_header_size() bytes rather than in small pieces. The
+ *       version is always plain, since the data read by mlog_read_sector()
+ *       are not compressed.
+ *
+ * @param offset offset in header
+ * @param buf buffer to receive header data
+ * @param len buffer size
+ * 
+ * @return bytes copied into buffer, 0 at the end of header or not logging
+ */
+uint32_t mlog_read_header(uint32_t offset, void* buf, uint32_t len)
+{
+    mlog_header_out_t out = { buf, offset, len, 0 };
+
+    if (mlog_handle.log_status == MLOG_STATUS_IDLE) {
+        return 0;
+    }
+
+    __write_header(&out, MLOG_VERSION, mlog_handle.header.timestamp);
+
+    if (out.pos <= offset) {
+        return 0;
+    }
+
+    return out.pos - offset < len ? out.pos - offset : len;
+}
+
+/**
+ * Copy a complete sector of log buffer, which has not been written into storage
+ *
+ * @note Sectors are counted from the start of logging, the data of sector n
+ *       follows sector n - 1 in log file. Sectors taken by storage writer
+ *       can't be read any more, they are skipped by moving seq forward.
+ *
+ * @param seq sequence of sector to read
+ * @param buf buffer of MLOG_SECTOR_SIZE bytes
+ * 
+ * @return FMT Error, FMT_EEMPTY if the sector is not complete yet
+ */
+fmt_err_t mlog_read_sector(uint32_t* seq, void* buf)
+{
+    uint32_t ready_seq;
+
+    OS_ENTER_CRITICAL;
+    if (mlog_handle.log_status != MLOG_STATUS_LOGGING && mlog_handle.log_status != MLOG_STATUS_STOPPING) {
+        OS_EXIT_CRITICAL;
+        return FMT_EEMPTY;
+    }
+    ready_seq = mlog_handle.tail_seq
+                + (get_ready_head(mlog_handle.buffer.head, mlog_handle.buffer.tail) + mlog_handle.buffer.num_sector
+                      - mlog_handle.buffer.tail)
+                      % mlog_handle.buffer.num_sector;
+    if (*seq < mlog_handle.taken_seq) {
+        *seq = mlog_handle.taken_seq;
+    }
+    OS_EXIT_CRITICAL;
+
+    if (*seq >= ready_seq) {
+        return FMT_EEMPTY;
+    }
+
+    /* head and tail start from sector 0 */
+    memcpy(buf, &mlog_handle.buffer.data[(*seq % mlog_handle.buffer.num_sector) * MLOG_SECTOR_SIZE], MLOG_SECTOR_SIZE);
+
+    /* the copy is invalid if the sector is taken by storage writer meanwhile */
+    if (*seq < mlog_handle.taken_seq) {
+        *seq = mlog_handle.taken_seq;
+        return FMT_EEMPTY;
+    }
+
+    return FMT_EOK;
+}
+
+/**
+ * Call this function to start the binary log
+ *
+ * @param file_name mlog_handle file name with full path
+ * @return FMT Error
+ */
+fmt_err_t mlog_start(char* file_name)
+{
+    if (mlog_handle.log_status != MLOG_STATUS_IDLE) {
+        ulog_w(TAG, "%s is logging, stop it first", mlog_handle.file_name);
+        return FMT_EBUSY;
+    }
+
+    /*********************** create log file ***********************/
+    mlog_handle.fid = open(file_name, O_CREAT | O_WRONLY | O_TRUNC);
+
+    if (mlog_handle.fid < 0) {
+        ulog_e(TAG, "%s open fail", file_name);
+        return FMT_ERROR;
+    }
+    /* set log file open flag */
+    mlog_handle.is_open = 1;
+
+    /*********************** preallocate log file ***********************/
+    int32_t prealloc_mb = PARAM_GET_INT32(SYSTEM, MLOG_PREALLOC);
+    int32_t sync_ms = PARAM_GET_INT32(SYSTEM, MLOG_SYNC_MS);
+
+    /* at most 1GB each time, so the size fits uint32 */
+    if (prealloc_mb > 1024) {
+        prealloc_mb = 1024;
+    }
+#ifndef RT_FIOFTRUNCATE
+    /* the file would keep the preallocated size after stop */
+    if (prealloc_mb > 0) {
+        ulog_w(TAG, "log file can not be trimmed, preallocation is disabled");
+        prealloc_mb = 0;
+    }
+#endif
+    memset(&mlog_handle.io, 0, sizeof(mlog_handle.io));
+    mlog_handle.file_pos = 0;
+    mlog_handle.alloc_step = prealloc_mb > 0 ? prealloc_mb * 1024 * 1024 : 0;
+    mlog_handle.sync_period = sync_ms > 0 ? sync_ms : 0;
+    mlog_handle.unsynced = 0;
+    if (mlog_handle.alloc_step && !__storage_alloc(mlog_handle.alloc_step)) {
+        ulog_w(TAG, "fail to preallocate %d bytes for %s", mlog_handle.alloc_step, file_name);
+        mlog_handle.alloc_step = 0;
+    }
+    /* get current time stamp */
+    mlog_handle.header.timestamp = systime_now_ms();
+
+    /*********************** init log buffer ***********************/
+    mlog_handle.buffer.head = mlog_handle.buffer.tail = 0;
+    mlog_handle.buffer.index = 0;
+    memset(mlog_handle.buffer.pending, 0, mlog_handle.buffer.num_sector * sizeof(uint16_t));
+#ifdef FMT_USING_MLOG_PERSIST
+    /* frames are recovered from a cleared buffer, which has no stale data */
+    memset(mlog_handle.buffer.data, 0, mlog_handle.buffer.num_sector * MLOG_SECTOR_SIZE);
+    mlog_persist.magic = MLOG_PERSIST_MAGIC;
+    mlog_persist.timestamp = mlog_handle.header.timestamp;
+    mlog_persist.num_sector = mlog_handle.buffer.num_sector;
+    mlog_persist.sector_size = MLOG_SECTOR_SIZE;
+    __persist_update();
+#endif
+
+    /*********************** write log header ***********************/
+    mlog_handle.log_status = MLOG_STATUS_WRITE_HEAD;
+    mlog_header_out_t out = { NULL };
+
+#ifdef FMT_USING_SIH
+    sprintf(mlog_handle.header.model_info, "%s\n%s\n%s\n%s", ins_model_info.info, fms_model_info.info,
+        control_model_info.info, plant_model_info.info);
+#else
+    sprintf(mlog_handle.header.model_info, "%s\n%s\n%s", ins_model_info.info, fms_model_info.info,
+        control_model_info.info);
+#endif
+    __write_header(&out, mlog_handle.header.version, mlog_handle.header.timestamp);
+    mlog_handle.header_size = out.pos;
+    /* clear the description after it has been written */
+    memset(mlog_handle.header.description, 0, MLOG_DESCRIPTION_SIZE);
+
+    /* msg data are written from the end of header */
+    mlog_handle.file_pos = lseek(mlog_handle.fid, 0, SEEK_CUR);
+    mlog_handle.frame_pos = mlog_handle.file_pos;
+    memset(mlog_handle.last_pos, 0xFF, sizeof(mlog_handle.last_pos));
+    mlog_handle.index_pos = MLOG_OFFSET_NONE;
+    mlog_handle.index_seq = 0;
+    mlog_handle.tail_seq = mlog_handle.taken_seq = 0;
 
     /*********************** set log status ***********************/
     strncpy(mlog_handle.file_name, file_name, sizeof(mlog_handle.file_name) - 1);
 
+    /* build the msg id to bus table and reset statistics */
+    memset(mlog_handle.bus_map, 0, sizeof(mlog_handle.bus_map));
+    for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
+        mlog_handle.bus_map[_mlog_bus[i].msg_id] = i + 1;
+    }
+    memset(mlog_handle.monitor, 0, sizeof(mlog_handle.monitor));
+#ifdef FMT_USING_MLOG_COMPRESS
+    memset(&mlog_handle.compress, 0, sizeof(mlog_handle.compress));
+#endif
+    mlog_handle.start_time = systime_now_ms();
+    mlog_handle.last_sync = mlog_handle.start_time;
+    /* the first index record is written at the first output */
+    mlog_handle.last_index = mlog_handle.start_time - MLOG_INDEX_PERIOD;
+
+    /* apply profile selected by parameter, rates set by shell are kept if it's not changed */
+    uint32_t profile_index = PARAM_GET_INT32(SYSTEM, MLOG_PROFILE);
+    if (profile_index < sizeof(_mlog_profile) / sizeof(mlog_profile_t)
+        && mlog_handle.profile != &_mlog_profile[profile_index]) {
+        __apply_profile(&_mlog_profile[profile_index]);
+    }
     for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
-        mlog_handle.monitor[i].total_msg = 0;
-        mlog_handle.monitor[i].lost_msg = 0;
+        /* make sure the first msg is logged */
+        mlog_handle.last_log[i] = mlog_handle.start_time - mlog_handle.period[i];
     }
 
     /* start logging, set flag */
@@ -644,6 +1444,89 @@ void mlog_stop(void)
     }
 }
 
+#ifdef FMT_USING_MLOG_PERSIST
+/**
+ * Call this function to stop the binary log without writing the data in buffer
+ *
+ * @note The buffer and its persisted state are left as a reset leaves them, so
+ *       the data are saved by mlog_recover() later. The log file is closed by
+ *       mlog_async_output() before it writes anything else.
+ */
+void mlog_abort(void)
+{
+    OS_ENTER_CRITICAL;
+    if (mlog_handle.log_status == MLOG_STATUS_LOGGING) {
+        mlog_handle.aborted = 1;
+        mlog_handle.log_status = MLOG_STATUS_STOPPING;
+    }
+    OS_EXIT_CRITICAL;
+}
+
+/**
+ * Recover the log data left in buffer by last reset
+ *
+ * @note Data from tail to head of buffer are written into a new log file with
+ *       the header of current firmware. Incomplete frames in buffer have invalid
+ *       checksum, which are skipped by log parser. The index records refer to
+ *       the offset in original log file, so they can't be used to seek it.
+ *
+ * @param file_name recovery file name with full path
+ * @return FMT Error, FMT_EEMPTY if there is nothing to recover
+ */
+fmt_err_t mlog_recover(char* file_name)
+{
+    mlog_header_out_t out = { NULL };
+    uint32_t sector, head, tail, len;
+    uint32_t total = 0;
+
+    if (mlog_handle.log_status != MLOG_STATUS_IDLE) {
+        return FMT_EBUSY;
+    }
+
+    if (!__persist_valid()) {
+        return FMT_EEMPTY;
+    }
+
+    head = mlog_persist.head;
+    tail = mlog_persist.tail;
+    /* head sector is partially filled, the unused space is cleared */
+    for (len = MLOG_SECTOR_SIZE; len > 0 && mlog_handle.buffer.data[head * MLOG_SECTOR_SIZE + len - 1] == 0; len--) {
+    }
+
+    if (head == tail && len == 0) {
+        mlog_persist.magic = 0;
+        return FMT_EEMPTY;
+    }
+
+    mlog_handle.fid = open(file_name, O_CREAT | O_WRONLY | O_TRUNC);
+    if (mlog_handle.fid < 0) {
+        ulog_e(TAG, "%s open fail", file_name);
+        return FMT_ERROR;
+    }
+
+    /* data in buffer are not compressed */
+    __write_header(&out, MLOG_VERSION, mlog_persist.timestamp);
+
+    for (sector = tail; sector != head; sector = (sector + 1) % mlog_persist.num_sector) {
+        total += write(mlog_handle.fid, &mlog_handle.buffer.data[sector * MLOG_SECTOR_SIZE], MLOG_SECTOR_SIZE);
+    }
+    if (len) {
+        total += write(mlog_handle.fid, &mlog_handle.buffer.data[head * MLOG_SECTOR_SIZE], len);
+    }
+
+    fsync(mlog_handle.fid);
+    close(mlog_handle.fid);
+    mlog_handle.fid = -1;
+
+    /* recover only once */
+    mlog_persist.magic = 0;
+
+    ulog_i(TAG, "recover %d bytes into %s", total, file_name);
+
+    return FMT_EOK;
+}
+#endif
+
 /**
  * Asynchronous binary logs to storage device
  *
@@ -652,45 +1535,96 @@ void mlog_stop(void)
 void mlog_async_output(void)
 {
     uint32_t head_p, tail_p;
-    uint8_t need_sync = 0;
 
     if (!mlog_handle.is_open) {
         /* no log file is opened */
         return;
     }
 
+#ifdef FMT_USING_MLOG_PERSIST
+    if (mlog_handle.aborted) {
+        /* data in buffer are kept for mlog_recover() */
+        close(mlog_handle.fid);
+        mlog_handle.fid = -1;
+        mlog_handle.is_open = 0;
+        mlog_handle.aborted = 0;
+        mlog_handle.log_status = MLOG_STATUS_IDLE;
+
+        __invoke_callback_func(MLOG_CB_STOP);
+        ulog_w(TAG, "abort logging:%s", mlog_handle.file_name);
+        return;
+    }
+#endif
+
+    if (mlog_handle.log_status == MLOG_STATUS_LOGGING && systime_now_ms() - mlog_handle.last_index >= MLOG_INDEX_PERIOD) {
+        __write_index(systime_now_ms());
+    }
+
+    /* let readers copy the ready sectors before they are taken */
+    __invoke_callback_func(MLOG_CB_OUTPUT);
+
     OS_ENTER_CRITICAL;
-    head_p = mlog_handle.buffer.head;
     tail_p = mlog_handle.buffer.tail;
+    /* sectors with uncommitted reservation are left for next time */
+    head_p = get_ready_head(mlog_handle.buffer.head, tail_p);
     OS_EXIT_CRITICAL;
 
-    /* check if we need synchronous the output */
-    need_sync = (head_p != tail_p);
     /* write log buffer sector into storage device */
     while (head_p != tail_p) {
         /* check how many sectors that we can write at once */
         uint16_t sector_to_write = get_max_write_sector(head_p, tail_p);
-        /* write data to the storage device */
-        write(mlog_handle.fid, &mlog_handle.buffer.data[tail_p * MLOG_SECTOR_SIZE], sector_to_write * MLOG_SECTOR_SIZE);
+        /* extend the preallocated file before it's full */
+        if (mlog_handle.alloc_step && mlog_handle.file_pos + sector_to_write * MLOG_SECTOR_SIZE > mlog_handle.io.alloc_byte) {
+            if (!__storage_alloc(mlog_handle.io.alloc_byte + mlog_handle.alloc_step)) {
+                ulog_w(TAG, "fail to extend log file, stop preallocation");
+                mlog_handle.alloc_step = 0;
+            }
+        }
+        /* sectors are taken before they are written, see mlog_read_sector() */
+        OS_ENTER_CRITICAL;
+        mlog_handle.taken_seq = mlog_handle.tail_seq + sector_to_write;
+        OS_EXIT_CRITICAL;
+        /* write data to the storage device, sectors failed to write are dropped */
+        mlog_handle.io.drop_sector += __write_data(&mlog_handle.buffer.data[tail_p * MLOG_SECTOR_SIZE], sector_to_write * MLOG_SECTOR_SIZE);
+#ifdef FMT_USING_MLOG_PERSIST
+        /* clear the sectors written, so stale frames are never recovered */
+        memset(&mlog_handle.buffer.data[tail_p * MLOG_SECTOR_SIZE], 0, sector_to_write * MLOG_SECTOR_SIZE);
+#endif
         /* update buffer pointer */
         tail_p = (tail_p + sector_to_write) % mlog_handle.buffer.num_sector;
         OS_ENTER_CRITICAL;
         mlog_handle.buffer.tail = tail_p;
+        mlog_handle.tail_seq = mlog_handle.taken_seq;
+#ifdef FMT_USING_MLOG_PERSIST
+        __persist_update();
+#endif
         OS_EXIT_CRITICAL;
     }
 
-    /* synchronous the disk to make sure data have been written */
-    if (need_sync) {
-        fsync(mlog_handle.fid);
+    /* synchronous the disk to make sure data have been written, the fsync
+       interval bounds the data lost at power off */
+    if (mlog_handle.unsynced && systime_now_ms() - mlog_handle.last_sync >= mlog_handle.sync_period) {
+        __storage_sync();
     }
 
-    /* if logging is off, clean up the buffer. */
-    if (mlog_handle.log_status == MLOG_STATUS_STOPPING) {
+    /* if logging is off, clean up the buffer after all messages are committed */
+    if (mlog_handle.log_status == MLOG_STATUS_STOPPING && head_p == mlog_handle.buffer.head
+        && mlog_handle.buffer.pending[head_p] == 0) {
         /* dump rest data in buffer */
         if (mlog_handle.buffer.index) {
-            write(mlog_handle.fid, &mlog_handle.buffer.data[tail_p * MLOG_SECTOR_SIZE], mlog_handle.buffer.index);
-            fsync(mlog_handle.fid);
+            mlog_handle.io.drop_sector += __write_data(&mlog_handle.buffer.data[tail_p * MLOG_SECTOR_SIZE], mlog_handle.buffer.index);
+        }
+#ifdef RT_FIOFTRUNCATE
+        /* trim the preallocated space which is not used */
+        if (mlog_handle.io.alloc_byte > mlog_handle.file_pos) {
+            off_t len = mlog_handle.file_pos;
+
+            if (ioctl(mlog_handle.fid, RT_FIOFTRUNCATE, &len) != 0) {
+                ulog_w(TAG, "fail to trim log file, %ld bytes are not used", mlog_handle.io.alloc_byte - len);
+            }
         }
+#endif
+        __storage_sync();
         /* close the file if needed */
         if (mlog_handle.is_open) {
             close(mlog_handle.fid);
@@ -700,15 +1634,27 @@ void mlog_async_output(void)
 
         /* set log status to idle */
         mlog_handle.log_status = MLOG_STATUS_IDLE;
+#ifdef FMT_USING_MLOG_PERSIST
+        /* all data are in log file, nothing to recover */
+        mlog_persist.magic = 0;
+#endif
 
         /* invoke callback function */
         __invoke_callback_func(MLOG_CB_STOP);
 
         ulog_i(TAG, "stop logging:%s", mlog_handle.file_name);
         for (int i = 0; i < sizeof(_mlog_bus) / sizeof(mlog_bus_t); i++) {
-            ulog_i(TAG, "%-20s id:%-3d record:%-8d lost:%-5d", _mlog_bus[i].name, _mlog_bus[i].msg_id,
-                mlog_handle.monitor[i].total_msg, mlog_handle.monitor[i].lost_msg);
+            ulog_i(TAG, "%-20s id:%-3d record:%-8d lost:%-5d bytes:%d", _mlog_bus[i].name, _mlog_bus[i].msg_id,
+                mlog_handle.monitor[i].total_msg, mlog_handle.monitor[i].lost_msg, mlog_handle.monitor[i].total_byte);
         }
+        ulog_i(TAG, "buffer peak:%d/%d sectors, dropped:%d sectors, write max:%dus, fsync max:%dus",
+            mlog_handle.io.peak_sector, mlog_handle.buffer.num_sector, mlog_handle.io.drop_sector,
+            mlog_handle.io.write_max_us, mlog_handle.io.sync_max_us);
+#ifdef FMT_USING_MLOG_COMPRESS
+        ulog_i(TAG, "compress %d sectors, %d -> %d bytes, %dus/sector", mlog_handle.compress.sector_num,
+            mlog_handle.compress.raw_byte, mlog_handle.compress.data_byte,
+            mlog_handle.compress.sector_num ? mlog_handle.compress.time_us / mlog_handle.compress.sector_num : 0);
+#endif
     }
 }
 
@@ -723,7 +1669,11 @@ fmt_err_t mlog_init(void)
     mlog_handle.is_open = 0;
     mlog_handle.log_status = MLOG_STATUS_IDLE;
     /* initialize log header */
+#ifdef FMT_USING_MLOG_COMPRESS
+    mlog_handle.header.version = MLOG_VERSION | MLOG_VERSION_COMPRESSED;
+#else
     mlog_handle.header.version = MLOG_VERSION;
+#endif
     mlog_handle.header.timestamp = 0;
     mlog_handle.header.max_name_len = MLOG_MAX_NAME_LEN;
     mlog_handle.header.max_desc_len = MLOG_DESCRIPTION_SIZE;
@@ -736,6 +1686,7 @@ fmt_err_t mlog_init(void)
 
     /* initialize mlog_handle buffer */
     mlog_handle.buffer.data = mlog_data_buffer;
+    mlog_handle.buffer.pending = mlog_sector_pending;
 
     if (mlog_handle.buffer.data == NULL) {
         console_printf("mlog_handle buffer malloc fail!\n");
@@ -748,11 +1699,8 @@ fmt_err_t mlog_init(void)
         mlog_handle.buffer.index = 0;
     }
 
-    /* create write lock */
-    if (rt_mutex_init(&mlog_handle.lock, "mlog_lock", RT_IPC_FLAG_FIFO) != RT_EOK) {
-        console_printf("fail to create mlog lock!\n");
-        return FMT_ERROR;
-    }
+    /* profile is applied again at start if parameter changes */
+    __apply_profile(&_mlog_profile[0]);
 
     return FMT_EOK;
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* This file does not depend on firmament.h, since it's also linked into
+ * host tools to decode the log file */
+#include <string.h>
+
+#include "module/log/mlog_lz.h"
+
+/* LZ77 with byte aligned tokens, the window is the block itself.
+ * token 0x00 ~ 0x7F: literal run of (token + 1) bytes, followed by the bytes
+ * token 0x80 ~ 0xFF: match of (token - 0x80 + 3) bytes, followed by
+ *                    (distance - 1) as little-endian uint16 */
+#define LZ_MAX_LITERAL 128
+#define LZ_MIN_MATCH   3
+#define LZ_MAX_MATCH   (0x7F + LZ_MIN_MATCH)
+#define LZ_MAX_DIST    65536
+
+#define LZ_HASH(_p) ((((uint32_t)(_p)[0] << 16 | (uint32_t)(_p)[1] << 8 | (_p)[2]) * 2654435761U) >> 22)
+
+static uint32_t __emit_literal(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t op, uint32_t dst_size)
+{
+    while (len) {
+        uint32_t n = len < LZ_MAX_LITERAL ? len : LZ_MAX_LITERAL;
+
+        if (op + 1 + n > dst_size) {
+            return 0;
+        }
+        dst[op++] = n - 1;
+        memcpy(&dst[op], src, n);
+        op += n;
+        src += n;
+        len -= n;
+    }
+
+    return op;
+}
+
+/**
+ * @brief Compress a block of data
+ * @note Allocation-free, the work area is used as hash table of recent positions
+ *
+ * @param src Data to compress
+ * @param len Length of data, at most 65535
+ * @param dst Buffer to receive compressed data
+ * @param dst_size Size of buffer
+ * @param work Work area of MLOG_LZ_HASH_SIZE entries
+ * @return uint32_t Compressed length, 0 if data can not be compressed into buffer
+ */
+uint32_t mlog_lz_compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_size, uint16_t* work)
+{
+    uint32_t ip = 0, op = 0;
+    uint32_t literal = 0;
+
+    /* positions are stored as offset + 1, 0 means empty */
+    memset(work, 0, MLOG_LZ_HASH_SIZE * sizeof(uint16_t));
+
+    while (ip + LZ_MIN_MATCH <= len) {
+        uint32_t h = LZ_HASH(&src[ip]);
+        uint32_t ref = work[h];
+        uint32_t match_len = 0;
+
+        work[h] = ip + 1;
+
+        if (ref && ip - (ref - 1) <= LZ_MAX_DIST) {
+            uint32_t max_len = len - ip < LZ_MAX_MATCH ? len - ip : LZ_MAX_MATCH;
+
+            ref -= 1;
+            while (match_len < max_len && src[ref + match_len] == src[ip + match_len]) {
+                match_len++;
+            }
+        }
+
+        if (match_len < LZ_MIN_MATCH) {
+            ip++;
+            continue;
+        }
+
+        /* flush pending literals */
+        op = __emit_literal(&src[literal], ip - literal, dst, op, dst_size);
+        if (op == 0 || op + 3 > dst_size) {
+            return 0;
+        }
+
+        dst[op++] = 0x80 | (match_len - LZ_MIN_MATCH);
+        dst[op++] = (ip - ref - 1) & 0xFF;
+        dst[op++] = (ip - ref - 1) >> 8;
+
+        ip += match_len;
+        literal = ip;
+    }
+
+    if (len > literal) {
+        op = __emit_literal(&src[literal], len - literal, dst, op, dst_size);
+    }
+
+    return op;
+}
+
+/**
+ * @brief Decompress a block of data
+ *
+ * @param src Compressed data
+ * @param len Length of compressed data
+ * @param dst Buffer to receive decompressed data
+ * @param dst_size Size of buffer
+ * @return int32_t Decompressed length, -1 if data is corrupted
+ */
+int32_t mlog_lz_decompress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_size)
+{
+    uint32_t ip = 0, op = 0;
+
+    while (ip < len) {
+        uint8_t token = src[ip++];
+
+        if (token < 0x80) {
+            uint32_t n = token + 1;
+
+            if (ip + n > len || op + n > dst_size) {
+                return -1;
+            }
+            memcpy(&dst[op], &src[ip], n);
+            ip += n;
+            op += n;
+        } else {
+            uint32_t n = token - 0x80 + LZ_MIN_MATCH;
+            uint32_t dist;
+
+            if (ip + 2 > len) {
+                return -1;
+            }
+            dist = (src[ip] | (uint32_t)src[ip + 1] << 8) + 1;
+            ip += 2;
+
+            if (dist > op || op + n > dst_size) {
+                return -1;
+            }
+            /* byte by byte, since the match may overlap itself */
+            for (uint32_t i = 0; i < n; i++, op++) {
+                dst[op] = dst[op - dist];
+            }
+        }
+    }
+
+    return op;
+}
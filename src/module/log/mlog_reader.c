@@ -0,0 +1,376 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Only built for Linux, this file is linked into host tools and does not
+ * depend on firmament.h */
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "module/log/mlog_reader.h"
+
+/* size of McnField types and param types, see mcn_schema.h and param.h */
+static const uint8_t elem_size[] = { 1, 1, 2, 2, 4, 4, 4, 8, 1 };
+static const uint8_t param_size[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    int error;
+} cursor_t;
+
+static const uint8_t* take(cursor_t* c, size_t n)
+{
+    const uint8_t* p = &c->data[c->pos];
+
+    if (c->error || c->pos + n > c->len) {
+        c->error = 1;
+        return NULL;
+    }
+    c->pos += n;
+
+    return p;
+}
+
+static uint32_t take_uint(cursor_t* c, size_t n)
+{
+    const uint8_t* p = take(c, n);
+    uint32_t val = 0;
+
+    for (size_t i = 0; p && i < n; i++) {
+        val |= (uint32_t)p[i] << (8 * i);
+    }
+
+    return val;
+}
+
+static int parse_header(mlog_reader_t* reader)
+{
+    cursor_t c = { reader->data, reader->size, 0, 0 };
+    uint16_t name_len, desc_len, model_len;
+    uint8_t num_group;
+
+    reader->version = take_uint(&c, 2);
+    reader->timestamp = take_uint(&c, 4);
+    name_len = take_uint(&c, 2);
+    desc_len = take_uint(&c, 2);
+    model_len = take_uint(&c, 2);
+    take(&c, desc_len);
+    take(&c, model_len);
+
+    /* only plain log of version 2 has checksum and index */
+    if (c.error || reader->version != MLOG_VERSION) {
+        return -1;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        reader->payload_len[i] = -1;
+    }
+
+    reader->num_bus = take_uint(&c, 1);
+    for (int n = 0; n < reader->num_bus && !c.error; n++) {
+        const uint8_t* name = take(&c, name_len);
+        uint8_t num_elem;
+        int32_t len = 0;
+
+        reader->bus[n].msg_id = take_uint(&c, 1);
+        num_elem = take_uint(&c, 1);
+        if (name) {
+            size_t n_len = name_len < MLOG_READER_NAME_LEN - 1 ? name_len : MLOG_READER_NAME_LEN - 1;
+
+            memcpy(reader->bus[n].name, name, n_len);
+            reader->bus[n].name[n_len] = '\0';
+        }
+
+        for (int k = 0; k < num_elem && !c.error; k++) {
+            uint16_t type, number;
+
+            take(&c, name_len);
+            type = take_uint(&c, 2);
+            number = take_uint(&c, 2);
+            len += (type < sizeof(elem_size) ? elem_size[type] : 0) * number;
+        }
+        /* frames of bus without schema can't be parsed */
+        reader->payload_len[reader->bus[n].msg_id] = num_elem ? len : -1;
+    }
+    reader->payload_len[MLOG_INDEX_ID] = sizeof(mlog_index_t) + reader->num_bus * sizeof(uint32_t);
+
+    num_group = take_uint(&c, 1);
+    for (int n = 0; n < num_group && !c.error; n++) {
+        uint32_t param_num;
+
+        take(&c, name_len);
+        param_num = take_uint(&c, 4);
+        for (uint32_t k = 0; k < param_num && !c.error; k++) {
+            uint8_t type;
+
+            take(&c, name_len);
+            type = take_uint(&c, 1);
+            if (type < sizeof(param_size)) {
+                take(&c, param_size[type]);
+            }
+        }
+    }
+    reader->data_offset = c.pos;
+
+    return c.error ? -1 : 0;
+}
+
+/* find the first index record starting in [from, to), returns reader->size if not found */
+static size_t find_index(const mlog_reader_t* reader, size_t from, size_t to, mlog_index_t* index)
+{
+    while (from < to) {
+        const uint8_t* p = memchr(&reader->data[from], MLOG_BEGIN_MSG1, to - from);
+
+        if (p == NULL) {
+            break;
+        }
+        from = p - reader->data;
+        if (mlog_reader_index(reader, from, index, NULL) == 0) {
+            return from;
+        }
+        from++;
+    }
+
+    return reader->size;
+}
+
+/**
+ * @brief Open and map a log file
+ *
+ * @param reader Reader handle
+ * @param path Path of log file
+ * @return int 0 indicates success, -1 if file can't be opened or is not a plain log of version 2
+ */
+int mlog_reader_open(mlog_reader_t* reader, const char* path)
+{
+    struct stat st;
+    void* base;
+
+    memset(reader, 0, sizeof(mlog_reader_t));
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0) {
+        return -1;
+    }
+
+    if (fstat(reader->fd, &st) < 0 || st.st_size == 0) {
+        goto fail;
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (base == MAP_FAILED) {
+        goto fail;
+    }
+    reader->data = base;
+    reader->size = st.st_size;
+
+    if (parse_header(reader) < 0) {
+        munmap(base, st.st_size);
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    close(reader->fd);
+    reader->fd = -1;
+    reader->data = NULL;
+
+    return -1;
+}
+
+/**
+ * @brief Unmap and close the log file
+ *
+ * @param reader Reader handle
+ */
+void mlog_reader_close(mlog_reader_t* reader)
+{
+    if (reader->data) {
+        munmap((void*)reader->data, reader->size);
+        close(reader->fd);
+    }
+    reader->data = NULL;
+    reader->fd = -1;
+}
+
+/**
+ * @brief Parse the frame at offset
+ *
+ * @param reader Reader handle
+ * @param offset Offset of frame
+ * @param frame Frame to be filled
+ * @return int 0 indicates success, -1 if there is no valid frame at offset
+ */
+int mlog_reader_frame(const mlog_reader_t* reader, size_t offset, mlog_frame_t* frame)
+{
+    const uint8_t* p = &reader->data[offset];
+    int32_t len;
+
+    if (offset + MLOG_FRAME_OVERHEAD > reader->size || p[0] != MLOG_BEGIN_MSG1 || p[1] != MLOG_BEGIN_MSG2) {
+        return -1;
+    }
+
+    len = reader->payload_len[p[2]];
+    if (len < 0 || offset + len + MLOG_FRAME_OVERHEAD > reader->size || p[len + 5] != MLOG_END_MSG) {
+        return -1;
+    }
+
+    if (mlog_checksum(0, &p[2], len + 1) != (p[len + 3] | p[len + 4] << 8)) {
+        return -1;
+    }
+
+    frame->offset = offset;
+    frame->msg_id = p[2];
+    frame->len = len;
+    frame->payload = &p[3];
+
+    return 0;
+}
+
+/**
+ * @brief Read the next frame
+ * @note Corrupted data and frames of unknown bus are skipped, the skipped
+ * bytes are given by frame->offset - *offset before call.
+ *
+ * @param reader Reader handle
+ * @param offset Offset to read from, it's advanced to the end of frame
+ * @param frame Frame to be filled
+ * @return int 1 if a frame is read, 0 at the end of file
+ */
+int mlog_reader_next(const mlog_reader_t* reader, size_t* offset, mlog_frame_t* frame)
+{
+    size_t pos = *offset;
+
+    while (pos < reader->size) {
+        const uint8_t* p = memchr(&reader->data[pos], MLOG_BEGIN_MSG1, reader->size - pos);
+
+        if (p == NULL) {
+            break;
+        }
+        pos = p - reader->data;
+
+        if (mlog_reader_frame(reader, pos, frame) == 0) {
+            *offset = pos + frame->len + MLOG_FRAME_OVERHEAD;
+            return 1;
+        }
+        pos++;
+    }
+    *offset = reader->size;
+
+    return 0;
+}
+
+/**
+ * @brief Read the index record at offset
+ *
+ * @param reader Reader handle
+ * @param offset Offset of index record
+ * @param index Index to be filled
+ * @param last_offset Array of reader->num_bus to receive offset of the last frame
+ * of each bus, can be NULL
+ * @return int 0 indicates success, -1 if there is no index record at offset
+ */
+int mlog_reader_index(const mlog_reader_t* reader, size_t offset, mlog_index_t* index, uint32_t* last_offset)
+{
+    mlog_frame_t frame;
+
+    if (offset + 3 > reader->size || reader->data[offset + 2] != MLOG_INDEX_ID
+        || mlog_reader_frame(reader, offset, &frame) < 0) {
+        return -1;
+    }
+
+    memcpy(index, frame.payload, sizeof(mlog_index_t));
+    if (index->magic != MLOG_INDEX_MAGIC) {
+        return -1;
+    }
+    if (last_offset) {
+        memcpy(last_offset, &frame.payload[sizeof(mlog_index_t)], reader->num_bus * sizeof(uint32_t));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find the last index record written at or before a timestamp
+ * @note Index records are found by binary search of file offset, each step
+ * scans forward to the next index record, which is at most one index period
+ * of data. Frames following the record are logged after its timestamp.
+ *
+ * @param reader Reader handle
+ * @param timestamp Time (ms) to seek
+ * @return size_t Offset of the index record, or offset of the first frame if
+ * timestamp is before the first index record
+ */
+size_t mlog_reader_seek(const mlog_reader_t* reader, uint32_t timestamp)
+{
+    size_t lo = reader->data_offset, hi = reader->size;
+    size_t found = reader->data_offset;
+    mlog_index_t index;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t pos = find_index(reader, mid, hi, &index);
+
+        if (pos >= hi || (int32_t)(index.timestamp - timestamp) > 0) {
+            /* the record we want is before mid */
+            hi = mid;
+        } else {
+            found = pos;
+            lo = pos + 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Get the last frame of a bus logged before an index record
+ *
+ * @param reader Reader handle
+ * @param index_offset Offset of index record, e.g, returned by mlog_reader_seek()
+ * @param msg_id Msg id of bus
+ * @param frame Frame to be filled
+ * @return int 0 indicates success, -1 if the bus has not been logged or index is invalid
+ */
+int mlog_reader_last_frame(const mlog_reader_t* reader, size_t index_offset, uint8_t msg_id, mlog_frame_t* frame)
+{
+    uint32_t last_offset[255];
+    mlog_index_t index;
+
+    if (mlog_reader_index(reader, index_offset, &index, last_offset) < 0) {
+        return -1;
+    }
+
+    for (int n = 0; n < reader->num_bus; n++) {
+        if (reader->bus[n].msg_id == msg_id && last_offset[n] != MLOG_OFFSET_NONE) {
+            /* offsets don't match the file if it's recovered from buffer */
+            if (mlog_reader_frame(reader, last_offset[n], frame) < 0 || frame->msg_id != msg_id) {
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+#endif
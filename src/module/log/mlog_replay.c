@@ -0,0 +1,327 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* This file does not depend on firmament.h, since it's also linked into
+ * host tools to replay logs */
+#include <string.h>
+
+#include "module/log/mlog_replay.h"
+
+/* size of McnField types and param types, see mcn_schema.h and param.h */
+static const uint8_t elem_size[] = { 1, 1, 2, 2, 4, 4, 4, 8, 1 };
+static const uint8_t param_size[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+static uint32_t __fill(mlog_replay_t* replay)
+{
+    if (replay->pos) {
+        memmove(replay->buf, &replay->buf[replay->pos], replay->len - replay->pos);
+        replay->len -= replay->pos;
+        replay->pos = 0;
+    }
+
+    while (!replay->eof && replay->len < MLOG_REPLAY_BUFFER_SIZE) {
+        int32_t n = replay->io->read(replay->io->ctx, &replay->buf[replay->len], MLOG_REPLAY_BUFFER_SIZE - replay->len);
+
+        if (n <= 0) {
+            replay->eof = 1;
+            break;
+        }
+        replay->len += n;
+        replay->read_byte += n;
+    }
+
+    return replay->len;
+}
+
+static const uint8_t* __take(mlog_replay_t* replay, uint32_t n)
+{
+    const uint8_t* p;
+
+    if (replay->len - replay->pos < n) {
+        __fill(replay);
+    }
+    if (replay->error || replay->len - replay->pos < n) {
+        replay->error = 1;
+        return NULL;
+    }
+    p = &replay->buf[replay->pos];
+    replay->pos += n;
+
+    return p;
+}
+
+static uint32_t __take_uint(mlog_replay_t* replay, uint32_t n)
+{
+    const uint8_t* p = __take(replay, n);
+    uint32_t val = 0;
+
+    for (uint32_t i = 0; p && i < n; i++) {
+        val |= (uint32_t)p[i] << (8 * i);
+    }
+
+    return val;
+}
+
+/* name fields of header are not terminated if they fill the whole length */
+static void __take_name(mlog_replay_t* replay, uint16_t name_len, char* name)
+{
+    const uint8_t* p = __take(replay, name_len);
+    uint16_t len = name_len < MLOG_REPLAY_NAME_LEN - 1 ? name_len : MLOG_REPLAY_NAME_LEN - 1;
+
+    if (p && name) {
+        memcpy(name, p, len);
+        name[len] = '\0';
+    }
+}
+
+/* read the next valid frame, returns 0 at the end of file */
+static int __next_frame(mlog_replay_t* replay, uint8_t* msg_id, const uint8_t** payload, uint16_t* len)
+{
+    for (;;) {
+        uint32_t avail = replay->len - replay->pos;
+        const uint8_t* p;
+        int16_t plen;
+
+        if (avail < MLOG_FRAME_OVERHEAD && !replay->eof) {
+            avail = __fill(replay) - replay->pos;
+        }
+        if (avail == 0) {
+            return 0;
+        }
+
+        p = memchr(&replay->buf[replay->pos], MLOG_BEGIN_MSG1, avail);
+        if (p == NULL) {
+            replay->stat.skip_byte += avail;
+            replay->pos = replay->len;
+            continue;
+        }
+        replay->stat.skip_byte += p - &replay->buf[replay->pos];
+        replay->pos = p - replay->buf;
+        avail = replay->len - replay->pos;
+
+        if (avail < 3 && !replay->eof) {
+            __fill(replay);
+            continue;
+        }
+        plen = avail >= 3 ? replay->payload_len[p[2]] : -1;
+        if (avail < 3 || p[1] != MLOG_BEGIN_MSG2 || plen < 0) {
+            replay->stat.skip_byte++;
+            replay->pos++;
+            continue;
+        }
+
+        if (avail < plen + MLOG_FRAME_OVERHEAD) {
+            if (!replay->eof) {
+                __fill(replay);
+            } else {
+                /* frame truncated at the end of file */
+                replay->stat.skip_byte++;
+                replay->pos++;
+            }
+            continue;
+        }
+
+        if (p[plen + 5] != MLOG_END_MSG
+            || mlog_checksum(0, &p[2], plen + 1) != (p[plen + 3] | p[plen + 4] << 8)) {
+            replay->stat.skip_byte++;
+            replay->pos++;
+            continue;
+        }
+
+        *msg_id = p[2];
+        *payload = &p[3];
+        *len = plen;
+        replay->pos += plen + MLOG_FRAME_OVERHEAD;
+
+        return 1;
+    }
+}
+
+/**
+ * @brief Open a log and parse its header
+ *
+ * @param replay Replay handle
+ * @param io Log source and models
+ * @return int 0 indicates success, -1 if it's not a plain log of version 2
+ */
+int mlog_replay_open(mlog_replay_t* replay, const mlog_replay_io_t* io)
+{
+    uint16_t name_len, desc_len, model_len;
+    uint8_t num_group;
+
+    memset(replay, 0, sizeof(mlog_replay_t));
+    replay->io = io;
+
+    replay->version = __take_uint(replay, 2);
+    replay->timestamp = __take_uint(replay, 4);
+    name_len = __take_uint(replay, 2);
+    desc_len = __take_uint(replay, 2);
+    model_len = __take_uint(replay, 2);
+    __take(replay, desc_len);
+    __take(replay, model_len);
+
+    /* compressed log must be decoded first, see mlog_decode */
+    if (replay->error || replay->version != MLOG_VERSION) {
+        return -1;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        replay->payload_len[i] = -1;
+    }
+
+    replay->num_bus = __take_uint(replay, 1);
+    for (int n = 0; n < replay->num_bus && !replay->error; n++) {
+        uint8_t num_elem;
+        int32_t len = 0;
+
+        __take_name(replay, name_len, replay->bus[n].name);
+        replay->bus[n].msg_id = __take_uint(replay, 1);
+        num_elem = __take_uint(replay, 1);
+
+        for (int k = 0; k < num_elem && !replay->error; k++) {
+            uint16_t type, number;
+
+            __take_name(replay, name_len, NULL);
+            type = __take_uint(replay, 2);
+            number = __take_uint(replay, 2);
+            len += (type < sizeof(elem_size) ? elem_size[type] : 0) * number;
+        }
+        /* frames of bus without schema can't be parsed */
+        replay->payload_len[replay->bus[n].msg_id] = num_elem && len < MLOG_REPLAY_BUFFER_SIZE / 2 ? len : -1;
+    }
+    replay->payload_len[MLOG_INDEX_ID] = sizeof(mlog_index_t) + replay->num_bus * sizeof(uint32_t);
+
+    num_group = __take_uint(replay, 1);
+    for (int n = 0; n < num_group && !replay->error; n++) {
+        uint32_t param_num;
+
+        __take_name(replay, name_len, NULL);
+        param_num = __take_uint(replay, 4);
+        for (uint32_t k = 0; k < param_num && !replay->error; k++) {
+            uint8_t type;
+
+            __take_name(replay, name_len, NULL);
+            type = __take_uint(replay, 1);
+            if (type < sizeof(param_size)) {
+                __take(replay, param_size[type]);
+            }
+        }
+    }
+
+    replay->data_offset = replay->read_byte - (replay->len - replay->pos);
+
+    return replay->error ? -1 : 0;
+}
+
+/**
+ * @brief Find a bus in log by name
+ *
+ * @param replay Replay handle
+ * @param name Bus name
+ * @param len Buffer to receive the payload length, can be NULL
+ * @return int Msg id of bus, -1 if the bus is not in log or has no schema
+ */
+int mlog_replay_find_bus(const mlog_replay_t* replay, const char* name, uint16_t* len)
+{
+    for (int n = 0; n < replay->num_bus; n++) {
+        if (strcmp(replay->bus[n].name, name) == 0 && replay->payload_len[replay->bus[n].msg_id] >= 0) {
+            if (len) {
+                *len = replay->payload_len[replay->bus[n].msg_id];
+            }
+            return replay->bus[n].msg_id;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Mark a bus as input of models
+ * @note The payload of input bus must start with uint32 timestamp (ms), which
+ * drives the model clock. Frames of other buses are skipped.
+ *
+ * @param replay Replay handle
+ * @param msg_id Msg id of bus in log
+ */
+void mlog_replay_set_input(mlog_replay_t* replay, uint8_t msg_id)
+{
+    replay->input[msg_id] = 1;
+}
+
+/**
+ * @brief Replay the log
+ * @note Inputs of a step are logged after the step with its timestamp, so all
+ * the steps before the timestamp of an input frame are run before it's fed.
+ * The last step is run at the end of file.
+ *
+ * @param replay Replay handle
+ * @param max_step Return after stepping so many times, so the caller can
+ * yield, e.g, to let the logger write the regenerated log
+ * @return int 1 if there is more to replay, 0 at the end of file
+ */
+int mlog_replay_run(mlog_replay_t* replay, uint32_t max_step)
+{
+    const mlog_replay_io_t* io = replay->io;
+    uint32_t step = 0;
+    uint8_t msg_id;
+    const uint8_t* payload;
+    uint16_t len;
+    uint32_t timestamp;
+
+    while (step < max_step) {
+        if (!__next_frame(replay, &msg_id, &payload, &len)) {
+            if (replay->started) {
+                io->step(io->ctx, replay->time);
+                replay->stat.step++;
+                replay->stat.end_time = replay->time;
+                replay->started = 0;
+            }
+            return 0;
+        }
+        replay->stat.frame++;
+
+        if (!replay->input[msg_id] || len < sizeof(uint32_t)) {
+            continue;
+        }
+        memcpy(&timestamp, payload, sizeof(uint32_t));
+
+        if (!replay->started) {
+            replay->started = 1;
+            replay->time = timestamp;
+            replay->stat.start_time = timestamp;
+        } else if ((int32_t)(timestamp - replay->time) > MLOG_REPLAY_MAX_GAP) {
+            /* logging is paused or data is lost, models can't be stepped without input */
+            io->step(io->ctx, replay->time);
+            replay->stat.step++;
+            replay->stat.gap++;
+            replay->time = timestamp;
+            step++;
+        }
+
+        while ((int32_t)(timestamp - replay->time) > 0) {
+            io->step(io->ctx, replay->time);
+            replay->stat.step++;
+            replay->time++;
+            step++;
+        }
+        replay->stat.end_time = replay->time;
+
+        io->input(io->ctx, msg_id, payload, len);
+        replay->stat.input++;
+    }
+
+    return 1;
+}
@@ -0,0 +1,181 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* This file does not depend on firmament.h, since it's also linked into
+ * host tools to simulate the link */
+#include <string.h>
+
+#include "module/log/mlog_stream.h"
+
+static void __refill(mlog_stream_t* stream, uint32_t now)
+{
+    uint64_t tokens = stream->tokens + (uint64_t)stream->config.rate * (now - stream->last_time);
+    uint64_t burst = (uint64_t)stream->config.burst * 1000;
+
+    stream->tokens = tokens < burst ? tokens : burst;
+    stream->last_time = now;
+}
+
+static bool __take(mlog_stream_t* stream, uint32_t len)
+{
+    uint32_t cost = (stream->config.overhead + len) * 1000;
+
+    if (stream->tokens < cost) {
+        return false;
+    }
+    stream->tokens -= cost;
+    stream->stat.link_byte += stream->config.overhead + len;
+
+    return true;
+}
+
+static mlog_stream_slot_t* __free_slot(mlog_stream_t* stream)
+{
+    for (int i = 0; i < MLOG_STREAM_WINDOW; i++) {
+        if (!stream->window[i].used) {
+            return &stream->window[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Initialize a stream
+ *
+ * @param stream Stream handle
+ * @param config Stream configuration
+ * @param now Current time (ms)
+ */
+void mlog_stream_init(mlog_stream_t* stream, const mlog_stream_config_t* config, uint32_t now)
+{
+    memset(stream, 0, sizeof(mlog_stream_t));
+    stream->config = *config;
+    /* the bucket must hold at least one chunk, otherwise nothing can be sent */
+    if (stream->config.burst < stream->config.overhead + MLOG_STREAM_CHUNK_SIZE) {
+        stream->config.burst = stream->config.overhead + MLOG_STREAM_CHUNK_SIZE;
+    }
+    stream->last_time = now;
+}
+
+/**
+ * @brief Send chunks as the link budget allows
+ * @note Chunks which are not acked in time are retransmitted before new chunks
+ * are pulled. New chunks are only pulled if there is a free slot in window, so
+ * the window also limits the data in flight.
+ *
+ * @param stream Stream handle
+ * @param io Data source and link
+ * @param now Current time (ms)
+ * @return uint32_t Number of chunks sent
+ */
+uint32_t mlog_stream_poll(mlog_stream_t* stream, const mlog_stream_io_t* io, uint32_t now)
+{
+    uint32_t sent = 0;
+    mlog_stream_slot_t* slot;
+
+    __refill(stream, now);
+
+    for (int i = 0; i < MLOG_STREAM_WINDOW; i++) {
+        slot = &stream->window[i];
+
+        if (!slot->used || now - slot->sent_time < stream->config.timeout) {
+            continue;
+        }
+        if (slot->retry >= stream->config.max_retry) {
+            /* receiver has gone or the link is too bad, give it up */
+            slot->used = 0;
+            stream->stat.lost_chunk++;
+            continue;
+        }
+        if (!__take(stream, slot->chunk.len)) {
+            return sent;
+        }
+        slot->sent_time = now;
+        slot->retry++;
+        stream->stat.retry_chunk++;
+        sent++;
+        if (!io->send(io->ctx, &slot->chunk)) {
+            return sent;
+        }
+    }
+
+    while ((slot = __free_slot(stream)) != NULL
+           && stream->tokens >= (stream->config.overhead + MLOG_STREAM_CHUNK_SIZE) * 1000) {
+        bool ok;
+
+        if (!io->pull(io->ctx, &slot->chunk)) {
+            break;
+        }
+        slot->chunk.seq = stream->next_seq++;
+        __take(stream, slot->chunk.len);
+        stream->stat.sent_chunk++;
+        stream->stat.data_byte += slot->chunk.len;
+        sent++;
+
+        ok = io->send(io->ctx, &slot->chunk);
+        if (slot->chunk.acked) {
+            /* kept for retransmission, even if it fails to send now */
+            slot->used = 1;
+            slot->sent_time = now;
+            slot->retry = 0;
+        } else if (!ok) {
+            stream->stat.lost_chunk++;
+        }
+        if (!ok) {
+            break;
+        }
+    }
+
+    return sent;
+}
+
+/**
+ * @brief Handle the ack of a chunk
+ *
+ * @param stream Stream handle
+ * @param seq Sequence of chunk acked
+ * @return true if the chunk is waiting for ack, false for duplicated ack
+ */
+bool mlog_stream_ack(mlog_stream_t* stream, uint16_t seq)
+{
+    for (int i = 0; i < MLOG_STREAM_WINDOW; i++) {
+        if (stream->window[i].used && stream->window[i].chunk.seq == seq) {
+            stream->window[i].used = 0;
+            stream->stat.acked_chunk++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Get the number of chunks waiting for ack
+ *
+ * @param stream Stream handle
+ * @return uint8_t Number of chunks
+ */
+uint8_t mlog_stream_pending(const mlog_stream_t* stream)
+{
+    uint8_t num = 0;
+
+    for (int i = 0; i < MLOG_STREAM_WINDOW; i++) {
+        num += stream->window[i].used;
+    }
+
+    return num;
+}
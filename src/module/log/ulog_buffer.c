@@ -0,0 +1,185 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* This file does not depend on firmament.h, since it's also linked into
+ * host tools to benchmark the buffering */
+#include <string.h>
+
+#include "module/log/ulog_buffer.h"
+
+static uint32_t __used(const ulog_buffer_t* buffer, uint32_t head)
+{
+    return (head + buffer->config.size - buffer->tail) % buffer->config.size;
+}
+
+/* The ring is written in the order of file, so the offset of tail in ring and
+ * the offset in file are equal modulo chunk size, as the ring size is a multiple
+ * of chunk. Cutting writes at chunk boundaries of ring keeps them aligned in file. */
+static uint32_t __write(ulog_buffer_t* buffer, bool all)
+{
+    const ulog_buffer_io_t* io = buffer->io;
+    uint32_t head, tail, end, len;
+    uint32_t total = 0;
+
+    io->lock(io->ctx);
+    /* only one writer at a time, e.g. sync called by another thread */
+    if (buffer->writing) {
+        io->unlock(io->ctx);
+        return 0;
+    }
+    buffer->writing = 1;
+    head = buffer->head;
+    io->unlock(io->ctx);
+
+    tail = buffer->tail;
+    while (tail != head) {
+        end = tail < head ? head : buffer->config.size;
+        if (!all && end != buffer->config.size) {
+            end -= end % buffer->config.chunk;
+            if (end <= tail) {
+                break;
+            }
+        }
+        len = end - tail;
+
+        /* data of failed write is discarded, otherwise the writer may get stuck */
+        if (io->write(io->ctx, &buffer->buf[tail], len) == (int32_t)len) {
+            buffer->stat.write_byte += len;
+        } else {
+            buffer->stat.error++;
+        }
+        buffer->stat.write++;
+
+        tail = end % buffer->config.size;
+        total += len;
+    }
+
+    io->lock(io->ctx);
+    buffer->tail = tail;
+    buffer->writing = 0;
+    io->unlock(io->ctx);
+
+    return total;
+}
+
+/**
+ * @brief Initialize log buffer
+ *
+ * @param buffer Log buffer
+ * @param config Buffer configuration
+ * @param io File and lock
+ * @param buf Memory of ring, config->size bytes
+ */
+void ulog_buffer_init(ulog_buffer_t* buffer, const ulog_buffer_config_t* config, const ulog_buffer_io_t* io,
+    uint8_t* buf)
+{
+    memset(buffer, 0, sizeof(ulog_buffer_t));
+    buffer->config = *config;
+    buffer->io = io;
+    buffer->buf = buf;
+}
+
+/**
+ * @brief Append a log line
+ * @note The line is dropped as a whole if the ring doesn't have enough space,
+ * data in ring is never overwritten.
+ *
+ * @param buffer Log buffer
+ * @param data Log line
+ * @param len Length of line
+ * @return true if it's appended, false if it's dropped
+ */
+bool ulog_buffer_append(ulog_buffer_t* buffer, const void* data, uint32_t len)
+{
+    const ulog_buffer_io_t* io = buffer->io;
+    uint32_t used, first;
+
+    io->lock(io->ctx);
+
+    /* one byte is kept free to tell full ring from empty one */
+    used = __used(buffer, buffer->head);
+    if (len > buffer->config.size - 1 - used) {
+        buffer->stat.drop_line++;
+        buffer->stat.drop_byte += len;
+        io->unlock(io->ctx);
+        return false;
+    }
+
+    first = buffer->config.size - buffer->head;
+    first = len < first ? len : first;
+    memcpy(&buffer->buf[buffer->head], data, first);
+    memcpy(buffer->buf, (const uint8_t*)data + first, len - first);
+    buffer->head = (buffer->head + len) % buffer->config.size;
+
+    buffer->stat.append_line++;
+    if (used + len > buffer->stat.max_used) {
+        buffer->stat.max_used = used + len;
+    }
+
+    io->unlock(io->ctx);
+
+    return true;
+}
+
+/**
+ * @brief Write buffered log in aligned chunks
+ * @note This function should be called by the writer thread when log is
+ * appended or periodically. The data less than a chunk is written when it has
+ * waited for config.timeout.
+ *
+ * @param buffer Log buffer
+ * @param now Current time (ms)
+ * @return uint32_t Bytes written
+ */
+uint32_t ulog_buffer_flush(ulog_buffer_t* buffer, uint32_t now)
+{
+    uint32_t used, written;
+    bool timeout;
+
+    buffer->io->lock(buffer->io->ctx);
+    used = __used(buffer, buffer->head);
+    buffer->io->unlock(buffer->io->ctx);
+
+    if (used == 0) {
+        buffer->waiting = 0;
+        return 0;
+    }
+    if (!buffer->waiting) {
+        buffer->waiting = 1;
+        buffer->waiting_time = now;
+    }
+    timeout = now - buffer->waiting_time >= buffer->config.timeout;
+
+    written = __write(buffer, timeout);
+    if (timeout || written >= used) {
+        buffer->waiting = 0;
+    }
+
+    return written;
+}
+
+/**
+ * @brief Write all buffered log
+ *
+ * @param buffer Log buffer
+ * @return uint32_t Bytes written
+ */
+uint32_t ulog_buffer_sync(ulog_buffer_t* buffer)
+{
+    buffer->waiting = 0;
+
+    return __write(buffer, true);
+}
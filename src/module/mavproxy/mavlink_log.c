@@ -0,0 +1,337 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Stream mlog to ground station by LOGGING_DATA and LOGGING_DATA_ACKED, in
+ * parallel with the storage writer. The log header is sent first, followed by
+ * the sectors of log buffer. Complete sectors are copied in the MLOG_CB_OUTPUT
+ * callback, which is called by storage writer right before it takes them, so
+ * the publishers never pay for the copy. Sectors taken while the staging slots
+ * are full are skipped and the receiver finds the next msg frame by its
+ * checksum. */
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/log/mlog_stream.h"
+#include "module/mavproxy/mavproxy.h"
+
+#define MAVLINK_LOG_ACK_TIMEOUT 300
+#define MAVLINK_LOG_MAX_RETRY   5
+#define MAVLINK_LOG_ACK_QUEUE   16
+#define MAVLINK_LOG_SECTOR_NUM  2
+/* bytes of LOGGING_DATA on link except the data */
+#define MAVLINK_LOG_OVERHEAD \
+    (MAVLINK_NUM_NON_PAYLOAD_BYTES + MAVLINK_MSG_ID_LOGGING_DATA_LEN - MLOG_STREAM_CHUNK_SIZE)
+
+static struct {
+    mlog_stream_t stream;
+    uint8_t active;
+    uint8_t restart;          // stream is started or a new log session is started
+    uint8_t target_system;
+    uint8_t target_component;
+    uint8_t ack_data;         // data chunks need ack, otherwise only header chunks
+    uint8_t header_done;      // log header has been streamed
+    uint8_t* header;          // copy of log header, which is generated once per session
+    uint32_t header_len;
+    uint32_t header_pos;      // bytes of log header streamed
+    /* sectors are staged by storage writer and streamed by mavproxy */
+    uint8_t copying;          // a sector is being staged
+    uint8_t sector_sync;      // a sector has been staged, the following ones are expected in order
+    uint8_t sector_full[MAVLINK_LOG_SECTOR_NUM];
+    uint8_t sector_in;        // slot to stage next sector
+    uint8_t sector_out;       // slot being streamed
+    uint32_t sector_pos;      // bytes of sector_out streamed
+    uint32_t sector_seq;      // sequence of next sector to stage
+    uint32_t lost_sector;     // sectors taken by storage writer before they are staged
+    /* acks are received by mavproxy monitor and handled by mavproxy */
+    uint16_t ack_queue[MAVLINK_LOG_ACK_QUEUE];
+    uint8_t ack_head;
+    uint8_t ack_tail;
+} mav_log;
+
+static uint8_t mav_log_sector[MAVLINK_LOG_SECTOR_NUM][MLOG_SECTOR_SIZE];
+
+static void free_header(void)
+{
+    if (mav_log.header) {
+        rt_free(mav_log.header);
+        mav_log.header = NULL;
+    }
+    mav_log.header_len = 0;
+}
+
+static bool pull_chunk(void* ctx, mlog_chunk_t* chunk)
+{
+    uint32_t len;
+
+    chunk->first_offset = MLOG_STREAM_NO_OFFSET;
+
+    if (!mav_log.header_done) {
+        len = mav_log.header_len - mav_log.header_pos;
+        if (len) {
+            chunk->len = len < MLOG_STREAM_CHUNK_SIZE ? len : MLOG_STREAM_CHUNK_SIZE;
+            memcpy(chunk->data, &mav_log.header[mav_log.header_pos], chunk->len);
+            mav_log.header_pos += chunk->len;
+            /* log can't be parsed without header */
+            chunk->acked = 1;
+            return true;
+        }
+        /* chunks waiting for ack have their own copy */
+        free_header();
+        mav_log.header_done = 1;
+    }
+
+    if (!mav_log.sector_full[mav_log.sector_out]) {
+        return false;
+    }
+
+    len = MLOG_SECTOR_SIZE - mav_log.sector_pos;
+    chunk->len = len < MLOG_STREAM_CHUNK_SIZE ? len : MLOG_STREAM_CHUNK_SIZE;
+    chunk->acked = mav_log.ack_data;
+    memcpy(chunk->data, &mav_log_sector[mav_log.sector_out][mav_log.sector_pos], chunk->len);
+    mav_log.sector_pos += chunk->len;
+
+    if (mav_log.sector_pos >= MLOG_SECTOR_SIZE) {
+        /* release the slot for next sector */
+        mav_log.sector_pos = 0;
+        OS_ENTER_CRITICAL;
+        mav_log.sector_full[mav_log.sector_out] = 0;
+        mav_log.sector_out = (mav_log.sector_out + 1) % MAVLINK_LOG_SECTOR_NUM;
+        OS_EXIT_CRITICAL;
+    }
+
+    return true;
+}
+
+static bool send_chunk(void* ctx, const mlog_chunk_t* chunk)
+{
+    mavlink_system_t mav_sys = mavproxy_get_system();
+    mavlink_message_t msg;
+
+    if (chunk->acked) {
+        mavlink_msg_logging_data_acked_pack(mav_sys.sysid, mav_sys.compid, &msg, mav_log.target_system,
+            mav_log.target_component, chunk->seq, chunk->len, chunk->first_offset, chunk->data);
+    } else {
+        mavlink_msg_logging_data_pack(mav_sys.sysid, mav_sys.compid, &msg, mav_log.target_system,
+            mav_log.target_component, chunk->seq, chunk->len, chunk->first_offset, chunk->data);
+    }
+
+    return mavproxy_send_immediate_msg(&msg, true) == FMT_EOK;
+}
+
+static const mlog_stream_io_t mav_log_io = {
+    .pull = pull_chunk,
+    .send = send_chunk,
+    .ctx = NULL
+};
+
+static void reset_stream(uint32_t now)
+{
+    mlog_stream_config_t config;
+    int32_t rate = PARAM_GET_INT32(SYSTEM, MLOG_STREAM_RATE);
+    uint32_t len;
+
+    config.rate = rate > 0 ? rate : 0;
+    /* allow 100ms of data at once */
+    config.burst = config.rate / 10;
+    config.overhead = MAVLINK_LOG_OVERHEAD;
+    config.timeout = MAVLINK_LOG_ACK_TIMEOUT;
+    config.max_retry = MAVLINK_LOG_MAX_RETRY;
+    mlog_stream_init(&mav_log.stream, &config, now);
+
+    mav_log.ack_data = PARAM_GET_INT32(SYSTEM, MLOG_STREAM_ACK) ? 1 : 0;
+    mav_log.header_done = 0;
+    mav_log.header_pos = 0;
+
+    /* the header is generated as a whole, reading it by chunks would regenerate it for each chunk */
+    free_header();
+    len = mlog_get_header_size();
+    if (len) {
+        mav_log.header = rt_malloc(len);
+        if (mav_log.header == NULL) {
+            console_printf("mavlink log: no memory for log header of %d bytes\n", len);
+            mav_log.active = 0;
+            return;
+        }
+        mav_log.header_len = mlog_read_header(0, mav_log.header, len);
+    }
+}
+
+static void mlog_start_cb(void)
+{
+    /* stream the header of new log session */
+    mav_log.restart = 1;
+}
+
+/* Called in the thread of storage writer before it takes the ready sectors, so
+ * they are copied into the free slots before being cleared or reused. It's the
+ * only one staging sectors, the slots are released by mavproxy. */
+static void mlog_output_cb(void)
+{
+    uint32_t seq;
+    uint8_t slot;
+    uint8_t staged = 0;
+    fmt_err_t err;
+
+    for (;;) {
+        OS_ENTER_CRITICAL;
+        if (!mav_log.active || mav_log.restart || mav_log.sector_full[mav_log.sector_in]) {
+            OS_EXIT_CRITICAL;
+            break;
+        }
+        mav_log.copying = 1;
+        slot = mav_log.sector_in;
+        OS_EXIT_CRITICAL;
+
+        seq = mav_log.sector_seq;
+        err = mlog_read_sector(&seq, mav_log_sector[slot]);
+
+        /* data streamed starts from the oldest sector in buffer */
+        if (mav_log.sector_sync) {
+            mav_log.lost_sector += seq - mav_log.sector_seq;
+        }
+        mav_log.sector_seq = seq;
+        if (err != FMT_EOK) {
+            mav_log.copying = 0;
+            break;
+        }
+        mav_log.sector_seq++;
+        mav_log.sector_sync = 1;
+
+        OS_ENTER_CRITICAL;
+        mav_log.sector_full[slot] = 1;
+        mav_log.sector_in = (slot + 1) % MAVLINK_LOG_SECTOR_NUM;
+        mav_log.copying = 0;
+        OS_EXIT_CRITICAL;
+        staged++;
+    }
+
+    if (staged) {
+        mavproxy_send_event(EVENT_MAVLOG_UPDATE);
+    }
+}
+
+/**
+ * Start streaming log to ground station
+ *
+ * @param target_system system id of ground station
+ * @param target_component component id of ground station
+ *
+ * @return FMT Errors, FMT_ENOSYS if streaming is disabled by MLOG_STREAM_RATE
+ */
+fmt_err_t mavlink_log_start(uint8_t target_system, uint8_t target_component)
+{
+    if (PARAM_GET_INT32(SYSTEM, MLOG_STREAM_RATE) <= 0) {
+        return FMT_ENOSYS;
+    }
+
+    OS_ENTER_CRITICAL;
+    mav_log.target_system = target_system;
+    mav_log.target_component = target_component;
+    mav_log.restart = 1;
+    mav_log.active = 1;
+    OS_EXIT_CRITICAL;
+
+    return FMT_EOK;
+}
+
+/**
+ * Stop streaming log to ground station
+ */
+void mavlink_log_stop(void)
+{
+    if (mav_log.active) {
+        mav_log.active = 0;
+        console_printf("mavlink log stop, chunk sent:%d retry:%d lost:%d, sector lost:%d\n",
+            mav_log.stream.stat.sent_chunk, mav_log.stream.stat.retry_chunk, mav_log.stream.stat.lost_chunk,
+            mav_log.lost_sector);
+    }
+}
+
+/**
+ * Handle LOGGING_ACK of ground station
+ *
+ * @param seq sequence of chunk acked
+ */
+void mavlink_log_handle_ack(uint16_t seq)
+{
+    OS_ENTER_CRITICAL;
+    if ((mav_log.ack_head + 1) % MAVLINK_LOG_ACK_QUEUE != mav_log.ack_tail) {
+        mav_log.ack_queue[mav_log.ack_head] = seq;
+        mav_log.ack_head = (mav_log.ack_head + 1) % MAVLINK_LOG_ACK_QUEUE;
+    }
+    OS_EXIT_CRITICAL;
+}
+
+/**
+ * Send log data as the link budget allows
+ * @note this function should be called periodically by mavproxy
+ */
+void mavlink_log_output(void)
+{
+    uint32_t now = systime_now_ms();
+    uint8_t restart;
+
+    if (!mav_log.active) {
+        /* header is only accessed by mavproxy */
+        free_header();
+        return;
+    }
+
+    OS_ENTER_CRITICAL;
+    /* staged sectors are dropped, unless one is being staged, then try it next time */
+    restart = mav_log.restart && !mav_log.copying;
+    if (restart) {
+        mav_log.restart = 0;
+        mav_log.sector_sync = 0;
+        memset(mav_log.sector_full, 0, sizeof(mav_log.sector_full));
+        mav_log.sector_in = mav_log.sector_out = 0;
+        mav_log.sector_pos = 0;
+        mav_log.sector_seq = 0;
+        mav_log.lost_sector = 0;
+        mav_log.ack_tail = mav_log.ack_head;
+    }
+    OS_EXIT_CRITICAL;
+
+    if (restart) {
+        reset_stream(now);
+        if (!mav_log.active) {
+            return;
+        }
+    }
+
+    OS_ENTER_CRITICAL;
+    while (mav_log.ack_tail != mav_log.ack_head) {
+        mlog_stream_ack(&mav_log.stream, mav_log.ack_queue[mav_log.ack_tail]);
+        mav_log.ack_tail = (mav_log.ack_tail + 1) % MAVLINK_LOG_ACK_QUEUE;
+    }
+    OS_EXIT_CRITICAL;
+
+    mlog_stream_poll(&mav_log.stream, &mav_log_io, now);
+}
+
+/**
+ * Initialize mavlink log streaming
+ *
+ * @return FMT Errors
+ */
+fmt_err_t mavlink_log_init(void)
+{
+    FMT_TRY(mlog_register_callback(MLOG_CB_START, mlog_start_cb));
+    FMT_TRY(mlog_register_callback(MLOG_CB_OUTPUT, mlog_output_cb));
+
+    return FMT_EOK;
+}
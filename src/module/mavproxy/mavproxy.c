@@ -238,7 +238,7 @@ void mavproxy_loop(void)
 {
     rt_err_t res;
     rt_uint32_t recv_set = 0;
-    rt_uint32_t wait_set = EVENT_MAVPROXY_UPDATE | EVENT_MAVCONSOLE_TIMEOUT | EVENT_SEND_ALL_PARAM;
+    rt_uint32_t wait_set = EVENT_MAVPROXY_UPDATE | EVENT_MAVCONSOLE_TIMEOUT | EVENT_SEND_ALL_PARAM | EVENT_MAVLOG_UPDATE;
 
     /* create mavproxy monitor to handle received mavlink msgs */
     mavproxy_monitor_create();
@@ -285,6 +285,11 @@ void mavproxy_loop(void)
                 /* handle mavlink command */
                 mavproxy_cmd_exec();
             }
+
+            if (recv_set & (EVENT_MAVPROXY_UPDATE | EVENT_MAVLOG_UPDATE)) {
+                /* stream log data in the rest of link budget */
+                mavlink_log_output();
+            }
         }
     }
 }
@@ -302,6 +307,9 @@ fmt_err_t mavproxy_init(void)
     /* init mavlink console */
     mavlink_console_init();
 
+    /* init mavlink log streaming */
+    mavlink_log_init();
+
     /* create tx lock */
     mav_handle.tx_lock = rt_sem_create("mav_tx_lock", 1, RT_IPC_FLAG_FIFO);
 
@@ -142,6 +142,18 @@ static void handle_mavlink_command(mavlink_command_long_t* command, mavlink_mess
         acknowledge(command->command, MAV_RESULT_ACCEPTED);
     } break;
 
+    case MAV_CMD_LOGGING_START: {
+        fmt_err_t err = mavlink_log_start(msg->sysid, msg->compid);
+
+        acknowledge(command->command, err == FMT_EOK ? MAV_RESULT_ACCEPTED : MAV_RESULT_DENIED);
+    } break;
+
+    case MAV_CMD_LOGGING_STOP: {
+        mavlink_log_stop();
+
+        acknowledge(command->command, MAV_RESULT_ACCEPTED);
+    } break;
+
     case MAV_CMD_DO_REPOSITION: {
         /* When click pause button, GCS will send this command */
         gcs_set_cmd(CMD_Pause);
@@ -273,6 +285,12 @@ static fmt_err_t handle_mavlink_msg(mavlink_message_t* msg, mavlink_system_t sys
         mavlink_console_process_rx_msg(&serial_control);
     } break;
 
+    case MAVLINK_MSG_ID_LOGGING_ACK: {
+        if (system.sysid == mavlink_msg_logging_ack_get_target_system(msg)) {
+            mavlink_log_handle_ack(mavlink_msg_logging_ack_get_sequence(msg));
+        }
+    } break;
+
     case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL: {
         if (system.sysid == mavlink_msg_file_transfer_protocol_get_target_system(msg)) {
             mavlink_file_transfer_protocol_t ftp_protocol_t;
@@ -41,6 +41,28 @@ PARAM_DECLARE_GROUP(SYSTEM) = {
 	2: from boot until disarm
 	3: from boot until shutdown  */
     PARAM_DEFINE_INT32(MLOG_MODE, 0),
+    /* Determines which buses are logged and how often, see mlog profiles.
+	0: default
+	1: full
+	2: tuning
+	3: minimal  */
+    PARAM_DEFINE_INT32(MLOG_PROFILE, 0),
+    /* Preallocate the log file in extents of this size (MB), which avoids the
+	allocation stall of file system during logging.
+	0: disabled  */
+    PARAM_DEFINE_INT32(MLOG_PREALLOC, 0),
+    /* Interval (ms) to fsync the log file.
+	0: fsync after each output  */
+    PARAM_DEFINE_INT32(MLOG_SYNC_MS, 0),
+    /* Link budget (bytes/s) to stream log over MAVLink, which is started by
+	MAV_CMD_LOGGING_START of ground station.
+	0: disabled  */
+    PARAM_DEFINE_INT32(MLOG_STREAM_RATE, 0),
+    /* Which log data streamed over MAVLink need ack of ground station, the
+	data not acked in time are retransmitted.
+	0: only log header
+	1: all data  */
+    PARAM_DEFINE_INT32(MLOG_STREAM_ACK, 1),
 };
 
 PARAM_GROUP(CALIB)
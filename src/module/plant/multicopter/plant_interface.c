@@ -40,6 +40,31 @@ static uint32_t gps_timestamp = 0xFFFF;
 
 fmt_model_info_t plant_model_info;
 
+/* plant bus schema */
+MCN_SCHEMA_DEFINE(Plant_States_Bus,
+    MCN_FIELD(Plant_States_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(Plant_States_Bus, phi, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, theta, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, psi, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, rot_x_B, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, rot_y_B, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, rot_z_B, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, acc_x_O, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, acc_y_O, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, acc_z_O, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, vel_x_O, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, vel_y_O, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, vel_z_O, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, x_R, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, y_R, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, h_R, MCN_FLOAT),
+    MCN_FIELD(Plant_States_Bus, lon, MCN_DOUBLE),
+    MCN_FIELD(Plant_States_Bus, lat, MCN_DOUBLE),
+    MCN_FIELD(Plant_States_Bus, alt, MCN_DOUBLE),
+    MCN_FIELD(Plant_States_Bus, lon_ref, MCN_DOUBLE),
+    MCN_FIELD(Plant_States_Bus, lat_ref, MCN_DOUBLE),
+    MCN_FIELD(Plant_States_Bus, alt_ref, MCN_DOUBLE));
+
 static void publish_sensor_data(uint32_t timestamp)
 {
     if (Plant_Y.IMU.timestamp != imu_timestamp) {
@@ -114,12 +139,8 @@ void plant_interface_step(uint32_t timestamp)
     /* run plant model */
     Plant_step();
 
-    /* Log Plant output bus data */
-    DEFINE_TIMETAG(plant_output, 100);
-    if (check_timetag(TIMETAG(plant_output))) {
-        /* Log Control out data */
-        mlog_push_msg((uint8_t*)&Plant_Y.Plant_States, MLOG_PLANT_STATE_ID, sizeof(Plant_States_Bus));
-    }
+    /* Log Plant output bus data, the log rate is decided by mlog profile */
+    mlog_push_msg((uint8_t*)&Plant_Y.Plant_States, MLOG_PLANT_STATE_ID, sizeof(Plant_States_Bus));
 
     /* publish sensor model's data */
     publish_sensor_data(timestamp);
@@ -136,6 +157,8 @@ void plant_interface_init(void)
         ulog_e(TAG, "uMCN topic control_output subscribe fail!\n");
     }
 
+    FMT_CHECK(mlog_register_bus_schema(MLOG_PLANT_STATE_ID, MCN_SCHEMA(Plant_States_Bus)));
+
     Plant_init();
 }
 
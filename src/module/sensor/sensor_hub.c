@@ -28,6 +28,13 @@
 #define MAX_IMU_DEV_NUM 2
 #define MAX_MAG_DEV_NUM 2
 
+/* Health of a sensor instance, which is raised by a valid measurement and lowered
+ * by a failed or invalid one. The score of multi topic is the health rounded up
+ * to levels, so a few errors in a row are needed to switch to another instance */
+#define SENSOR_HEALTH_MAX   100
+#define SENSOR_HEALTH_ERROR 20
+#define SENSOR_HEALTH_LEVEL 50
+
 MCN_DEFINE(sensor_imu0_0, sizeof(imu_data_t));
 MCN_DEFINE(sensor_imu0, sizeof(imu_data_t));
 
@@ -40,6 +47,10 @@ MCN_DEFINE(sensor_mag0, sizeof(mag_data_t));
 MCN_DEFINE(sensor_mag1_0, sizeof(mag_data_t));
 MCN_DEFINE(sensor_mag1, sizeof(mag_data_t));
 
+/* consumers read the primary imu/mag through the multi-instance topic */
+MCN_MULTI_DEFINE(sensor_imu, 20, MCN_HUB(sensor_imu0), MCN_HUB(sensor_imu1));
+MCN_MULTI_DEFINE(sensor_mag, 200, MCN_HUB(sensor_mag0), MCN_HUB(sensor_mag1));
+
 MCN_DEFINE(sensor_baro, sizeof(baro_data_t));
 
 MCN_DEFINE(sensor_gps, sizeof(gps_data_t));
@@ -56,6 +67,9 @@ static sensor_gps_t gps_dev = NULL;
 static Butter3* butter3_gyr[MAX_IMU_DEV_NUM][3];
 static Butter3* butter3_acc[MAX_IMU_DEV_NUM][3];
 
+static int16_t imu_health[MAX_IMU_DEV_NUM] = { SENSOR_HEALTH_MAX, SENSOR_HEALTH_MAX };
+static int16_t mag_health[MAX_MAG_DEV_NUM] = { SENSOR_HEALTH_MAX, SENSOR_HEALTH_MAX };
+
 static void dcm_from_euler(const float rpy[3], float dcm[9])
 {
     float cosPhi = arm_cos_f32(rpy[0]);
@@ -78,74 +92,61 @@ static void dcm_from_euler(const float rpy[3], float dcm[9])
     dcm[8] = cosPhi * cosThe;
 }
 
-static int echo_sensor_imu(void* param)
-{
-    fmt_err_t err;
-    imu_data_t imu_report;
-
-    err = mcn_copy_from_hub((McnHub*)param, &imu_report);
-
-    if (err != FMT_EOK) {
-        return -1;
-    }
-
-    console_printf("gyr:%f %f %f acc:%f %f %f\n",
-        imu_report.gyr_B_radDs[0], imu_report.gyr_B_radDs[1], imu_report.gyr_B_radDs[2],
-        imu_report.acc_B_mDs2[0], imu_report.acc_B_mDs2[1], imu_report.acc_B_mDs2[2]);
-
-    return 0;
-}
-
-static int echo_sensor_mag(void* param)
-{
-    fmt_err_t err;
-    mag_data_t mag_report;
-
-    err = mcn_copy_from_hub((McnHub*)param, &mag_report);
-
-    if (err != FMT_EOK) {
-        return -1;
-    }
-
-    console_printf("mag:%f %f %f\n",
-        mag_report.mag_B_gauss[0], mag_report.mag_B_gauss[1], mag_report.mag_B_gauss[2]);
-
-    return 0;
-}
-
-static int echo_sensor_baro(void* param)
-{
-    fmt_err_t err;
-    baro_data_t baro_report;
-
-    err = mcn_copy_from_hub((McnHub*)param, &baro_report);
-
-    if (err != FMT_EOK) {
-        return -1;
-    }
-
-    console_printf("timestamp:%d pressure:%d temperature:%f altitude:%f\n",
-        baro_report.timestamp_ms, baro_report.pressure_pa, baro_report.temperature_deg,
-        baro_report.altitude_m);
+/* sensor topic schemas, used by generic echo */
+MCN_SCHEMA_DEFINE(imu_data_t,
+    MCN_FIELD(imu_data_t, timestamp_ms, MCN_UINT32),
+    MCN_FIELD_VEC(imu_data_t, gyr_B_radDs, MCN_FLOAT),
+    MCN_FIELD_VEC(imu_data_t, acc_B_mDs2, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(mag_data_t,
+    MCN_FIELD(mag_data_t, timestamp_ms, MCN_UINT32),
+    MCN_FIELD_VEC(mag_data_t, mag_B_gauss, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(baro_data_t,
+    MCN_FIELD(baro_data_t, timestamp_ms, MCN_UINT32),
+    MCN_FIELD(baro_data_t, temperature_deg, MCN_FLOAT),
+    MCN_FIELD(baro_data_t, pressure_pa, MCN_INT32),
+    MCN_FIELD(baro_data_t, altitude_m, MCN_FLOAT));
+
+MCN_SCHEMA_DEFINE(gps_data_t,
+    MCN_FIELD(gps_data_t, timestamp_ms, MCN_UINT32),
+    MCN_FIELD(gps_data_t, lon, MCN_INT32),
+    MCN_FIELD(gps_data_t, lat, MCN_INT32),
+    MCN_FIELD(gps_data_t, height, MCN_INT32),
+    MCN_FIELD(gps_data_t, hAcc, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, vAcc, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, velN, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, velE, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, velD, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, vel, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, cog, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, sAcc, MCN_FLOAT),
+    MCN_FIELD(gps_data_t, fixType, MCN_UINT8),
+    MCN_FIELD(gps_data_t, numSV, MCN_UINT8),
+    MCN_FIELD(gps_data_t, reserved, MCN_UINT16));
+
+MCN_SCHEMA_DEFINE(optflow_data_t,
+    MCN_FIELD(optflow_data_t, timestamp_ms, MCN_UINT32),
+    MCN_FIELD(optflow_data_t, vx_mPs, MCN_FLOAT),
+    MCN_FIELD(optflow_data_t, vy_mPs, MCN_FLOAT),
+    MCN_FIELD(optflow_data_t, valid, MCN_UINT32));
+
+MCN_SCHEMA_DEFINE(rf_data_t,
+    MCN_FIELD(rf_data_t, timestamp_ms, MCN_UINT32),
+    MCN_FIELD(rf_data_t, distance_m, MCN_FLOAT));
 
-    return 0;
-}
-
-static int echo_sensor_gps(void* param)
+/**
+ * @brief Attach schema to topic and advertise it with generic echo
+ * 
+ * @param hub uMCN hub
+ * @param schema Topic schema
+ * @return fmt_err_t FMT_EOK for success
+ */
+static fmt_err_t advertise_with_schema(McnHub_t hub, const McnSchema* schema)
 {
-    fmt_err_t err;
-    gps_data_t gps_report;
-
-    err = mcn_copy_from_hub((McnHub*)param, &gps_report);
-
-    if (err != FMT_EOK) {
-        return -1;
-    }
-
-    console_printf("lon:%d lat:%d alt:%d fixType:%d numSV:%d hAcc:%.2f vAcc:%.2f sAcc:%.2f\n", gps_report.lon, gps_report.lat,
-        gps_report.height, gps_report.fixType, gps_report.numSV, gps_report.hAcc, gps_report.vAcc, gps_report.sAcc);
+    FMT_TRY(mcn_set_schema(hub, schema));
 
-    return 0;
+    return mcn_advertise(hub, mcn_schema_echo);
 }
 
 static void imu_rotation_init(uint8_t id)
@@ -332,6 +333,33 @@ static void mag_filter_init(uint8_t id)
     /* do nothing */
 }
 
+static void sensor_switch_cb(McnMulti_t multi, uint8_t from, uint8_t to)
+{
+    ulog_w("Sensor", "%s switch from instance %d to %d", multi->name, from, to);
+}
+
+static bool vec3_valid(const float vec[3])
+{
+    return isfinite(vec[0]) && isfinite(vec[1]) && isfinite(vec[2]);
+}
+
+static void update_health(McnMulti_t multi, int16_t* health, uint8_t instance, bool valid)
+{
+    int16_t val = *health + (valid ? 1 : -SENSOR_HEALTH_ERROR);
+
+    if (val > SENSOR_HEALTH_MAX) {
+        val = SENSOR_HEALTH_MAX;
+    }
+    if (val < 0) {
+        val = 0;
+    }
+
+    if (val != *health) {
+        *health = val;
+        mcn_multi_set_score(multi, instance, (val + SENSOR_HEALTH_LEVEL - 1) / SENSOR_HEALTH_LEVEL);
+    }
+}
+
 /**
  * @brief Advertise sensor imu topic
  * 
@@ -342,12 +370,12 @@ fmt_err_t advertise_sensor_imu(uint8_t id)
 {
     switch (id) {
     case 0:
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_imu0_0), echo_sensor_imu));
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_imu0), echo_sensor_imu));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_imu0_0), MCN_SCHEMA(imu_data_t)));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_imu0), MCN_SCHEMA(imu_data_t)));
         break;
     case 1:
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_imu1_0), echo_sensor_imu));
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_imu1), echo_sensor_imu));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_imu1_0), MCN_SCHEMA(imu_data_t)));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_imu1), MCN_SCHEMA(imu_data_t)));
         break;
     default:
         return FMT_EINVAL;
@@ -366,12 +394,12 @@ fmt_err_t advertise_sensor_mag(uint8_t id)
 {
     switch (id) {
     case 0:
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_mag0_0), echo_sensor_mag));
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_mag0), echo_sensor_mag));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_mag0_0), MCN_SCHEMA(mag_data_t)));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_mag0), MCN_SCHEMA(mag_data_t)));
         break;
     case 1:
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_mag1_0), echo_sensor_mag));
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_mag1), echo_sensor_mag));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_mag1_0), MCN_SCHEMA(mag_data_t)));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_mag1), MCN_SCHEMA(mag_data_t)));
         break;
     default:
         return FMT_EINVAL;
@@ -390,7 +418,7 @@ fmt_err_t advertise_sensor_baro(uint8_t id)
 {
     switch (id) {
     case 0:
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_baro), echo_sensor_baro));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_baro), MCN_SCHEMA(baro_data_t)));
         break;
     default:
         return FMT_EINVAL;
@@ -409,7 +437,7 @@ fmt_err_t advertise_sensor_gps(uint8_t id)
 {
     switch (id) {
     case 0:
-        FMT_TRY(mcn_advertise(MCN_HUB(sensor_gps), echo_sensor_gps));
+        FMT_TRY(advertise_with_schema(MCN_HUB(sensor_gps), MCN_SCHEMA(gps_data_t)));
         break;
     default:
         return FMT_EINVAL;
@@ -506,14 +534,35 @@ fmt_err_t register_sensor_gps(const char* dev_name)
 fmt_err_t register_sensor_optflow(const char* dev_name)
 {
     //TODO
-    FMT_TRY(mcn_advertise(MCN_HUB(sensor_optflow), NULL));
+    FMT_TRY(advertise_with_schema(MCN_HUB(sensor_optflow), MCN_SCHEMA(optflow_data_t)));
     return FMT_EOK;
 }
 
 fmt_err_t register_sensor_rangefinder(const char* dev_name)
 {
     //TODO
-    FMT_TRY(mcn_advertise(MCN_HUB(sensor_rangefinder), NULL));
+    FMT_TRY(advertise_with_schema(MCN_HUB(sensor_rangefinder), MCN_SCHEMA(rf_data_t)));
+    return FMT_EOK;
+}
+
+/**
+ * @brief Initialize sensor hub
+ * @note Should be called before sensors are registered or advertised
+ * 
+ * @return fmt_err_t FMT_EOK for success
+ */
+fmt_err_t sensor_hub_init(void)
+{
+    McnMulti_t multi[] = { MCN_MULTI(sensor_imu), MCN_MULTI(sensor_mag) };
+
+    for (int i = 0; i < sizeof(multi) / sizeof(McnMulti_t); i++) {
+        /* all instances start healthy, the primary is kept until one degrades */
+        for (uint8_t k = 0; k < multi[i]->instance_num; k++) {
+            mcn_multi_set_score(multi[i], k, SENSOR_HEALTH_MAX / SENSOR_HEALTH_LEVEL);
+        }
+        mcn_multi_set_switch_cb(multi[i], sensor_switch_cb);
+    }
+
     return FMT_EOK;
 }
 
@@ -536,8 +585,12 @@ void sensor_collect(void)
 
         /* Collect imu0 data */
         if (imu_dev[0] != NULL) {
-            if (sensor_gyr_measure(imu_dev[0], imu_data.gyr_B_radDs) == FMT_EOK
-                && sensor_acc_measure(imu_dev[0], imu_data.acc_B_mDs2) == FMT_EOK) {
+            bool valid = sensor_gyr_measure(imu_dev[0], imu_data.gyr_B_radDs) == FMT_EOK
+                && sensor_acc_measure(imu_dev[0], imu_data.acc_B_mDs2) == FMT_EOK
+                && vec3_valid(imu_data.gyr_B_radDs) && vec3_valid(imu_data.acc_B_mDs2);
+
+            update_health(MCN_MULTI(sensor_imu), &imu_health[0], 0, valid);
+            if (valid) {
                 /* publish scaled imu data without calibration and filtering */
                 mcn_publish(MCN_HUB(sensor_imu0_0), &imu_data);
                 /* do calibration */
@@ -563,8 +616,12 @@ void sensor_collect(void)
 
         /* Collect imu1 data */
         if (imu_dev[1] != NULL) {
-            if (sensor_gyr_measure(imu_dev[1], imu_data.gyr_B_radDs) == FMT_EOK
-                && sensor_acc_measure(imu_dev[1], imu_data.acc_B_mDs2) == FMT_EOK) {
+            bool valid = sensor_gyr_measure(imu_dev[1], imu_data.gyr_B_radDs) == FMT_EOK
+                && sensor_acc_measure(imu_dev[1], imu_data.acc_B_mDs2) == FMT_EOK
+                && vec3_valid(imu_data.gyr_B_radDs) && vec3_valid(imu_data.acc_B_mDs2);
+
+            update_health(MCN_MULTI(sensor_imu), &imu_health[1], 1, valid);
+            if (valid) {
                 /* publish scaled imu data without calibration and filtering */
                 mcn_publish(MCN_HUB(sensor_imu1_0), &imu_data);
                 /* do calibration */
@@ -600,7 +657,11 @@ void sensor_collect(void)
 
         /* Collect mag0 data */
         if (mag_dev[0] != NULL) {
-            if (sensor_mag_measure(mag_dev[0], mag_data.mag_B_gauss) == FMT_EOK) {
+            bool valid = sensor_mag_measure(mag_dev[0], mag_data.mag_B_gauss) == FMT_EOK
+                && vec3_valid(mag_data.mag_B_gauss);
+
+            update_health(MCN_MULTI(sensor_mag), &mag_health[0], 0, valid);
+            if (valid) {
                 mcn_publish(MCN_HUB(sensor_mag0_0), &mag_data);
                 /* do calibration */
                 sensor_mag_correct(mag_dev[0], mag_data.mag_B_gauss, temp);
@@ -614,7 +675,11 @@ void sensor_collect(void)
 
         /* Collect mag1 data */
         if (mag_dev[1] != NULL) {
-            if (sensor_mag_measure(mag_dev[1], mag_data.mag_B_gauss) == FMT_EOK) {
+            bool valid = sensor_mag_measure(mag_dev[1], mag_data.mag_B_gauss) == FMT_EOK
+                && vec3_valid(mag_data.mag_B_gauss);
+
+            update_health(MCN_MULTI(sensor_mag), &mag_health[1], 1, valid);
+            if (valid) {
                 mcn_publish(MCN_HUB(sensor_mag1_0), &mag_data);
                 /* do calibration */
                 sensor_mag_correct(mag_dev[1], mag_data.mag_B_gauss, temp);
@@ -15,6 +15,7 @@
  *****************************************************************************/
 
 #include <firmament.h>
+#include <dfs_posix.h>
 #include <string.h>
 
 #include "module/syscmd/optparse.h"
@@ -29,6 +30,12 @@ static void show_usage(void)
     SHELL_COMMAND("echo", "Echo a uMCN topic.");
     SHELL_COMMAND("suspend", "Suspend a uMCN topic.");
     SHELL_COMMAND("resume", "Resume a uMCN topic.");
+    SHELL_COMMAND("mem", "Show memory used by uMCN topics.");
+    SHELL_COMMAND("profile", "Profile publish interval and latency of a uMCN topic.");
+    SHELL_COMMAND("dispatch", "Show deferred callback dispatch statistics.");
+    SHELL_COMMAND("record", "Record uMCN traffic into capture file.");
+    SHELL_COMMAND("replay", "Replay a capture file into uMCN topics.");
+    SHELL_COMMAND("schema", "Show field layout of a uMCN topic.");
 }
 
 static void show_echo_usage(void)
@@ -50,6 +57,43 @@ static void show_resume_usage(void)
     COMMAND_USAGE("mcn resume", "<topic>");
 }
 
+static void show_profile_usage(void)
+{
+    COMMAND_USAGE("mcn profile", "<start|stop|show|dump> <topic> [file]");
+
+    PRINT_STRING("\ncommand:\n");
+    SHELL_COMMAND("start", "Start (or restart) profiling the topic.");
+    SHELL_COMMAND("stop", "Stop profiling the topic.");
+    SHELL_COMMAND("show", "Show interval and latency statistics.");
+    SHELL_COMMAND("dump", "Dump profile as binary record into file.");
+}
+
+static void show_record_usage(void)
+{
+    COMMAND_USAGE("mcn record", "<start|stop|status> [file] [topic ...] [options]");
+
+    PRINT_STRING("\ncommand:\n");
+    SHELL_COMMAND("start", "Start recording the topics (all topics if no topic given) into file.");
+    SHELL_COMMAND("stop", "Stop recording.");
+    SHELL_COMMAND("status", "Show recording statistics.");
+
+    PRINT_STRING("\noptions:\n");
+    SHELL_OPTION("-b, --buffer", "Set record ring buffer size (bytes).");
+}
+
+static void show_replay_usage(void)
+{
+    COMMAND_USAGE("mcn replay", "<file> [options]");
+
+    PRINT_STRING("\noptions:\n");
+    SHELL_OPTION("-r, --realtime", "Replay at original timing, otherwise as fast as possible.");
+}
+
+static void show_schema_usage(void)
+{
+    COMMAND_USAGE("mcn schema", "<topic>");
+}
+
 static int name_maxlen(const char* title)
 {
     int max_len = strlen(title);
@@ -70,12 +114,23 @@ static int name_maxlen(const char* title)
     return max_len;
 }
 
+static uint32_t topic_skipped(McnHub_t hub)
+{
+    uint32_t skipped = 0;
+
+    for (McnNode_t node = hub->link_head; node != NULL; node = node->next) {
+        skipped += node->skipped;
+    }
+
+    return skipped;
+}
+
 static void list_topic(void)
 {
     uint32_t max_len = name_maxlen("Topic") + 2;
 
-    rt_kprintf("%-*.s    #SUB   Freq(Hz)   Echo   Suspend\n", max_len - 2, "Topic"); syscmd_putc('-', max_len);
-    printf(           " ------ ---------- ------ ---------\n");
+    rt_kprintf("%-*.s    #SUB   Freq(Hz)   Echo   Suspend    #Skip     #Busy\n", max_len - 2, "Topic"); syscmd_putc('-', max_len);
+    printf(           " ------ ---------- ------ --------- ---------- ----------\n");
 
     McnList_t ite = mcn_get_list();
     for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
@@ -88,49 +143,388 @@ static void list_topic(void)
         syscmd_printf(' ', strlen("Echo") + 2, SYSCMD_ALIGN_MIDDLE, "%s", hub->echo ? "true" : "false");
         printf(" ");
         syscmd_printf(' ', strlen("Suspend") + 2, SYSCMD_ALIGN_MIDDLE, "%s", hub->suspend ? "true" : "false");
+        printf(" ");
+        syscmd_printf(' ', strlen("#Skip") + 5, SYSCMD_ALIGN_MIDDLE, "%ld", topic_skipped(hub));
+        printf(" ");
+        syscmd_printf(' ', strlen("#Busy") + 5, SYSCMD_ALIGN_MIDDLE, "%ld", hub->busy_drop);
         printf("\n");
     }
 }
 
-static int suspend_topic(struct optparse options)
+static void show_topic_mem(void)
+{
+    uint32_t max_len = name_maxlen("Topic") + 2;
+    uint32_t total = 0;
+
+    rt_kprintf("%-*.s    Data(B)    Node(B)\n", max_len - 2, "Topic"); syscmd_putc('-', max_len);
+    printf(           " ---------- ----------\n");
+
+    McnList_t ite = mcn_get_list();
+    for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+        uint32_t data_mem = mcn_get_topic_mem(hub);
+        uint32_t node_mem = hub->link_num * sizeof(McnNode);
+
+        syscmd_printf(' ', max_len, SYSCMD_ALIGN_LEFT, hub->obj_name);
+        printf(" ");
+        syscmd_printf(' ', strlen("Data(B)") + 3, SYSCMD_ALIGN_MIDDLE, "%ld", data_mem);
+        printf(" ");
+        syscmd_printf(' ', strlen("Node(B)") + 3, SYSCMD_ALIGN_MIDDLE, "%ld", node_mem);
+        printf("\n");
+
+        total += data_mem + node_mem;
+    }
+
+    printf("total: %ld bytes\n", total);
+#ifdef FMT_USING_MCN_STATIC
+    uint32_t used, num;
+
+    mcn_get_node_pool_usage(&used, &num);
+    printf("node pool: %ld/%ld used, %ld bytes reserved\n", used, num, num * sizeof(McnNode));
+#endif
+}
+
+static void show_hist(const char* title, const McnHist* hist)
+{
+    printf("%s: count %ld", title, hist->count);
+    if (hist->count == 0) {
+        printf("\n");
+        return;
+    }
+    printf(" min %ld avg %ld p50 %ld p90 %ld p99 %ld max %ld (us)\n",
+           hist->min,
+           (uint32_t)(hist->sum / hist->count),
+           mcn_hist_percentile(hist, 50),
+           mcn_hist_percentile(hist, 90),
+           mcn_hist_percentile(hist, 99),
+           hist->max);
+
+    for (uint32_t i = 0; i < MCN_HIST_BIN_NUM; i++) {
+        if (hist->bin[i] == 0) {
+            continue;
+        }
+        if (i == MCN_HIST_BIN_NUM - 1) {
+            printf("  >= %-8ld: %ld\n", 1UL << (i - 1), hist->bin[i]);
+        } else {
+            printf("  < %-9ld: %ld\n", 1UL << i, hist->bin[i]);
+        }
+    }
+}
+
+static void show_dispatch(void)
+{
+    uint32_t max_len = name_maxlen("Topic") + 2;
+    uint32_t peak, overflow;
+
+    rt_kprintf("%-*.s  #Defer  Coalesced   Overflow\n", max_len - 2, "Topic"); syscmd_putc('-', max_len);
+    printf(           " ------ ---------- ----------\n");
+
+    McnList_t ite = mcn_get_list();
+    for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+        uint32_t defer_num = 0, coalesced = 0;
+
+        overflow = 0;
+        for (McnNode_t node = hub->link_head; node != NULL; node = node->next) {
+            if (node->dispatch_buf) {
+                defer_num++;
+                coalesced += node->coalesced;
+                overflow += node->overflow;
+            }
+        }
+        if (defer_num == 0) {
+            continue;
+        }
+
+        syscmd_printf(' ', max_len, SYSCMD_ALIGN_LEFT, hub->obj_name);
+        printf(" ");
+        syscmd_printf(' ', strlen("#Defer"), SYSCMD_ALIGN_MIDDLE, "%ld", defer_num);
+        printf(" ");
+        syscmd_printf(' ', strlen("Coalesced") + 1, SYSCMD_ALIGN_MIDDLE, "%ld", coalesced);
+        printf(" ");
+        syscmd_printf(' ', strlen("Overflow") + 2, SYSCMD_ALIGN_MIDDLE, "%ld", overflow);
+        printf("\n");
+    }
+
+    mcn_get_dispatch_stats(&peak, &overflow);
+    printf("dispatch queue: peak %ld/%d, overflow %ld\n", peak, MCN_DISPATCH_QUEUE_SIZE, overflow);
+}
+
+static int dump_profile(McnHub_t hub, const char* file)
+{
+    McnProfileRecord record;
+
+    if (mcn_profile_dump(hub, &record) != FMT_EOK) {
+        printf("topic %s is not being profiled\n", hub->obj_name);
+        return EXIT_FAILURE;
+    }
+
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        printf("open %s fail!\n", file);
+        return EXIT_FAILURE;
+    }
+
+    if (write(fd, &record, sizeof(record)) != sizeof(record)) {
+        printf("write %s fail!\n", file);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    printf("dump %d bytes into %s\n", (int)sizeof(record), file);
+
+    return EXIT_SUCCESS;
+}
+
+static int profile_topic(struct optparse options)
+{
+    char* cmd;
+    char* arg;
+    McnProfile profile;
+
+    if ((cmd = optparse_arg(&options)) == NULL || (arg = optparse_arg(&options)) == NULL) {
+        show_profile_usage();
+        return EXIT_FAILURE;
+    }
+
+    McnHub_t target_hub = mcn_find(arg);
+
+    if (target_hub == NULL) {
+        console_printf("can not find topic %s\n", arg);
+        return EXIT_FAILURE;
+    }
+
+    if (STRING_COMPARE(cmd, "start")) {
+        if (mcn_profile_start(target_hub) != FMT_EOK) {
+            console_printf("fail to start profile\n");
+            return EXIT_FAILURE;
+        }
+    } else if (STRING_COMPARE(cmd, "stop")) {
+        mcn_profile_stop(target_hub);
+    } else if (STRING_COMPARE(cmd, "show")) {
+        if (mcn_profile_get(target_hub, &profile) != FMT_EOK) {
+            printf("topic %s is not being profiled\n", arg);
+            return EXIT_FAILURE;
+        }
+        printf("%s profiled for %ld ms\n", arg, (uint32_t)((systime_now_us() - profile.start_time) / 1000));
+        show_hist("interval", &profile.interval);
+        show_hist("latency", &profile.latency);
+    } else if (STRING_COMPARE(cmd, "dump")) {
+        if ((arg = optparse_arg(&options)) == NULL) {
+            show_profile_usage();
+            return EXIT_FAILURE;
+        }
+        return dump_profile(target_hub, arg);
+    } else {
+        show_profile_usage();
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void show_record_stats(void)
 {
+    McnRecordStats stats;
+
+    mcn_record_get_stats(&stats);
+
+    printf("recorder: %s, %ld ms\n", stats.running ? "running" : "stopped", stats.duration_ms);
+    printf("records: %ld, dropped %ld, write error %ld\n", stats.record_cnt, stats.drop_cnt, stats.write_error);
+    printf("written: %ld bytes, %ld B/s\n", (uint32_t)stats.bytes,
+           stats.duration_ms ? (uint32_t)(stats.bytes * 1000 / stats.duration_ms) : 0);
+    printf("buffer: peak %ld/%ld bytes\n", stats.peak_usage, stats.buffer_size);
+    printf("publish overhead: %ld us total, %ld ns per record\n", (uint32_t)stats.hook_time,
+           stats.record_cnt ? (uint32_t)(stats.hook_time * 1000 / stats.record_cnt) : 0);
+}
+
+static int record_traffic(struct optparse options)
+{
+    char* cmd;
     char* arg;
+    char* file;
     int option;
+    uint32_t buffer_size = 0;
+    uint32_t topic_num = 0;
     struct optparse_long longopts[] = {
         { "help", 'h', OPTPARSE_NONE },
+        { "buffer", 'b', OPTPARSE_REQUIRED },
         { NULL } /* Don't remove this line */
     };
 
     while ((option = optparse_long(&options, longopts, NULL)) != -1) {
         switch (option) {
         case 'h':
-            show_suspend_usage();
+            show_record_usage();
             return EXIT_SUCCESS;
+        case 'b':
+            buffer_size = atoi(options.optarg);
+            break;
         case '?':
-            console_printf("%s: %s\n", "mcn echo", options.errmsg);
+            console_printf("%s: %s\n", "mcn record", options.errmsg);
             return EXIT_FAILURE;
         }
     }
 
-    if ((arg = optparse_arg(&options)) == NULL) {
-        show_suspend_usage();
+    if ((cmd = optparse_arg(&options)) == NULL) {
+        show_record_usage();
         return EXIT_FAILURE;
     }
 
-    McnList_t ite = mcn_get_list();
-    McnHub_t target_hub = NULL;
+    if (STRING_COMPARE(cmd, "start")) {
+        if ((file = optparse_arg(&options)) == NULL) {
+            show_record_usage();
+            return EXIT_FAILURE;
+        }
 
-    while (1) {
-        McnHub_t hub = mcn_iterate(&ite);
-        if (hub == NULL) {
-            break;
+        mcn_record_topic(NULL, false);
+        while ((arg = optparse_arg(&options)) != NULL) {
+            McnHub_t hub = mcn_find(arg);
+
+            if (hub == NULL) {
+                console_printf("can not find topic %s\n", arg);
+                return EXIT_FAILURE;
+            }
+            mcn_record_topic(hub, true);
+            topic_num++;
+        }
+        if (topic_num == 0) {
+            mcn_record_topic(NULL, true);
+        }
+
+        if (mcn_record_start(file, buffer_size) != FMT_EOK) {
+            console_printf("fail to start record\n");
+            return EXIT_FAILURE;
         }
-        if (strcmp(hub->obj_name, arg) == 0) {
-            target_hub = hub;
+    } else if (STRING_COMPARE(cmd, "stop")) {
+        if (mcn_record_stop() != FMT_EOK) {
+            printf("recorder is not running\n");
+            return EXIT_FAILURE;
+        }
+        show_record_stats();
+    } else if (STRING_COMPARE(cmd, "status")) {
+        show_record_stats();
+    } else {
+        show_record_usage();
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int replay_traffic(struct optparse options)
+{
+    char* arg;
+    int option;
+    uint8_t mode = MCN_REPLAY_FAST;
+    McnReplayStats stats;
+    fmt_err_t err;
+    struct optparse_long longopts[] = {
+        { "help", 'h', OPTPARSE_NONE },
+        { "realtime", 'r', OPTPARSE_NONE },
+        { NULL } /* Don't remove this line */
+    };
+
+    while ((option = optparse_long(&options, longopts, NULL)) != -1) {
+        switch (option) {
+        case 'h':
+            show_replay_usage();
+            return EXIT_SUCCESS;
+        case 'r':
+            mode = MCN_REPLAY_REALTIME;
             break;
+        case '?':
+            console_printf("%s: %s\n", "mcn replay", options.errmsg);
+            return EXIT_FAILURE;
         }
     }
 
+    if ((arg = optparse_arg(&options)) == NULL) {
+        show_replay_usage();
+        return EXIT_FAILURE;
+    }
+
+    err = mcn_replay(arg, mode, &stats);
+    if (err == FMT_EINVAL) {
+        console_printf("%s is not a valid capture file\n", arg);
+        return EXIT_FAILURE;
+    } else if (err != FMT_EOK) {
+        console_printf("fail to replay %s\n", arg);
+        return EXIT_FAILURE;
+    }
+
+    printf("replayed %ld records, skipped %ld, failed %ld\n", stats.replay_cnt, stats.skip_cnt, stats.fail_cnt);
+    printf("capture %ld ms, replay %ld ms\n", stats.capture_ms, stats.duration_ms);
+    if (mode == MCN_REPLAY_REALTIME) {
+        show_hist("timing error", &stats.error);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int show_schema(struct optparse options)
+{
+    char* arg;
+
+    if ((arg = optparse_arg(&options)) == NULL) {
+        show_schema_usage();
+        return EXIT_FAILURE;
+    }
+
+    McnHub_t target_hub = mcn_find(arg);
+
+    if (target_hub == NULL) {
+        console_printf("can not find topic %s\n", arg);
+        return EXIT_FAILURE;
+    }
+
+    const McnSchema* schema = target_hub->schema;
+
+    if (schema == NULL) {
+        console_printf("there is no schema attached to topic %s\n", arg);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %d bytes, %d fields, %ld bytes packed\n", schema->name, schema->size, schema->field_num,
+        mcn_schema_packed_size(schema));
+    printf("%-20s %-8s %-8s %-8s\n", "Field", "Type", "Offset", "Num");
+    syscmd_putc('-', 47);
+    printf("\n");
+    for (uint32_t i = 0; i < schema->field_num; i++) {
+        const McnField* field = &schema->field[i];
+
+        printf("%-20s %-8s %-8d %-8d\n", field->name, mcn_schema_type_name(field->type), field->offset, field->num);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int suspend_topic(struct optparse options)
+{
+    char* arg;
+    int option;
+    struct optparse_long longopts[] = {
+        { "help", 'h', OPTPARSE_NONE },
+        { NULL } /* Don't remove this line */
+    };
+
+    while ((option = optparse_long(&options, longopts, NULL)) != -1) {
+        switch (option) {
+        case 'h':
+            show_suspend_usage();
+            return EXIT_SUCCESS;
+        case '?':
+            console_printf("%s: %s\n", "mcn echo", options.errmsg);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((arg = optparse_arg(&options)) == NULL) {
+        show_suspend_usage();
+        return EXIT_FAILURE;
+    }
+
+    McnHub_t target_hub = mcn_find(arg);
+
     if (target_hub == NULL) {
         console_printf("can not find topic %s\n", arg);
         return EXIT_FAILURE;
@@ -166,19 +560,7 @@ static int resume_topic(struct optparse options)
         return EXIT_FAILURE;
     }
 
-    McnList_t ite = mcn_get_list();
-    McnHub_t target_hub = NULL;
-
-    while (1) {
-        McnHub_t hub = mcn_iterate(&ite);
-        if (hub == NULL) {
-            break;
-        }
-        if (strcmp(hub->obj_name, arg) == 0) {
-            target_hub = hub;
-            break;
-        }
-    }
+    McnHub_t target_hub = mcn_find(arg);
 
     if (target_hub == NULL) {
         console_printf("can not find topic %s\n", arg);
@@ -226,18 +608,7 @@ static int echo_topic(struct optparse options)
         return EXIT_FAILURE;
     }
 
-    McnList_t ite = mcn_get_list();
-    McnHub_t target_hub = NULL;
-    while (1) {
-        McnHub_t hub = mcn_iterate(&ite);
-        if (hub == NULL) {
-            break;
-        }
-        if (strcmp(hub->obj_name, arg) == 0) {
-            target_hub = hub;
-            break;
-        }
-    }
+    McnHub_t target_hub = mcn_find(arg);
 
     if (target_hub == NULL) {
         console_printf("can not find topic %s\n", arg);
@@ -295,6 +666,18 @@ int cmd_mcn(int argc, char** argv)
     if (arg) {
         if (STRING_COMPARE(arg, "list")) {
             list_topic();
+        } else if (STRING_COMPARE(arg, "mem")) {
+            show_topic_mem();
+        } else if (STRING_COMPARE(arg, "dispatch")) {
+            show_dispatch();
+        } else if (STRING_COMPARE(arg, "profile")) {
+            res = profile_topic(options);
+        } else if (STRING_COMPARE(arg, "record")) {
+            res = record_traffic(options);
+        } else if (STRING_COMPARE(arg, "replay")) {
+            res = replay_traffic(options);
+        } else if (STRING_COMPARE(arg, "schema")) {
+            res = show_schema(options);
         } else if (STRING_COMPARE(arg, "echo")) {
             res = echo_topic(options);
         } else if (STRING_COMPARE(arg, "suspend")) {
@@ -18,6 +18,7 @@
 
 #include "module/syscmd/syscmd.h"
 #include "task/task_logger.h"
+#include "task/task_vehicle.h"
 #include "module/file_manager/file_manager.h"
 
 static void _show_mlog_status(void)
@@ -31,8 +32,80 @@ static void _show_mlog_status(void)
     mlog_statistic();
 }
 
+static void _show_profile(void)
+{
+    const mlog_profile_t* profile_list;
+    const mlog_profile_t* current = mlog_get_profile();
+    uint8_t num;
+
+    profile_list = mlog_get_profile_list(&num);
+    for (uint8_t i = 0; i < num; i++) {
+        console_printf("%c %s\n", &profile_list[i] == current ? '*' : ' ', profile_list[i].name);
+    }
+}
+
+static void _set_bus_rate(const char* id, const char* rate)
+{
+    uint16_t period = STRING_COMPARE(rate, "off") ? MLOG_RATE_OFF : atoi(rate);
+
+    if (mlog_set_bus_rate(atoi(id), period) != FMT_EOK) {
+        console_printf("invalid msg id %s\n", id);
+    }
+}
+
+static void _replay(const char* log_file, const char* out_file)
+{
+    char path[100];
+    vehicle_replay_stat_t stat;
+    uint32_t span;
+    fmt_err_t err;
+
+    if (out_file) {
+        strncpy(path, out_file, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    } else {
+        /* write <log>_replay.bin next to the log */
+        int len = strlen(log_file);
+
+        if (len > 4 && strcmp(&log_file[len - 4], ".bin") == 0) {
+            len -= 4;
+        }
+        snprintf(path, sizeof(path), "%.*s_replay.bin", len, log_file);
+    }
+
+    err = vehicle_replay_mlog(log_file, path, &stat);
+    if (err != FMT_EOK) {
+        if (err == FMT_EBUSY) {
+            console_printf("vehicle must be disarmed and logging must be stopped\n");
+        } else {
+            console_printf("fail to replay %s, err:%d\n", log_file, err);
+        }
+        return;
+    }
+
+    span = stat.log.end_time - stat.log.start_time;
+    console_printf("replayed %s into %s\n", log_file, path);
+    console_printf("frame:%u input:%u step:%u skip byte:%u gap:%u mismatch:%u\n", stat.log.frame, stat.log.input,
+        stat.log.step, stat.log.skip_byte, stat.log.gap, stat.mismatch);
+    console_printf("log %u ms, replay %u ms, speed %.1fx real time\n", span, stat.duration_ms,
+        stat.duration_ms ? (float)span / stat.duration_ms : 0.0f);
+}
+
 static void show_usage(void)
 {
+    COMMAND_USAGE("mlog", "<command> [options]");
+
+    PRINT_STRING("\ncommand:\n");
+    SHELL_COMMAND("start", "Start logging, with optional log file name.");
+    SHELL_COMMAND("stop", "Stop logging.");
+    SHELL_COMMAND("status", "Show log file and per-bus statistics.");
+    SHELL_COMMAND("ws", "Show working log session.");
+    SHELL_COMMAND("profile", "List log profiles, or select one by mlog profile <name>.");
+    SHELL_COMMAND("rate", "Set log period of bus, mlog rate <msg id> <ms|off>.");
+    SHELL_COMMAND("replay", "Replay model inputs of log as fast as possible, mlog replay <log> [output].");
+
+    PRINT_STRING("\noptions:\n");
+    SHELL_OPTION("-m, --msg", "Add description into log file.");
 }
 
 static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
@@ -59,7 +132,19 @@ static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
         logger_stop_mlog();
     } else if (strcmp(argv[1], "status") == 0) {
         _show_mlog_status();
-    }else if (strcmp(argv[1], "ws") == 0) {
+    } else if (strcmp(argv[1], "profile") == 0) {
+        if (argc >= 3) {
+            if (mlog_set_profile(argv[2]) != FMT_EOK) {
+                console_printf("unknown profile %s\n", argv[2]);
+            }
+        } else {
+            _show_profile();
+        }
+    } else if (strcmp(argv[1], "rate") == 0 && argc >= 4) {
+        _set_bus_rate(argv[2], argv[3]);
+    } else if (strcmp(argv[1], "replay") == 0 && argc >= 3) {
+        _replay(argv[2], argc >= 4 ? argv[3] : NULL);
+    } else if (strcmp(argv[1], "ws") == 0) {
         char path[100];
         current_log_session(path);
         console_printf("working log session: %s\n", path);
@@ -26,19 +26,11 @@ static GCS_Cmd_Bus gcs_cmd;
 
 MCN_DEFINE(gcs_cmd, sizeof(GCS_Cmd_Bus));
 
-static int gcs_cmd_echo(void* parameter)
-{
-    GCS_Cmd_Bus gcs_cmd;
-
-    if (mcn_copy_from_hub((McnHub*)parameter, &gcs_cmd) != FMT_EOK) {
-        return -1;
-    }
-
-    printf("timestamp:%u mode:%u cmd1:%u cmd2:%u\n",
-        gcs_cmd.timestamp, gcs_cmd.mode, gcs_cmd.cmd_1, gcs_cmd.cmd_2);
-
-    return 0;
-}
+MCN_SCHEMA_DEFINE(GCS_Cmd_Bus,
+    MCN_FIELD(GCS_Cmd_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(GCS_Cmd_Bus, mode, MCN_UINT32),
+    MCN_FIELD(GCS_Cmd_Bus, cmd_1, MCN_UINT32),
+    MCN_FIELD(GCS_Cmd_Bus, cmd_2, MCN_UINT32));
 
 fmt_err_t gcs_set_cmd(FMS_Cmd cmd)
 {
@@ -127,7 +119,9 @@ fmt_err_t gcs_cmd_init(void)
     gcs_cmd_rb = ringbuffer_static_create((uint8_t*)gcs_cmd_buffer, sizeof(gcs_cmd_buffer));
     RT_ASSERT(gcs_cmd_rb != NULL);
 
-    FMT_TRY(mcn_advertise(MCN_HUB(gcs_cmd), gcs_cmd_echo));
+    FMT_TRY(mcn_set_schema(MCN_HUB(gcs_cmd), MCN_SCHEMA(GCS_Cmd_Bus)));
+    FMT_TRY(mcn_advertise(MCN_HUB(gcs_cmd), mcn_schema_echo));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_GCS_CMD_ID, MCN_SCHEMA(GCS_Cmd_Bus)));
 
     return FMT_EOK;
 }
\ No newline at end of file
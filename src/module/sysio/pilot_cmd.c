@@ -50,22 +50,15 @@ static Pilot_Cmd_Bus pilot_cmd_bus;
 MCN_DEFINE(pilot_cmd, sizeof(Pilot_Cmd_Bus));
 MCN_DEFINE(rc_channels, sizeof(rcChannel));
 
-static int echo_pilot_cmd(void* parameter)
-{
-    fmt_err_t err;
-    Pilot_Cmd_Bus pilot_cmd;
-
-    err = mcn_copy_from_hub((McnHub*)parameter, &pilot_cmd);
-
-    if (err != FMT_EOK)
-        return -1;
-
-    console_printf("stick_yaw:%.2f stick_throttle:%.2f stick_roll:%.2f stick_pitch:%.2f mode:%u cmd:[%u %u]\n",
-        pilot_cmd.stick_yaw, pilot_cmd.stick_throttle, pilot_cmd.stick_roll, pilot_cmd.stick_pitch, pilot_cmd.mode,
-        pilot_cmd.cmd_1, pilot_cmd.cmd_2);
-
-    return 0;
-}
+MCN_SCHEMA_DEFINE(Pilot_Cmd_Bus,
+    MCN_FIELD(Pilot_Cmd_Bus, timestamp, MCN_UINT32),
+    MCN_FIELD(Pilot_Cmd_Bus, stick_yaw, MCN_FLOAT),
+    MCN_FIELD(Pilot_Cmd_Bus, stick_throttle, MCN_FLOAT),
+    MCN_FIELD(Pilot_Cmd_Bus, stick_roll, MCN_FLOAT),
+    MCN_FIELD(Pilot_Cmd_Bus, stick_pitch, MCN_FLOAT),
+    MCN_FIELD(Pilot_Cmd_Bus, mode, MCN_UINT32),
+    MCN_FIELD(Pilot_Cmd_Bus, cmd_1, MCN_UINT32),
+    MCN_FIELD(Pilot_Cmd_Bus, cmd_2, MCN_UINT32));
 
 static int echo_rc_channels(void* parameter)
 {
@@ -337,7 +330,9 @@ fmt_err_t pilot_cmd_map_stick(
 fmt_err_t pilot_cmd_init(void)
 {
     /* advertise pilot command topic */
-    FMT_CHECK(mcn_advertise(MCN_HUB(pilot_cmd), echo_pilot_cmd));
+    FMT_CHECK(mcn_set_schema(MCN_HUB(pilot_cmd), MCN_SCHEMA(Pilot_Cmd_Bus)));
+    FMT_CHECK(mcn_advertise(MCN_HUB(pilot_cmd), mcn_schema_echo));
+    FMT_CHECK(mlog_register_bus_schema(MLOG_PILOT_CMD_ID, MCN_SCHEMA(Pilot_Cmd_Bus)));
     FMT_CHECK(mcn_advertise(MCN_HUB(rc_channels), echo_rc_channels));
 
     return FMT_EOK;
@@ -37,6 +37,7 @@ MCN_DECLARE(fms_output);
 
 static mavlink_system_t mavlink_system;
 static McnNode_t fms_out_nod;
+static McnNode_t ins_out_nod;
 
 static uint32_t get_custom_mode(FMS_Out_Bus fms_out)
 {
@@ -206,18 +207,19 @@ static bool mavlink_msg_system_time_cb(mavlink_message_t* msg_t)
 static bool mavlink_msg_attitude_cb(mavlink_message_t* msg_t)
 {
     mavlink_attitude_t attitude;
-    INS_Out_Bus ins_out;
+    const INS_Out_Bus* ins_out = mcn_borrow(MCN_HUB(ins_output), ins_out_nod);
 
-    if (mcn_copy_from_hub(MCN_HUB(ins_output), &ins_out) != FMT_EOK) {
+    if (ins_out == NULL) {
         return false;
     }
 
-    attitude.roll = ins_out.phi;
-    attitude.pitch = ins_out.theta;
-    attitude.yaw = ins_out.psi;
-    attitude.rollspeed = ins_out.p;
-    attitude.pitchspeed = ins_out.q;
-    attitude.yawspeed = ins_out.r;
+    attitude.roll = ins_out->phi;
+    attitude.pitch = ins_out->theta;
+    attitude.yaw = ins_out->psi;
+    attitude.rollspeed = ins_out->p;
+    attitude.pitchspeed = ins_out->q;
+    attitude.yawspeed = ins_out->r;
+    mcn_release(MCN_HUB(ins_output), ins_out);
 
     mavlink_msg_attitude_encode(mavlink_system.sysid, mavlink_system.compid,
         msg_t, &attitude);
@@ -227,34 +229,37 @@ static bool mavlink_msg_attitude_cb(mavlink_message_t* msg_t)
 
 static bool mavlink_msg_local_pos_cb(mavlink_message_t* msg_t)
 {
-    INS_Out_Bus ins_out;
+    const INS_Out_Bus* ins_out = mcn_borrow(MCN_HUB(ins_output), ins_out_nod);
 
-    if (mcn_copy_from_hub(MCN_HUB(ins_output), &ins_out) != FMT_EOK) {
+    if (ins_out == NULL) {
         return false;
     }
 
     mavlink_msg_local_position_ned_pack(
         mavlink_system.sysid, mavlink_system.compid, msg_t, systime_now_ms(),
-        ins_out.x_R, ins_out.y_R, -ins_out.h_R, ins_out.vn, ins_out.ve,
-        ins_out.vd);
+        ins_out->x_R, ins_out->y_R, -ins_out->h_R, ins_out->vn, ins_out->ve,
+        ins_out->vd);
+    mcn_release(MCN_HUB(ins_output), ins_out);
 
     return true;
 }
 
 static bool mavlink_msg_altitude_cb(mavlink_message_t* msg_t)
 {
-    INS_Out_Bus ins_out;
+    const INS_Out_Bus* ins_out;
     baro_data_t baro_report;
 
-    if (mcn_copy_from_hub(MCN_HUB(ins_output), &ins_out) != FMT_EOK) {
+    if (mcn_copy_from_hub(MCN_HUB(sensor_baro), &baro_report) != FMT_EOK) {
         return false;
     }
-    if (mcn_copy_from_hub(MCN_HUB(sensor_baro), &baro_report) != FMT_EOK) {
+    ins_out = mcn_borrow(MCN_HUB(ins_output), ins_out_nod);
+    if (ins_out == NULL) {
         return false;
     }
 
     mavlink_msg_altitude_pack(mavlink_system.sysid, mavlink_system.compid, msg_t, systime_now_ms() * 1e3,
-        baro_report.altitude_m, baro_report.altitude_m, ins_out.h_R, ins_out.h_R, ins_out.h_AGL, 0.0f);
+        baro_report.altitude_m, baro_report.altitude_m, ins_out->h_R, ins_out->h_R, ins_out->h_AGL, 0.0f);
+    mcn_release(MCN_HUB(ins_output), ins_out);
 
     return true;
 }
@@ -327,6 +332,14 @@ fmt_err_t task_comm_init(void)
 
     fms_out_nod = mcn_subscribe(MCN_HUB(fms_output), NULL, NULL);
     FMT_ASSERT(fms_out_nod != NULL);
+    /* fms_output is only checked by heartbeat, no need to be flagged at full rate */
+    mcn_node_throttle(fms_out_nod, 100, 0);
+
+    /* ins_output is borrowed by telemetry, only a few fields of the bus are sent.
+       The node is never polled and the fastest message using it is sent at 10Hz */
+    ins_out_nod = mcn_subscribe(MCN_HUB(ins_output), NULL, NULL);
+    FMT_ASSERT(ins_out_nod != NULL);
+    mcn_node_throttle(ins_out_nod, 100, 0);
 
     return err;
 }
@@ -18,12 +18,14 @@
 #include <string.h>
 
 #include "module/file_manager/file_manager.h"
+#include "module/log/ulog_buffer.h"
 #include "module/task_manager/task_manager.h"
 
-#define TAG               "Logger"
-#define ULOG_FILE_NAME    "ulog.txt"
-#define EVENT_MLOG_UPDATE (1 << 0)
-#define EVENT_ULOG_UPDATE (1 << 1)
+#define TAG                     "Logger"
+#define ULOG_FILE_NAME          "ulog.txt"
+#define MLOG_RECOVERY_FILE_NAME "mlog_recovery.bin"
+#define EVENT_MLOG_UPDATE       (1 << 0)
+#define EVENT_ULOG_UPDATE       (1 << 1)
 
 static struct rt_event _log_event;
 
@@ -36,11 +38,49 @@ static void ulog_console_backend_output(struct ulog_backend* backend, rt_uint32_
 #endif /* ENABLE_ULOG_CONSOLE_BACKEND */
 
 #ifdef ENABLE_ULOG_FS_BACKEND
+/* log lines are buffered and written by logger thread in aligned chunks, so a
+ * burst of log doesn't turn into lots of small writes into storage */
+#define ULOG_FS_BUFFER_SIZE   8192
+#define ULOG_FS_CHUNK_SIZE    512
+#define ULOG_FS_FLUSH_TIMEOUT 1000
+
 static int _ulog_fd = -1;
+static ulog_buffer_t _ulog_fs_buffer;
+static uint8_t _ulog_fs_buffer_data[ULOG_FS_BUFFER_SIZE];
+
+static int32_t ulog_fs_write(void* ctx, const void* buf, uint32_t len)
+{
+    return _ulog_fd >= 0 ? write(_ulog_fd, buf, len) : -1;
+}
+
+static void ulog_fs_lock(void* ctx)
+{
+    OS_ENTER_CRITICAL;
+}
+
+static void ulog_fs_unlock(void* ctx)
+{
+    OS_EXIT_CRITICAL;
+}
+
+static const ulog_buffer_io_t ulog_fs_io = {
+    .write = ulog_fs_write,
+    .lock = ulog_fs_lock,
+    .unlock = ulog_fs_unlock,
+    .ctx = NULL
+};
+
 static void ulog_fs_backend_init(struct ulog_backend* backend)
 {
     char file_name[50];
     char log_session[50];
+    ulog_buffer_config_t config = {
+        .size = ULOG_FS_BUFFER_SIZE,
+        .chunk = ULOG_FS_CHUNK_SIZE,
+        .timeout = ULOG_FS_FLUSH_TIMEOUT
+    };
+
+    ulog_buffer_init(&_ulog_fs_buffer, &config, &ulog_fs_io, _ulog_fs_buffer_data);
 
     if (current_log_session(log_session) == FMT_EOK) {
         sprintf(file_name, "%s/%s", log_session, ULOG_FILE_NAME);
@@ -57,17 +97,46 @@ static void ulog_fs_backend_output(struct ulog_backend* backend, rt_uint32_t lev
     const char* log, size_t len)
 {
     if (_ulog_fd >= 0) {
-        write(_ulog_fd, log, len);
+        ulog_buffer_append(&_ulog_fs_buffer, log, len);
+    }
+}
+
+static void ulog_fs_backend_flush(struct ulog_backend* backend)
+{
+    if (_ulog_fd >= 0) {
+        ulog_buffer_sync(&_ulog_fs_buffer);
+        fsync(_ulog_fd);
     }
 }
 
 static void ulog_fs_backend_deinit(struct ulog_backend* backend)
 {
     if (_ulog_fd >= 0) {
+        ulog_buffer_sync(&_ulog_fs_buffer);
         close(_ulog_fd);
         _ulog_fd = -1;
     }
 }
+
+/* write buffered log if a chunk is filled or the timeout is reached */
+static void ulog_fs_output(void)
+{
+    static uint32_t drop_line = 0;
+
+    if (_ulog_fd < 0) {
+        return;
+    }
+
+    if (ulog_buffer_flush(&_ulog_fs_buffer, systime_now_ms())) {
+        fsync(_ulog_fd);
+    }
+
+    if (_ulog_fs_buffer.stat.drop_line != drop_line) {
+        drop_line = _ulog_fs_buffer.stat.drop_line;
+        console_printf("ulog fs buffer full, line dropped:%d byte dropped:%d\n", _ulog_fs_buffer.stat.drop_line,
+            _ulog_fs_buffer.stat.drop_byte);
+    }
+}
 #endif /* ENABLE_ULOG_FS_BACKEND */
 
 static void mlog_update_cb(void)
@@ -120,6 +189,9 @@ fmt_err_t task_logger_init(void)
     /* init ulog */
     ulog_init();
 
+    /* init uMCN traffic recorder */
+    mcn_record_init();
+
 #ifdef ENABLE_ULOG_CONSOLE_BACKEND
     static struct ulog_backend console;
     /* register ulog console backend */
@@ -132,10 +204,21 @@ fmt_err_t task_logger_init(void)
     /* register ulog filesystem backend */
     fs.init = ulog_fs_backend_init;
     fs.output = ulog_fs_backend_output;
+    fs.flush = ulog_fs_backend_flush;
     fs.deinit = ulog_fs_backend_deinit;
     ulog_backend_register(&fs, "filesystem", RT_FALSE);
 #endif
 
+#ifdef FMT_USING_MLOG_PERSIST
+    char recovery_name[100];
+
+    /* save log data left in buffer by last reset before it's overwritten */
+    if (current_log_session(recovery_name) == FMT_EOK) {
+        strcat(recovery_name, "/" MLOG_RECOVERY_FILE_NAME);
+        mlog_recover(recovery_name);
+    }
+#endif
+
     if (PARAM_GET_INT32(SYSTEM, MLOG_MODE) == 2 || PARAM_GET_INT32(SYSTEM, MLOG_MODE) == 3) {
         logger_start_mlog(NULL);
     }
@@ -169,13 +252,17 @@ void task_logger_entry(void* parameter)
             /* if timeout, check if there are log data need to send */
             mlog_async_output();
             ulog_async_output();
-
-#ifdef ENABLE_ULOG_FS_BACKEND
-            fsync(_ulog_fd);
-#endif
         } else {
             /* some other error happen */
         }
+
+#ifdef ENABLE_ULOG_FS_BACKEND
+        /* logger may be kept busy by mlog, so flush is checked on every loop */
+        ulog_fs_output();
+#endif
+
+        /* write recorded uMCN traffic if recording */
+        mcn_record_async_output();
     }
 }
 
@@ -184,9 +184,13 @@ fmt_err_t task_status_init(void)
 {
     fms_out_nod = mcn_subscribe(MCN_HUB(fms_output), NULL, NULL);
     RT_ASSERT(fms_out_nod != NULL);
+    /* status is polled every 10ms, faster publishes are never seen */
+    mcn_node_throttle(fms_out_nod, 10, 0);
 
     ins_out_nod = mcn_subscribe(MCN_HUB(ins_output), NULL, NULL);
     RT_ASSERT(ins_out_nod != NULL);
+    /* ins status is not checked yet, see update_ins_status() */
+    mcn_node_throttle(ins_out_nod, 100, 0);
 
     pilot_cmd_nod = mcn_subscribe(MCN_HUB(pilot_cmd), NULL, NULL);
     RT_ASSERT(pilot_cmd_nod != NULL);
@@ -14,6 +14,7 @@
  * limitations under the License.
  *****************************************************************************/
 
+#include <dfs_posix.h>
 #include <firmament.h>
 
 #include "module/control/control_interface.h"
@@ -27,8 +28,15 @@
 #include "module/sysio/pilot_cmd.h"
 #include "module/task_manager/task_manager.h"
 #include "task/task_logger.h"
+#include "task/task_vehicle.h"
 
 #define EVENT_VEHICLE_UPDATE (1 << 0)
+#define EVENT_VEHICLE_REPLAY (1 << 1)
+
+/* steps replayed before checking the log buffer */
+#define REPLAY_BATCH_STEP 10
+/* free sectors of log buffer to replay next batch, so regenerated msgs are not dropped */
+#define REPLAY_MIN_FREE_SECTOR 2
 
 extern rt_device_t main_out_dev;
 extern rt_device_t aux_out_dev;
@@ -36,11 +44,207 @@ extern rt_device_t aux_out_dev;
 static struct rt_timer timer_vehicle;
 static struct rt_event event_vehicle;
 
+/* model input buses replayed, matched by bus name in log */
+static const struct {
+    const char* name;
+    uint8_t msg_id;
+} replay_input_bus[] = {
+    { "IMU", MLOG_IMU_ID },
+    { "MAG", MLOG_MAG_ID },
+    { "Barometer", MLOG_BARO_ID },
+    { "GPS_uBlox", MLOG_GPS_ID },
+    { "Rangefinder", MLOG_RANGEFINDER_ID },
+    { "Optical_Flow", MLOG_OPTICAL_FLOW_ID },
+    { "Pilot_Cmd", MLOG_PILOT_CMD_ID },
+    { "GCS_Cmd", MLOG_GCS_CMD_ID },
+};
+
+static struct {
+    uint8_t busy;
+    const char* log_file;
+    char* out_file;
+    vehicle_replay_stat_t* stat;
+    fmt_err_t result;
+    struct rt_semaphore done;
+    /* replay context */
+    int fd;
+    uint8_t bus_map[256]; /* msg id in log -> msg id of this firmware */
+    uint8_t started;
+    TimeTag ins_tag;
+    TimeTag fms_tag;
+    TimeTag control_tag;
+} replay;
+
 static void timer_vehicle_update(void* parameter)
 {
     rt_event_send(&event_vehicle, EVENT_VEHICLE_UPDATE);
 }
 
+static int32_t replay_read(void* ctx, void* buf, uint32_t len)
+{
+    return read(replay.fd, buf, len);
+}
+
+static void replay_input(void* ctx, uint8_t msg_id, const uint8_t* payload, uint16_t len)
+{
+    fmt_err_t err = ins_interface_replay_input(replay.bus_map[msg_id], payload, len);
+
+    if (err == FMT_ENOTHANDLE) {
+        err = fms_interface_replay_input(replay.bus_map[msg_id], payload, len);
+    }
+    if (err != FMT_EOK) {
+        replay.stat->mismatch++;
+    }
+}
+
+/* models are run in the same order and periods as vehicle loop */
+static void replay_step(void* ctx, uint32_t timestamp)
+{
+    if (!replay.started) {
+        replay.started = 1;
+        /* all models are run at the first step */
+        replay.ins_tag.tag = timestamp - ins_model_info.period;
+        replay.fms_tag.tag = timestamp - fms_model_info.period;
+        replay.control_tag.tag = timestamp - control_model_info.period;
+    }
+
+    if (check_timetag3(&replay.ins_tag, timestamp, ins_model_info.period)) {
+        ins_interface_replay_step();
+    }
+    if (check_timetag3(&replay.fms_tag, timestamp, fms_model_info.period)) {
+        fms_interface_replay_step();
+    }
+    if (check_timetag3(&replay.control_tag, timestamp, control_model_info.period)) {
+        control_interface_step(timestamp);
+    }
+}
+
+static const mlog_replay_io_t replay_io = {
+    .read = replay_read,
+    .input = replay_input,
+    .step = replay_step,
+    .ctx = NULL
+};
+
+static fmt_err_t replay_run(mlog_replay_t* log)
+{
+    const mlog_profile_t* profile = mlog_get_profile();
+    uint64_t start;
+    int more;
+    int id;
+
+    if (mlog_replay_open(log, &replay_io) < 0) {
+        return FMT_EINVAL;
+    }
+
+    memset(replay.bus_map, 0, sizeof(replay.bus_map));
+    for (uint8_t i = 0; i < sizeof(replay_input_bus) / sizeof(replay_input_bus[0]); i++) {
+        id = mlog_replay_find_bus(log, replay_input_bus[i].name, NULL);
+        if (id >= 0) {
+            replay.bus_map[id] = replay_input_bus[i].msg_id;
+            mlog_replay_set_input(log, id);
+        }
+    }
+
+    if (mlog_start(replay.out_file) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+    /* regenerated outputs are logged at full rate, the log rate of profile goes by system time.
+     * Parameter MLOG_PROFILE is not changed, the profile is only used by this session */
+    mlog_apply_profile("full");
+
+    ins_interface_reset();
+    fms_interface_reset();
+    control_interface_reset();
+    replay.started = 0;
+
+    start = systime_now_us();
+    do {
+        more = mlog_replay_run(log, REPLAY_BATCH_STEP);
+        /* let logger write the log buffer */
+        while (mlog_get_free_sector() < REPLAY_MIN_FREE_SECTOR) {
+            sys_msleep(1);
+        }
+    } while (more);
+    replay.stat->duration_ms = (systime_now_us() - start) / 1000;
+    replay.stat->log = log->stat;
+
+    mlog_stop();
+    if (profile) {
+        mlog_apply_profile(profile->name);
+    }
+
+    /* back to live data */
+    ins_interface_reset();
+    fms_interface_reset();
+    control_interface_reset();
+
+    return FMT_EOK;
+}
+
+static void replay_handle(void)
+{
+    mlog_replay_t* log;
+
+    memset(replay.stat, 0, sizeof(vehicle_replay_stat_t));
+
+    /* models are stepped by log, vehicle must not fly */
+    if (FMS_Y.FMS_Out.status != VehicleStatus_Disarm || mlog_get_status() != MLOG_STATUS_IDLE) {
+        replay.result = FMT_EBUSY;
+        return;
+    }
+
+    log = rt_malloc(sizeof(mlog_replay_t));
+    if (log == NULL) {
+        replay.result = FMT_ENOMEM;
+        return;
+    }
+
+    replay.fd = open(replay.log_file, O_RDONLY);
+    if (replay.fd < 0) {
+        replay.result = FMT_ENOTHANDLE;
+    } else {
+        replay.result = replay_run(log);
+        close(replay.fd);
+    }
+
+    rt_free(log);
+}
+
+/**
+ * Replay model inputs of a log and write the regenerated log
+ * @note The vehicle loop is paused during the replay, which runs in vehicle
+ * task as fast as the models can be stepped. Vehicle must be disarmed and
+ * logging must be stopped.
+ *
+ * @param log_file log to replay
+ * @param out_file log to write, which has the replayed inputs and model outputs
+ * @param stat replay statistics
+ *
+ * @return FMT Errors
+ */
+fmt_err_t vehicle_replay_mlog(const char* log_file, char* out_file, vehicle_replay_stat_t* stat)
+{
+    OS_ENTER_CRITICAL;
+    if (replay.busy) {
+        OS_EXIT_CRITICAL;
+        return FMT_EBUSY;
+    }
+    replay.busy = 1;
+    OS_EXIT_CRITICAL;
+
+    replay.log_file = log_file;
+    replay.out_file = out_file;
+    replay.stat = stat;
+
+    rt_event_send(&event_vehicle, EVENT_VEHICLE_REPLAY);
+    rt_sem_take(&replay.done, RT_WAITING_FOREVER);
+
+    replay.busy = 0;
+
+    return replay.result;
+}
+
 void task_vehicle_entry(void* parameter)
 {
     static uint32_t time_start = 0;
@@ -48,7 +252,7 @@ void task_vehicle_entry(void* parameter)
     uint32_t timestamp;
     rt_err_t res;
     rt_uint32_t recv_set = 0;
-    uint32_t wait_set = EVENT_VEHICLE_UPDATE;
+    uint32_t wait_set = EVENT_VEHICLE_UPDATE | EVENT_VEHICLE_REPLAY;
 
     while (1) {
         res = rt_event_recv(&event_vehicle, wait_set, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
@@ -89,6 +293,11 @@ void task_vehicle_entry(void* parameter)
                 send_hil_actuator_cmd();
 #endif
             }
+
+            if (recv_set & EVENT_VEHICLE_REPLAY) {
+                replay_handle();
+                rt_sem_release(&replay.done);
+            }
         }
     }
 }
@@ -114,6 +323,10 @@ fmt_err_t task_vehicle_init(void)
         return FMT_ERROR;
     }
 
+    if (rt_sem_init(&replay.done, "replay", 0, RT_IPC_FLAG_FIFO) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
     /* register timer event */
     rt_timer_init(&timer_vehicle, "vehicle",
         timer_vehicle_update,
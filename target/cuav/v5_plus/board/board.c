@@ -422,6 +422,9 @@ void bsp_initialize(void)
     /* ist8310 and ncp5623c are on gps module and possibly it is not connected */
     drv_ncp5623c_init("i2c1_dev2");
 
+    /* init sensor hub before sensors are registered */
+    FMT_CHECK(sensor_hub_init());
+
 #if defined(FMT_USING_SIH) || defined(FMT_USING_HIL)
     FMT_CHECK(advertise_sensor_imu(0));
     FMT_CHECK(advertise_sensor_mag(0));
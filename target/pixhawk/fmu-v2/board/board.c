@@ -324,6 +324,9 @@ void bsp_initialize(void)
     /* init other devices */
     RT_CHECK(tca62724_drv_init("i2c2"));
 
+    /* init sensor hub before sensors are registered */
+    FMT_CHECK(sensor_hub_init());
+
     /* register sensor to sensor hub */
 #if defined(FMT_USING_SIH) || defined(FMT_USING_HIL)
     FMT_CHECK(advertise_sensor_imu(0));
@@ -255,6 +255,9 @@ void bsp_initialize(void)
     /* init parameter system */
     FMT_CHECK(param_init());
 
+    /* init sensor hub before sensors are registered */
+    FMT_CHECK(sensor_hub_init());
+
 #if defined(FMT_USING_SIH) || defined(FMT_USING_HIL)
     FMT_CHECK(advertise_sensor_imu(0));
     FMT_CHECK(advertise_sensor_mag(0));
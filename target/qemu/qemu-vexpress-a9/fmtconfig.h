@@ -32,10 +32,19 @@
 /* Send out pilot cmd via mavlink */
 #define FMT_OUTPUT_PILOT_CMD
 
+/* uMCN: allocate topics and nodes from static storage */
+#define FMT_USING_MCN_STATIC
+/* unit test topics are included, registry size is checked by link.lds */
+#define MCN_STATIC_REGISTRY_SIZE 512
+
 /* MLog */
 #define MLOG_BUFFER_SIZE         80 * 1024
 #define MLOG_SECTOR_SIZE         4096
 #define MLOG_MAX_SECTOR_TO_WRITE 5
+/* compress log sectors before they are written into storage */
+// #define FMT_USING_MLOG_COMPRESS
+/* keep log buffer in no-init RAM, which is recovered into file after reset */
+// #define FMT_USING_MLOG_PERSIST
 
 /* ULog */
 #define FMT_USING_ULOG
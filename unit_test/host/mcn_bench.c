@@ -0,0 +1,632 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Host-native micro benchmark of uMCN hot path. Results are printed as CSV:
+ * case,size,subscribers,threads,iterations,ns_per_op
+ * For replay_realtime, ns_per_op is the mean timing error of replayed publishes.
+ * For lookup cases, subscribers is the number of topics advertised. */
+
+#include <firmament.h>
+#include "module/ipc/mcn_record.h"
+#include "module/ipc/mcn_schema.h"
+#include "module/ipc/mcn_shm.h"
+#include <sched.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_SIZE 2048
+#define BENCH_MAX_SUBS 30
+#define BENCH_MAX_READERS 4
+#define BENCH_CAPTURE     "mcn_bench.rec"
+#define BENCH_SHM         "/mcn_bench"
+/* publishes between two record outputs, as logger task does periodically */
+#define BENCH_RECORD_OUTPUT_PERIOD 32
+#define BENCH_RECORD_BUFFER_SIZE   (256 * 1024)
+/* samples and publish interval (us) of the capture for realtime replay */
+#define BENCH_REALTIME_NUM      500
+#define BENCH_REALTIME_INTERVAL 1000
+
+MCN_DEFINE(bench_16, 16);
+MCN_DEFINE(bench_64, 64);
+MCN_DEFINE(bench_256, 256);
+MCN_DEFINE(bench_1024, 1024);
+MCN_DEFINE(bench_2048, 2048);
+
+/* typical sensor topic, which has padding before lat */
+typedef struct {
+    uint32_t timestamp;
+    float gyr[3];
+    float acc[3];
+    uint8_t valid;
+    double lat;
+    double lon;
+    float alt;
+    uint16_t status;
+} bench_sample_t;
+
+MCN_DEFINE(bench_schema, sizeof(bench_sample_t));
+
+MCN_SCHEMA_DEFINE(bench_sample_t,
+    MCN_FIELD(bench_sample_t, timestamp, MCN_UINT32),
+    MCN_FIELD_VEC(bench_sample_t, gyr, MCN_FLOAT),
+    MCN_FIELD_VEC(bench_sample_t, acc, MCN_FLOAT),
+    MCN_FIELD(bench_sample_t, valid, MCN_UINT8),
+    MCN_FIELD(bench_sample_t, lat, MCN_DOUBLE),
+    MCN_FIELD(bench_sample_t, lon, MCN_DOUBLE),
+    MCN_FIELD(bench_sample_t, alt, MCN_FLOAT),
+    MCN_FIELD(bench_sample_t, status, MCN_UINT16));
+
+/* extra topics to benchmark topic lookup with 100+ topics */
+#define BENCH_TOPIC_DEFINE_8(_p) \
+    MCN_DEFINE(_p##_0, 4);       \
+    MCN_DEFINE(_p##_1, 4);       \
+    MCN_DEFINE(_p##_2, 4);       \
+    MCN_DEFINE(_p##_3, 4);       \
+    MCN_DEFINE(_p##_4, 4);       \
+    MCN_DEFINE(_p##_5, 4);       \
+    MCN_DEFINE(_p##_6, 4);       \
+    MCN_DEFINE(_p##_7, 4)
+#define BENCH_TOPIC_HUB_8(_p)                                                          \
+    MCN_HUB(_p##_0), MCN_HUB(_p##_1), MCN_HUB(_p##_2), MCN_HUB(_p##_3), MCN_HUB(_p##_4), \
+        MCN_HUB(_p##_5), MCN_HUB(_p##_6), MCN_HUB(_p##_7)
+#define BENCH_TOPIC_DEFINE_64(_p)      \
+    BENCH_TOPIC_DEFINE_8(_p##_a);      \
+    BENCH_TOPIC_DEFINE_8(_p##_b);      \
+    BENCH_TOPIC_DEFINE_8(_p##_c);      \
+    BENCH_TOPIC_DEFINE_8(_p##_d);      \
+    BENCH_TOPIC_DEFINE_8(_p##_e);      \
+    BENCH_TOPIC_DEFINE_8(_p##_f);      \
+    BENCH_TOPIC_DEFINE_8(_p##_g);      \
+    BENCH_TOPIC_DEFINE_8(_p##_h)
+#define BENCH_TOPIC_HUB_64(_p)                                                   \
+    BENCH_TOPIC_HUB_8(_p##_a), BENCH_TOPIC_HUB_8(_p##_b), BENCH_TOPIC_HUB_8(_p##_c), \
+        BENCH_TOPIC_HUB_8(_p##_d), BENCH_TOPIC_HUB_8(_p##_e), BENCH_TOPIC_HUB_8(_p##_f), \
+        BENCH_TOPIC_HUB_8(_p##_g), BENCH_TOPIC_HUB_8(_p##_h)
+
+BENCH_TOPIC_DEFINE_64(bench_reg_x);
+BENCH_TOPIC_DEFINE_64(bench_reg_y);
+
+static McnHub_t lookup_hubs[] = {
+    BENCH_TOPIC_HUB_64(bench_reg_x),
+    BENCH_TOPIC_HUB_64(bench_reg_y),
+};
+
+static McnHub_t bench_hubs[] = {
+    MCN_HUB(bench_16),
+    MCN_HUB(bench_64),
+    MCN_HUB(bench_256),
+    MCN_HUB(bench_1024),
+    MCN_HUB(bench_2048),
+};
+static const uint32_t bench_subs[] = { 1, 2, 4, 8, 16, 30 };
+static const uint32_t bench_readers[] = { 1, 2, 4 };
+
+static uint32_t iterations = 100000;
+static uint32_t torn_reads;
+static uint32_t lookup_miss;
+static uint32_t format_mismatch;
+static volatile int readers_run;
+
+struct reader {
+    pthread_t tid;
+    McnHub_t hub;
+    McnNode_t node;
+    volatile uint64_t ops;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char* name, McnHub_t hub, uint32_t subs, uint32_t threads, uint64_t ops, uint64_t ns)
+{
+    printf("%s,%u,%u,%u,%llu,%.1f\n", name, (unsigned)hub->obj_size, subs, threads, (unsigned long long)ops,
+           ops ? (double)ns / ops : 0.0);
+}
+
+static void bench_publish(McnHub_t hub, uint32_t subs)
+{
+    static uint8_t data[BENCH_MAX_SIZE];
+    McnNode_t nodes[BENCH_MAX_SUBS];
+    uint64_t start;
+
+    for (uint32_t i = 0; i < subs; i++) {
+        nodes[i] = mcn_subscribe(hub, NULL, NULL);
+    }
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data[0] = (uint8_t)i;
+        mcn_publish(hub, data);
+    }
+    report("publish", hub, subs, 1, iterations, now_ns() - start);
+
+    for (uint32_t i = 0; i < subs; i++) {
+        mcn_unsubscribe(hub, nodes[i]);
+    }
+}
+
+static void bench_copy_poll(McnHub_t hub)
+{
+    static uint8_t data[BENCH_MAX_SIZE];
+    McnNode_t node = mcn_subscribe(hub, NULL, NULL);
+    volatile bool updated = false;
+    uint64_t start;
+
+    mcn_publish(hub, data);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        mcn_copy(hub, node, data);
+    }
+    report("copy", hub, 1, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        updated = mcn_poll(node);
+    }
+    (void)updated;
+    report("poll", hub, 1, 1, iterations, now_ns() - start);
+
+    mcn_unsubscribe(hub, node);
+}
+
+static void* reader_entry(void* parameter)
+{
+    struct reader* reader = (struct reader*)parameter;
+    uint8_t data[BENCH_MAX_SIZE];
+
+    while (readers_run) {
+        mcn_copy(reader->hub, reader->node, data);
+        reader->ops++;
+    }
+
+    return NULL;
+}
+
+static void bench_contention(McnHub_t hub, uint32_t readers_num)
+{
+    static uint8_t data[BENCH_MAX_SIZE];
+    struct reader readers[BENCH_MAX_READERS];
+    uint64_t start, publish_ns, copy_ops = 0;
+    uint64_t base_ops[BENCH_MAX_READERS];
+
+    mcn_publish(hub, data);
+
+    readers_run = 1;
+    for (uint32_t i = 0; i < readers_num; i++) {
+        readers[i].hub = hub;
+        readers[i].node = mcn_subscribe(hub, NULL, NULL);
+        readers[i].ops = 0;
+        pthread_create(&readers[i].tid, NULL, reader_entry, &readers[i]);
+    }
+    /* wait until all readers are running */
+    for (uint32_t i = 0; i < readers_num; i++) {
+        while (readers[i].ops == 0) {
+            sched_yield();
+        }
+    }
+    for (uint32_t i = 0; i < readers_num; i++) {
+        base_ops[i] = readers[i].ops;
+    }
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data[0] = (uint8_t)i;
+        mcn_publish(hub, data);
+    }
+    publish_ns = now_ns() - start;
+    for (uint32_t i = 0; i < readers_num; i++) {
+        copy_ops += readers[i].ops - base_ops[i];
+    }
+    readers_run = 0;
+
+    for (uint32_t i = 0; i < readers_num; i++) {
+        pthread_join(readers[i].tid, NULL);
+        mcn_unsubscribe(hub, readers[i].node);
+    }
+
+    report("publish_contended", hub, readers_num, readers_num + 1, iterations, publish_ns);
+    /* readers run in parallel, so ns/op is the time of one reader per copy */
+    report("copy_contended", hub, readers_num, readers_num + 1, copy_ops, publish_ns * readers_num);
+}
+
+static void bench_record_replay(McnHub_t hub)
+{
+    static uint8_t data[BENCH_MAX_SIZE];
+    McnRecordStats record_stats;
+    McnReplayStats replay_stats;
+    uint64_t start;
+
+    mcn_record_topic(hub, true);
+    if (mcn_record_start(BENCH_CAPTURE, BENCH_RECORD_BUFFER_SIZE) != FMT_EOK) {
+        fprintf(stderr, "record start fail\n");
+        return;
+    }
+
+    /* file output is included, which is the end-to-end cost of recording */
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data[0] = (uint8_t)i;
+        mcn_publish(hub, data);
+        if (i % BENCH_RECORD_OUTPUT_PERIOD == 0) {
+            mcn_record_async_output();
+        }
+    }
+    mcn_record_stop();
+    report("publish_record", hub, 0, 1, iterations, now_ns() - start);
+
+    mcn_record_get_stats(&record_stats);
+    if (record_stats.drop_cnt) {
+        fprintf(stderr, "%s: %u records dropped\n", hub->obj_name, (unsigned)record_stats.drop_cnt);
+    }
+
+    start = now_ns();
+    if (mcn_replay(BENCH_CAPTURE, MCN_REPLAY_FAST, &replay_stats) == FMT_EOK) {
+        report("replay", hub, 0, 1, replay_stats.replay_cnt, now_ns() - start);
+    }
+
+    /* capture with fixed publish interval to measure realtime replay timing */
+    mcn_record_start(BENCH_CAPTURE, BENCH_RECORD_BUFFER_SIZE);
+    for (uint32_t i = 0; i < BENCH_REALTIME_NUM; i++) {
+        mcn_publish(hub, data);
+        mcn_record_async_output();
+        usleep(BENCH_REALTIME_INTERVAL);
+    }
+    mcn_record_stop();
+    mcn_record_topic(hub, false);
+
+    if (mcn_replay(BENCH_CAPTURE, MCN_REPLAY_REALTIME, &replay_stats) == FMT_EOK) {
+        report("replay_realtime", hub, 0, 1, replay_stats.error.count, replay_stats.error.sum * 1000);
+        fprintf(stderr, "%s: realtime replay error p99 %u max %u (us), capture %u ms, replay %u ms\n",
+                hub->obj_name, (unsigned)mcn_hist_percentile(&replay_stats.error, 99),
+                (unsigned)replay_stats.error.max, (unsigned)replay_stats.capture_ms,
+                (unsigned)replay_stats.duration_ms);
+    }
+
+    unlink(BENCH_CAPTURE);
+}
+
+/* reader process of shared memory mirror, sample is valid if all bytes are the same */
+static void shm_reader_process(const char* topic_name, int result_fd)
+{
+    McnShmClient client;
+    const McnShmTopic* topic;
+    uint8_t data[BENCH_MAX_SIZE];
+    uint64_t result[2] = { 0, 0 }; /* ns, torn reads */
+    uint64_t start;
+
+    if (mcn_shm_client_open(&client, BENCH_SHM) != 0 || (topic = mcn_shm_client_find(&client, topic_name)) == NULL) {
+        _exit(EXIT_FAILURE);
+    }
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (mcn_shm_client_read(&client, topic, data, NULL, NULL) == 0) {
+            for (uint32_t k = 1; k < topic->size; k++) {
+                if (data[k] != data[0]) {
+                    result[1]++;
+                    break;
+                }
+            }
+        }
+    }
+    result[0] = now_ns() - start;
+
+    mcn_shm_client_close(&client);
+    _exit(write(result_fd, result, sizeof(result)) == sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static void bench_shm(McnHub_t hub)
+{
+    static uint8_t data[BENCH_MAX_SIZE];
+    uint64_t start;
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        memset(data, (uint8_t)i, hub->obj_size);
+        mcn_publish(hub, data);
+    }
+    report("publish_shm_base", hub, 0, 1, iterations, now_ns() - start);
+
+    if (mcn_shm_start(BENCH_SHM, &hub, 1) != FMT_EOK) {
+        fprintf(stderr, "shm start fail\n");
+        return;
+    }
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        memset(data, (uint8_t)i, hub->obj_size);
+        mcn_publish(hub, data);
+    }
+    report("publish_shm", hub, 0, 1, iterations, now_ns() - start);
+
+    for (uint32_t j = 0; j < sizeof(bench_readers) / sizeof(uint32_t); j++) {
+        uint32_t readers_num = bench_readers[j];
+        uint32_t running = readers_num, publish_cnt = 0;
+        uint64_t read_ns = 0, torn = 0, result[2];
+        int fd[2];
+
+        if (pipe(fd) < 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < readers_num; i++) {
+            if (fork() == 0) {
+                close(fd[0]);
+                shm_reader_process(hub->obj_name, fd[1]);
+            }
+        }
+        close(fd[1]);
+
+        /* keep publishing until all readers exit */
+        start = now_ns();
+        while (running) {
+            memset(data, (uint8_t)publish_cnt, hub->obj_size);
+            mcn_publish(hub, data);
+            if (++publish_cnt % 64 == 0) {
+                while (running && waitpid(-1, NULL, WNOHANG) > 0) {
+                    running--;
+                }
+            }
+        }
+        report("publish_shm_contended", hub, readers_num, readers_num + 1, publish_cnt, now_ns() - start);
+
+        while (read(fd[0], result, sizeof(result)) == sizeof(result)) {
+            read_ns += result[0];
+            torn += result[1];
+        }
+        close(fd[0]);
+        /* readers run in parallel, so ns/op is the time of one reader per read */
+        report("shm_read", hub, readers_num, readers_num + 1, (uint64_t)iterations * readers_num, read_ns);
+        if (torn) {
+            fprintf(stderr, "%s: %u torn reads with %u readers\n", hub->obj_name, (unsigned)torn,
+                    (unsigned)readers_num);
+            torn_reads += torn;
+        }
+    }
+
+    mcn_shm_stop();
+}
+
+/* topic lookup by walking the topic list, as it was done before the registry */
+static McnHub_t find_in_list(const char* name)
+{
+    McnList_t ite = mcn_get_list();
+
+    for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+        if (strcmp(hub->obj_name, name) == 0) {
+            return hub;
+        }
+    }
+
+    return NULL;
+}
+
+static void bench_lookup(void)
+{
+    uint32_t hub_num = sizeof(lookup_hubs) / sizeof(McnHub_t);
+    uint32_t topic_num = 0;
+    uint32_t miss = 0;
+    uint64_t start;
+
+    /* only advertised topics are in the list */
+    for (uint32_t i = 0; i < hub_num; i++) {
+        if (mcn_advertise(lookup_hubs[i], NULL) != FMT_EOK) {
+            fprintf(stderr, "advertise %s fail\n", lookup_hubs[i]->obj_name);
+            lookup_miss++;
+            return;
+        }
+    }
+    McnList_t ite = mcn_get_list();
+    while (mcn_iterate(&ite) != NULL) {
+        topic_num++;
+    }
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        miss += find_in_list(lookup_hubs[i % hub_num]->obj_name) != lookup_hubs[i % hub_num];
+    }
+    report("lookup_list", lookup_hubs[0], topic_num, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        miss += mcn_find(lookup_hubs[i % hub_num]->obj_name) != lookup_hubs[i % hub_num];
+    }
+    report("lookup_find", lookup_hubs[0], topic_num, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        miss += mcn_find_by_id(lookup_hubs[i % hub_num]->id) != lookup_hubs[i % hub_num];
+    }
+    report("lookup_find_by_id", lookup_hubs[0], topic_num, 1, iterations, now_ns() - start);
+
+    if (miss) {
+        fprintf(stderr, "%u topic lookups fail\n", (unsigned)miss);
+        lookup_miss += miss;
+    }
+}
+
+/* handwritten serializers, as echo functions and mlog element tables used to be.
+ * They are not inlined, as the schema serializers are called through the schema */
+static __attribute__((noinline)) uint32_t hand_pack(const bench_sample_t* data, uint8_t* buffer)
+{
+    uint32_t len = 0;
+
+    memcpy(&buffer[len], &data->timestamp, sizeof(data->timestamp));
+    len += sizeof(data->timestamp);
+    memcpy(&buffer[len], data->gyr, sizeof(data->gyr));
+    len += sizeof(data->gyr);
+    memcpy(&buffer[len], data->acc, sizeof(data->acc));
+    len += sizeof(data->acc);
+    memcpy(&buffer[len], &data->valid, sizeof(data->valid));
+    len += sizeof(data->valid);
+    memcpy(&buffer[len], &data->lat, sizeof(data->lat));
+    len += sizeof(data->lat);
+    memcpy(&buffer[len], &data->lon, sizeof(data->lon));
+    len += sizeof(data->lon);
+    memcpy(&buffer[len], &data->alt, sizeof(data->alt));
+    len += sizeof(data->alt);
+    memcpy(&buffer[len], &data->status, sizeof(data->status));
+    len += sizeof(data->status);
+
+    return len;
+}
+
+static __attribute__((noinline)) int hand_format(const bench_sample_t* data, char* buffer, uint32_t size)
+{
+    return snprintf(buffer, size, "timestamp:%u gyr:%f %f %f acc:%f %f %f valid:%u lat:%lf lon:%lf alt:%f status:%u\n",
+                    data->timestamp, data->gyr[0], data->gyr[1], data->gyr[2], data->acc[0], data->acc[1],
+                    data->acc[2], data->valid, data->lat, data->lon, data->alt, data->status);
+}
+
+static float random_value(void)
+{
+    /* covers values rounded at the 6th decimal, large ones and negative zero */
+    static const float scale[] = { 1e-7f, 1e-3f, 1.0f, 1e3f, 1e9f, 1e12f, -0.0f };
+
+    return (float)(rand() - RAND_MAX / 2) / RAND_MAX * scale[rand() % 7];
+}
+
+/* text of schema_format should be the same as the one of snprintf() */
+static void check_schema_format(McnHub_t hub)
+{
+    char text[MCN_SCHEMA_TEXT_SIZE], hand_text[MCN_SCHEMA_TEXT_SIZE];
+    bench_sample_t data;
+
+    srand(1);
+    for (uint32_t i = 0; i < 100000; i++) {
+        data.timestamp = rand();
+        for (int k = 0; k < 3; k++) {
+            data.gyr[k] = random_value();
+            data.acc[k] = random_value();
+        }
+        data.valid = rand();
+        data.lat = random_value() * (double)rand();
+        data.lon = (double)random_value() / 3;
+        data.alt = (rand() % 2000000 - 1000000) / 1e6f + rand() % 100;
+        data.status = rand();
+
+        mcn_schema_format(hub->schema, &data, text, sizeof(text));
+        hand_format(&data, hand_text, sizeof(hand_text));
+        if (strcmp(text, hand_text)) {
+            if (format_mismatch++ == 0) {
+                fprintf(stderr, "format mismatch:\n%s%s", text, hand_text);
+            }
+        }
+    }
+}
+
+static void bench_schema_serialize(McnHub_t hub)
+{
+    bench_sample_t data = { 1000, { 0.1f, 0.2f, 0.3f }, { 0.0f, 0.0f, -9.8f }, 1, 0.5, 0.25, 10.0f, 3 };
+    static uint8_t buffer[MCN_SCHEMA_TEXT_SIZE];
+    volatile uint32_t sink = 0;
+    uint64_t start;
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data.timestamp = i;
+        sink += mcn_schema_pack(hub->schema, &data, buffer);
+    }
+    report("schema_pack", hub, 0, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data.timestamp = i;
+        sink += hand_pack(&data, buffer);
+    }
+    report("hand_pack", hub, 0, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data.timestamp = i;
+        sink += mcn_schema_format(hub->schema, &data, (char*)buffer, sizeof(buffer));
+    }
+    report("schema_format", hub, 0, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data.timestamp = i;
+        sink += hand_format(&data, (char*)buffer, sizeof(buffer));
+    }
+    report("hand_format", hub, 0, 1, iterations, now_ns() - start);
+
+    check_schema_format(hub);
+
+    (void)sink;
+}
+
+static void show_usage(const char* name)
+{
+    printf("usage: %s [-n iterations]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            show_usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (mcn_init() != FMT_EOK || mcn_record_init() != FMT_EOK) {
+        fprintf(stderr, "mcn init fail\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < sizeof(bench_hubs) / sizeof(McnHub_t); i++) {
+        if (mcn_advertise(bench_hubs[i], NULL) != FMT_EOK) {
+            fprintf(stderr, "advertise %s fail\n", bench_hubs[i]->obj_name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (mcn_set_schema(MCN_HUB(bench_schema), MCN_SCHEMA(bench_sample_t)) != FMT_EOK) {
+        fprintf(stderr, "set schema fail\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("case,size,subscribers,threads,iterations,ns_per_op\n");
+
+    for (uint32_t i = 0; i < sizeof(bench_hubs) / sizeof(McnHub_t); i++) {
+        for (uint32_t j = 0; j < sizeof(bench_subs) / sizeof(uint32_t); j++) {
+            bench_publish(bench_hubs[i], bench_subs[j]);
+        }
+        bench_copy_poll(bench_hubs[i]);
+        for (uint32_t j = 0; j < sizeof(bench_readers) / sizeof(uint32_t); j++) {
+            bench_contention(bench_hubs[i], bench_readers[j]);
+        }
+        bench_record_replay(bench_hubs[i]);
+        bench_shm(bench_hubs[i]);
+    }
+    bench_schema_serialize(MCN_HUB(bench_schema));
+    bench_lookup();
+
+    return torn_reads || lookup_miss || format_mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
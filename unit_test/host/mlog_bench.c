@@ -0,0 +1,298 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Benchmark of mlog_reader on a synthetic log.
+ *   mlog_bench [size_mb] [file]
+ * A log with the rates of a typical flight is generated, including an index
+ * record every 100ms and a corrupted byte every 256MB. The log is then parsed
+ * from begin to end and seeked to random timestamps. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "module/log/mlog_reader.h"
+
+#define NAME_LEN       20
+#define DESC_LEN       128
+#define MODEL_LEN      256
+#define INDEX_PERIOD   100
+#define CORRUPT_STRIDE (256UL * 1024 * 1024)
+#define SEEK_NUM       100000
+#define SEEK_CHECK_NUM 1000
+
+typedef struct {
+    const char* name;
+    uint8_t msg_id;
+    uint16_t len;    /* payload length, timestamp followed by floats */
+    uint16_t period; /* ms */
+} bench_bus_t;
+
+static const bench_bus_t bench_bus[] = {
+    { "IMU", 1, 28, 1 },
+    { "MAG", 2, 16, 10 },
+    { "Barometer", 3, 12, 20 },
+    { "INS_Out", 9, 100, 4 },
+    { "Control_Out", 11, 40, 1 },
+};
+#define BUS_NUM (sizeof(bench_bus) / sizeof(bench_bus_t))
+
+static struct {
+    FILE* fp;
+    uint64_t pos;
+    uint32_t last_offset[BUS_NUM];
+    uint32_t index_offset;
+    uint32_t index_num;
+    uint64_t frame_num;
+} gen;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void put(const void* data, size_t len)
+{
+    fwrite(data, 1, len, gen.fp);
+    gen.pos += len;
+}
+
+static void put_uint(uint32_t val, size_t n)
+{
+    put(&val, n); /* little-endian host */
+}
+
+static void put_name(const char* name)
+{
+    char buffer[NAME_LEN] = { 0 };
+
+    memcpy(buffer, name, strlen(name) < NAME_LEN ? strlen(name) : NAME_LEN);
+    put(buffer, NAME_LEN);
+}
+
+static void put_frame(uint8_t msg_id, const void* payload, uint16_t len)
+{
+    const uint8_t begin[3] = { MLOG_BEGIN_MSG1, MLOG_BEGIN_MSG2, msg_id };
+    uint16_t sum = mlog_checksum(mlog_checksum(0, &msg_id, 1), payload, len);
+
+    put(begin, sizeof(begin));
+    put(payload, len);
+    put_uint(sum, 2);
+    put_uint(MLOG_END_MSG, 1);
+    gen.frame_num++;
+}
+
+static void put_header(void)
+{
+    static const uint8_t zero[MODEL_LEN];
+
+    put_uint(MLOG_VERSION, 2);
+    put_uint(0, 4);
+    put_uint(NAME_LEN, 2);
+    put_uint(DESC_LEN, 2);
+    put_uint(MODEL_LEN, 2);
+    put(zero, DESC_LEN);
+    put(zero, MODEL_LEN);
+
+    put_uint(BUS_NUM, 1);
+    for (size_t n = 0; n < BUS_NUM; n++) {
+        put_name(bench_bus[n].name);
+        put_uint(bench_bus[n].msg_id, 1);
+        put_uint(2, 1);
+        /* uint32 timestamp and float data, see McnFieldType */
+        put_name("timestamp_ms");
+        put_uint(5, 2);
+        put_uint(1, 2);
+        put_name("data");
+        put_uint(6, 2);
+        put_uint((bench_bus[n].len - 4) / 4, 2);
+    }
+    /* no parameter */
+    put_uint(0, 1);
+}
+
+static void put_index(uint32_t timestamp)
+{
+    uint32_t record[sizeof(mlog_index_t) / sizeof(uint32_t) + BUS_NUM];
+    mlog_index_t* index = (mlog_index_t*)record;
+    uint32_t offset = gen.pos;
+
+    index->magic = MLOG_INDEX_MAGIC;
+    index->timestamp = timestamp;
+    index->seq = gen.index_num++;
+    index->prev_offset = gen.index_offset;
+    memcpy(index->last_offset, gen.last_offset, sizeof(gen.last_offset));
+    put_frame(MLOG_INDEX_ID, record, sizeof(record));
+    gen.index_offset = offset;
+}
+
+static uint32_t generate(const char* path, uint64_t size)
+{
+    uint32_t t;
+
+    gen.fp = fopen(path, "wb");
+    if (gen.fp == NULL) {
+        return 0;
+    }
+    setvbuf(gen.fp, NULL, _IOFBF, 1 << 20);
+    memset(gen.last_offset, 0xFF, sizeof(gen.last_offset));
+    gen.index_offset = MLOG_OFFSET_NONE;
+
+    put_header();
+    for (t = 0; gen.pos < size; t++) {
+        if (t % INDEX_PERIOD == 0) {
+            put_index(t);
+        }
+        for (size_t n = 0; n < BUS_NUM; n++) {
+            float payload[32];
+
+            if (t % bench_bus[n].period) {
+                continue;
+            }
+            memcpy(payload, &t, sizeof(t));
+            for (int k = 1; k < bench_bus[n].len / 4; k++) {
+                payload[k] = (float)n + k * 0.001f * (t % 1000);
+            }
+            gen.last_offset[n] = gen.pos;
+            put_frame(bench_bus[n].msg_id, payload, bench_bus[n].len);
+        }
+    }
+    fclose(gen.fp);
+
+    return t;
+}
+
+static uint32_t corrupt(const char* path, uint64_t size)
+{
+    FILE* fp = fopen(path, "r+b");
+    uint32_t num = 0;
+
+    for (uint64_t pos = CORRUPT_STRIDE / 2; fp && pos < size; pos += CORRUPT_STRIDE) {
+        uint8_t byte;
+
+        fseek(fp, pos, SEEK_SET);
+        byte = fgetc(fp);
+        fseek(fp, pos, SEEK_SET);
+        fputc(byte ^ 0x5A, fp);
+        num++;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+
+    return num;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t size = (argc > 1 ? strtoull(argv[1], NULL, 0) : 2048) * 1024 * 1024;
+    const char* path = argc > 2 ? argv[2] : "mlog_bench.bin";
+    uint64_t frame_num = 0, index_num = 0, skipped = 0;
+    uint32_t duration, corrupt_num, bad_seek = 0;
+    mlog_reader_t reader;
+    mlog_frame_t frame;
+    size_t offset;
+    double start, elapsed;
+
+    if (size >= 4ULL * 1024 * 1024 * 1024) {
+        fprintf(stderr, "log size must be less than 4GB\n");
+        return 1;
+    }
+
+    start = now_sec();
+    duration = generate(path, size);
+    if (duration == 0) {
+        fprintf(stderr, "fail to write %s\n", path);
+        return 1;
+    }
+    corrupt_num = corrupt(path, gen.pos);
+    printf("generate: %.1f MB, %u s of flight, %lu frames, %u index, %u bytes corrupted, %.2f s\n", gen.pos / 1048576.0,
+           duration / 1000, (unsigned long)gen.frame_num, gen.index_num, corrupt_num, now_sec() - start);
+
+    start = now_sec();
+    if (mlog_reader_open(&reader, path) < 0) {
+        fprintf(stderr, "fail to open %s\n", path);
+        return 1;
+    }
+    printf("open: %.1f us\n", (now_sec() - start) * 1e6);
+
+    /* parse the whole file */
+    start = now_sec();
+    offset = reader.data_offset;
+    while (1) {
+        size_t from = offset;
+
+        if (!mlog_reader_next(&reader, &offset, &frame)) {
+            skipped += reader.size - from;
+            break;
+        }
+        skipped += frame.offset - from;
+        frame_num++;
+        index_num += frame.msg_id == MLOG_INDEX_ID;
+    }
+    elapsed = now_sec() - start;
+    printf("parse: %lu frames (%lu index), %lu lost, %lu bytes skipped, %.2f s, %.0f MB/s, %.1f Mframes/s\n",
+           (unsigned long)frame_num, (unsigned long)index_num, (unsigned long)(gen.frame_num - frame_num),
+           (unsigned long)skipped, elapsed, reader.size / 1048576.0 / elapsed, frame_num / elapsed / 1e6);
+
+    /* seek random timestamps */
+    srand(1);
+    start = now_sec();
+    for (int i = 0; i < SEEK_NUM; i++) {
+        offset = mlog_reader_seek(&reader, (uint32_t)((uint64_t)rand() * duration / RAND_MAX));
+    }
+    elapsed = now_sec() - start;
+    printf("seek: %d times, %.2f us/seek\n", SEEK_NUM, elapsed / SEEK_NUM * 1e6);
+
+    /* check the record found is the last one before timestamp, and IMU data is before it */
+    for (int i = 0; i < SEEK_CHECK_NUM; i++) {
+        uint32_t t = (uint32_t)((uint64_t)rand() * duration / RAND_MAX);
+        mlog_index_t index, next;
+        uint32_t imu_time;
+
+        offset = mlog_reader_seek(&reader, t);
+        if (mlog_reader_index(&reader, offset, &index, NULL) < 0 || index.timestamp > t) {
+            bad_seek++;
+            continue;
+        }
+        /* next index record, which may be lost by corruption */
+        mlog_reader_next(&reader, &offset, &frame);
+        while (mlog_reader_next(&reader, &offset, &frame) && frame.msg_id != MLOG_INDEX_ID) {
+        }
+        if (frame.msg_id == MLOG_INDEX_ID && mlog_reader_index(&reader, frame.offset, &next, NULL) == 0
+            && next.timestamp <= t) {
+            bad_seek++;
+            continue;
+        }
+        if (mlog_reader_last_frame(&reader, mlog_reader_seek(&reader, t), 1, &frame) == 0) {
+            memcpy(&imu_time, frame.payload, sizeof(imu_time));
+            if (imu_time >= index.timestamp) {
+                bad_seek++;
+            }
+        }
+    }
+    printf("seek check: %d/%d wrong\n", bad_seek, SEEK_CHECK_NUM);
+
+    mlog_reader_close(&reader);
+
+    return bad_seek || gen.frame_num - frame_num > corrupt_num ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Decode mlog file into plain mlog file, which is readable by existing tools.
+ *   mlog_decode <input> [output]
+ * Blocks of compressed log are decoded, then msg frames are checked against
+ * the bus list of header. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "module/log/mlog_format.h"
+#include "module/log/mlog_lz.h"
+
+static const uint8_t elem_size[] = { 1, 1, 2, 2, 4, 4, 4, 8, 1 };
+static const uint8_t param_size[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    int error;
+} reader_t;
+
+static const uint8_t* take(reader_t* r, size_t n)
+{
+    const uint8_t* p = &r->data[r->pos];
+
+    if (r->error || r->pos + n > r->len) {
+        r->error = 1;
+        return NULL;
+    }
+    r->pos += n;
+
+    return p;
+}
+
+static uint32_t take_uint(reader_t* r, size_t n)
+{
+    const uint8_t* p = take(r, n);
+    uint32_t val = 0;
+
+    for (size_t i = 0; p && i < n; i++) {
+        val |= (uint32_t)p[i] << (8 * i);
+    }
+
+    return val;
+}
+
+/* parse header, returns the payload length of each msg id, -1 for unknown id */
+static int parse_header(reader_t* r, int32_t* msg_len, uint16_t* version)
+{
+    uint16_t name_len, desc_len, model_len;
+    uint8_t num_bus, num_group;
+
+    *version = take_uint(r, 2);
+    take_uint(r, 4); /* timestamp */
+    name_len = take_uint(r, 2);
+    desc_len = take_uint(r, 2);
+    model_len = take_uint(r, 2);
+    take(r, desc_len);
+    take(r, model_len);
+
+    num_bus = take_uint(r, 1);
+    for (int n = 0; n < num_bus && !r->error; n++) {
+        const uint8_t* name = take(r, name_len);
+        uint8_t msg_id = take_uint(r, 1);
+        uint8_t num_elem = take_uint(r, 1);
+        int32_t len = 0;
+
+        for (int k = 0; k < num_elem && !r->error; k++) {
+            uint16_t type, number;
+
+            take(r, name_len);
+            type = take_uint(r, 2);
+            number = take_uint(r, 2);
+            len += (type < sizeof(elem_size) ? elem_size[type] : 0) * number;
+        }
+        /* bus without schema can't be walked */
+        msg_len[msg_id] = num_elem ? len : -1;
+        if (name) {
+            printf("bus %-20.*s id:%-3d len:%d\n", name_len, name, msg_id, msg_len[msg_id]);
+        }
+    }
+    if ((*version & ~MLOG_VERSION_COMPRESSED) >= 2) {
+        msg_len[MLOG_INDEX_ID] = sizeof(mlog_index_t) + num_bus * sizeof(uint32_t);
+    }
+
+    num_group = take_uint(r, 1);
+    for (int n = 0; n < num_group && !r->error; n++) {
+        uint32_t param_num;
+
+        take(r, name_len);
+        param_num = take_uint(r, 4);
+        for (uint32_t k = 0; k < param_num && !r->error; k++) {
+            uint8_t type;
+
+            take(r, name_len);
+            type = take_uint(r, 1);
+            if (type >= sizeof(param_size)) {
+                /* unknown type has no value written */
+                continue;
+            }
+            take(r, param_size[type]);
+        }
+    }
+
+    return r->error ? -1 : 0;
+}
+
+static uint8_t* read_file(const char* path, size_t* len)
+{
+    FILE* fp = fopen(path, "rb");
+    uint8_t* data;
+    long size;
+
+    if (fp == NULL) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    data = malloc(size ? size : 1);
+    if (data && fread(data, 1, size, fp) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *len = size;
+
+    return data;
+}
+
+/* size of log data after decoded */
+static size_t decoded_size(const reader_t* r, int compressed)
+{
+    size_t pos = r->pos, size = 0;
+
+    if (!compressed) {
+        return r->len - r->pos;
+    }
+
+    while (pos + sizeof(mlog_block_t) <= r->len) {
+        mlog_block_t block;
+
+        memcpy(&block, &r->data[pos], sizeof(block));
+        if (block.magic != MLOG_BLOCK_MAGIC) {
+            break;
+        }
+        size += block.raw_len;
+        pos += sizeof(block) + block.data_len;
+    }
+
+    return size;
+}
+
+/* walk msg frames of known bus, returns the number of bytes skipped to resync.
+ * Frames of version 1 have no checksum. */
+static size_t check_frames(const uint8_t* data, size_t len, const int32_t* msg_len, int checksum, uint32_t* msg_num)
+{
+    uint32_t overhead = checksum ? MLOG_FRAME_OVERHEAD : MLOG_FRAME_OVERHEAD - 2;
+    size_t pos = 0, skipped = 0;
+
+    while (pos + 3 < len) {
+        uint8_t msg_id = data[pos + 2];
+        size_t end = pos + msg_len[msg_id] + overhead - 1;
+
+        if (data[pos] == MLOG_BEGIN_MSG1 && data[pos + 1] == MLOG_BEGIN_MSG2 && msg_len[msg_id] >= 0 && end < len
+            && data[end] == MLOG_END_MSG
+            && (!checksum
+                || mlog_checksum(0, &data[pos + 2], msg_len[msg_id] + 1) == (data[end - 2] | data[end - 1] << 8))) {
+            msg_num[msg_id]++;
+            pos = end + 1;
+        } else {
+            pos++;
+            skipped++;
+        }
+    }
+
+    return skipped;
+}
+
+int main(int argc, char** argv)
+{
+    static int32_t msg_len[256];
+    static uint32_t msg_num[256];
+    reader_t r = { 0 };
+    uint8_t* out;
+    size_t out_len = 0, header_len, skipped;
+    uint32_t block_num = 0, stored_num = 0;
+    uint16_t version;
+    int compressed;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <input> [output]\n", argv[0]);
+        return 1;
+    }
+
+    r.data = read_file(argv[1], &r.len);
+    if (r.data == NULL) {
+        fprintf(stderr, "fail to read %s\n", argv[1]);
+        return 1;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        msg_len[i] = -1;
+    }
+    if (parse_header(&r, msg_len, &version) < 0) {
+        fprintf(stderr, "invalid header\n");
+        return 1;
+    }
+    header_len = r.pos;
+
+    out = malloc(header_len + decoded_size(&r, version & MLOG_VERSION_COMPRESSED));
+    if (out == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    memcpy(out, r.data, header_len);
+    out_len = header_len;
+    /* output is plain log */
+    compressed = version & MLOG_VERSION_COMPRESSED;
+    version &= ~MLOG_VERSION_COMPRESSED;
+    memcpy(out, &version, sizeof(version));
+
+    if (compressed) {
+        while (r.pos < r.len) {
+            mlog_block_t block;
+            size_t block_pos = r.pos;
+            const uint8_t* p = take(&r, sizeof(block));
+            int32_t n;
+
+            if (p != NULL) {
+                memcpy(&block, p, sizeof(block));
+                p = take(&r, block.data_len);
+            }
+            /* log is not stopped properly, the rest is preallocated space or partial block */
+            if (p == NULL || block.magic != MLOG_BLOCK_MAGIC) {
+                printf("log ends at block %u, %zu bytes after it are ignored\n", block_num, r.len - block_pos);
+                r.pos = block_pos;
+                break;
+            }
+
+            if (block.method == MLOG_BLOCK_LZ) {
+                n = mlog_lz_decompress(p, block.data_len, &out[out_len], block.raw_len);
+            } else {
+                memcpy(&out[out_len], p, block.data_len);
+                n = block.data_len;
+                stored_num++;
+            }
+            if (n != block.raw_len) {
+                fprintf(stderr, "corrupted block %u\n", block_num);
+                return 1;
+            }
+            out_len += n;
+            block_num++;
+        }
+        printf("%u blocks (%u stored), %zu -> %zu bytes, ratio %.1f%%\n", block_num, stored_num, r.pos - header_len,
+               out_len - header_len, 100.0 * (r.pos - header_len) / (out_len - header_len ? out_len - header_len : 1));
+    } else {
+        memcpy(&out[out_len], &r.data[header_len], r.len - header_len);
+        out_len = r.len;
+        printf("log is not compressed\n");
+    }
+
+    skipped = check_frames(&out[header_len], out_len - header_len, msg_len, version >= 2, msg_num);
+    for (int i = 0; i < 256; i++) {
+        if (msg_num[i]) {
+            printf("msg id:%-3d frames:%u%s\n", i, msg_num[i], version >= 2 && i == MLOG_INDEX_ID ? " (index)" : "");
+        }
+    }
+    printf("%zu bytes not in frames of known bus\n", skipped);
+
+    if (argc > 2) {
+        FILE* fp = fopen(argv[2], "wb");
+
+        if (fp == NULL || fwrite(out, 1, out_len, fp) != out_len) {
+            fprintf(stderr, "fail to write %s\n", argv[2]);
+            return 1;
+        }
+        fclose(fp);
+    }
+
+    return 0;
+}
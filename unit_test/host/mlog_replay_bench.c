@@ -0,0 +1,428 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Replay of mlog with the INS, FMS and Controller models on host.
+ *   mlog_replay_bench [log] [output]
+ * Model inputs of the log are replayed as the vehicle task does in replay mode,
+ * see task_vehicle.c, and the regenerated log is written into output. Without
+ * a log, a log of a vehicle standing on ground is generated. The log is replayed
+ * twice to check the regenerated log is identical, the replay speed is reported
+ * as a multiple of real time. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Controller.h>
+#include <FMS.h>
+#include <INS.h>
+
+#include "module/log/mlog_replay.h"
+
+#define NAME_LEN       20
+#define DESC_LEN       128
+#define MODEL_LEN      256
+#define GEN_SECONDS    600
+#define GEN_FILE       "mlog_replay_bench.bin"
+#define OUT_FILE       "mlog_replay_bench_out.bin"
+#define OUT_BUFFER     (1 << 20)
+#define RF_LEN         8
+#define OPTFLOW_LEN    16
+
+/* buses of log, msg ids are the ones of firmware, see mlog.h */
+enum {
+    BUS_IMU,
+    BUS_MAG,
+    BUS_BARO,
+    BUS_GPS,
+    BUS_RF,
+    BUS_OPTFLOW,
+    BUS_PILOT_CMD,
+    BUS_GCS_CMD,
+    BUS_INS_OUT,
+    BUS_FMS_OUT,
+    BUS_CONTROL_OUT,
+    BUS_NUM
+};
+
+static const struct {
+    const char* name;
+    uint16_t len;
+    uint16_t period; /* ms, of generated log */
+} bench_bus[BUS_NUM] = {
+    { "IMU", sizeof(IMU_Bus), 2 },
+    { "MAG", sizeof(MAG_Bus), 10 },
+    { "Barometer", sizeof(Barometer_Bus), 20 },
+    { "GPS_uBlox", sizeof(GPS_uBlox_Bus), 100 },
+    { "Rangefinder", RF_LEN, 0 },
+    { "Optical_Flow", OPTFLOW_LEN, 0 },
+    { "Pilot_Cmd", sizeof(Pilot_Cmd_Bus), 20 },
+    { "GCS_Cmd", sizeof(GCS_Cmd_Bus), 0 },
+    { "INS_Out", sizeof(INS_Out_Bus), 100 },
+    { "FMS_Out", sizeof(FMS_Out_Bus), 100 },
+    { "Control_Out", sizeof(Control_Out_Bus), 100 },
+};
+
+typedef struct {
+    int fd;
+    /* regenerated log */
+    FILE* out;
+    uint8_t* out_buf;
+    uint32_t out_len;
+    uint64_t out_size;
+    uint64_t out_hash;
+    /* msg id in log of each bus, -1 if it's not in log */
+    int bus_id[BUS_NUM];
+    uint8_t bus_of_id[256];
+    /* model scheduling, the same as vehicle task */
+    uint8_t started;
+    uint32_t ins_tag;
+    uint32_t fms_tag;
+    uint32_t control_tag;
+    uint8_t updated[BUS_NUM];
+    uint8_t rf_report[RF_LEN];
+    uint8_t optflow_report[OPTFLOW_LEN];
+    uint32_t mismatch;
+} replay_ctx_t;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* output goes to a buffer, which is hashed and written into file if any */
+static void out_put(replay_ctx_t* ctx, const void* data, uint32_t len)
+{
+    const uint8_t* p = data;
+
+    for (uint32_t i = 0; i < len; i++) {
+        /* FNV-1a */
+        ctx->out_hash = (ctx->out_hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    if (ctx->out_len + len > OUT_BUFFER) {
+        if (ctx->out) {
+            fwrite(ctx->out_buf, 1, ctx->out_len, ctx->out);
+        }
+        ctx->out_len = 0;
+    }
+    memcpy(&ctx->out_buf[ctx->out_len], data, len);
+    ctx->out_len += len;
+    ctx->out_size += len;
+}
+
+static void out_frame(replay_ctx_t* ctx, int bus, const void* payload)
+{
+    uint8_t msg_id = ctx->bus_id[bus];
+    uint8_t head[3] = { MLOG_BEGIN_MSG1, MLOG_BEGIN_MSG2, msg_id };
+    uint16_t sum = mlog_checksum(mlog_checksum(0, &msg_id, 1), payload, bench_bus[bus].len);
+    uint8_t tail[3] = { sum & 0xFF, sum >> 8, MLOG_END_MSG };
+
+    if (ctx->bus_id[bus] < 0) {
+        return;
+    }
+    out_put(ctx, head, sizeof(head));
+    out_put(ctx, payload, bench_bus[bus].len);
+    out_put(ctx, tail, sizeof(tail));
+}
+
+static int32_t replay_read(void* ctx, void* buf, uint32_t len)
+{
+    return read(((replay_ctx_t*)ctx)->fd, buf, len);
+}
+
+static void replay_input(void* ctx, uint8_t msg_id, const uint8_t* payload, uint16_t len)
+{
+    replay_ctx_t* c = ctx;
+    int bus = c->bus_of_id[msg_id];
+    void* dst[BUS_NUM] = {
+        &INS_U.IMU, &INS_U.MAG, &INS_U.Barometer, &INS_U.GPS_uBlox, c->rf_report, c->optflow_report,
+        &FMS_U.Pilot_Cmd, &FMS_U.GCS_Cmd
+    };
+
+    if (len != bench_bus[bus].len) {
+        c->mismatch++;
+        return;
+    }
+    memcpy(dst[bus], payload, len);
+    c->updated[bus] = 1;
+}
+
+/* mirror of ins_interface_run(), fms_interface_run() and control_interface_step() */
+static void replay_step(void* ctx, uint32_t timestamp)
+{
+    replay_ctx_t* c = ctx;
+    const void* ins_input[] = { &INS_U.IMU, &INS_U.MAG, &INS_U.Barometer, &INS_U.GPS_uBlox, c->rf_report,
+        c->optflow_report };
+
+    if (!c->started) {
+        c->started = 1;
+        c->ins_tag = timestamp - INS_EXPORT.period;
+        c->fms_tag = timestamp - FMS_EXPORT.period;
+        c->control_tag = timestamp - CONTROL_EXPORT.period;
+    }
+
+    if (timestamp - c->ins_tag >= INS_EXPORT.period) {
+        c->ins_tag = timestamp;
+        INS_step();
+        for (int bus = BUS_IMU; bus <= BUS_OPTFLOW; bus++) {
+            if (c->updated[bus]) {
+                c->updated[bus] = 0;
+                out_frame(c, bus, ins_input[bus]);
+            }
+        }
+        out_frame(c, BUS_INS_OUT, &INS_Y.INS_Out);
+    }
+
+    if (timestamp - c->fms_tag >= FMS_EXPORT.period) {
+        c->fms_tag = timestamp;
+        FMS_U.INS_Out = INS_Y.INS_Out;
+        FMS_U.Control_Out = Controller_Y.Control_Out;
+        FMS_step();
+        if (c->updated[BUS_PILOT_CMD]) {
+            c->updated[BUS_PILOT_CMD] = 0;
+            out_frame(c, BUS_PILOT_CMD, &FMS_U.Pilot_Cmd);
+        }
+        if (c->updated[BUS_GCS_CMD]) {
+            c->updated[BUS_GCS_CMD] = 0;
+            out_frame(c, BUS_GCS_CMD, &FMS_U.GCS_Cmd);
+        }
+        out_frame(c, BUS_FMS_OUT, &FMS_Y.FMS_Out);
+    }
+
+    if (timestamp - c->control_tag >= CONTROL_EXPORT.period) {
+        c->control_tag = timestamp;
+        Controller_U.FMS_Out = FMS_Y.FMS_Out;
+        Controller_U.INS_Out = INS_Y.INS_Out;
+        Controller_step();
+        out_frame(c, BUS_CONTROL_OUT, &Controller_Y.Control_Out);
+    }
+}
+
+static int replay(const char* path, const char* out_path, replay_ctx_t* ctx, mlog_replay_stat_t* stat,
+    double* duration)
+{
+    static mlog_replay_t log;
+    const mlog_replay_io_t io = { replay_read, replay_input, replay_step, ctx };
+    uint8_t* header;
+    double start;
+
+    memset(ctx, 0, sizeof(replay_ctx_t));
+    ctx->out_hash = 0xcbf29ce484222325ULL;
+    ctx->out_buf = malloc(OUT_BUFFER);
+    ctx->fd = open(path, O_RDONLY);
+    if (ctx->fd < 0 || mlog_replay_open(&log, &io) < 0) {
+        printf("%s is not a plain mlog of version %d\n", path, MLOG_VERSION);
+        return -1;
+    }
+
+    for (int bus = 0; bus < BUS_NUM; bus++) {
+        ctx->bus_id[bus] = mlog_replay_find_bus(&log, bench_bus[bus].name, NULL);
+        if (ctx->bus_id[bus] >= 0 && bus <= BUS_GCS_CMD) {
+            ctx->bus_of_id[ctx->bus_id[bus]] = bus;
+            mlog_replay_set_input(&log, ctx->bus_id[bus]);
+        }
+    }
+
+    /* regenerated log has the same header */
+    if (out_path) {
+        ctx->out = fopen(out_path, "wb");
+    }
+    header = malloc(log.data_offset);
+    pread(ctx->fd, header, log.data_offset, 0);
+    out_put(ctx, header, log.data_offset);
+    free(header);
+
+    INS_init();
+    FMS_init();
+    Controller_init();
+
+    start = now_sec();
+    while (mlog_replay_run(&log, 1000)) {
+    }
+    *duration = now_sec() - start;
+    *stat = log.stat;
+
+    if (ctx->out) {
+        fwrite(ctx->out_buf, 1, ctx->out_len, ctx->out);
+        fclose(ctx->out);
+    }
+    free(ctx->out_buf);
+    close(ctx->fd);
+
+    return 0;
+}
+
+static void put(FILE* fp, const void* data, size_t len)
+{
+    fwrite(data, 1, len, fp);
+}
+
+static void put_uint(FILE* fp, uint32_t val, size_t n)
+{
+    put(fp, &val, n); /* little-endian host */
+}
+
+static void put_name(FILE* fp, const char* name)
+{
+    char buffer[NAME_LEN] = { 0 };
+
+    memcpy(buffer, name, strlen(name) < NAME_LEN ? strlen(name) : NAME_LEN);
+    put(fp, buffer, NAME_LEN);
+}
+
+static void put_frame(FILE* fp, uint8_t msg_id, const void* payload, uint16_t len)
+{
+    const uint8_t begin[3] = { MLOG_BEGIN_MSG1, MLOG_BEGIN_MSG2, msg_id };
+    uint16_t sum = mlog_checksum(mlog_checksum(0, &msg_id, 1), payload, len);
+
+    put(fp, begin, sizeof(begin));
+    put(fp, payload, len);
+    put_uint(fp, sum, 2);
+    put_uint(fp, MLOG_END_MSG, 1);
+}
+
+static float noise(void)
+{
+    return (rand() / (float)RAND_MAX - 0.5f) * 0.02f;
+}
+
+/* vehicle standing on ground, sensors are logged at the steps of INS */
+static int generate(const char* path, uint32_t seconds)
+{
+    static const uint8_t zero[MODEL_LEN];
+    FILE* fp = fopen(path, "wb");
+
+    if (fp == NULL) {
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+    srand(1);
+
+    put_uint(fp, MLOG_VERSION, 2);
+    put_uint(fp, 0, 4);
+    put_uint(fp, NAME_LEN, 2);
+    put_uint(fp, DESC_LEN, 2);
+    put_uint(fp, MODEL_LEN, 2);
+    put(fp, zero, DESC_LEN);
+    put(fp, zero, MODEL_LEN);
+    put_uint(fp, BUS_NUM, 1);
+    for (int bus = 0; bus < BUS_NUM; bus++) {
+        put_name(fp, bench_bus[bus].name);
+        put_uint(fp, bus + 1, 1);
+        put_uint(fp, 1, 1);
+        /* layout is not needed to replay, see McnFieldType */
+        put_name(fp, "data");
+        put_uint(fp, 0, 2);
+        put_uint(fp, bench_bus[bus].len, 2);
+    }
+    /* no parameter */
+    put_uint(fp, 0, 1);
+
+    for (uint32_t t = 1000; t < 1000 + seconds * 1000; t += 2) {
+        IMU_Bus imu = { t, noise(), noise(), noise(), noise(), noise(), -9.8f + noise() };
+        MAG_Bus mag = { t, 0.2f + noise(), 0.0f + noise(), 0.4f + noise() };
+        Barometer_Bus baro = { t, 101325.0f + 100 * noise(), 25.0f };
+        GPS_uBlox_Bus gps = { 0 };
+        Pilot_Cmd_Bus pilot = { 0 };
+        GCS_Cmd_Bus gcs = { 0 };
+        uint8_t out[256] = { 0 };
+
+        gps.timestamp = t;
+        gps.fixType = 3;
+        gps.numSV = 12;
+        gps.lat = 300000000 + (int32_t)(100 * noise());
+        gps.lon = 1200000000 + (int32_t)(100 * noise());
+        gps.height = 10000;
+        gps.hAcc = 800;
+        gps.vAcc = 1200;
+        gps.sAcc = 300;
+        pilot.timestamp = t;
+        gcs.timestamp = t;
+
+        put_frame(fp, BUS_IMU + 1, &imu, sizeof(imu));
+        if (t % bench_bus[BUS_MAG].period == 0) {
+            put_frame(fp, BUS_MAG + 1, &mag, sizeof(mag));
+        }
+        if (t % bench_bus[BUS_BARO].period == 0) {
+            put_frame(fp, BUS_BARO + 1, &baro, sizeof(baro));
+        }
+        if (t % bench_bus[BUS_GPS].period == 0) {
+            put_frame(fp, BUS_GPS + 1, &gps, sizeof(gps));
+        }
+        /* flight log has outputs, they are skipped by replay */
+        if (t % bench_bus[BUS_INS_OUT].period == 0) {
+            put_frame(fp, BUS_INS_OUT + 1, out, bench_bus[BUS_INS_OUT].len);
+        }
+        if (t % bench_bus[BUS_PILOT_CMD].period == 0) {
+            put_frame(fp, BUS_PILOT_CMD + 1, &pilot, sizeof(pilot));
+        }
+        if (t == 1000) {
+            put_frame(fp, BUS_GCS_CMD + 1, &gcs, sizeof(gcs));
+        }
+        if (t % bench_bus[BUS_FMS_OUT].period == 0) {
+            put_frame(fp, BUS_FMS_OUT + 1, out, bench_bus[BUS_FMS_OUT].len);
+            put_frame(fp, BUS_CONTROL_OUT + 1, out, bench_bus[BUS_CONTROL_OUT].len);
+        }
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : GEN_FILE;
+    const char* out_path = argc > 2 ? argv[2] : OUT_FILE;
+    replay_ctx_t ctx;
+    mlog_replay_stat_t stat;
+    double duration, best = 1e9;
+    uint64_t hash = 0;
+    uint32_t span;
+
+    if (argc <= 1) {
+        printf("generate %s of %d s\n", GEN_FILE, GEN_SECONDS);
+        if (generate(GEN_FILE, GEN_SECONDS) < 0) {
+            return 1;
+        }
+    }
+
+    for (int run = 0; run < 2; run++) {
+        if (replay(path, run == 0 ? out_path : NULL, &ctx, &stat, &duration) < 0) {
+            return 1;
+        }
+        if (run && ctx.out_hash != hash) {
+            printf("regenerated log differs between runs\n");
+            return 1;
+        }
+        hash = ctx.out_hash;
+        best = duration < best ? duration : best;
+    }
+
+    span = stat.end_time - stat.start_time;
+    printf("frame:%u input:%u step:%u skip byte:%u gap:%u mismatch:%u\n", stat.frame, stat.input, stat.step,
+        stat.skip_byte, stat.gap, ctx.mismatch);
+    printf("log %.1f s, replay %.3f s, speed %.1fx real time\n", span / 1000.0, best, span / 1000.0 / best);
+    printf("regenerated %s, %llu bytes, identical in 2 runs (hash %016llx)\n", out_path,
+        (unsigned long long)ctx.out_size, (unsigned long long)hash);
+
+    return 0;
+}
@@ -0,0 +1,347 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Loopback benchmark of mlog_stream over a simulated serial link.
+ *   mlog_stream_bench [seconds]
+ * The source emulates mavlink_log: the log header is sent first, then sectors
+ * of log buffer are staged in 2 slots, sectors completed when both slots are
+ * full are skipped. Chunks go through a full-duplex serial link with latency
+ * and random loss in both directions, the receiver acks LOGGING_DATA_ACKED
+ * and checks the data of each chunk against the log generated. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "module/log/mlog_stream.h"
+
+#define BAUDRATE      57600
+#define LINK_BYTE_US  (10 * 1000000ULL / BAUDRATE)
+#define LINK_LATENCY  20000 /* us */
+#define TX_BUFFER     1024  /* bytes of serial tx buffer */
+#define STREAM_RATE   5000  /* bytes/s, leave some link budget for telemetry */
+#define OVERHEAD      (12 + 5) /* MAVLink v1 frame and fields of LOGGING_DATA except data */
+#define ACK_LEN       (12 + 4)
+#define SECTOR_SIZE   4096
+#define SECTOR_NUM    2
+#define HEADER_SIZE   1500
+#define QUEUE_SIZE    256
+#define SEQ_NUM       65536
+#define POLL_PERIOD   2  /* ms, MAVPROXY_INTERVAL */
+
+typedef struct {
+    uint64_t done;    /* time (us) the last byte leaves the sender */
+    uint64_t arrival; /* time (us) it arrives the receiver */
+    uint8_t lost;
+    uint16_t len;
+    mlog_chunk_t chunk;
+} frame_t;
+
+typedef struct {
+    frame_t frame[QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint64_t busy; /* time (us) the link is free */
+} link_t;
+
+/* ground truth of chunk */
+typedef struct {
+    uint8_t used;
+    uint8_t received;
+    uint8_t header;
+    uint8_t len;
+    uint32_t offset; /* offset in header or log data */
+} truth_t;
+
+static struct {
+    /* simulation */
+    uint64_t now_us;
+    uint32_t rand;
+    uint32_t loss; /* in 1/1000 */
+    link_t down;
+    link_t up;
+    /* source */
+    uint32_t log_rate;
+    uint64_t log_pos;
+    uint32_t header_pos;
+    uint32_t slot_sector[SECTOR_NUM];
+    uint8_t slot_full[SECTOR_NUM];
+    uint8_t slot_in;
+    uint8_t slot_out;
+    uint32_t slot_pos;
+    uint32_t skipped_sector;
+    uint8_t pull_header; /* source of the last chunk pulled */
+    uint32_t pull_offset;
+    /* receiver */
+    truth_t truth[SEQ_NUM];
+    uint64_t recv_byte;
+    uint32_t recv_header;
+    uint32_t mismatch;
+} sim;
+
+static uint32_t rand_next(void)
+{
+    /* xorshift32 */
+    sim.rand ^= sim.rand << 13;
+    sim.rand ^= sim.rand >> 17;
+    sim.rand ^= sim.rand << 5;
+    return sim.rand;
+}
+
+static uint8_t log_byte(uint32_t offset, uint8_t header)
+{
+    uint32_t x = offset * 2654435761u + (header ? 0x9e3779b9u : 0);
+
+    x ^= x >> 15;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    return (uint8_t)x;
+}
+
+static frame_t* link_send(link_t* link, uint16_t len, uint32_t buffer)
+{
+    frame_t* frame;
+    uint32_t queued = 0;
+
+    /* bytes in tx buffer which are not sent yet */
+    for (uint32_t i = link->tail; i != link->head; i = (i + 1) % QUEUE_SIZE) {
+        if (link->frame[i].done > sim.now_us) {
+            queued += link->frame[i].len;
+        }
+    }
+    if (queued + len > buffer || (link->head + 1) % QUEUE_SIZE == link->tail) {
+        return NULL;
+    }
+
+    frame = &link->frame[link->head];
+    link->head = (link->head + 1) % QUEUE_SIZE;
+
+    link->busy = (link->busy > sim.now_us ? link->busy : sim.now_us) + len * LINK_BYTE_US;
+    frame->done = link->busy;
+    frame->arrival = link->busy + LINK_LATENCY;
+    frame->len = len;
+    frame->lost = rand_next() % 1000 < sim.loss;
+
+    return frame;
+}
+
+static frame_t* link_recv(link_t* link)
+{
+    frame_t* frame;
+
+    while (link->tail != link->head) {
+        frame = &link->frame[link->tail];
+        if (frame->arrival > sim.now_us) {
+            break;
+        }
+        link->tail = (link->tail + 1) % QUEUE_SIZE;
+        if (!frame->lost) {
+            return frame;
+        }
+    }
+
+    return NULL;
+}
+
+static void source_update(uint32_t dt_ms)
+{
+    uint64_t pos = sim.log_pos + (uint64_t)sim.log_rate * dt_ms / 1000;
+
+    /* stage the sectors completed */
+    for (uint64_t sector = sim.log_pos / SECTOR_SIZE; sector < pos / SECTOR_SIZE; sector++) {
+        if (sim.slot_full[sim.slot_in]) {
+            sim.skipped_sector++;
+            continue;
+        }
+        sim.slot_sector[sim.slot_in] = sector;
+        sim.slot_full[sim.slot_in] = 1;
+        sim.slot_in = (sim.slot_in + 1) % SECTOR_NUM;
+    }
+    sim.log_pos = pos;
+}
+
+static bool pull_chunk(void* ctx, mlog_chunk_t* chunk)
+{
+    uint8_t* acked = ctx;
+    uint32_t offset;
+
+    chunk->first_offset = MLOG_STREAM_NO_OFFSET;
+
+    if (sim.header_pos < HEADER_SIZE) {
+        chunk->len = HEADER_SIZE - sim.header_pos < MLOG_STREAM_CHUNK_SIZE ? HEADER_SIZE - sim.header_pos
+                                                                            : MLOG_STREAM_CHUNK_SIZE;
+        for (int i = 0; i < chunk->len; i++) {
+            chunk->data[i] = log_byte(sim.header_pos + i, 1);
+        }
+        chunk->acked = 1;
+        sim.pull_header = 1;
+        sim.pull_offset = sim.header_pos;
+        sim.header_pos += chunk->len;
+        return true;
+    }
+
+    if (!sim.slot_full[sim.slot_out]) {
+        return false;
+    }
+
+    offset = sim.slot_sector[sim.slot_out] * SECTOR_SIZE + sim.slot_pos;
+    chunk->len = SECTOR_SIZE - sim.slot_pos < MLOG_STREAM_CHUNK_SIZE ? SECTOR_SIZE - sim.slot_pos
+                                                                      : MLOG_STREAM_CHUNK_SIZE;
+    chunk->acked = *acked;
+    sim.pull_header = 0;
+    sim.pull_offset = offset;
+    for (int i = 0; i < chunk->len; i++) {
+        chunk->data[i] = log_byte(offset + i, 0);
+    }
+    sim.slot_pos += chunk->len;
+    if (sim.slot_pos >= SECTOR_SIZE) {
+        sim.slot_pos = 0;
+        sim.slot_full[sim.slot_out] = 0;
+        sim.slot_out = (sim.slot_out + 1) % SECTOR_NUM;
+    }
+
+    return true;
+}
+
+static bool send_chunk(void* ctx, const mlog_chunk_t* chunk)
+{
+    truth_t* truth = &sim.truth[chunk->seq];
+    frame_t* frame = link_send(&sim.down, OVERHEAD + chunk->len, TX_BUFFER);
+
+    /* a chunk is sent for the first time right after it's pulled */
+    if (!truth->used) {
+        truth->used = 1;
+        truth->header = sim.pull_header;
+        truth->offset = sim.pull_offset;
+        truth->len = chunk->len;
+    }
+
+    if (frame == NULL) {
+        return false;
+    }
+    frame->chunk = *chunk;
+
+    return true;
+}
+
+static void receiver_update(mlog_stream_t* stream)
+{
+    frame_t* frame;
+
+    while ((frame = link_recv(&sim.down)) != NULL) {
+        mlog_chunk_t* chunk = &frame->chunk;
+        truth_t* truth = &sim.truth[chunk->seq];
+
+        if (chunk->acked) {
+            frame_t* ack = link_send(&sim.up, ACK_LEN, UINT32_MAX);
+            if (ack) {
+                ack->chunk.seq = chunk->seq;
+            }
+        }
+        if (truth->received) {
+            continue;
+        }
+        truth->received = 1;
+
+        for (int i = 0; i < chunk->len; i++) {
+            if (chunk->data[i] != log_byte(truth->offset + i, truth->header)) {
+                sim.mismatch++;
+                break;
+            }
+        }
+        if (truth->header) {
+            sim.recv_header += chunk->len;
+        } else {
+            sim.recv_byte += chunk->len;
+        }
+    }
+
+    while ((frame = link_recv(&sim.up)) != NULL) {
+        mlog_stream_ack(stream, frame->chunk.seq);
+    }
+}
+
+static void run(uint32_t seconds, uint32_t log_rate, uint32_t loss, uint8_t acked)
+{
+    static mlog_stream_t stream;
+    mlog_stream_config_t config = { STREAM_RATE, STREAM_RATE / 10, OVERHEAD, 300, 5 };
+    mlog_stream_io_t io = { pull_chunk, send_chunk, &acked };
+    uint64_t pulled = 0;
+    uint64_t sector_byte;
+    uint32_t missed = 0;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.rand = 0x12345678 + loss;
+    sim.loss = loss * 10;
+    sim.log_rate = log_rate;
+    mlog_stream_init(&stream, &config, 0);
+
+    for (uint32_t t = 0; t < seconds * 1000; t++) {
+        sim.now_us = (uint64_t)t * 1000;
+        source_update(1);
+        receiver_update(&stream);
+        if (t % POLL_PERIOD == 0) {
+            mlog_stream_poll(&stream, &io, t);
+        }
+    }
+
+    for (uint32_t i = 0; i < SEQ_NUM; i++) {
+        if (sim.truth[i].used && !sim.truth[i].header) {
+            pulled += sim.truth[i].len;
+            missed += !sim.truth[i].received;
+        }
+    }
+    sector_byte = sim.log_pos / SECTOR_SIZE * SECTOR_SIZE;
+
+    printf("%6u %5u%% %4u %9.0f %7.1f%% %7.1f%% %7.1f%% %7s %6u %6u %6u %6u %8u\n", log_rate, loss, acked,
+        (double)(sim.recv_byte + sim.recv_header) / seconds,
+        100.0 * stream.stat.link_byte / ((double)seconds * BAUDRATE / 10),
+        pulled ? 100.0 * sim.recv_byte / pulled : 0.0,
+        sector_byte ? 100.0 * sim.recv_byte / sector_byte : 0.0,
+        sim.recv_header == HEADER_SIZE ? "ok" : "missing",
+        stream.stat.retry_chunk, stream.stat.lost_chunk, missed, sim.skipped_sector, sim.mismatch);
+
+    if (sim.mismatch) {
+        printf("data of %u chunks mismatch\n", sim.mismatch);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static const uint32_t log_rate[] = { 2000, 20000 };
+    static const uint32_t loss[] = { 0, 1, 5, 10, 20 };
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : 120;
+
+    printf("%u baud, stream rate %u B/s, latency %u ms, %u s per run\n", BAUDRATE, STREAM_RATE,
+        LINK_LATENCY / 1000, seconds);
+    printf("  log: log rate (B/s), loss: frame loss in both directions, ack: data chunks acked\n");
+    printf("  complete: data streamed which is received, coverage: log received\n");
+    printf("  missed: chunks never received, skipped: sectors not streamed since link is slower\n");
+    printf("%6s %6s %4s %9s %8s %8s %8s %7s %6s %6s %6s %6s %8s\n", "log", "loss", "ack", "goodput", "link",
+        "complete", "coverage", "header", "retry", "lost", "missed", "skip", "mismatch");
+
+    for (int i = 0; i < sizeof(log_rate) / sizeof(log_rate[0]); i++) {
+        for (int j = 0; j < sizeof(loss) / sizeof(loss[0]); j++) {
+            for (uint8_t acked = 0; acked <= 1; acked++) {
+                run(seconds, log_rate[i], loss[j], acked);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* POSIX file API replacing the dfs_posix.h of RT-Thread */
+
+#ifndef DFS_POSIX_H__
+#define DFS_POSIX_H__
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* dfs open() has no mode argument, give created files a sane one */
+static inline int dfs_open(const char* file, int flags)
+{
+    return open(file, flags, 0644);
+}
+#define open(file, flags) dfs_open(file, flags)
+
+#endif
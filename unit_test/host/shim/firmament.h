@@ -0,0 +1,167 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* POSIX shim of the RT-Thread and system APIs used by host-native builds of
+ * firmware modules (e.g. uMCN). It replaces the firmament.h of firmware. */
+
+#ifndef FIRMAMENT_H__
+#define FIRMAMENT_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************* RT-Thread *******************/
+typedef long rt_err_t;
+typedef uint32_t rt_tick_t;
+typedef uint8_t rt_uint8_t;
+typedef uint16_t rt_uint16_t;
+typedef uint32_t rt_uint32_t;
+typedef int32_t rt_int32_t;
+
+#define RT_EOK      0
+#define RT_ERROR    1
+#define RT_ETIMEOUT 2
+#define RT_NULL     NULL
+
+#define RT_WAITING_FOREVER -1
+#define RT_WAITING_NO      0
+#define RT_TICK_PER_SECOND 1000
+
+#define RT_IPC_FLAG_FIFO         0x00
+#define RT_TIMER_FLAG_PERIODIC   0x02
+#define RT_TIMER_FLAG_SOFT_TIMER 0x04
+#define RT_EVENT_FLAG_AND        0x01
+#define RT_EVENT_FLAG_OR         0x02
+#define RT_EVENT_FLAG_CLEAR      0x04
+
+#define RT_USED          __attribute__((used))
+#define SECTION(x)       __attribute__((section(x)))
+#define RT_ASSERT(EX)    ((EX) ? (void)0 : abort())
+#define RT_THREAD_PRIORITY_MAX 32
+
+#define TICKS_FROM_MS(_ms) ((RT_TICK_PER_SECOND * (_ms) + 999) / 1000)
+
+struct rt_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint16_t value;
+};
+typedef struct rt_semaphore* rt_sem_t;
+
+struct rt_mutex {
+    pthread_mutex_t lock;
+};
+typedef struct rt_mutex* rt_mutex_t;
+
+struct rt_event {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t set;
+};
+typedef struct rt_event* rt_event_t;
+
+struct rt_thread {
+    pthread_t tid;
+    void (*entry)(void* parameter);
+    void* parameter;
+};
+typedef struct rt_thread* rt_thread_t;
+
+/* soft timers are not run by the shim */
+struct rt_timer {
+    void (*timeout)(void* parameter);
+};
+typedef struct rt_timer* rt_timer_t;
+
+void* rt_malloc(size_t size);
+void rt_free(void* ptr);
+/* the scheduler lock is emulated by a global recursive mutex */
+void rt_enter_critical(void);
+void rt_exit_critical(void);
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char* name, uint32_t value, uint8_t flag);
+rt_sem_t rt_sem_create(const char* name, uint32_t value, uint8_t flag);
+rt_err_t rt_sem_detach(rt_sem_t sem);
+rt_err_t rt_sem_delete(rt_sem_t sem);
+rt_err_t rt_sem_take(rt_sem_t sem, int32_t time);
+rt_err_t rt_sem_release(rt_sem_t sem);
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char* name, uint8_t flag);
+rt_err_t rt_mutex_take(rt_mutex_t mutex, int32_t time);
+rt_err_t rt_mutex_release(rt_mutex_t mutex);
+
+rt_err_t rt_event_init(rt_event_t event, const char* name, uint8_t flag);
+rt_err_t rt_event_detach(rt_event_t event);
+rt_err_t rt_event_send(rt_event_t event, uint32_t set);
+rt_err_t rt_event_recv(rt_event_t event, uint32_t set, uint8_t option, int32_t timeout, uint32_t* recved);
+
+rt_err_t rt_thread_init(rt_thread_t thread, const char* name, void (*entry)(void* parameter), void* parameter,
+                        void* stack_start, uint32_t stack_size, uint8_t priority, uint32_t tick);
+rt_err_t rt_thread_startup(rt_thread_t thread);
+rt_err_t rt_thread_delay(rt_tick_t tick);
+
+void rt_timer_init(rt_timer_t timer, const char* name, void (*timeout)(void* parameter), void* parameter,
+                   rt_tick_t time, uint8_t flag);
+rt_err_t rt_timer_start(rt_timer_t timer);
+
+/******************* System *******************/
+typedef enum {
+    FMT_EOK = 0,
+    FMT_ERROR,
+    FMT_ETIMEOUT,
+    FMT_EFULL,
+    FMT_EEMPTY,
+    FMT_ENOMEM,
+    FMT_ENOSYS,
+    FMT_EBUSY,
+    FMT_EIO,
+    FMT_EINTR,
+    FMT_EINVAL,
+    FMT_ENOTHANDLE,
+} fmt_err_t;
+
+#define FMT_TRY(__exp)                \
+    do {                              \
+        fmt_err_t err = (__exp);      \
+        if (err != FMT_EOK) {         \
+            return err;               \
+        }                             \
+    } while (0)
+
+#define OS_ENTER_CRITICAL rt_enter_critical()
+#define OS_EXIT_CRITICAL  rt_exit_critical()
+
+#define MCN_DISPATCH_THREAD_PRIORITY 5
+
+int console_printf(const char* fmt, ...);
+uint32_t systime_now_ms(void);
+uint64_t systime_now_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "module/ipc/uMCN.h"
+
+#endif
@@ -0,0 +1,5 @@
+/* CMSIS DSP of the generated models, see shim/model/limits.h */
+#include <math.h>
+
+#define arm_sin_f32 sinf
+#define arm_cos_f32 cosf
@@ -0,0 +1,9 @@
+/* The generated models are built for 32-bit ARM and check the word size by
+ * ULONG_MAX. They don't use long, so it's overridden to build them on 64-bit
+ * hosts, only for the models, see mlog_replay_bench in Makefile. */
+#include_next <limits.h>
+
+#undef ULONG_MAX
+#undef LONG_MAX
+#define ULONG_MAX 0xFFFFFFFFU
+#define LONG_MAX  0x7FFFFFFF
@@ -0,0 +1,296 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <firmament.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <time.h>
+
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/**
+ * @brief Get absolute deadline of a timeout in ticks
+ *
+ * @param ts Deadline
+ * @param tick Timeout in ticks
+ */
+static void deadline(struct timespec* ts, int32_t tick)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += tick / RT_TICK_PER_SECOND;
+    ts->tv_nsec += (long)(tick % RT_TICK_PER_SECOND) * (1000000000L / RT_TICK_PER_SECOND);
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void* thread_entry(void* parameter)
+{
+    rt_thread_t thread = (rt_thread_t)parameter;
+
+    thread->entry(thread->parameter);
+
+    return NULL;
+}
+
+void* rt_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+void rt_enter_critical(void)
+{
+    pthread_mutex_lock(&critical_lock);
+}
+
+void rt_exit_critical(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char* name, uint32_t value, uint8_t flag)
+{
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->value = value;
+
+    return RT_EOK;
+}
+
+rt_sem_t rt_sem_create(const char* name, uint32_t value, uint8_t flag)
+{
+    rt_sem_t sem = (rt_sem_t)rt_malloc(sizeof(struct rt_semaphore));
+
+    if (sem) {
+        rt_sem_init(sem, name, value, flag);
+    }
+
+    return sem;
+}
+
+rt_err_t rt_sem_detach(rt_sem_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_delete(rt_sem_t sem)
+{
+    rt_sem_detach(sem);
+    rt_free(sem);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, int32_t time)
+{
+    struct timespec ts;
+    rt_err_t res = RT_EOK;
+
+    deadline(&ts, time);
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->value == 0) {
+        if (time == RT_WAITING_NO) {
+            res = -RT_ETIMEOUT;
+            break;
+        } else if (time == RT_WAITING_FOREVER) {
+            pthread_cond_wait(&sem->cond, &sem->lock);
+        } else if (pthread_cond_timedwait(&sem->cond, &sem->lock, &ts) == ETIMEDOUT) {
+            res = -RT_ETIMEOUT;
+            break;
+        }
+    }
+    if (res == RT_EOK) {
+        sem->value--;
+    }
+    pthread_mutex_unlock(&sem->lock);
+
+    return res;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    sem->value++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char* name, uint8_t flag)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mutex->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, int32_t time)
+{
+    return pthread_mutex_lock(&mutex->lock) == 0 ? RT_EOK : -RT_ERROR;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    return pthread_mutex_unlock(&mutex->lock) == 0 ? RT_EOK : -RT_ERROR;
+}
+
+rt_err_t rt_event_init(rt_event_t event, const char* name, uint8_t flag)
+{
+    pthread_mutex_init(&event->lock, NULL);
+    pthread_cond_init(&event->cond, NULL);
+    event->set = 0;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_event_detach(rt_event_t event)
+{
+    pthread_cond_destroy(&event->cond);
+    pthread_mutex_destroy(&event->lock);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_event_send(rt_event_t event, uint32_t set)
+{
+    pthread_mutex_lock(&event->lock);
+    event->set |= set;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->lock);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_event_recv(rt_event_t event, uint32_t set, uint8_t option, int32_t timeout, uint32_t* recved)
+{
+    struct timespec ts;
+    rt_err_t res = RT_EOK;
+
+    deadline(&ts, timeout);
+
+    pthread_mutex_lock(&event->lock);
+    while (1) {
+        uint32_t match = event->set & set;
+
+        if ((option & RT_EVENT_FLAG_AND) ? match == set : match != 0) {
+            if (recved) {
+                *recved = match;
+            }
+            if (option & RT_EVENT_FLAG_CLEAR) {
+                event->set &= ~match;
+            }
+            break;
+        }
+
+        if (timeout == RT_WAITING_NO) {
+            res = -RT_ETIMEOUT;
+            break;
+        } else if (timeout == RT_WAITING_FOREVER) {
+            pthread_cond_wait(&event->cond, &event->lock);
+        } else if (pthread_cond_timedwait(&event->cond, &event->lock, &ts) == ETIMEDOUT) {
+            res = -RT_ETIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&event->lock);
+
+    return res;
+}
+
+rt_err_t rt_thread_init(rt_thread_t thread, const char* name, void (*entry)(void* parameter), void* parameter,
+                        void* stack_start, uint32_t stack_size, uint8_t priority, uint32_t tick)
+{
+    thread->entry = entry;
+    thread->parameter = parameter;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    if (pthread_create(&thread->tid, NULL, thread_entry, thread) != 0) {
+        return -RT_ERROR;
+    }
+    pthread_detach(thread->tid);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    struct timespec ts = {
+        .tv_sec = tick / RT_TICK_PER_SECOND,
+        .tv_nsec = (long)(tick % RT_TICK_PER_SECOND) * (1000000000L / RT_TICK_PER_SECOND)
+    };
+
+    nanosleep(&ts, NULL);
+
+    return RT_EOK;
+}
+
+void rt_timer_init(rt_timer_t timer, const char* name, void (*timeout)(void* parameter), void* parameter,
+                   rt_tick_t time, uint8_t flag)
+{
+    timer->timeout = timeout;
+}
+
+rt_err_t rt_timer_start(rt_timer_t timer)
+{
+    return RT_EOK;
+}
+
+int console_printf(const char* fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vfprintf(stderr, fmt, args);
+    va_end(args);
+
+    return len;
+}
+
+uint64_t systime_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t systime_now_ms(void)
+{
+    return (uint32_t)(systime_now_us() / 1000);
+}
@@ -0,0 +1,237 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/* Benchmark of the ulog filesystem backend with and without buffering.
+ *   ulog_buffer_bench [bursts]
+ * A high priority thread logs bursts of warning lines and the time spent in the
+ * output of each line is measured, as ulog_output pays when the backend is
+ * called in its context. Unbuffered, each line is written into storage. Buffered,
+ * lines are appended into ulog_buffer and a writer thread, the logger, flushes
+ * it when notified or every 20ms. The storage is simulated by a fixed latency
+ * per write, a throughput and a penalty for writes not aligned to its sectors. */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "module/log/ulog_buffer.h"
+
+#define BURST_NUM       20
+#define BURST_LINES     60
+#define BURST_PERIOD    200  /* ms */
+#define SD_SECTOR       512
+#define SD_WRITE_US     1000 /* latency of a write */
+#define SD_BYTE_NS      2000 /* 500KB/s */
+#define SD_UNALIGNED_US 2000 /* read-modify-write of partial sector */
+#define BUFFER_SIZE     8192 /* ULOG_FS_BUFFER_SIZE */
+#define FLUSH_TIMEOUT   1000 /* ULOG_FS_FLUSH_TIMEOUT */
+#define LOGGER_PERIOD   20   /* ms, event timeout of logger */
+
+typedef struct {
+    uint64_t offset;
+    uint32_t write;
+    uint32_t unaligned;
+    uint64_t busy_us;
+} storage_t;
+
+typedef struct {
+    const char* name;
+    double max_us;
+    double p99_us;
+    double mean_us;
+    uint32_t line;
+} result_t;
+
+static storage_t storage;
+static pthread_mutex_t storage_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond = PTHREAD_COND_INITIALIZER;
+static int event_set;
+static int running;
+static ulog_buffer_t buffer;
+static uint8_t buffer_data[BUFFER_SIZE];
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(uint64_t us)
+{
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+
+    nanosleep(&ts, NULL);
+}
+
+/* the caller is blocked until storage completes the write */
+static int32_t storage_write(void* ctx, const void* buf, uint32_t len)
+{
+    uint64_t cost = SD_WRITE_US + (uint64_t)len * SD_BYTE_NS / 1000;
+
+    pthread_mutex_lock(&storage_lock);
+    if (storage.offset % SD_SECTOR || len % SD_SECTOR) {
+        cost += SD_UNALIGNED_US;
+        storage.unaligned++;
+    }
+    storage.offset += len;
+    storage.write++;
+    storage.busy_us += cost;
+    sleep_us(cost);
+    pthread_mutex_unlock(&storage_lock);
+
+    return len;
+}
+
+static void ring_lock_cb(void* ctx)
+{
+    pthread_mutex_lock(&ring_lock);
+}
+
+static void ring_unlock_cb(void* ctx)
+{
+    pthread_mutex_unlock(&ring_lock);
+}
+
+static const ulog_buffer_io_t buffer_io = {
+    .write = storage_write,
+    .lock = ring_lock_cb,
+    .unlock = ring_unlock_cb,
+    .ctx = NULL
+};
+
+static void send_event(void)
+{
+    pthread_mutex_lock(&event_lock);
+    event_set = 1;
+    pthread_cond_signal(&event_cond);
+    pthread_mutex_unlock(&event_lock);
+}
+
+/* logger thread, see task_logger_entry() */
+static void* logger_entry(void* arg)
+{
+    struct timespec deadline;
+
+    while (running) {
+        pthread_mutex_lock(&event_lock);
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOGGER_PERIOD * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (!event_set && running) {
+            if (pthread_cond_timedwait(&event_cond, &event_lock, &deadline)) {
+                break;
+            }
+        }
+        event_set = 0;
+        pthread_mutex_unlock(&event_lock);
+
+        ulog_buffer_flush(&buffer, now_us() / 1000);
+    }
+    ulog_buffer_sync(&buffer);
+
+    return NULL;
+}
+
+static int compare(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void run(int buffered, uint32_t bursts, result_t* result)
+{
+    uint32_t num = bursts * BURST_LINES;
+    double* sample = malloc(num * sizeof(double));
+    ulog_buffer_config_t config = { BUFFER_SIZE, SD_SECTOR, FLUSH_TIMEOUT };
+    struct sched_param param = { sched_get_priority_max(SCHED_FIFO) };
+    pthread_t logger;
+    double sum = 0;
+    char line[128];
+
+    memset(&storage, 0, sizeof(storage));
+    ulog_buffer_init(&buffer, &config, &buffer_io, buffer_data);
+    /* the logging thread is the one of highest priority, if it's allowed */
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    if (buffered) {
+        running = 1;
+        pthread_create(&logger, NULL, logger_entry, NULL);
+    }
+
+    for (uint32_t n = 0; n < num; n++) {
+        uint64_t start;
+        int len;
+
+        if (n && n % BURST_LINES == 0) {
+            sleep_us(BURST_PERIOD * 1000);
+        }
+        len = snprintf(line, sizeof(line), "[%llu] W/Vehicle: sensor timeout, imu:%u mag:%u baro:%u gps:%u\n",
+            (unsigned long long)(now_us() / 1000), n, n % 7, n % 11, n % 13);
+
+        start = now_us();
+        if (buffered) {
+            ulog_buffer_append(&buffer, line, len);
+            send_event();
+        } else {
+            storage_write(NULL, line, len);
+        }
+        sample[n] = now_us() - start;
+        sum += sample[n];
+    }
+
+    if (buffered) {
+        running = 0;
+        send_event();
+        pthread_join(logger, NULL);
+    }
+
+    qsort(sample, num, sizeof(double), compare);
+    result->name = buffered ? "buffered" : "direct";
+    result->line = num;
+    result->max_us = sample[num - 1];
+    result->p99_us = sample[num * 99 / 100];
+    result->mean_us = sum / num;
+    free(sample);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t bursts = argc > 1 ? atoi(argv[1]) : BURST_NUM;
+    result_t result;
+
+    printf("%u bursts of %u lines, storage %uus per write, %uns per byte, +%uus unaligned\n", bursts, BURST_LINES,
+        SD_WRITE_US, SD_BYTE_NS, SD_UNALIGNED_US);
+    printf("%-9s %8s %8s %8s %8s %8s %9s %8s\n", "mode", "max(us)", "p99(us)", "mean(us)", "write", "unalign",
+        "storage(ms)", "dropped");
+
+    for (int buffered = 0; buffered < 2; buffered++) {
+        run(buffered, bursts, &result);
+        printf("%-9s %8.0f %8.0f %8.1f %8u %8u %11.0f %8u\n", result.name, result.max_us, result.p99_us,
+            result.mean_us, storage.write, storage.unaligned, storage.busy_us / 1000.0,
+            buffered ? buffer.stat.drop_line : 0);
+    }
+
+    return 0;
+}
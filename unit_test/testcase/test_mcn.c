@@ -0,0 +1,706 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#include <firmament.h>
+#include <dfs_posix.h>
+#include <string.h>
+
+#include <utest.h>
+
+#define TEST_TOPIC_SIZE       2048
+#define TEST_LATENCY_SAMPLES  500
+#define TEST_PUBLISH_PRIORITY (RT_THREAD_PRIORITY_MAX - 2)
+#define TEST_QUEUE_DEPTH      7
+#define TEST_BENCH_LOOPS      1000
+#define TEST_CAPTURE_FILE     "/test_mcn.rec"
+#define TEST_RECORD_NUM       5
+
+MCN_DEFINE(test_mcn_large, TEST_TOPIC_SIZE);
+MCN_DEFINE_QUEUE(test_mcn_queue, sizeof(uint32_t), TEST_QUEUE_DEPTH);
+MCN_DEFINE_LOAN(test_mcn_loan, TEST_TOPIC_SIZE, 1, 1);
+MCN_DEFINE(test_mcn_ws_a, sizeof(uint32_t));
+MCN_DEFINE(test_mcn_ws_b, sizeof(uint32_t));
+MCN_DEFINE(test_mcn_inst0, sizeof(uint32_t));
+MCN_DEFINE(test_mcn_inst1, sizeof(uint32_t));
+MCN_MULTI_DEFINE(test_mcn_multi, 20, MCN_HUB(test_mcn_inst0), MCN_HUB(test_mcn_inst1));
+
+/* topic data with padding between members */
+typedef struct {
+    uint32_t timestamp;
+    uint8_t flag;
+    float vec[3];
+    double lat;
+    uint16_t id;
+} test_schema_t;
+
+MCN_DEFINE(test_mcn_schema, sizeof(test_schema_t));
+
+MCN_SCHEMA_DEFINE(test_schema_t,
+    MCN_FIELD(test_schema_t, timestamp, MCN_UINT32),
+    MCN_FIELD(test_schema_t, flag, MCN_UINT8),
+    MCN_FIELD_VEC(test_schema_t, vec, MCN_FLOAT),
+    MCN_FIELD(test_schema_t, lat, MCN_DOUBLE),
+    MCN_FIELD(test_schema_t, id, MCN_UINT16));
+
+/* extra topics to benchmark topic lookup with 100+ topics */
+#define TEST_TOPIC_DEFINE_8(_p)                                                        \
+    MCN_DEFINE(_p##_0, 4);                                                             \
+    MCN_DEFINE(_p##_1, 4);                                                             \
+    MCN_DEFINE(_p##_2, 4);                                                             \
+    MCN_DEFINE(_p##_3, 4);                                                             \
+    MCN_DEFINE(_p##_4, 4);                                                             \
+    MCN_DEFINE(_p##_5, 4);                                                             \
+    MCN_DEFINE(_p##_6, 4);                                                             \
+    MCN_DEFINE(_p##_7, 4)
+#define TEST_TOPIC_HUB_8(_p)                                                           \
+    MCN_HUB(_p##_0), MCN_HUB(_p##_1), MCN_HUB(_p##_2), MCN_HUB(_p##_3), MCN_HUB(_p##_4), \
+        MCN_HUB(_p##_5), MCN_HUB(_p##_6), MCN_HUB(_p##_7)
+
+TEST_TOPIC_DEFINE_8(test_mcn_reg_a);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_b);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_c);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_d);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_e);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_f);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_g);
+TEST_TOPIC_DEFINE_8(test_mcn_reg_h);
+
+static McnHub_t reg_hubs[] = {
+    TEST_TOPIC_HUB_8(test_mcn_reg_a),
+    TEST_TOPIC_HUB_8(test_mcn_reg_b),
+    TEST_TOPIC_HUB_8(test_mcn_reg_c),
+    TEST_TOPIC_HUB_8(test_mcn_reg_d),
+    TEST_TOPIC_HUB_8(test_mcn_reg_e),
+    TEST_TOPIC_HUB_8(test_mcn_reg_f),
+    TEST_TOPIC_HUB_8(test_mcn_reg_g),
+    TEST_TOPIC_HUB_8(test_mcn_reg_h),
+};
+
+static uint8_t pub_buffer[TEST_TOPIC_SIZE];
+static uint8_t sub_buffer[TEST_TOPIC_SIZE];
+static volatile uint8_t publisher_running;
+static struct rt_semaphore publisher_exit;
+
+static void publisher_entry(void* parameter)
+{
+    uint8_t cnt = 0;
+
+    while (publisher_running) {
+        memset(pub_buffer, cnt++, TEST_TOPIC_SIZE);
+        mcn_publish(MCN_HUB(test_mcn_large), pub_buffer);
+    }
+
+    rt_sem_release(&publisher_exit);
+}
+
+static void test_seqlock_consistency(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_large), NULL, NULL);
+    uint32_t torn = 0;
+
+    uassert_not_null(node);
+
+    publisher_running = 1;
+    rt_thread_t tid = rt_thread_create("mcn_pub", publisher_entry, RT_NULL, 1024, TEST_PUBLISH_PRIORITY, 5);
+    uassert_not_null(tid);
+    rt_thread_startup(tid);
+
+    for (int i = 0; i < TEST_LATENCY_SAMPLES; i++) {
+        rt_thread_delay(1);
+
+        if (mcn_copy(MCN_HUB(test_mcn_large), node, sub_buffer) != FMT_EOK) {
+            continue;
+        }
+        for (int k = 1; k < TEST_TOPIC_SIZE; k++) {
+            if (sub_buffer[k] != sub_buffer[0]) {
+                torn++;
+                break;
+            }
+        }
+    }
+
+    publisher_running = 0;
+    rt_sem_take(&publisher_exit, RT_WAITING_FOREVER);
+
+    uassert_int_equal(torn, 0);
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_large), node), FMT_EOK);
+}
+
+static void test_publish_busy(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_loan), NULL, NULL);
+    uint32_t busy_drop = MCN_HUB(test_mcn_loan)->busy_drop;
+    uint8_t* loan;
+
+    uassert_not_null(node);
+
+    /* a publish preempting an unfinished one is rejected and counted */
+    loan = mcn_loan(MCN_HUB(test_mcn_loan));
+    uassert_not_null(loan);
+    memset(loan, 1, TEST_TOPIC_SIZE);
+    memset(pub_buffer, 2, TEST_TOPIC_SIZE);
+    uassert_int_equal(mcn_publish(MCN_HUB(test_mcn_loan), pub_buffer), FMT_EBUSY);
+    uassert_null(mcn_loan(MCN_HUB(test_mcn_loan)));
+    uassert_int_equal(MCN_HUB(test_mcn_loan)->busy_drop, busy_drop + 2);
+    uassert_int_equal(mcn_commit(MCN_HUB(test_mcn_loan)), FMT_EOK);
+
+    /* the sample of the unfinished publish is delivered */
+    uassert_true(mcn_poll(node));
+    uassert_int_equal(mcn_copy(MCN_HUB(test_mcn_loan), node, sub_buffer), FMT_EOK);
+    uassert_int_equal(sub_buffer[0], 1);
+
+    uassert_int_equal(mcn_publish(MCN_HUB(test_mcn_loan), pub_buffer), FMT_EOK);
+    uassert_int_equal(MCN_HUB(test_mcn_loan)->busy_drop, busy_drop + 2);
+
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_loan), node), FMT_EOK);
+}
+
+static void test_queue_copy_n(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_queue), NULL, NULL);
+    uint32_t samples[TEST_QUEUE_DEPTH + 1];
+    uint32_t num, lost;
+    uint32_t val;
+
+    uassert_not_null(node);
+
+    /* drain samples left by previous runs */
+    num = TEST_QUEUE_DEPTH + 1;
+    mcn_copy_n(MCN_HUB(test_mcn_queue), node, samples, &num, &lost);
+
+    /* less samples than queue depth, nothing lost */
+    for (val = 1; val <= 5; val++) {
+        mcn_publish(MCN_HUB(test_mcn_queue), &val);
+    }
+    num = TEST_QUEUE_DEPTH + 1;
+    uassert_int_equal(mcn_copy_n(MCN_HUB(test_mcn_queue), node, samples, &num, &lost), FMT_EOK);
+    uassert_int_equal(num, 5);
+    uassert_int_equal(lost, 0);
+    uassert_int_equal(samples[0], 1);
+    uassert_int_equal(samples[4], 5);
+    uassert_false(mcn_poll(node));
+
+    /* queue overflow, oldest samples are overwritten */
+    for (val = 6; val <= 15; val++) {
+        mcn_publish(MCN_HUB(test_mcn_queue), &val);
+    }
+    num = TEST_QUEUE_DEPTH + 1;
+    uassert_int_equal(mcn_copy_n(MCN_HUB(test_mcn_queue), node, samples, &num, &lost), FMT_EOK);
+    uassert_int_equal(num, TEST_QUEUE_DEPTH);
+    uassert_int_equal(lost, 10 - TEST_QUEUE_DEPTH);
+    uassert_int_equal(samples[0], 15 - TEST_QUEUE_DEPTH + 1);
+    uassert_int_equal(samples[TEST_QUEUE_DEPTH - 1], 15);
+
+    /* partial read keeps the rest pending */
+    for (val = 16; val <= 18; val++) {
+        mcn_publish(MCN_HUB(test_mcn_queue), &val);
+    }
+    num = 2;
+    mcn_copy_n(MCN_HUB(test_mcn_queue), node, samples, &num, &lost);
+    uassert_int_equal(num, 2);
+    uassert_int_equal(samples[1], 17);
+    uassert_true(mcn_poll(node));
+    num = 2;
+    mcn_copy_n(MCN_HUB(test_mcn_queue), node, samples, &num, &lost);
+    uassert_int_equal(num, 1);
+    uassert_int_equal(samples[0], 18);
+
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_queue), node), FMT_EOK);
+}
+
+static void test_loan_borrow(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_loan), NULL, NULL);
+    uint32_t copy_time, loan_time;
+    uint32_t checksum = 0;
+    uint64_t start;
+
+    uassert_not_null(node);
+
+    /* publish and copy, the payload is copied twice */
+    start = systime_now_us();
+    for (int i = 0; i < TEST_BENCH_LOOPS; i++) {
+        memset(pub_buffer, i, TEST_TOPIC_SIZE);
+        mcn_publish(MCN_HUB(test_mcn_loan), pub_buffer);
+        mcn_copy(MCN_HUB(test_mcn_loan), node, sub_buffer);
+        checksum += sub_buffer[TEST_TOPIC_SIZE - 1];
+    }
+    copy_time = systime_now_us() - start;
+
+    /* loan and borrow, the payload is written and read in place */
+    start = systime_now_us();
+    for (int i = 0; i < TEST_BENCH_LOOPS; i++) {
+        uint8_t* loan = mcn_loan(MCN_HUB(test_mcn_loan));
+        uassert_not_null(loan);
+        if (loan == NULL) {
+            break;
+        }
+        memset(loan, i, TEST_TOPIC_SIZE);
+        uassert_int_equal(mcn_commit(MCN_HUB(test_mcn_loan)), FMT_EOK);
+
+        const uint8_t* data = mcn_borrow(MCN_HUB(test_mcn_loan), node);
+        uassert_not_null(data);
+        if (data == NULL) {
+            break;
+        }
+        checksum -= data[TEST_TOPIC_SIZE - 1];
+        mcn_release(MCN_HUB(test_mcn_loan), data);
+    }
+    loan_time = systime_now_us() - start;
+
+    /* the test writes and reads the payload in both cases, uMCN copies it twice
+     * with publish/copy and never with loan/borrow */
+    console_printf("%d bytes topic, publish/copy: %ldus, %ld KB/s delivered, %d bytes copied per sample\n",
+        TEST_TOPIC_SIZE, copy_time, copy_time ? (uint32_t)(TEST_BENCH_LOOPS * (uint64_t)TEST_TOPIC_SIZE * 1000000 / 1024 / copy_time) : 0,
+        2 * TEST_TOPIC_SIZE);
+    console_printf("%d bytes topic, loan/borrow: %ldus, %ld KB/s delivered, 0 bytes copied per sample\n",
+        TEST_TOPIC_SIZE, loan_time, loan_time ? (uint32_t)(TEST_BENCH_LOOPS * (uint64_t)TEST_TOPIC_SIZE * 1000000 / 1024 / loan_time) : 0);
+
+    /* timing is only reported, it depends on the load of target */
+    uassert_int_equal(checksum, 0);
+
+    /* borrowed data is kept while the topic is published again */
+    const uint8_t* data = mcn_borrow(MCN_HUB(test_mcn_loan), node);
+    uassert_not_null(data);
+    uint8_t val = data[0];
+    memset(pub_buffer, val + 1, TEST_TOPIC_SIZE);
+    for (int i = 0; i < 4; i++) {
+        mcn_publish(MCN_HUB(test_mcn_loan), pub_buffer);
+    }
+    uassert_int_equal(data[0], val);
+    uassert_int_equal(mcn_release(MCN_HUB(test_mcn_loan), data), FMT_EOK);
+
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_loan), node), FMT_EOK);
+}
+
+static McnHub_t find_in_list(const char* name)
+{
+    McnList_t ite = mcn_get_list();
+
+    for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+        if (strcmp(hub->obj_name, name) == 0) {
+            return hub;
+        }
+    }
+
+    return NULL;
+}
+
+static void test_registry_lookup(void)
+{
+    uint32_t list_time, hash_time;
+    uint32_t lookup_num = 0;
+    uint32_t list_miss = 0, hash_miss = 0;
+    uint64_t start;
+
+    uassert_true(mcn_get_topic_num() >= sizeof(reg_hubs) / sizeof(McnHub_t));
+
+    for (int i = 0; i < sizeof(reg_hubs) / sizeof(McnHub_t); i++) {
+        uassert_true(mcn_find(reg_hubs[i]->obj_name) == reg_hubs[i]);
+        uassert_true(mcn_find_by_id(reg_hubs[i]->id) == reg_hubs[i]);
+        uassert_int_equal(reg_hubs[i]->id, mcn_topic_id(reg_hubs[i]->obj_name));
+    }
+    uassert_null(mcn_find("test_mcn_not_exist"));
+
+    /* look up every advertised topic by walking the list and by the registry,
+     * results are checked after timing, so only the lookups are measured */
+    start = systime_now_us();
+    for (int n = 0; n < 10; n++) {
+        McnList_t ite = mcn_get_list();
+        for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+            list_miss += find_in_list(hub->obj_name) != hub;
+            lookup_num++;
+        }
+    }
+    list_time = systime_now_us() - start;
+
+    start = systime_now_us();
+    for (int n = 0; n < 10; n++) {
+        McnList_t ite = mcn_get_list();
+        for (McnHub_t hub = mcn_iterate(&ite); hub != NULL; hub = mcn_iterate(&ite)) {
+            hash_miss += mcn_find(hub->obj_name) != hub;
+        }
+    }
+    hash_time = systime_now_us() - start;
+
+    /* timing is only reported, the list walk may be faster with a few topics */
+    console_printf("%ld topics lookup, list: %ldns/op, registry: %ldns/op\n", lookup_num / 10,
+        (uint32_t)(list_time * 1000ULL / lookup_num), (uint32_t)(hash_time * 1000ULL / lookup_num));
+
+    uassert_int_equal(list_miss, 0);
+    uassert_int_equal(hash_miss, 0);
+}
+
+static void delayed_publisher_entry(void* parameter)
+{
+    uint32_t val = 1;
+
+    rt_thread_delay(TICKS_FROM_MS(10));
+    mcn_publish((McnHub_t)parameter, &val);
+}
+
+static void test_waitset(void)
+{
+    McnWaitset waitset;
+    McnNode_t node_a = mcn_subscribe(MCN_HUB(test_mcn_ws_a), NULL, NULL);
+    McnNode_t node_b = mcn_subscribe(MCN_HUB(test_mcn_ws_b), NULL, NULL);
+    uint32_t val = 0;
+    uint32_t ready;
+
+    uassert_not_null(node_a);
+    uassert_not_null(node_b);
+    uassert_int_equal(mcn_waitset_init(&waitset, "mcn_ws"), FMT_EOK);
+    uassert_int_equal(mcn_waitset_attach(&waitset, node_a, 0), FMT_EOK);
+    uassert_int_equal(mcn_waitset_attach(&waitset, node_b, 1), FMT_EOK);
+    /* bit already used */
+    uassert_int_equal(mcn_waitset_attach(&waitset, node_b, 0), FMT_EBUSY);
+
+    /* drain the ready bits of data published by previous runs */
+    mcn_waitset_wait(&waitset, 0);
+
+    /* nothing published */
+    uassert_int_equal(mcn_waitset_wait(&waitset, TICKS_FROM_MS(5)), 0);
+
+    /* several publishes before waiting are reported by one wakeup */
+    mcn_publish(MCN_HUB(test_mcn_ws_a), &val);
+    mcn_publish(MCN_HUB(test_mcn_ws_b), &val);
+    mcn_publish(MCN_HUB(test_mcn_ws_a), &val);
+    uassert_int_equal(mcn_waitset_wait(&waitset, 0), 0x03);
+    uassert_int_equal(mcn_waitset_wait(&waitset, 0), 0);
+
+    /* wakeup by publish from another thread */
+    rt_thread_t tid = rt_thread_create("mcn_ws", delayed_publisher_entry, MCN_HUB(test_mcn_ws_b), 1024, TEST_PUBLISH_PRIORITY, 5);
+    uassert_not_null(tid);
+    rt_thread_startup(tid);
+    ready = mcn_waitset_wait(&waitset, TICKS_FROM_MS(100));
+    uassert_int_equal(ready, 0x02);
+    uassert_true(mcn_poll(node_b));
+    uassert_int_equal(mcn_copy(MCN_HUB(test_mcn_ws_b), node_b, &val), FMT_EOK);
+    uassert_int_equal(val, 1);
+
+    uassert_int_equal(mcn_waitset_detach(&waitset, node_a), FMT_EOK);
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_ws_b), node_b), FMT_EOK);
+    uassert_int_equal(mcn_waitset_deinit(&waitset), FMT_EOK);
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_ws_a), node_a), FMT_EOK);
+}
+
+static void test_throttle(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_ws_a), NULL, NULL);
+    uint32_t val = 0;
+    uint32_t delivered = 0;
+
+    uassert_not_null(node);
+
+    /* deliver one of every 10 publishes */
+    mcn_node_throttle(node, 0, 10);
+    mcn_node_clear(node);
+    for (int i = 0; i < 100; i++) {
+        mcn_publish(MCN_HUB(test_mcn_ws_a), &val);
+        if (mcn_poll(node)) {
+            delivered++;
+            mcn_node_clear(node);
+        }
+    }
+    uassert_int_equal(delivered, 10);
+    uassert_int_equal(node->skipped, 90);
+
+    /* deliver at most once every 20ms */
+    delivered = 0;
+    mcn_node_throttle(node, 20, 0);
+    for (int i = 0; i < 100; i++) {
+        mcn_publish(MCN_HUB(test_mcn_ws_a), &val);
+        if (mcn_poll(node)) {
+            delivered++;
+            mcn_node_clear(node);
+        }
+        rt_thread_delay(TICKS_FROM_MS(1));
+    }
+    uassert_in_range(delivered, 3, 7);
+
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_ws_a), node), FMT_EOK);
+}
+
+static void test_profile(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_ws_a), NULL, NULL);
+    McnProfile profile;
+    McnProfileRecord record;
+    uint32_t val = 0;
+
+    uassert_not_null(node);
+    uassert_int_equal(mcn_profile_get(MCN_HUB(test_mcn_ws_a), &profile), FMT_EEMPTY);
+    uassert_int_equal(mcn_profile_start(MCN_HUB(test_mcn_ws_a)), FMT_EOK);
+
+    for (int i = 0; i < 10; i++) {
+        mcn_publish(MCN_HUB(test_mcn_ws_a), &val);
+        rt_thread_delay(TICKS_FROM_MS(2));
+        mcn_copy(MCN_HUB(test_mcn_ws_a), node, &val);
+        /* copy without new publish is not counted */
+        mcn_copy(MCN_HUB(test_mcn_ws_a), node, &val);
+    }
+
+    uassert_int_equal(mcn_profile_get(MCN_HUB(test_mcn_ws_a), &profile), FMT_EOK);
+    uassert_int_equal(profile.interval.count, 9);
+    uassert_int_equal(profile.latency.count, 10);
+    uassert_true(profile.interval.min >= 1000);
+    uassert_true(profile.latency.min >= 1000);
+    uassert_true(mcn_hist_percentile(&profile.interval, 50) >= profile.interval.min);
+    uassert_true(mcn_hist_percentile(&profile.interval, 99) <= profile.interval.max);
+
+    uassert_int_equal(mcn_profile_dump(MCN_HUB(test_mcn_ws_a), &record), FMT_EOK);
+    uassert_int_equal(record.magic, MCN_PROFILE_MAGIC);
+    uassert_int_equal(record.topic_id, mcn_topic_id("test_mcn_ws_a"));
+    uassert_int_equal(record.latency.count, 10);
+
+    uassert_int_equal(mcn_profile_stop(MCN_HUB(test_mcn_ws_a)), FMT_EOK);
+    uassert_null(MCN_HUB(test_mcn_ws_a)->profile);
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_ws_a), node), FMT_EOK);
+}
+
+static uint32_t defer_cb_cnt;
+static uint32_t defer_cb_val;
+static rt_thread_t defer_cb_thread;
+
+static void defer_cb(void* parameter)
+{
+    defer_cb_cnt++;
+    defer_cb_val = *(uint32_t*)parameter;
+    defer_cb_thread = rt_thread_self();
+}
+
+static void test_deferred_dispatch(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_HUB(test_mcn_ws_b), NULL, defer_cb);
+    uint32_t buffer;
+    uint32_t val;
+
+    uassert_not_null(node);
+    uassert_int_equal(mcn_node_defer_callback(MCN_HUB(test_mcn_ws_b), node, &buffer), FMT_EOK);
+    defer_cb_cnt = 0;
+
+    /* publishes before the dispatcher runs are coalesced into one callback */
+    rt_enter_critical();
+    for (val = 1; val <= 5; val++) {
+        mcn_publish(MCN_HUB(test_mcn_ws_b), &val);
+    }
+    rt_exit_critical();
+    rt_thread_delay(TICKS_FROM_MS(5));
+
+    uassert_int_equal(defer_cb_cnt, 1);
+    uassert_int_equal(defer_cb_val, 5);
+    uassert_int_equal(node->coalesced, 4);
+    uassert_true(defer_cb_thread != rt_thread_self());
+
+    /* back to inline callback */
+    uassert_int_equal(mcn_node_defer_callback(MCN_HUB(test_mcn_ws_b), node, NULL), FMT_EOK);
+    mcn_publish(MCN_HUB(test_mcn_ws_b), &val);
+    uassert_int_equal(defer_cb_cnt, 2);
+    uassert_true(defer_cb_thread == rt_thread_self());
+
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_ws_b), node), FMT_EOK);
+}
+
+static void test_multi_instance(void)
+{
+    McnMultiNode multi_node;
+    uint32_t val;
+    uint32_t switch_cnt = MCN_MULTI(test_mcn_multi)->switch_cnt;
+
+    uassert_int_equal(MCN_MULTI(test_mcn_multi)->instance_num, 2);
+    uassert_int_equal(mcn_multi_subscribe(MCN_MULTI(test_mcn_multi), &multi_node, NULL), FMT_EOK);
+    mcn_multi_set_score(MCN_MULTI(test_mcn_multi), 0, 0);
+    mcn_multi_set_score(MCN_MULTI(test_mcn_multi), 1, 0);
+
+    /* same score, keep the primary instance */
+    val = 0;
+    mcn_publish(MCN_HUB(test_mcn_inst0), &val);
+    val = 1;
+    mcn_publish(MCN_HUB(test_mcn_inst1), &val);
+    uassert_true(mcn_multi_poll(&multi_node));
+    uassert_int_equal(mcn_multi_copy(&multi_node, &val), FMT_EOK);
+    uassert_int_equal(val, mcn_multi_select(MCN_MULTI(test_mcn_multi)));
+
+    /* switch to instance with higher score */
+    mcn_multi_set_score(MCN_MULTI(test_mcn_multi), 1, 10);
+    mcn_multi_set_score(MCN_MULTI(test_mcn_multi), 0, 5);
+    uassert_int_equal(mcn_multi_copy(&multi_node, &val), FMT_EOK);
+    uassert_int_equal(val, 1);
+
+    /* switch away from the instance which is not updated within timeout */
+    for (int i = 0; i < 5; i++) {
+        val = 0;
+        mcn_publish(MCN_HUB(test_mcn_inst0), &val);
+        rt_thread_delay(TICKS_FROM_MS(10));
+        mcn_multi_select(MCN_MULTI(test_mcn_multi));
+    }
+    uassert_int_equal(mcn_multi_select(MCN_MULTI(test_mcn_multi)), 0);
+    uassert_int_equal(mcn_multi_copy(&multi_node, &val), FMT_EOK);
+    uassert_int_equal(val, 0);
+
+    /* switch back once it's updated again */
+    val = 1;
+    mcn_publish(MCN_HUB(test_mcn_inst1), &val);
+    uassert_int_equal(mcn_multi_select(MCN_MULTI(test_mcn_multi)), 1);
+    uassert_true(MCN_MULTI(test_mcn_multi)->switch_cnt - switch_cnt >= 2);
+
+    uassert_int_equal(mcn_multi_unsubscribe(&multi_node), FMT_EOK);
+}
+
+static void test_record_replay(void)
+{
+    McnRecordStats record_stats;
+    McnReplayStats replay_stats;
+    McnNode_t node;
+    uint32_t val[TEST_QUEUE_DEPTH];
+    uint32_t num = TEST_QUEUE_DEPTH, lost;
+
+    mcn_record_topic(NULL, false);
+    mcn_record_topic(MCN_HUB(test_mcn_queue), true);
+    uassert_int_equal(mcn_record_start(TEST_CAPTURE_FILE, 0), FMT_EOK);
+    uassert_int_equal(mcn_record_start(TEST_CAPTURE_FILE, 0), FMT_EBUSY);
+
+    for (uint32_t i = 0; i < TEST_RECORD_NUM; i++) {
+        mcn_publish(MCN_HUB(test_mcn_queue), &i);
+        /* topic without record flag is not recorded */
+        mcn_publish(MCN_HUB(test_mcn_ws_a), &i);
+        rt_thread_delay(TICKS_FROM_MS(2));
+    }
+    uassert_int_equal(mcn_record_stop(), FMT_EOK);
+    mcn_record_topic(MCN_HUB(test_mcn_queue), false);
+
+    mcn_record_get_stats(&record_stats);
+    uassert_int_equal(record_stats.record_cnt, TEST_RECORD_NUM);
+    uassert_int_equal(record_stats.drop_cnt, 0);
+    uassert_int_equal(record_stats.write_error, 0);
+
+    /* replayed samples arrive in the recorded order */
+    node = mcn_subscribe(MCN_HUB(test_mcn_queue), NULL, NULL);
+    uassert_not_null(node);
+    uassert_int_equal(mcn_replay(TEST_CAPTURE_FILE, MCN_REPLAY_FAST, &replay_stats), FMT_EOK);
+    uassert_int_equal(replay_stats.replay_cnt, TEST_RECORD_NUM);
+    uassert_int_equal(replay_stats.skip_cnt, 0);
+    uassert_int_equal(mcn_copy_n(MCN_HUB(test_mcn_queue), node, val, &num, &lost), FMT_EOK);
+    uassert_int_equal(num, TEST_RECORD_NUM);
+    for (uint32_t i = 0; i < TEST_RECORD_NUM; i++) {
+        uassert_int_equal(val[i], i);
+    }
+
+    /* realtime replay keeps the original timing */
+    uassert_int_equal(mcn_replay(TEST_CAPTURE_FILE, MCN_REPLAY_REALTIME, &replay_stats), FMT_EOK);
+    uassert_int_equal(replay_stats.replay_cnt, TEST_RECORD_NUM);
+    uassert_int_equal(replay_stats.error.count, TEST_RECORD_NUM);
+    uassert_true(replay_stats.duration_ms >= replay_stats.capture_ms);
+    console_printf("realtime replay error: avg %ldus max %ldus\n",
+                   (uint32_t)(replay_stats.error.sum / replay_stats.error.count), replay_stats.error.max);
+
+    uassert_int_equal(mcn_unsubscribe(MCN_HUB(test_mcn_queue), node), FMT_EOK);
+    unlink(TEST_CAPTURE_FILE);
+}
+
+static void test_schema(void)
+{
+    test_schema_t data = { .timestamp = 100, .flag = 1, .vec = { 1.0f, 2.0f, 3.0f }, .lat = 0.5, .id = 7 };
+    uint8_t packed[sizeof(test_schema_t)];
+    char text[100];
+    /* vec is described with wrong type */
+    McnField bad_field[] = { MCN_FIELD_VEC(test_schema_t, vec, MCN_DOUBLE) };
+    McnSchema bad_schema = { "bad", sizeof(test_schema_t), 1, bad_field };
+
+    uassert_int_equal(mcn_schema_check(MCN_SCHEMA(test_schema_t)), FMT_EOK);
+    uassert_int_equal(mcn_schema_check(&bad_schema), FMT_EINVAL);
+
+    /* schema size must match topic size */
+    uassert_int_equal(mcn_set_schema(MCN_HUB(test_mcn_large), MCN_SCHEMA(test_schema_t)), FMT_EINVAL);
+    uassert_int_equal(mcn_set_schema(MCN_HUB(test_mcn_schema), MCN_SCHEMA(test_schema_t)), FMT_EOK);
+    uassert_true(MCN_HUB(test_mcn_schema)->schema == MCN_SCHEMA(test_schema_t));
+
+    uassert_int_equal(MCN_SCHEMA(test_schema_t)->field[2].offset, offsetof(test_schema_t, vec));
+    uassert_int_equal(MCN_SCHEMA(test_schema_t)->field[2].num, 3);
+    uassert_not_null(mcn_schema_find_field(MCN_SCHEMA(test_schema_t), "lat"));
+    uassert_null(mcn_schema_find_field(MCN_SCHEMA(test_schema_t), "lon"));
+
+    /* padding is removed by pack */
+    uassert_int_equal(mcn_schema_packed_size(MCN_SCHEMA(test_schema_t)), 27);
+    uassert_int_equal(mcn_schema_pack(MCN_SCHEMA(test_schema_t), &data, packed), 27);
+    uassert_buf_equal(&packed[0], &data.timestamp, 4);
+    uassert_int_equal(packed[4], data.flag);
+    uassert_buf_equal(&packed[5], data.vec, 12);
+    uassert_buf_equal(&packed[17], &data.lat, 8);
+    uassert_buf_equal(&packed[25], &data.id, 2);
+
+    mcn_schema_format(MCN_SCHEMA(test_schema_t), &data, text, sizeof(text));
+    uassert_str_equal(text, "timestamp:100 flag:1 vec:1.000000 2.000000 3.000000 lat:0.500000 id:7\n");
+    /* text is truncated if buffer is too small */
+    uassert_int_equal(mcn_schema_format(MCN_SCHEMA(test_schema_t), &data, text, 10), 9);
+    uassert_int_equal(strlen(text), 9);
+
+    uassert_int_equal(mcn_set_schema(MCN_HUB(test_mcn_schema), NULL), FMT_EOK);
+}
+
+static rt_err_t testcase_init(void)
+{
+    if (MCN_HUB(test_mcn_large)->pdata == NULL) {
+        RT_TRY(mcn_advertise(MCN_HUB(test_mcn_large), NULL));
+    }
+    if (MCN_HUB(test_mcn_queue)->pdata == NULL) {
+        RT_TRY(mcn_advertise_queue(MCN_HUB(test_mcn_queue), TEST_QUEUE_DEPTH, NULL));
+    }
+    if (MCN_HUB(test_mcn_loan)->pdata == NULL) {
+        RT_TRY(mcn_advertise_loan(MCN_HUB(test_mcn_loan), 1, 1, NULL));
+    }
+
+    if (MCN_HUB(test_mcn_ws_a)->pdata == NULL) {
+        RT_TRY(mcn_advertise(MCN_HUB(test_mcn_ws_a), NULL));
+    }
+    if (MCN_HUB(test_mcn_ws_b)->pdata == NULL) {
+        RT_TRY(mcn_advertise(MCN_HUB(test_mcn_ws_b), NULL));
+    }
+    if (MCN_HUB(test_mcn_inst0)->pdata == NULL) {
+        RT_TRY(mcn_advertise(MCN_HUB(test_mcn_inst0), NULL));
+    }
+    if (MCN_HUB(test_mcn_inst1)->pdata == NULL) {
+        RT_TRY(mcn_advertise(MCN_HUB(test_mcn_inst1), NULL));
+    }
+    for (int i = 0; i < sizeof(reg_hubs) / sizeof(McnHub_t); i++) {
+        if (reg_hubs[i]->pdata == NULL) {
+            RT_TRY(mcn_advertise(reg_hubs[i], NULL));
+        }
+    }
+
+    return rt_sem_init(&publisher_exit, "mcn_pub", 0, RT_IPC_FLAG_FIFO);
+}
+
+static rt_err_t testcase_cleanup(void)
+{
+    return rt_sem_detach(&publisher_exit);
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_seqlock_consistency);
+    UTEST_UNIT_RUN(test_publish_busy);
+    UTEST_UNIT_RUN(test_queue_copy_n);
+    UTEST_UNIT_RUN(test_loan_borrow);
+    UTEST_UNIT_RUN(test_registry_lookup);
+    UTEST_UNIT_RUN(test_waitset);
+    UTEST_UNIT_RUN(test_throttle);
+    UTEST_UNIT_RUN(test_profile);
+    UTEST_UNIT_RUN(test_deferred_dispatch);
+    UTEST_UNIT_RUN(test_multi_instance);
+    UTEST_UNIT_RUN(test_record_replay);
+    UTEST_UNIT_RUN(test_schema);
+}
+UTEST_TC_EXPORT(testcase, "unit_test.uMCN", testcase_init, testcase_cleanup, 10);
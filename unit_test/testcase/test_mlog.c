@@ -0,0 +1,739 @@
+/******************************************************************************
+ * Copyright 2021 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#include <firmament.h>
+#include <dfs_posix.h>
+#include <string.h>
+
+#include <utest.h>
+
+#include "module/log/mlog.h"
+
+#define TEST_LOG_FILE       "/test_mlog.bin"
+#define TEST_RECOVER_FILE   "/test_mlog_recover.bin"
+#define TEST_MSG_ID         0xFE
+#define TEST_MSG_MAGIC      0x474F4C4D
+#define TEST_BENCH_LOOPS    1000
+#define TEST_PRODUCER_NUM   3
+#define TEST_PRODUCER_MSGS  2000
+#define TEST_STOP_TIMEOUT   5000
+#define TEST_FRAME_NUM      16
+#define TEST_FRAME_MAX_SIZE 32768
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint8_t producer;
+    /* frame size does not divide sector size, so frames also cross sector boundary */
+    uint8_t payload[41];
+} test_msg_t;
+
+/* header of variable size frame, followed by pattern bytes */
+typedef struct {
+    uint32_t magic;
+    uint32_t len;
+    uint32_t seq;
+} test_frame_t;
+
+static struct rt_semaphore producer_exit;
+static uint32_t producer_sent[TEST_PRODUCER_NUM];
+static const uint32_t frame_size[] = { 12, 64, 512, 4093, 4096, 8192, 12345, TEST_FRAME_MAX_SIZE };
+
+static void producer_entry(void* parameter)
+{
+    uint8_t id = (uint8_t)(uint32_t)parameter;
+    test_msg_t msg = { .magic = TEST_MSG_MAGIC, .producer = id };
+
+    for (uint32_t i = 0; i < TEST_PRODUCER_MSGS; i++) {
+        memset(msg.payload, msg.seq, sizeof(msg.payload));
+        if (mlog_push_msg((uint8_t*)&msg, TEST_MSG_ID, sizeof(msg)) == FMT_EOK) {
+            msg.seq++;
+        }
+        /* give logger task a chance to drain the buffer */
+        if (i % 20 == 0) {
+            rt_thread_delay(1);
+        }
+    }
+    producer_sent[id] = msg.seq;
+
+    rt_sem_release(&producer_exit);
+}
+
+/* Replica of the write path before reserve/commit: a mutex per message, header
+ * written byte by byte, then the payload. It's only used as baseline of the
+ * per-message cost, so the sector callback is left out. */
+static struct {
+    struct rt_mutex lock;
+    uint8_t* data;
+    uint32_t head;
+    uint32_t index;
+} baseline;
+
+static void baseline_putc(uint8_t ch)
+{
+    if (MLOG_SECTOR_SIZE - baseline.index < 1) {
+        baseline.head = (baseline.head + 1) % 2;
+        baseline.index = 0;
+    }
+    baseline.data[baseline.head * MLOG_SECTOR_SIZE + baseline.index] = ch;
+    baseline.index += 1;
+}
+
+static void baseline_write(const uint8_t* data, uint16_t len)
+{
+    uint32_t free_space_in_sector = MLOG_SECTOR_SIZE - baseline.index;
+
+    if (free_space_in_sector < len) {
+        memcpy(&baseline.data[baseline.head * MLOG_SECTOR_SIZE + baseline.index], data, free_space_in_sector);
+        baseline.head = (baseline.head + 1) % 2;
+        baseline.index = 0;
+        memcpy(&baseline.data[baseline.head * MLOG_SECTOR_SIZE], &data[free_space_in_sector], len - free_space_in_sector);
+        baseline.index += len - free_space_in_sector;
+    } else {
+        memcpy(&baseline.data[baseline.head * MLOG_SECTOR_SIZE + baseline.index], data, len);
+        baseline.index += len;
+    }
+}
+
+static void baseline_push_msg(const uint8_t* payload, uint8_t msg_id, uint16_t len)
+{
+    rt_mutex_take(&baseline.lock, RT_WAITING_FOREVER);
+    baseline_putc(MLOG_BEGIN_MSG1);
+    baseline_putc(MLOG_BEGIN_MSG2);
+    baseline_putc(msg_id);
+    baseline_write(payload, len);
+    baseline_putc(MLOG_END_MSG);
+    rt_mutex_release(&baseline.lock);
+}
+
+static fmt_err_t wait_mlog_idle(void)
+{
+    for (int i = 0; i < TEST_STOP_TIMEOUT / 10; i++) {
+        if (mlog_get_status() == MLOG_STATUS_IDLE) {
+            return FMT_EOK;
+        }
+        rt_thread_delay(RT_TICK_PER_SECOND / 100);
+    }
+
+    return FMT_ETIMEOUT;
+}
+
+/* push frame and retry until logger task drains the buffer */
+static fmt_err_t push_frame(uint8_t* payload, uint32_t len, uint8_t scatter)
+{
+    fmt_err_t err;
+
+    for (int i = 0; i < TEST_STOP_TIMEOUT; i++) {
+        if (scatter) {
+            /* header, and the pattern split into two pieces */
+            mlog_iovec_t iov[3] = {
+                { payload, sizeof(test_frame_t) },
+                { &payload[sizeof(test_frame_t)], (len - sizeof(test_frame_t)) / 2 },
+                { &payload[sizeof(test_frame_t) + (len - sizeof(test_frame_t)) / 2], (len - sizeof(test_frame_t) + 1) / 2 },
+            };
+            err = mlog_push_msgv(TEST_MSG_ID, iov, 3);
+        } else {
+            err = mlog_push_msg(payload, TEST_MSG_ID, len);
+        }
+
+        if (err != FMT_EFULL) {
+            return err;
+        }
+        rt_thread_delay(1);
+    }
+
+    return FMT_ETIMEOUT;
+}
+
+static void test_large_frame(void)
+{
+    uint8_t* payload;
+    uint8_t* chunk;
+    uint8_t window[3 + sizeof(test_frame_t)] = { 0 };
+    test_frame_t frame = { .magic = TEST_MSG_MAGIC };
+    uint32_t body_index = 0;
+    uint32_t recv_seq = 0;
+    uint16_t sum = 0;
+    int chunk_len;
+    int fd;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+
+    payload = rt_malloc(TEST_FRAME_MAX_SIZE);
+    chunk = rt_malloc(512);
+    uassert_not_null(payload);
+    uassert_not_null(chunk);
+    if (payload == NULL || chunk == NULL) {
+        goto out;
+    }
+
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+
+    for (int n = 0; n < sizeof(frame_size) / sizeof(uint32_t); n++) {
+        uint64_t push_time = 0;
+
+        frame.len = frame_size[n];
+        for (int k = 0; k < TEST_FRAME_NUM; k++) {
+            uint64_t start;
+
+            memcpy(payload, &frame, sizeof(frame));
+            for (uint32_t i = sizeof(frame); i < frame.len; i++) {
+                payload[i] = (uint8_t)(frame.seq + i);
+            }
+
+            start = systime_now_us();
+            uassert_int_equal(push_frame(payload, frame.len, k & 1), FMT_EOK);
+            push_time += systime_now_us() - start;
+            frame.seq++;
+        }
+        /* includes the time waiting for buffer space */
+        console_printf("mlog push %ld bytes frame: %ldus/msg, %ld KB/s\n", frame.len, (uint32_t)(push_time / TEST_FRAME_NUM),
+            push_time ? (uint32_t)((uint64_t)frame.len * TEST_FRAME_NUM * 1000000 / 1024 / push_time) : 0);
+    }
+
+    /* frame larger than the whole buffer is rejected, its pieces all refer to the payload */
+    {
+        mlog_iovec_t iov[MLOG_BUFFER_SIZE / TEST_FRAME_MAX_SIZE + 1];
+        uint32_t remain = MLOG_BUFFER_SIZE + 1;
+
+        for (int i = 0; i < sizeof(iov) / sizeof(mlog_iovec_t); i++) {
+            iov[i].base = payload;
+            iov[i].len = remain < TEST_FRAME_MAX_SIZE ? remain : TEST_FRAME_MAX_SIZE;
+            remain -= iov[i].len;
+        }
+        uassert_int_equal(remain, 0);
+        uassert_int_equal(mlog_push_msgv(TEST_MSG_ID, iov, sizeof(iov) / sizeof(mlog_iovec_t)), FMT_EINVAL);
+    }
+
+    mlog_stop();
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+
+    /* scan frames and check the pattern */
+    fd = open(TEST_LOG_FILE, O_RDONLY);
+    uassert_true(fd >= 0);
+    if (fd < 0) {
+        goto out;
+    }
+
+    while ((chunk_len = read(fd, chunk, 512)) > 0) {
+        for (int k = 0; k < chunk_len; k++) {
+            if (body_index) {
+                /* inside frame body */
+                if (body_index < frame.len) {
+                    uassert_int_equal(chunk[k], (uint8_t)(frame.seq + body_index));
+                    sum = mlog_checksum(sum, &chunk[k], 1);
+                } else if (body_index == frame.len) {
+                    uassert_int_equal(chunk[k], sum & 0xFF);
+                } else if (body_index == frame.len + 1) {
+                    uassert_int_equal(chunk[k], sum >> 8);
+                } else {
+                    uassert_int_equal(chunk[k], MLOG_END_MSG);
+                    recv_seq++;
+                    body_index = 0;
+                    continue;
+                }
+                body_index++;
+                continue;
+            }
+
+            memmove(window, &window[1], sizeof(window) - 1);
+            window[sizeof(window) - 1] = chunk[k];
+            if (window[0] != MLOG_BEGIN_MSG1 || window[1] != MLOG_BEGIN_MSG2 || window[2] != TEST_MSG_ID) {
+                continue;
+            }
+            memcpy(&frame, &window[3], sizeof(frame));
+            if (frame.magic != TEST_MSG_MAGIC || frame.len < sizeof(frame)) {
+                continue;
+            }
+
+            uassert_int_equal(frame.seq, recv_seq);
+            body_index = sizeof(frame);
+            /* msg id and frame header */
+            sum = mlog_checksum(0, &window[2], sizeof(window) - 2);
+            memset(window, 0, sizeof(window));
+        }
+    }
+    close(fd);
+    unlink(TEST_LOG_FILE);
+
+    uassert_int_equal(recv_seq, TEST_FRAME_NUM * sizeof(frame_size) / sizeof(uint32_t));
+
+out:
+    rt_free(payload);
+    rt_free(chunk);
+}
+
+static void test_push_concurrent(void)
+{
+    uint32_t recv[TEST_PRODUCER_NUM] = { 0 };
+    uint8_t frame[sizeof(test_msg_t) + MLOG_FRAME_OVERHEAD];
+    uint8_t chunk[512];
+    int chunk_len;
+    test_msg_t msg = { .magic = TEST_MSG_MAGIC, .producer = TEST_PRODUCER_NUM };
+    uint64_t start;
+    uint32_t bench_time, baseline_time, bench_num = 0;
+    uint32_t match = 0;
+    int fd;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+
+    /* per-message cost of the previous write path, on the same target */
+    baseline.data = (uint8_t*)rt_malloc(2 * MLOG_SECTOR_SIZE);
+    uassert_not_null(baseline.data);
+    if (baseline.data == NULL) {
+        return;
+    }
+    baseline.head = 0;
+    baseline.index = 0;
+    rt_mutex_init(&baseline.lock, "mlog_bl", RT_IPC_FLAG_FIFO);
+    start = systime_now_us();
+    for (int i = 0; i < TEST_BENCH_LOOPS; i++) {
+        baseline_push_msg((uint8_t*)&msg, TEST_MSG_ID, sizeof(msg));
+    }
+    baseline_time = systime_now_us() - start;
+    rt_mutex_detach(&baseline.lock);
+    rt_free(baseline.data);
+
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+
+    /* per-message cost without contention */
+    start = systime_now_us();
+    for (int i = 0; i < TEST_BENCH_LOOPS; i++) {
+        if (mlog_push_msg((uint8_t*)&msg, TEST_MSG_ID, sizeof(msg)) == FMT_EOK) {
+            bench_num++;
+        }
+    }
+    bench_time = systime_now_us() - start;
+    console_printf("mlog push %d bytes msg: before %ldns/msg (mutex), after %ldns/msg (reserve/commit)\n",
+                   sizeof(msg), baseline_time * 1000 / TEST_BENCH_LOOPS, bench_time * 1000 / TEST_BENCH_LOOPS);
+
+    /* producers with different priorities preempt each other */
+    for (int i = 0; i < TEST_PRODUCER_NUM; i++) {
+        rt_thread_t tid = rt_thread_create("mlog_pd", producer_entry, (void*)i, 1024, RT_THREAD_PRIORITY_MAX - 4 + i, 1);
+
+        uassert_not_null(tid);
+        rt_thread_startup(tid);
+    }
+    for (int i = 0; i < TEST_PRODUCER_NUM; i++) {
+        rt_sem_take(&producer_exit, RT_WAITING_FOREVER);
+    }
+
+    mlog_stop();
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+
+    /* every frame is complete and in order of each producer */
+    fd = open(TEST_LOG_FILE, O_RDONLY);
+    uassert_true(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+
+    memset(frame, 0, sizeof(frame));
+    while ((chunk_len = read(fd, chunk, sizeof(chunk))) > 0) {
+        for (int k = 0; k < chunk_len; k++) {
+            test_msg_t recv_msg;
+
+            /* slide the window by one byte */
+            memmove(frame, &frame[1], sizeof(frame) - 1);
+            frame[sizeof(frame) - 1] = chunk[k];
+
+            if (frame[0] != MLOG_BEGIN_MSG1 || frame[1] != MLOG_BEGIN_MSG2 || frame[2] != TEST_MSG_ID) {
+                continue;
+            }
+            memcpy(&recv_msg, &frame[3], sizeof(recv_msg));
+            if (recv_msg.magic != TEST_MSG_MAGIC) {
+                continue;
+            }
+
+            uassert_int_equal(frame[sizeof(frame) - 1], MLOG_END_MSG);
+            uassert_int_equal(mlog_checksum(0, &frame[2], sizeof(recv_msg) + 1),
+                frame[sizeof(frame) - 3] | frame[sizeof(frame) - 2] << 8);
+            if (recv_msg.producer < TEST_PRODUCER_NUM) {
+                uassert_int_equal(recv_msg.seq, recv[recv_msg.producer]);
+                uassert_int_equal(recv_msg.payload[sizeof(recv_msg.payload) - 1], (uint8_t)recv_msg.seq);
+                recv[recv_msg.producer]++;
+            }
+            match++;
+        }
+    }
+    close(fd);
+    unlink(TEST_LOG_FILE);
+
+    uassert_int_equal(match, bench_num + producer_sent[0] + producer_sent[1] + producer_sent[2]);
+    for (int i = 0; i < TEST_PRODUCER_NUM; i++) {
+        uassert_int_equal(recv[i], producer_sent[i]);
+    }
+}
+
+static void test_bus_stat(void)
+{
+    uint8_t payload[32] = { 0 };
+    uint16_t period = mlog_get_bus_rate(MLOG_MAG_ID);
+    mlog_stat_t stat;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+
+    uassert_int_equal(mlog_get_bus_stat(TEST_MSG_ID, &stat), FMT_EINVAL);
+    /* log every msg whatever the profile is */
+    uassert_int_equal(mlog_set_bus_rate(MLOG_MAG_ID, 0), FMT_EOK);
+
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+    for (int i = 0; i < 10; i++) {
+        uassert_int_equal(mlog_push_msg(payload, MLOG_MAG_ID, sizeof(payload)), FMT_EOK);
+    }
+    uassert_int_equal(mlog_get_bus_stat(MLOG_MAG_ID, &stat), FMT_EOK);
+    mlog_statistic();
+    mlog_stop();
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+    unlink(TEST_LOG_FILE);
+    mlog_set_bus_rate(MLOG_MAG_ID, period);
+
+    /* mag may also be logged by ins meanwhile */
+    uassert_true(stat.total_msg >= 10);
+    uassert_true(stat.total_byte >= 10 * (sizeof(payload) + 4));
+    uassert_true(stat.last_timestamp != 0);
+}
+
+/* padding after flag, which is not described by any field */
+typedef struct {
+    uint32_t timestamp;
+    uint8_t flag;
+    float value;
+} test_bus_t;
+
+typedef struct {
+    uint32_t timestamp;
+    uint32_t value;
+} test_pair_t;
+
+static void test_bus_schema(void)
+{
+    McnField padded_field[] = {
+        MCN_FIELD(test_bus_t, timestamp, MCN_UINT32),
+        MCN_FIELD(test_bus_t, flag, MCN_UINT8),
+        MCN_FIELD(test_bus_t, value, MCN_FLOAT),
+    };
+    McnSchema padded = { "padded", sizeof(test_bus_t), 3, padded_field };
+    /* value is not described */
+    McnSchema partial = { "partial", sizeof(test_bus_t), 2, padded_field };
+    /* fields cover the struct, but not in offset order */
+    McnField unordered_field[] = {
+        MCN_FIELD(test_pair_t, value, MCN_UINT32),
+        MCN_FIELD(test_pair_t, timestamp, MCN_UINT32),
+    };
+    McnSchema unordered = { "unordered", sizeof(test_pair_t), 2, unordered_field };
+
+    uassert_int_equal(mlog_register_bus_schema(MLOG_IMU_ID, &padded), FMT_EINVAL);
+    uassert_int_equal(mlog_register_bus_schema(MLOG_IMU_ID, &partial), FMT_EINVAL);
+    uassert_int_equal(mlog_register_bus_schema(MLOG_IMU_ID, &unordered), FMT_EINVAL);
+    uassert_int_equal(mlog_register_bus_schema(TEST_MSG_ID, &padded), FMT_EINVAL);
+}
+
+static void test_bus_rate(void)
+{
+    uint8_t payload[32] = { 0 };
+    uint16_t period = mlog_get_bus_rate(MLOG_BARO_ID);
+    uint32_t logged = 0;
+    mlog_stat_t stat;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+
+    uassert_int_equal(mlog_set_profile("unknown"), FMT_EINVAL);
+    uassert_int_equal(mlog_set_bus_rate(TEST_MSG_ID, 0), FMT_EINVAL);
+
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+
+    /* disabled bus is dropped before it reaches the buffer */
+    uassert_int_equal(mlog_set_bus_rate(MLOG_BARO_ID, MLOG_RATE_OFF), FMT_EOK);
+    uassert_int_equal(mlog_push_msg(payload, MLOG_BARO_ID, sizeof(payload)), FMT_ENOTHANDLE);
+
+    /* logged at most once every 50ms */
+    uassert_int_equal(mlog_set_bus_rate(MLOG_BARO_ID, 50), FMT_EOK);
+    for (int i = 0; i < 20; i++) {
+        if (mlog_push_msg(payload, MLOG_BARO_ID, sizeof(payload)) == FMT_EOK) {
+            logged++;
+        }
+        rt_thread_delay(TICKS_FROM_MS(10));
+    }
+    uassert_in_range(logged, 3, 5);
+    uassert_int_equal(mlog_get_bus_stat(MLOG_BARO_ID, &stat), FMT_EOK);
+    uassert_true(stat.skip_msg >= 21 - logged);
+
+    mlog_stop();
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+    unlink(TEST_LOG_FILE);
+    mlog_set_bus_rate(MLOG_BARO_ID, period);
+}
+
+static void test_index_record(void)
+{
+    uint8_t payload[32] = { 0 };
+    uint16_t period = mlog_get_bus_rate(MLOG_MAG_ID);
+    /* index record header and offsets of the first two buses, IMU and MAG */
+    uint8_t window[3 + sizeof(mlog_index_t) + 2 * sizeof(uint32_t)] = { 0 };
+    uint8_t chunk[256];
+    uint32_t index_num = 0;
+    int chunk_len;
+    int fd;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+
+    /* index id is reserved */
+    uassert_int_equal(mlog_push_msg(payload, MLOG_INDEX_ID, sizeof(payload)), FMT_EINVAL);
+
+    uassert_int_equal(mlog_set_bus_rate(MLOG_MAG_ID, 0), FMT_EOK);
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+    for (int i = 0; i < 5; i++) {
+        uassert_int_equal(mlog_push_msg(payload, MLOG_MAG_ID, sizeof(payload)), FMT_EOK);
+        rt_thread_delay(TICKS_FROM_MS(100));
+    }
+    mlog_stop();
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+    mlog_set_bus_rate(MLOG_MAG_ID, period);
+
+    fd = open(TEST_LOG_FILE, O_RDONLY);
+    uassert_true(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+
+    while ((chunk_len = read(fd, chunk, sizeof(chunk))) > 0) {
+        for (int k = 0; k < chunk_len; k++) {
+            mlog_index_t index;
+            uint32_t mag_offset;
+            uint8_t begin[3];
+            int fd2;
+
+            memmove(window, &window[1], sizeof(window) - 1);
+            window[sizeof(window) - 1] = chunk[k];
+            if (window[0] != MLOG_BEGIN_MSG1 || window[1] != MLOG_BEGIN_MSG2 || window[2] != MLOG_INDEX_ID) {
+                continue;
+            }
+            memcpy(&index, &window[3], sizeof(index));
+            if (index.magic != MLOG_INDEX_MAGIC) {
+                continue;
+            }
+            uassert_int_equal(index.seq, index_num);
+            index_num++;
+
+            /* the last MAG frame is where the offset points to */
+            memcpy(&mag_offset, &window[3 + sizeof(index) + sizeof(uint32_t)], sizeof(mag_offset));
+            if (mag_offset == MLOG_OFFSET_NONE) {
+                continue;
+            }
+            fd2 = open(TEST_LOG_FILE, O_RDONLY);
+            uassert_true(fd2 >= 0 && lseek(fd2, mag_offset, SEEK_SET) == mag_offset);
+            uassert_int_equal(read(fd2, begin, sizeof(begin)), sizeof(begin));
+            uassert_true(begin[0] == MLOG_BEGIN_MSG1 && begin[1] == MLOG_BEGIN_MSG2 && begin[2] == MLOG_MAG_ID);
+            close(fd2);
+        }
+    }
+    close(fd);
+    unlink(TEST_LOG_FILE);
+
+    /* written every 100ms */
+    uassert_true(index_num >= 3);
+}
+
+static uint32_t hist_sum(const uint32_t* hist)
+{
+    uint32_t sum = 0;
+
+    for (int i = 0; i < MLOG_LAT_BUCKET_NUM; i++) {
+        sum += hist[i];
+    }
+
+    return sum;
+}
+
+static void test_prealloc(void)
+{
+    uint8_t payload[200] = { 0 };
+    int32_t prealloc = PARAM_GET_INT32(SYSTEM, MLOG_PREALLOC);
+    int32_t sync_ms = PARAM_GET_INT32(SYSTEM, MLOG_SYNC_MS);
+    int32_t val;
+    mlog_io_stat_t io;
+    struct stat st;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+
+    /* preallocate 1MB, which is extended once by ~1.2MB data */
+    val = 1;
+    param_set_val(&PARAM_GET(SYSTEM, MLOG_PREALLOC), &val);
+    val = 200;
+    param_set_val(&PARAM_GET(SYSTEM, MLOG_SYNC_MS), &val);
+
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+    for (int i = 0; i < 6000; i++) {
+        /* test bus is always logged, retry if buffer is full */
+        while (mlog_push_msg(payload, TEST_MSG_ID, sizeof(payload)) == FMT_EFULL) {
+            rt_thread_delay(1);
+        }
+    }
+    mlog_stop();
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+
+    mlog_get_io_stat(&io);
+    mlog_statistic();
+    uassert_int_equal(io.drop_sector, 0);
+    uassert_true(io.write_byte >= 6000 * (sizeof(payload) + 4));
+#ifdef RT_FIOFTRUNCATE
+    /* preallocated at start and extended once */
+    uassert_true(io.alloc_byte >= 2 * 1024 * 1024);
+    uassert_int_equal(io.alloc_num, 2);
+#else
+    /* preallocation is refused, since the file can not be trimmed at stop */
+    uassert_int_equal(io.alloc_byte, 0);
+    uassert_int_equal(io.alloc_num, 0);
+#endif
+    uassert_true(hist_sum(io.write_hist) > 0);
+    uassert_true(hist_sum(io.sync_hist) > 0);
+    uassert_true(io.peak_sector > 0 && io.peak_sector <= MLOG_BUFFER_SIZE / MLOG_SECTOR_SIZE);
+
+    uassert_int_equal(stat(TEST_LOG_FILE, &st), 0);
+    uassert_true(st.st_size >= io.write_byte);
+#ifdef RT_FIOFTRUNCATE
+    /* unused preallocated space is trimmed */
+    uassert_true(st.st_size < io.alloc_byte);
+#else
+    uassert_true(st.st_size < 2 * 1024 * 1024);
+#endif
+    unlink(TEST_LOG_FILE);
+
+    param_set_val(&PARAM_GET(SYSTEM, MLOG_PREALLOC), &prealloc);
+    param_set_val(&PARAM_GET(SYSTEM, MLOG_SYNC_MS), &sync_ms);
+}
+
+#ifdef FMT_USING_MLOG_PERSIST
+static void test_recover(void)
+{
+    rt_thread_t self = rt_thread_self();
+    rt_uint8_t priority = self->current_priority;
+    rt_uint8_t high_priority = LOGGER_THREAD_PRIORITY - 1;
+    uint8_t frame[sizeof(test_msg_t) + MLOG_FRAME_OVERHEAD] = { 0 };
+    uint8_t chunk[512];
+    int chunk_len;
+    test_msg_t msg = { .magic = TEST_MSG_MAGIC, .producer = 0 };
+    uint32_t recv_seq = 0;
+    int fd;
+
+    if (mlog_get_status() != MLOG_STATUS_IDLE) {
+        console_printf("mlog is busy, skip test\n");
+        return;
+    }
+    /* nothing is left by the tests before */
+    uassert_int_equal(mlog_recover(TEST_RECOVER_FILE), FMT_EEMPTY);
+
+    /* logger task can't write buffer until the test gives up cpu */
+    rt_thread_control(self, RT_THREAD_CTRL_CHANGE_PRIORITY, &high_priority);
+    uassert_int_equal(mlog_start(TEST_LOG_FILE), FMT_EOK);
+    /* fill the ring, the last sector is partially filled */
+    for (;;) {
+        memset(msg.payload, msg.seq, sizeof(msg.payload));
+        if (mlog_push_msg((uint8_t*)&msg, TEST_MSG_ID, sizeof(msg)) != FMT_EOK) {
+            break;
+        }
+        msg.seq++;
+    }
+    /* stopped as a reset, head and tail of buffer are left persisted */
+    mlog_abort();
+    rt_thread_control(self, RT_THREAD_CTRL_CHANGE_PRIORITY, &priority);
+    uassert_int_equal(wait_mlog_idle(), FMT_EOK);
+    uassert_true(msg.seq * sizeof(frame) > MLOG_BUFFER_SIZE - 2 * MLOG_SECTOR_SIZE);
+
+    uassert_int_equal(mlog_recover(TEST_RECOVER_FILE), FMT_EOK);
+    /* recovered only once */
+    uassert_int_equal(mlog_recover(TEST_RECOVER_FILE), FMT_EEMPTY);
+
+    /* every frame pushed is recovered in order */
+    fd = open(TEST_RECOVER_FILE, O_RDONLY);
+    uassert_true(fd >= 0);
+    if (fd < 0) {
+        goto out;
+    }
+    while ((chunk_len = read(fd, chunk, sizeof(chunk))) > 0) {
+        for (int k = 0; k < chunk_len; k++) {
+            test_msg_t recv_msg;
+
+            memmove(frame, &frame[1], sizeof(frame) - 1);
+            frame[sizeof(frame) - 1] = chunk[k];
+
+            if (frame[0] != MLOG_BEGIN_MSG1 || frame[1] != MLOG_BEGIN_MSG2 || frame[2] != TEST_MSG_ID) {
+                continue;
+            }
+            memcpy(&recv_msg, &frame[3], sizeof(recv_msg));
+            if (recv_msg.magic != TEST_MSG_MAGIC) {
+                continue;
+            }
+
+            uassert_int_equal(frame[sizeof(frame) - 1], MLOG_END_MSG);
+            uassert_int_equal(mlog_checksum(0, &frame[2], sizeof(recv_msg) + 1),
+                frame[sizeof(frame) - 3] | frame[sizeof(frame) - 2] << 8);
+            uassert_int_equal(recv_msg.seq, recv_seq);
+            uassert_int_equal(recv_msg.payload[sizeof(recv_msg.payload) - 1], (uint8_t)recv_msg.seq);
+            recv_seq++;
+        }
+    }
+    close(fd);
+    uassert_int_equal(recv_seq, msg.seq);
+
+out:
+    unlink(TEST_RECOVER_FILE);
+    unlink(TEST_LOG_FILE);
+}
+#endif
+
+static rt_err_t testcase_init(void)
+{
+    return rt_sem_init(&producer_exit, "mlog_pd", 0, RT_IPC_FLAG_FIFO);
+}
+
+static rt_err_t testcase_cleanup(void)
+{
+    return rt_sem_detach(&producer_exit);
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_push_concurrent);
+    UTEST_UNIT_RUN(test_large_frame);
+    UTEST_UNIT_RUN(test_bus_stat);
+    UTEST_UNIT_RUN(test_bus_schema);
+    UTEST_UNIT_RUN(test_bus_rate);
+    UTEST_UNIT_RUN(test_index_record);
+    UTEST_UNIT_RUN(test_prealloc);
+#ifdef FMT_USING_MLOG_PERSIST
+    UTEST_UNIT_RUN(test_recover);
+#endif
+}
+UTEST_TC_EXPORT(testcase, "unit_test.mlog", testcase_init, testcase_cleanup, 30);